@@ -7715,6 +7715,11 @@ namespace Legion {
        *              This allows control over the granularity so they
        *              can be made small enough to interleave with other
        *              runtime work. The default is 100 (us).
+       * -lg:prof_inflight <int> The maximum amount of profiling data in
+       *              MBs waiting to be compressed and written out by the
+       *              profiler's background writer thread. Threads dumping
+       *              profiling data block once this much is queued.
+       *              The default is 64 (MB).
        *
        * @param argc the number of input arguments
        * @param argv pointer to an array of string arguments of size argc
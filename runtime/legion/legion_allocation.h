@@ -27,6 +27,9 @@
 #include <stddef.h>
 #include <functional>
 #include <stdlib.h>
+#if defined(LEGION_SLAB_ALLOCATION) && defined(TRACE_ALLOCATION)
+#include <typeinfo>
+#endif
 #include "legion/legion_config.h"
 #include "legion/legion_template_help.h" // StaticAssert
 #if __cplusplus >= 201103L
@@ -303,6 +306,198 @@ namespace Legion {
       free(ptr);
     }
 
+#ifdef LEGION_SLAB_ALLOCATION
+#ifdef TRACE_ALLOCATION
+    /**
+     * \struct SlabAllocationStats
+     * Counters for a slab allocator, reported along with the
+     * rest of the allocation tracing information
+     */
+    struct SlabAllocationStats {
+    public:
+      // Only zero-initialized so that it is usable during static
+      // initialization, the rest is filled in on registration
+      void register_stats(const char *name, size_t object_size);
+    public:
+      const char *name;
+      size_t object_size;
+      unsigned long long cache_hits;
+      unsigned long long cache_refills;
+      unsigned long long global_returns;
+      unsigned long long slabs;
+      unsigned long long fallbacks;
+      SlabAllocationStats *next;
+      bool registered;
+    public:
+      // Implementation in runtime.cc
+      static SlabAllocationStats *registry;
+    };
+#endif
+
+    /**
+     * \class SlabAllocator
+     * A per-type pool of objects of a single size. Each thread
+     * keeps its own cache of free objects so that allocation
+     * and deallocation usually touch no shared state. When a
+     * thread's cache gets too large, a batch of objects is
+     * returned to a global pool for the type, which is also
+     * where threads go to refill their caches before carving
+     * up a new slab. Slabs are never returned to the system.
+     * Allocations of any other size (e.g. derived types that do
+     * not have their own LegionHeapify) go straight to malloc.
+     */
+    template<typename T>
+    class SlabAllocator {
+    public:
+      struct FreeObject {
+        FreeObject *next;
+        // only valid for the first object in a batch in the global pool
+        FreeObject *next_batch;
+      };
+      static const size_t ALIGNMENT = AlignmentTrait<T>::AlignmentOf;
+      static const size_t MIN_SIZE = (sizeof(T) < sizeof(FreeObject)) ?
+                                      sizeof(FreeObject) : sizeof(T);
+      static const size_t OBJECT_SIZE = 
+        ((MIN_SIZE + ALIGNMENT - 1) / ALIGNMENT) * ALIGNMENT;
+      static const size_t BATCH_SIZE = LEGION_SLAB_BATCH_SIZE;
+    public:
+      static inline void* allocate(size_t size);
+      static inline void deallocate(void *ptr, size_t size);
+    protected:
+      static FreeObject* refill_cache(void);
+      static void return_batch(void);
+    protected:
+      static __thread FreeObject *cache;
+      static __thread size_t cache_size;
+      static FreeObject *global_batches;
+      static volatile int global_lock;
+#ifdef TRACE_ALLOCATION
+      static SlabAllocationStats stats;
+#endif
+    };
+
+    template<typename T>
+    __thread typename SlabAllocator<T>::FreeObject* 
+      SlabAllocator<T>::cache = NULL;
+    template<typename T>
+    __thread size_t SlabAllocator<T>::cache_size = 0;
+    template<typename T>
+    typename SlabAllocator<T>::FreeObject* 
+      SlabAllocator<T>::global_batches = NULL;
+    template<typename T>
+    volatile int SlabAllocator<T>::global_lock = 0;
+#ifdef TRACE_ALLOCATION
+    template<typename T>
+    SlabAllocationStats SlabAllocator<T>::stats;
+#endif
+
+    //--------------------------------------------------------------------------
+    template<typename T>
+    /*static*/ inline void* SlabAllocator<T>::allocate(size_t size)
+    //--------------------------------------------------------------------------
+    {
+      if (size != sizeof(T))
+      {
+#ifdef TRACE_ALLOCATION
+        __sync_fetch_and_add(&stats.fallbacks, 1);
+#endif
+        return legion_alloc_aligned<T,true/*bytes*/>(size);
+      }
+      FreeObject *result = cache;
+      if (result == NULL)
+        result = refill_cache();
+#ifdef TRACE_ALLOCATION
+      else
+        __sync_fetch_and_add(&stats.cache_hits, 1);
+#endif
+      cache = result->next;
+      cache_size--;
+      return result;
+    }
+
+    //--------------------------------------------------------------------------
+    template<typename T>
+    /*static*/ inline void SlabAllocator<T>::deallocate(void *ptr, size_t size)
+    //--------------------------------------------------------------------------
+    {
+      if (size != sizeof(T))
+      {
+        free(ptr);
+        return;
+      }
+      FreeObject *object = static_cast<FreeObject*>(ptr);
+      object->next = cache;
+      cache = object;
+      if (++cache_size >= (2 * BATCH_SIZE))
+        return_batch();
+    }
+
+    //--------------------------------------------------------------------------
+    template<typename T>
+    /*static*/ typename SlabAllocator<T>::FreeObject* 
+                                         SlabAllocator<T>::refill_cache(void)
+    //--------------------------------------------------------------------------
+    {
+      // See if there is a batch to take from the global pool first
+      while (__sync_lock_test_and_set(&global_lock, 1))
+        while (global_lock) { }
+      FreeObject *batch = global_batches;
+      if (batch != NULL)
+        global_batches = batch->next_batch;
+#ifdef TRACE_ALLOCATION
+      if (!stats.registered)
+        stats.register_stats(typeid(T).name(), OBJECT_SIZE);
+#endif
+      __sync_lock_release(&global_lock);
+#ifdef TRACE_ALLOCATION
+      __sync_fetch_and_add(&stats.cache_refills, 1);
+#endif
+      if (batch == NULL)
+      {
+        // Carve up a new slab
+        char *slab = static_cast<char*>(
+            legion_alloc_aligned<OBJECT_SIZE,ALIGNMENT,true/*bytes*/>(
+              BATCH_SIZE * OBJECT_SIZE));
+        for (unsigned idx = 0; idx < (BATCH_SIZE-1); idx++)
+          reinterpret_cast<FreeObject*>(slab + idx * OBJECT_SIZE)->next =
+            reinterpret_cast<FreeObject*>(slab + (idx+1) * OBJECT_SIZE);
+        reinterpret_cast<FreeObject*>(
+            slab + (BATCH_SIZE-1) * OBJECT_SIZE)->next = cache;
+        batch = reinterpret_cast<FreeObject*>(slab);
+#ifdef TRACE_ALLOCATION
+        __sync_fetch_and_add(&stats.slabs, 1);
+#endif
+      }
+      // batches always hold exactly BATCH_SIZE objects
+      cache = batch;
+      cache_size += BATCH_SIZE;
+      return batch;
+    }
+
+    //--------------------------------------------------------------------------
+    template<typename T>
+    /*static*/ void SlabAllocator<T>::return_batch(void)
+    //--------------------------------------------------------------------------
+    {
+      // Split off the first BATCH_SIZE objects and hand them back
+      FreeObject *batch = cache;
+      FreeObject *last = batch;
+      for (unsigned idx = 1; idx < BATCH_SIZE; idx++)
+        last = last->next;
+      cache = last->next;
+      cache_size -= BATCH_SIZE;
+      last->next = NULL;
+      while (__sync_lock_test_and_set(&global_lock, 1))
+        while (global_lock) { }
+      batch->next_batch = global_batches;
+      global_batches = batch;
+      __sync_lock_release(&global_lock);
+#ifdef TRACE_ALLOCATION
+      __sync_fetch_and_add(&stats.global_returns, 1);
+#endif
+    }
+#endif // LEGION_SLAB_ALLOCATION
+
     // A class for Legion objects to inherit from to have their dynamic
     // memory allocations managed for alignment and tracing
     template<typename T>
@@ -314,7 +509,12 @@ namespace Legion {
       static inline void* operator new(size_t count, void *ptr);
       static inline void* operator new[](size_t count, void *ptr);
     public:
+#ifdef LEGION_SLAB_ALLOCATION
+      // the slab allocator needs the size to know where an object came from
+      static inline void operator delete(void *ptr, size_t size);
+#else
       static inline void operator delete(void *ptr);
+#endif
       static inline void operator delete[](void *ptr);
     public:
       static inline void operator delete(void *ptr, void *place);
@@ -329,7 +529,11 @@ namespace Legion {
 #ifdef TRACE_ALLOCATION
       HandleAllocation<T,HasAllocType<T>::value>::trace_allocation();
 #endif
+#ifdef LEGION_SLAB_ALLOCATION
+      return SlabAllocator<T>::allocate(count);
+#else
       return legion_alloc_aligned<T,true/*bytes*/>(count);  
+#endif
     }
 
     //--------------------------------------------------------------------------
@@ -367,6 +571,19 @@ namespace Legion {
       return ptr;
     }
 
+#ifdef LEGION_SLAB_ALLOCATION
+    //--------------------------------------------------------------------------
+    template<typename T>
+    /*static*/ inline void LegionHeapify<T>::operator delete(void *ptr,
+                                                             size_t size)
+    //--------------------------------------------------------------------------
+    {
+#ifdef TRACE_ALLOCATION
+      HandleAllocation<T,HasAllocType<T>::value>::trace_free();
+#endif
+      SlabAllocator<T>::deallocate(ptr, size);
+    }
+#else
     //--------------------------------------------------------------------------
     template<typename T>
     /*static*/ inline void LegionHeapify<T>::operator delete(void *ptr)
@@ -377,6 +594,7 @@ namespace Legion {
 #endif
       free(ptr);
     }
+#endif
 
     //--------------------------------------------------------------------------
     template<typename T>
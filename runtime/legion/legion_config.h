@@ -332,6 +332,29 @@
 #define LEGION_DEFAULT_MAX_MESSAGE_SIZE        (DEFAULT_MAX_MESSAGE_SIZE)
 #endif
 #endif
+// Number of bytes buffered in a virtual channel after which the
+// channel is flushed even if no message asked for it, zero means
+// the channel is only flushed once its buffer is full
+#ifndef LEGION_DEFAULT_MESSAGE_FLUSH_BYTES
+#define LEGION_DEFAULT_MESSAGE_FLUSH_BYTES     0
+#endif
+// Longest time in microseconds that a message can be buffered in a
+// virtual channel before it is flushed, zero disables the adaptive
+// time-based flushing and the coalescing of explicit flushes
+#ifndef LEGION_DEFAULT_MESSAGE_MAX_DELAY
+#define LEGION_DEFAULT_MESSAGE_MAX_DELAY       0
+#endif
+// Bit mask of the virtual channel kinds in which explicit flushes
+// can be coalesced when messages are being sent at a high rate,
+// by default this is the reference (6) and update (7) channels
+#ifndef LEGION_DEFAULT_MESSAGE_COALESCE_MASK
+#define LEGION_DEFAULT_MESSAGE_COALESCE_MASK   ((1 << 6) | (1 << 7))
+#endif
+// Smallest buffer that Serializer::serialize_external will reference
+// instead of copying it into the serializer's own buffer
+#ifndef LEGION_MIN_EXTERNAL_SERIALIZE_BYTES
+#define LEGION_MIN_EXTERNAL_SERIALIZE_BYTES    1024
+#endif
 // Timeout before checking for whether a logical user
 // should be pruned from the logical region tree data strucutre
 // Making the value less than or equal to zero will
@@ -358,6 +381,17 @@
 #define LEGION_DEFAULT_GC_EPOCH_SIZE           (DEFAULT_GC_EPOCH_SIZE)
 #endif
 #endif
+// Number of subviews an ExprView must have before it builds a
+// bounding box index to find the subviews overlapping an expression
+#ifndef LEGION_EXPR_VIEW_INDEX_THRESHOLD
+#define LEGION_EXPR_VIEW_INDEX_THRESHOLD       32
+#endif
+// Largest number of entries that a FieldMaskSet keeps in a sorted
+// flat array before it switches over to a map, values less than
+// two mean that sets with multiple entries always use a map
+#ifndef LEGION_FIELD_MASK_SET_FLAT_ENTRIES
+#define LEGION_FIELD_MASK_SET_FLAT_ENTRIES     16
+#endif
 
 // Used for debugging memory leaks
 // How often tracing information is dumped
@@ -379,6 +413,17 @@
 #define LEGION_MAX_ALIGNMENT            16
 #endif
 
+// Objects that inherit from LegionHeapify can be allocated
+// out of per-type slabs with per-thread free lists instead
+// of going to malloc for each allocation. Uncomment (or
+// define on the command line) to enable it. The batch size
+// is the number of free objects moved between a thread's
+// cache and the global pool for the type at a time.
+//#define LEGION_SLAB_ALLOCATION
+#ifndef LEGION_SLAB_BATCH_SIZE
+#define LEGION_SLAB_BATCH_SIZE          64
+#endif
+
 // Give an ideal upper bound on the maximum
 // number of operations Legion should keep
 // available for recycling. Where possible
@@ -1228,6 +1273,7 @@ typedef enum legion_error_t {
   ERROR_ILLEGAL_LOCAL_FUNCTION_TASK_LAUNCH = 570,
   ERROR_ILLEGAL_SHARED_OWNERSHIP = 571,
   ERROR_CONFUSED_USER = 572,
+  ERROR_INVALID_SPY_FILE = 573,
   
 
   LEGION_WARNING_FUTURE_NONLEAF = 1000,
@@ -1287,6 +1333,7 @@ typedef enum legion_error_t {
   LEGION_WARNING_DUPLICATE_DELETION = 1101,
   LEGION_WARNING_NEW_TEMPLATE_COUNT_EXCEEDED = 1102,
   LEGION_WARNING_NON_CALLBACK_REGISTRATION = 1103,
+  LEGION_WARNING_TRACE_CACHE_FAILED = 1104,
   
   
   LEGION_FATAL_MUST_EPOCH_NOADDRESS = 2000,
@@ -330,6 +330,21 @@ namespace Legion {
     {
     }
 
+    //--------------------------------------------------------------------------
+    void Mapper::map_task_batch(const MapperContext ctx,
+                                const MapTaskBatchInput &input,
+                                      MapTaskBatchOutput &output)
+    //--------------------------------------------------------------------------
+    {
+#ifdef DEBUG_LEGION
+      assert(input.tasks.size() == input.inputs.size());
+      assert(input.tasks.size() == output.outputs.size());
+#endif
+      for (unsigned idx = 0; idx < input.tasks.size(); idx++)
+        map_task(ctx, *input.tasks[idx], input.inputs[idx], 
+                 output.outputs[idx]);
+    }
+
     /////////////////////////////////////////////////////////////
     // MapperRuntime
     /////////////////////////////////////////////////////////////
@@ -277,6 +277,21 @@ namespace Legion {
        * analysis done for mapping operations.
        */
       virtual bool request_valid_instances(void) const { return true; }
+    public:
+      /**
+       * ----------------------------------------------------------------------
+       *  Request Batched Map Task
+       * ----------------------------------------------------------------------
+       * Indicate whether the runtime should map all the point tasks of a 
+       * slice of an index space task launch with a single call to 
+       * map_task_batch rather than invoking map_task once for each point.
+       * Batching is only performed for points that did not request valid
+       * instances and are not part of a must epoch launch. Mappers that 
+       * opt in should override map_task_batch to amortize their work 
+       * across the points; the default implementation of map_task_batch
+       * simply invokes map_task for each point.
+       */
+      virtual bool request_batched_map_task(void) const { return false; }
     public: // Task mapping calls
       /**
        * ----------------------------------------------------------------------
@@ -542,6 +557,34 @@ namespace Legion {
                                   MapTaskOutput&     output) = 0;
       //------------------------------------------------------------------------
 
+      /**
+       * ----------------------------------------------------------------------
+       *  Map Task Batch
+       * ----------------------------------------------------------------------
+       * The map task batch call is only performed for mappers that return
+       * true from request_batched_map_task. It maps several point tasks 
+       * from the same slice of an index space task launch in one call.
+       * The 'tasks' and 'inputs' vectors contain one entry for each point 
+       * and the 'outputs' vector has already been sized to match them. 
+       * Each output must be filled in with the same semantics as the 
+       * output of map_task for the corresponding task. All the points
+       * in a batch have the same task ID, target processor, and parent
+       * task, so mappers can compute shared parts of the mapping once
+       * for the whole batch.
+       */
+      struct MapTaskBatchInput {
+        std::vector<const Task*>                        tasks;
+        std::vector<MapTaskInput>                       inputs;
+      };
+      struct MapTaskBatchOutput {
+        std::vector<MapTaskOutput>                      outputs;
+      };
+      //------------------------------------------------------------------------
+      virtual void map_task_batch(const MapperContext        ctx,
+                                  const MapTaskBatchInput&   input,
+                                        MapTaskBatchOutput&  output);
+      //------------------------------------------------------------------------
+
       /**
        * ----------------------------------------------------------------------
        *  Select Task Variant 
@@ -730,6 +730,44 @@ namespace Legion {
       owner->update_footprint(sizeof(RuntimeCallInfo), this);
     }
 
+    //--------------------------------------------------------------------------
+    void LegionProfInstance::record_replay_slice(Processor proc,
+                    unsigned slice_index, unsigned num_instructions,
+                    unsigned long long cost,
+                    unsigned long long start, unsigned long long stop)
+    //--------------------------------------------------------------------------
+    {
+      replay_slice_infos.push_back(ReplaySliceInfo());
+      ReplaySliceInfo &info = replay_slice_infos.back();
+      info.slice_index = slice_index;
+      info.num_instructions = num_instructions;
+      info.cost = cost;
+      info.start = start;
+      info.stop = stop;
+      info.proc_id = proc.id;
+      owner->update_footprint(sizeof(ReplaySliceInfo), this);
+    }
+
+    //--------------------------------------------------------------------------
+    void LegionProfInstance::record_message_channel(Processor proc,
+                         unsigned channel, const unsigned long long *counters)
+    //--------------------------------------------------------------------------
+    {
+      message_channel_infos.push_back(MessageChannelInfo());
+      MessageChannelInfo &info = message_channel_infos.back();
+      info.channel = channel;
+      info.messages = counters[0];
+      info.bytes = counters[1];
+      info.active_messages = counters[2];
+      info.explicit_flushes = counters[3];
+      info.full_flushes = counters[4];
+      info.size_flushes = counters[5];
+      info.delay_flushes = counters[6];
+      info.idle_flushes = counters[7];
+      info.proc_id = proc.id;
+      owner->update_footprint(sizeof(MessageChannelInfo), this);
+    }
+
 #ifdef LEGION_PROF_SELF_PROFILE
     //--------------------------------------------------------------------------
     void LegionProfInstance::record_proftask(Processor proc, UniqueID op_id,
@@ -926,6 +964,17 @@ namespace Legion {
       {
         serializer->serialize(*it);
       }
+      for (std::deque<ReplaySliceInfo>::const_iterator it = 
+            replay_slice_infos.begin(); it != replay_slice_infos.end(); it++)
+      {
+        serializer->serialize(*it);
+      }
+      for (std::deque<MessageChannelInfo>::const_iterator it = 
+            message_channel_infos.begin(); it != 
+            message_channel_infos.end(); it++)
+      {
+        serializer->serialize(*it);
+      }
 
 #ifdef LEGION_PROF_SELF_PROFILE
       for (std::deque<ProfTaskInfo>::const_iterator it = 
@@ -961,6 +1010,8 @@ namespace Legion {
       inst_timeline_infos.clear();
       partition_infos.clear();
       mapper_call_infos.clear();
+      replay_slice_infos.clear();
+      message_channel_infos.clear();
     }
 
     //--------------------------------------------------------------------------
@@ -1273,6 +1324,26 @@ namespace Legion {
         if (t_curr >= t_stop)
           return diff;
       }
+      while (!replay_slice_infos.empty())
+      {
+        ReplaySliceInfo &front = replay_slice_infos.front();
+        serializer->serialize(front);
+        diff += sizeof(front);
+        replay_slice_infos.pop_front();
+        const long long t_curr = Realm::Clock::current_time_in_microseconds();
+        if (t_curr >= t_stop)
+          return diff;
+      }
+      while (!message_channel_infos.empty())
+      {
+        MessageChannelInfo &front = message_channel_infos.front();
+        serializer->serialize(front);
+        diff += sizeof(front);
+        message_channel_infos.pop_front();
+        const long long t_curr = Realm::Clock::current_time_in_microseconds();
+        if (t_curr >= t_stop)
+          return diff;
+      }
 
 #ifdef LEGION_PROF_SELF_PROFILE
       while (!prof_task_infos.empty())
@@ -1303,7 +1374,8 @@ namespace Legion {
                                    const char *prof_logfile,
                                    const size_t total_runtime_instances,
                                    const size_t footprint_threshold,
-                                   const size_t target_latency)
+                                   const size_t target_latency,
+                                   const size_t inflight_limit)
       : runtime(rt), done_event(Runtime::create_rt_user_event()), 
         output_footprint_threshold(footprint_threshold), 
         output_target_latency(target_latency), target_proc(target), 
@@ -1331,7 +1403,8 @@ namespace Legion {
             REPORT_LEGION_ERROR(ERROR_MISSING_PROFILER_OPTION,
                 "ERROR: The logfile name must contain '%%' "
                 "which will be replaced with the node id\n")
-          serializer = new LegionProfBinarySerializer(filename.c_str());
+          serializer = new LegionProfBinarySerializer(filename.c_str(),
+                                                      inflight_limit, runtime);
         }
         else
         {
@@ -1339,7 +1412,8 @@ namespace Legion {
           std::stringstream ss;
           ss << filename.substr(0, pct) << target.address_space() <<
                 filename.substr(pct + 1);
-          serializer = new LegionProfBinarySerializer(ss.str());
+          serializer = new LegionProfBinarySerializer(ss.str(),
+                                                      inflight_limit, runtime);
         }
       } 
       else if (!strcmp(serializer_type, "ascii")) 
@@ -2173,6 +2247,8 @@ namespace Legion {
             instances.begin(); it != instances.end(); it++) {
         (*it)->dump_state(serializer);
       }  
+      // Write out buffered data while we can still run meta-tasks
+      serializer->flush();
     }
 
     //--------------------------------------------------------------------------
@@ -2237,6 +2313,31 @@ namespace Legion {
                                                            start, stop);
     }
 
+    //--------------------------------------------------------------------------
+    void LegionProfiler::record_replay_slice(unsigned slice_index,
+                              unsigned num_instructions, unsigned long long cost,
+                              unsigned long long start, unsigned long long stop)
+    //--------------------------------------------------------------------------
+    {
+      Processor current = Processor::get_executing_processor();
+      if (thread_local_profiling_instance == NULL)
+        create_thread_local_profiling_instance();
+      thread_local_profiling_instance->record_replay_slice(current, slice_index,
+                                           num_instructions, cost, start, stop);
+    }
+
+    //--------------------------------------------------------------------------
+    void LegionProfiler::record_message_channel(unsigned channel,
+                                             const unsigned long long *counters)
+    //--------------------------------------------------------------------------
+    {
+      Processor current = Processor::get_executing_processor();
+      if (thread_local_profiling_instance == NULL)
+        create_thread_local_profiling_instance();
+      thread_local_profiling_instance->record_message_channel(current, 
+                                                     channel, counters);
+    }
+
 #ifdef DEBUG_LEGION
     //--------------------------------------------------------------------------
     void LegionProfiler::increment_total_outstanding_requests(
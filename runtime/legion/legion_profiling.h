@@ -325,6 +325,22 @@ namespace Legion {
         timestamp_t start, stop;
         ProcID proc_id;
       };
+      struct ReplaySliceInfo {
+      public:
+        unsigned slice_index;
+        unsigned num_instructions;
+        unsigned long long cost;
+        timestamp_t start, stop;
+        ProcID proc_id;
+      };
+      struct MessageChannelInfo {
+      public:
+        unsigned channel;
+        unsigned long long messages, bytes, active_messages;
+        unsigned long long explicit_flushes, full_flushes; 
+        unsigned long long size_flushes, delay_flushes, idle_flushes;
+        ProcID proc_id;
+      };
 #ifdef LEGION_PROF_SELF_PROFILE
       struct ProfTaskInfo {
       public:
@@ -425,6 +441,12 @@ namespace Legion {
                               timestamp_t stop);
       void record_runtime_call(Processor proc, RuntimeCallKind kind,
                                timestamp_t start, timestamp_t stop);
+      void record_replay_slice(Processor proc, unsigned slice_index,
+                               unsigned num_instructions,
+                               unsigned long long cost,
+                               timestamp_t start, timestamp_t stop);
+      void record_message_channel(Processor proc, unsigned channel,
+                                  const unsigned long long *counters);
 #ifdef LEGION_PROF_SELF_PROFILE
     public:
       void record_proftask(Processor p, UniqueID op_id, timestamp_t start,
@@ -467,6 +489,8 @@ namespace Legion {
     private:
       std::deque<MapperCallInfo> mapper_call_infos;
       std::deque<RuntimeCallInfo> runtime_call_infos;
+      std::deque<ReplaySliceInfo> replay_slice_infos;
+      std::deque<MessageChannelInfo> message_channel_infos;
 #ifdef LEGION_PROF_SELF_PROFILE
     private:
       std::deque<ProfTaskInfo> prof_task_infos;
@@ -506,7 +530,8 @@ namespace Legion {
                      const char *prof_logname,
                      const size_t total_runtime_instances,
                      const size_t footprint_threshold,
-                     const size_t target_latency);
+                     const size_t target_latency,
+                     const size_t inflight_limit);
       LegionProfiler(const LegionProfiler &rhs);
       virtual ~LegionProfiler(void);
     public:
@@ -605,6 +630,14 @@ namespace Legion {
       void record_runtime_call(RuntimeCallKind kind, timestamp_t start,
                                timestamp_t stop);
     public:
+      void record_replay_slice(unsigned slice_index, unsigned num_instructions,
+                               unsigned long long cost,
+                               timestamp_t start, timestamp_t stop);
+      // Counters are messages, bytes, active messages, and then the 
+      // number of flushes for each VirtualChannel::FlushReason
+      void record_message_channel(unsigned channel, 
+                                  const unsigned long long *counters);
+    public:
 #ifdef DEBUG_LEGION
       void increment_total_outstanding_requests(ProfilingKind kind,
                                                 unsigned cnt = 1);
@@ -5,6 +5,7 @@
 
 #include <sstream>
 #include <string>
+#include <algorithm>
 
 // http://stackoverflow.com/questions/3553296/c-sizeof-single-struct-member
 #define member_size(type, member) sizeof(((type *)0)->member)
@@ -14,14 +15,229 @@ namespace Legion {
 
     extern Realm::Logger log_prof;
 
+    ///////////////////////////// LegionProfStream /////////////////////////////
+
+    //--------------------------------------------------------------------------
+    LegionProfStream::LegionProfStream(FILE *f, size_t max, Runtime *rt)
+      : file(f), max_inflight(max), runtime(rt), 
+        chunk((char*)malloc(CHUNK_SIZE)), chunk_used(0), inflight_bytes(0), 
+        writer_active(false), failed(false)
+    //--------------------------------------------------------------------------
+    {
+#ifdef DEBUG_LEGION
+      assert(file != NULL);
+      assert(chunk != NULL);
+#endif
+#ifdef LEGION_USE_ZLIB
+      memset(&zstream, 0, sizeof(zstream));
+      // Favor speed over ratio, the point is to keep up with the
+      // application; window bits of 15+16 asks for a gzip wrapper
+      if (deflateInit2(&zstream, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8,
+                       Z_DEFAULT_STRATEGY) != Z_OK)
+        REPORT_LEGION_ERROR(ERROR_INVALID_PROFILER_FILE,
+            "Unable to initialize zlib for the legion profiler")
+      compressed.resize(deflateBound(&zstream, CHUNK_SIZE));
+#endif
+    }
+
+    //--------------------------------------------------------------------------
+    LegionProfStream::LegionProfStream(const LegionProfStream &rhs)
+      : file(NULL), max_inflight(0), runtime(NULL)
+    //--------------------------------------------------------------------------
+    {
+      // should never be called
+      assert(false);
+    }
+
+    //--------------------------------------------------------------------------
+    LegionProfStream::~LegionProfStream(void)
+    //--------------------------------------------------------------------------
+    {
+      // The runtime may no longer be able to run meta-tasks here, so 
+      // anything not handed off by flush is written out directly
+#ifdef DEBUG_LEGION
+      assert(!writer_active);
+#endif
+      while (!pending_chunks.empty())
+      {
+        std::pair<char*,size_t> next = pending_chunks.front();
+        pending_chunks.pop_front();
+        if (!failed && !compress_and_write(next.first, next.second))
+          failed = true;
+        free(next.first);
+      }
+      if ((chunk_used > 0) && !failed && !compress_and_write(chunk, chunk_used))
+        failed = true;
+      if ((fclose(file) != 0) || failed)
+        log_prof.error("Failed to write the complete legion profile, "
+                       "the logfile is truncated");
+#ifdef LEGION_USE_ZLIB
+      deflateEnd(&zstream);
+#endif
+      free(chunk);
+    }
+
+    //--------------------------------------------------------------------------
+    LegionProfStream& LegionProfStream::operator=(const LegionProfStream &rhs)
+    //--------------------------------------------------------------------------
+    {
+      // should never be called
+      assert(false);
+      return *this;
+    }
+
+    //--------------------------------------------------------------------------
+    void LegionProfStream::write_slow(const void *data, size_t bytes)
+    //--------------------------------------------------------------------------
+    {
+      const char *ptr = (const char*)data;
+      while (bytes > 0)
+      {
+        if (chunk_used == CHUNK_SIZE)
+          flush_chunk();
+        const size_t to_copy = std::min(bytes, CHUNK_SIZE - chunk_used);
+        memcpy(chunk + chunk_used, ptr, to_copy);
+        chunk_used += to_copy;
+        ptr += to_copy;
+        bytes -= to_copy;
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    void LegionProfStream::flush_chunk(void)
+    //--------------------------------------------------------------------------
+    {
+      if (chunk_used == 0)
+        return;
+      bool launch = false;
+      {
+        AutoLock s_lock(stream_lock);
+        // Bound the memory held by queued chunks, but always let at least
+        // one chunk through so a tiny bound can never deadlock us
+        while ((inflight_bytes > 0) && 
+               ((inflight_bytes + chunk_used) > max_inflight))
+        {
+          if (!space_event.exists())
+            space_event = Runtime::create_rt_user_event();
+          const RtEvent wait_on = space_event;
+          s_lock.release();
+          wait_on.wait();
+          s_lock.reacquire();
+        }
+        pending_chunks.push_back(std::pair<char*,size_t>(chunk, chunk_used));
+        inflight_bytes += chunk_used;
+        if (!writer_active)
+        {
+          writer_active = true;
+          launch = true;
+        }
+      }
+      if (launch)
+      {
+        WriteChunksArgs args(this);
+        runtime->issue_runtime_meta_task(args, LG_LOW_PRIORITY);
+      }
+      chunk = (char*)malloc(CHUNK_SIZE);
+      if (chunk == NULL)
+        REPORT_LEGION_ERROR(ERROR_INVALID_PROFILER_FILE,
+            "Out of memory buffering legion profiling data")
+      chunk_used = 0;
+    }
+
+    //--------------------------------------------------------------------------
+    void LegionProfStream::flush(void)
+    //--------------------------------------------------------------------------
+    {
+      flush_chunk();
+      RtEvent wait_on;
+      {
+        AutoLock s_lock(stream_lock);
+        if (!writer_active)
+          return;
+        if (!idle_event.exists())
+          idle_event = Runtime::create_rt_user_event();
+        wait_on = idle_event;
+      }
+      wait_on.wait();
+    }
+
+    //--------------------------------------------------------------------------
+    /*static*/ void LegionProfStream::handle_write_chunks(const void *args)
+    //--------------------------------------------------------------------------
+    {
+      const WriteChunksArgs *wargs = (const WriteChunksArgs*)args;
+      wargs->stream->write_chunks();
+    }
+
+    //--------------------------------------------------------------------------
+    void LegionProfStream::write_chunks(void)
+    //--------------------------------------------------------------------------
+    {
+      // Keep going until the queue is empty so chunks queued while we
+      // were writing don't need another meta-task
+      AutoLock s_lock(stream_lock);
+      while (!pending_chunks.empty())
+      {
+        std::pair<char*,size_t> next = pending_chunks.front();
+        pending_chunks.pop_front();
+        const bool skip = failed;
+        s_lock.release();
+        // Keep writing nothing after a failure but still drain the queue
+        const bool success = skip || compress_and_write(next.first,next.second);
+        free(next.first);
+        s_lock.reacquire();
+        if (!success)
+          failed = true;
+        inflight_bytes -= next.second;
+        if (space_event.exists())
+        {
+          Runtime::trigger_event(space_event);
+          space_event = RtUserEvent::NO_RT_USER_EVENT;
+        }
+      }
+      writer_active = false;
+      if (idle_event.exists())
+      {
+        Runtime::trigger_event(idle_event);
+        idle_event = RtUserEvent::NO_RT_USER_EVENT;
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    bool LegionProfStream::compress_and_write(const char *data, size_t size)
+    //--------------------------------------------------------------------------
+    {
+#ifdef LEGION_USE_ZLIB
+      // Each chunk is a complete gzip member of its own
+      if (deflateReset(&zstream) != Z_OK)
+        return false;
+      zstream.next_in = (Bytef*)data;
+      zstream.avail_in = size;
+      zstream.next_out = &compressed.front();
+      zstream.avail_out = compressed.size();
+      if (deflate(&zstream, Z_FINISH) != Z_STREAM_END)
+        return false;
+      const size_t compressed_size = compressed.size() - zstream.avail_out;
+      return (fwrite(&compressed.front(), 1, compressed_size, file) ==
+              compressed_size);
+#else
+      return (fwrite(data, 1, size, file) == size);
+#endif
+    }
+
+    ///////////////////////// LegionProfBinarySerializer /////////////////////
+
     //--------------------------------------------------------------------------
-    LegionProfBinarySerializer::LegionProfBinarySerializer(std::string filename)
+    LegionProfBinarySerializer::LegionProfBinarySerializer(std::string filename,
+                                                           size_t max_inflight,
+                                                           Runtime *runtime)
     //--------------------------------------------------------------------------
     {
-      f = lp_fopen(filename, "wb");
-      if (!f)
+      FILE *file = fopen(filename.c_str(), "wb");
+      if (file == NULL)
         REPORT_LEGION_ERROR(ERROR_INVALID_PROFILER_FILE,
             "Unable to open legion logfile %s for writing!", filename.c_str())
+      f = new LegionProfStream(file, max_inflight, runtime);
       writePreamble();
     }
 
@@ -392,6 +608,45 @@ namespace Legion {
          << "proc_id:ProcID:"       << sizeof(ProcID)
          << "}" << std::endl;
 
+      ss << "ReplaySliceInfo {"
+         << "id:" << REPLAY_SLICE_INFO_ID                            << delim
+         << "slice_index:unsigned:"        << sizeof(unsigned)       << delim
+         << "num_instructions:unsigned:"   << sizeof(unsigned)       << delim
+         << "cost:unsigned long long:"     << sizeof(unsigned long long) 
+                                                                     << delim
+         << "start:timestamp_t:"           << sizeof(timestamp_t)    << delim
+         << "stop:timestamp_t:"            << sizeof(timestamp_t)    << delim
+         << "proc_id:ProcID:"              << sizeof(ProcID)
+         << "}" << std::endl;
+
+      ss << "MessageChannelInfo {"
+         << "id:" << MESSAGE_CHANNEL_INFO_ID                         << delim
+         << "channel:unsigned:"            << sizeof(unsigned)       << delim
+         << "messages:unsigned long long:" << sizeof(unsigned long long) 
+                                                                     << delim
+         << "bytes:unsigned long long:"    << sizeof(unsigned long long) 
+                                                                     << delim
+         << "active_messages:unsigned long long:" 
+                                           << sizeof(unsigned long long) 
+                                                                     << delim
+         << "explicit_flushes:unsigned long long:" 
+                                           << sizeof(unsigned long long) 
+                                                                     << delim
+         << "full_flushes:unsigned long long:" 
+                                           << sizeof(unsigned long long) 
+                                                                     << delim
+         << "size_flushes:unsigned long long:" 
+                                           << sizeof(unsigned long long) 
+                                                                     << delim
+         << "delay_flushes:unsigned long long:" 
+                                           << sizeof(unsigned long long) 
+                                                                     << delim
+         << "idle_flushes:unsigned long long:" 
+                                           << sizeof(unsigned long long) 
+                                                                     << delim
+         << "proc_id:ProcID:"              << sizeof(ProcID)
+         << "}" << std::endl;
+
 #ifdef LEGION_PROF_SELF_PROFILE
       ss << "ProfTaskInfo {"
          << "id:" << PROFTASK_INFO_ID                        << delim
@@ -1036,6 +1291,56 @@ namespace Legion {
                 sizeof(runtime_call_info.proc_id));
     }
 
+    //--------------------------------------------------------------------------
+    void LegionProfBinarySerializer::serialize(
+                   const LegionProfInstance::ReplaySliceInfo& replay_slice_info)
+    //--------------------------------------------------------------------------
+    {
+      int ID = REPLAY_SLICE_INFO_ID;
+      lp_fwrite(f, (char*)&ID, sizeof(ID));
+      lp_fwrite(f, (char*)&(replay_slice_info.slice_index),
+                sizeof(replay_slice_info.slice_index));
+      lp_fwrite(f, (char*)&(replay_slice_info.num_instructions),
+                sizeof(replay_slice_info.num_instructions));
+      lp_fwrite(f, (char*)&(replay_slice_info.cost),
+                sizeof(replay_slice_info.cost));
+      lp_fwrite(f, (char*)&(replay_slice_info.start),
+                sizeof(replay_slice_info.start));
+      lp_fwrite(f, (char*)&(replay_slice_info.stop),
+                sizeof(replay_slice_info.stop));
+      lp_fwrite(f, (char*)&(replay_slice_info.proc_id),
+                sizeof(replay_slice_info.proc_id));
+    }
+
+    //--------------------------------------------------------------------------
+    void LegionProfBinarySerializer::serialize(
+             const LegionProfInstance::MessageChannelInfo& message_channel_info)
+    //--------------------------------------------------------------------------
+    {
+      int ID = MESSAGE_CHANNEL_INFO_ID;
+      lp_fwrite(f, (char*)&ID, sizeof(ID));
+      lp_fwrite(f, (char*)&(message_channel_info.channel),
+                sizeof(message_channel_info.channel));
+      lp_fwrite(f, (char*)&(message_channel_info.messages),
+                sizeof(message_channel_info.messages));
+      lp_fwrite(f, (char*)&(message_channel_info.bytes),
+                sizeof(message_channel_info.bytes));
+      lp_fwrite(f, (char*)&(message_channel_info.active_messages),
+                sizeof(message_channel_info.active_messages));
+      lp_fwrite(f, (char*)&(message_channel_info.explicit_flushes),
+                sizeof(message_channel_info.explicit_flushes));
+      lp_fwrite(f, (char*)&(message_channel_info.full_flushes),
+                sizeof(message_channel_info.full_flushes));
+      lp_fwrite(f, (char*)&(message_channel_info.size_flushes),
+                sizeof(message_channel_info.size_flushes));
+      lp_fwrite(f, (char*)&(message_channel_info.delay_flushes),
+                sizeof(message_channel_info.delay_flushes));
+      lp_fwrite(f, (char*)&(message_channel_info.idle_flushes),
+                sizeof(message_channel_info.idle_flushes));
+      lp_fwrite(f, (char*)&(message_channel_info.proc_id),
+                sizeof(message_channel_info.proc_id));
+    }
+
 #ifdef LEGION_PROF_SELF_PROFILE
     //--------------------------------------------------------------------------
     void LegionProfBinarySerializer::serialize(
@@ -1056,8 +1361,15 @@ namespace Legion {
     LegionProfBinarySerializer::~LegionProfBinarySerializer()
     //--------------------------------------------------------------------------
     {
-      lp_fflush(f, Z_FULL_FLUSH);
-      lp_fclose(f);
+      // Writes out anything that was serialized after the last flush
+      delete f;
+    }
+
+    //--------------------------------------------------------------------------
+    void LegionProfBinarySerializer::flush(void)
+    //--------------------------------------------------------------------------
+    {
+      f->flush();
     }
 
 
@@ -1774,6 +2086,35 @@ namespace Legion {
                      runtime_call_info.start, runtime_call_info.stop);
     }
 
+    //--------------------------------------------------------------------------
+    void LegionProfASCIISerializer::serialize(
+                   const LegionProfInstance::ReplaySliceInfo& replay_slice_info)
+    //--------------------------------------------------------------------------
+    {
+      log_prof.print("Prof Replay Slice Info %u %u %llu " IDFMT " %llu %llu",
+                     replay_slice_info.slice_index,
+                     replay_slice_info.num_instructions,
+                     replay_slice_info.cost, replay_slice_info.proc_id,
+                     replay_slice_info.start, replay_slice_info.stop);
+    }
+
+    //--------------------------------------------------------------------------
+    void LegionProfASCIISerializer::serialize(
+             const LegionProfInstance::MessageChannelInfo& message_channel_info)
+    //--------------------------------------------------------------------------
+    {
+      log_prof.print("Prof Message Channel Info %u %llu %llu %llu %llu %llu "
+                     "%llu %llu %llu " IDFMT, message_channel_info.channel,
+                     message_channel_info.messages, message_channel_info.bytes,
+                     message_channel_info.active_messages,
+                     message_channel_info.explicit_flushes,
+                     message_channel_info.full_flushes,
+                     message_channel_info.size_flushes,
+                     message_channel_info.delay_flushes,
+                     message_channel_info.idle_flushes,
+                     message_channel_info.proc_id);
+    }
+
 #ifdef LEGION_PROF_SELF_PROFILE
     //--------------------------------------------------------------------------
     void LegionProfASCIISerializer::serialize(
@@ -16,23 +16,15 @@
 #define __LEGION_PROFILING_SERIALIZER_H__
 
 #include <string>
+#include <deque>
 #include <stdio.h>
+#include <string.h>
 #include "legion/legion_profiling.h"
 
 #ifdef LEGION_USE_ZLIB
 #include <zlib.h>
-// lp_fopen expects filename to be a std::string
-#define lp_fopen(filename, mode)      gzopen(filename.c_str(),mode)
-#define lp_fwrite(f, data, num_bytes) gzwrite(f,data,num_bytes)
-#define lp_fflush(f, mode)            gzflush(f,mode)
-#define lp_fclose(f)                  gzclose(f)
-#else
-// lp_fopen expects filename to be a std::string
-#define lp_fopen(filename, mode)      fopen(filename.c_str(),mode)
-#define lp_fwrite(f, data, num_bytes) fwrite(data,num_bytes,1,f)
-#define lp_fflush(f, mode)            fflush(f)
-#define lp_fclose(f)                  fclose(f)
 #endif
+#define lp_fwrite(f, data, num_bytes) (f)->write(data,num_bytes)
 
 namespace Legion {
   namespace Internal { 
@@ -42,6 +34,9 @@ namespace Legion {
       virtual ~LegionProfSerializer() {};
 
       virtual bool is_thread_safe(void) const = 0;
+      // Called once everything has been serialized while the runtime can 
+      // still run meta-tasks, so buffered output can be written out
+      virtual void flush(void) { }
       // You must override the following functions in your implementation
       virtual void serialize(const LegionProfDesc::MapperCallDesc&) = 0;
       virtual void serialize(const LegionProfDesc::RuntimeCallDesc&) = 0;
@@ -90,6 +85,8 @@ namespace Legion {
       virtual void serialize(const LegionProfInstance::PartitionInfo&) = 0;
       virtual void serialize(const LegionProfInstance::MapperCallInfo&) = 0;
       virtual void serialize(const LegionProfInstance::RuntimeCallInfo&) = 0;
+      virtual void serialize(const LegionProfInstance::ReplaySliceInfo&) = 0;
+      virtual void serialize(const LegionProfInstance::MessageChannelInfo&)=0;
       virtual void serialize(const LegionProfInstance::GPUTaskInfo&) = 0;
 #ifdef LEGION_PROF_SELF_PROFILE
       virtual void serialize(const LegionProfInstance::ProfTaskInfo&) = 0;
@@ -97,14 +94,89 @@ namespace Legion {
     };
 
     // This is the Internal Binary Format Serializer
+    /**
+     * \class LegionProfStream
+     * Buffers the binary profile in fixed-size chunks and hands full
+     * chunks to a meta-task that compresses and writes them out, so
+     * threads dumping profiling data never wait on compression or the
+     * file system unless more than max_inflight bytes are queued.
+     * With zlib every chunk becomes its own gzip member, so the output is
+     * still an ordinary gzip file, and if the run dies, all chunks
+     * written so far can still be read.
+     */
+    class LegionProfStream {
+    public:
+      static const size_t CHUNK_SIZE = 1 << 20;
+    public:
+      struct WriteChunksArgs : public LgTaskArgs<WriteChunksArgs> {
+      public:
+        static const LgTaskID TASK_ID = LG_PROFILER_WRITE_TASK_ID;
+      public:
+        WriteChunksArgs(LegionProfStream *s)
+          : LgTaskArgs<WriteChunksArgs>(0), stream(s) { }
+      public:
+        LegionProfStream *const stream;
+      };
+    public:
+      LegionProfStream(FILE *f, size_t max_inflight, Runtime *runtime);
+      LegionProfStream(const LegionProfStream &rhs);
+      ~LegionProfStream(void);
+    public:
+      LegionProfStream& operator=(const LegionProfStream &rhs);
+    public:
+      inline void write(const void *data, size_t bytes)
+      {
+        if ((chunk_used + bytes) > CHUNK_SIZE)
+        {
+          write_slow(data, bytes);
+          return;
+        }
+        memcpy(chunk + chunk_used, data, bytes);
+        chunk_used += bytes;
+      }
+      // Hands off the current chunk and waits for the writer to finish
+      void flush(void);
+    public:
+      static void handle_write_chunks(const void *args);
+    protected:
+      void write_slow(const void *data, size_t bytes);
+      void flush_chunk(void);
+      void write_chunks(void);
+      bool compress_and_write(const char *data, size_t size);
+    protected:
+      FILE *const file;
+      const size_t max_inflight;
+      Runtime *const runtime;
+      char *chunk;
+      size_t chunk_used;
+    protected:
+      // Everything below is protected by stream_lock
+      LocalLock stream_lock;
+      std::deque<std::pair<char*,size_t> > pending_chunks;
+      size_t inflight_bytes;
+      // At most one write meta-task is in flight at a time
+      bool writer_active;
+      bool failed;
+      RtUserEvent space_event;
+      RtUserEvent idle_event;
+#ifdef LEGION_USE_ZLIB
+    protected:
+      // Only touched by the write meta-task
+      z_stream zstream;
+      std::vector<unsigned char> compressed;
+#endif
+    };
+
     class LegionProfBinarySerializer: public LegionProfSerializer {
     public:
-      LegionProfBinarySerializer(std::string filename);
+      LegionProfBinarySerializer(std::string filename, size_t max_inflight,
+                                 Runtime *runtime);
       ~LegionProfBinarySerializer();
 
       void writePreamble();
 
       bool is_thread_safe(void) const { return false; }
+      void flush(void);
       // Serialize Methods
       void serialize(const LegionProfDesc::MapperCallDesc&);
       void serialize(const LegionProfDesc::RuntimeCallDesc&);
@@ -149,16 +221,14 @@ namespace Legion {
       void serialize(const LegionProfInstance::PartitionInfo&);
       void serialize(const LegionProfInstance::MapperCallInfo&);
       void serialize(const LegionProfInstance::RuntimeCallInfo&);
+      void serialize(const LegionProfInstance::ReplaySliceInfo&);
+      void serialize(const LegionProfInstance::MessageChannelInfo&);
       void serialize(const LegionProfInstance::GPUTaskInfo&);
 #ifdef LEGION_PROF_SELF_PROFILE
       void serialize(const LegionProfInstance::ProfTaskInfo&);
 #endif
     private:
-#ifdef LEGION_USE_ZLIB
-      gzFile f;
-#else
-      FILE *f;
-#endif
+      LegionProfStream *f;
       enum LegionProfInstanceIDs {
         MESSAGE_DESC_ID,
         MAPPER_CALL_DESC_ID,
@@ -202,6 +272,8 @@ namespace Legion {
         PHYSICAL_INST_LAYOUT_ID,
         PHYSICAL_INST_LAYOUT_DIM_ID,
         INDEX_SPACE_SIZE_ID,
+        REPLAY_SLICE_INFO_ID,
+        MESSAGE_CHANNEL_INFO_ID,
 #ifdef LEGION_PROF_SELF_PROFILE
         PROFTASK_INFO_ID
 #endif
@@ -259,6 +331,8 @@ namespace Legion {
       void serialize(const LegionProfInstance::PartitionInfo&);
       void serialize(const LegionProfInstance::MapperCallInfo&);
       void serialize(const LegionProfInstance::RuntimeCallInfo&);
+      void serialize(const LegionProfInstance::ReplaySliceInfo&);
+      void serialize(const LegionProfInstance::MessageChannelInfo&);
       void serialize(const LegionProfInstance::GPUTaskInfo&);
 #ifdef LEGION_PROF_SELF_PROFILE
       void serialize(const LegionProfInstance::ProfTaskInfo&);
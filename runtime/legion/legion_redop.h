@@ -18,6 +18,8 @@
 
 #include <limits.h>
 
+#include "realm/redop.h"
+
 #ifdef LEGION_REDOP_HALF
 #include "mathtypes/half.h"
 #endif
@@ -1689,5 +1691,32 @@ namespace Legion {
 
 #include "legion_redop.inl"
 
+// exclusive apply/fold of contiguous data for the common builtin reductions
+//  goes through Realm's vectorized kernels (see realm/redop.h)
+#define SIMD_BUILTIN_REDOP(redop, type, op)                                 \
+  template<> struct ReductionKernels<Legion::redop<type> >                  \
+    : public SIMDReductionKernels<type, SIMDReductions::op> {};
+
+namespace Realm {
+  SIMD_BUILTIN_REDOP(SumReduction, int32_t, SUM)
+  SIMD_BUILTIN_REDOP(SumReduction, int64_t, SUM)
+  SIMD_BUILTIN_REDOP(SumReduction, float, SUM)
+  SIMD_BUILTIN_REDOP(SumReduction, double, SUM)
+  SIMD_BUILTIN_REDOP(ProdReduction, int32_t, PROD)
+  SIMD_BUILTIN_REDOP(ProdReduction, int64_t, PROD)
+  SIMD_BUILTIN_REDOP(ProdReduction, float, PROD)
+  SIMD_BUILTIN_REDOP(ProdReduction, double, PROD)
+  SIMD_BUILTIN_REDOP(MinReduction, int32_t, MIN)
+  SIMD_BUILTIN_REDOP(MinReduction, int64_t, MIN)
+  SIMD_BUILTIN_REDOP(MinReduction, float, MIN)
+  SIMD_BUILTIN_REDOP(MinReduction, double, MIN)
+  SIMD_BUILTIN_REDOP(MaxReduction, int32_t, MAX)
+  SIMD_BUILTIN_REDOP(MaxReduction, int64_t, MAX)
+  SIMD_BUILTIN_REDOP(MaxReduction, float, MAX)
+  SIMD_BUILTIN_REDOP(MaxReduction, double, MAX)
+}; // namespace Realm
+
+#undef SIMD_BUILTIN_REDOP
+
 #endif // __LEGION_REDOP_H__
 
@@ -21,6 +21,303 @@
 
 namespace Legion {
   namespace Internal {
+    namespace LegionSpy {
+
+      SpyLogger log_spy;
+      BinarySpyLog *binary_log = NULL;
+
+      // The binary log starts with a one line text header so the file is 
+      // easy to identify, followed by a stream of records. Every record
+      // starts with a varint tag. Tag zero introduces a new format string: 
+      // it is followed by the format's id and then the string itself as a
+      // varint length and its bytes. Any other tag is the id of a format
+      // and is followed by one value for each conversion in that format: 
+      // signed integers are zig-zag encoded varints, unsigned integers are
+      // plain varints and strings are a varint length and their bytes.
+      class BinarySpyLog {
+      public:
+        enum ArgKind {
+          SIGNED_INT,
+          SIGNED_LONG,
+          SIGNED_LONG_LONG,
+          SIGNED_SIZE,
+          UNSIGNED_INT,
+          UNSIGNED_LONG,
+          UNSIGNED_LONG_LONG,
+          UNSIGNED_SIZE,
+          STRING_ARG,
+        };
+        struct FormatInfo {
+        public:
+          unsigned id;
+          std::vector<ArgKind> args;
+        };
+      public:
+        BinarySpyLog(FILE *file, AddressSpaceID space);
+        BinarySpyLog(const BinarySpyLog &rhs);
+        ~BinarySpyLog(void);
+      public:
+        BinarySpyLog& operator=(const BinarySpyLog &rhs);
+      public:
+        void record(const char *fmt, va_list args);
+        void flush(void);
+      protected:
+        const FormatInfo& find_format(const char *fmt);
+        inline void write_varint(unsigned long long value);
+        inline void write_bytes(const char *data, size_t size);
+      public:
+        // Flush the buffer once it has this much in it
+        static const size_t FLUSH_SIZE = 1 << 20;
+        // No record can be longer than this except for its strings
+        static const size_t MAX_RECORD_SIZE = 1024;
+      protected:
+        FILE *const file;
+        LocalLock log_lock;
+        std::map<const char*,FormatInfo> formats;
+        char *buffer;
+        size_t offset;
+      };
+
+      //------------------------------------------------------------------------
+      BinarySpyLog::BinarySpyLog(FILE *f, AddressSpaceID space)
+        : file(f), offset(0)
+      //------------------------------------------------------------------------
+      {
+        buffer = (char*)malloc(FLUSH_SIZE + MAX_RECORD_SIZE);
+        fprintf(file, "FileType: BinaryLegionSpy v: 1.0 node: %d\n", space);
+      }
+
+      //------------------------------------------------------------------------
+      BinarySpyLog::BinarySpyLog(const BinarySpyLog &rhs)
+        : file(NULL)
+      //------------------------------------------------------------------------
+      {
+        // should never be called
+        assert(false);
+      }
+
+      //------------------------------------------------------------------------
+      BinarySpyLog::~BinarySpyLog(void)
+      //------------------------------------------------------------------------
+      {
+        flush();
+        fclose(file);
+        free(buffer);
+      }
+
+      //------------------------------------------------------------------------
+      BinarySpyLog& BinarySpyLog::operator=(const BinarySpyLog &rhs)
+      //------------------------------------------------------------------------
+      {
+        // should never be called
+        assert(false);
+        return *this;
+      }
+
+      //------------------------------------------------------------------------
+      inline void BinarySpyLog::write_varint(unsigned long long value)
+      //------------------------------------------------------------------------
+      {
+        while (value >= 0x80)
+        {
+          buffer[offset++] = (char)(value | 0x80);
+          value >>= 7;
+        }
+        buffer[offset++] = (char)value;
+      }
+
+      //------------------------------------------------------------------------
+      inline void BinarySpyLog::write_bytes(const char *data, size_t size)
+      //------------------------------------------------------------------------
+      {
+        write_varint(size);
+        // Strings don't count against MAX_RECORD_SIZE, so they have to 
+        // leave all of the slack at the end of the buffer for the rest of
+        // the record
+        if ((offset + size) > FLUSH_SIZE)
+        {
+          flush();
+          if (size > FLUSH_SIZE)
+          {
+            fwrite(data, 1, size, file);
+            return;
+          }
+        }
+        memcpy(buffer + offset, data, size);
+        offset += size;
+      }
+
+      //------------------------------------------------------------------------
+      const BinarySpyLog::FormatInfo& BinarySpyLog::find_format(
+                                                              const char *fmt)
+      //------------------------------------------------------------------------
+      {
+        // All the formats are string literals so we can key on the pointer
+        std::map<const char*,FormatInfo>::const_iterator finder = 
+          formats.find(fmt);
+        if (finder != formats.end())
+          return finder->second;
+        FormatInfo &info = formats[fmt];
+        info.id = formats.size();
+        // Figure out the kind of each of the arguments from the conversions
+        for (const char *p = strchr(fmt, '%'); p != NULL; p = strchr(p, '%'))
+        {
+          p++;
+          if (*p == '%')
+          {
+            p++;
+            continue;
+          }
+          int longs = 0;
+          bool size = false;
+          while ((*p == 'l') || (*p == 'z'))
+          {
+            if (*p == 'l')
+              longs++;
+            else
+              size = true;
+            p++;
+          }
+          switch (*p)
+          {
+            case 'd':
+            case 'i':
+              info.args.push_back(size ? SIGNED_SIZE : 
+                  (longs == 0) ? SIGNED_INT : 
+                  (longs == 1) ? SIGNED_LONG : SIGNED_LONG_LONG);
+              break;
+            case 'u':
+            case 'x':
+              info.args.push_back(size ? UNSIGNED_SIZE : 
+                  (longs == 0) ? UNSIGNED_INT : 
+                  (longs == 1) ? UNSIGNED_LONG : UNSIGNED_LONG_LONG);
+              break;
+            case 's':
+              info.args.push_back(STRING_ARG);
+              break;
+            default:
+              // Legion Spy formats only use integer and string conversions
+              assert(false);
+          }
+        }
+        // Tell the reader about the new format
+        write_varint(0);
+        write_varint(info.id);
+        write_bytes(fmt, strlen(fmt));
+        return info;
+      }
+
+      //------------------------------------------------------------------------
+      void BinarySpyLog::record(const char *fmt, va_list args)
+      //------------------------------------------------------------------------
+      {
+        AutoLock l_lock(log_lock);
+        const FormatInfo &info = find_format(fmt);
+        write_varint(info.id);
+        for (std::vector<ArgKind>::const_iterator it = 
+              info.args.begin(); it != info.args.end(); it++)
+        {
+          long long value = 0;
+          switch (*it)
+          {
+            case SIGNED_INT:
+              value = va_arg(args, int);
+              break;
+            case SIGNED_LONG:
+              value = va_arg(args, long);
+              break;
+            case SIGNED_LONG_LONG:
+              value = va_arg(args, long long);
+              break;
+            case SIGNED_SIZE:
+              value = va_arg(args, ssize_t);
+              break;
+            case UNSIGNED_INT:
+              write_varint(va_arg(args, unsigned));
+              continue;
+            case UNSIGNED_LONG:
+              write_varint(va_arg(args, unsigned long));
+              continue;
+            case UNSIGNED_LONG_LONG:
+              write_varint(va_arg(args, unsigned long long));
+              continue;
+            case UNSIGNED_SIZE:
+              write_varint(va_arg(args, size_t));
+              continue;
+            case STRING_ARG:
+              {
+                const char *str = va_arg(args, const char*);
+                write_bytes(str, strlen(str));
+                continue;
+              }
+            default:
+              assert(false);
+          }
+          // Zig-zag encode signed values so small negatives stay small
+          write_varint(((unsigned long long)value << 1) ^ 
+                       (unsigned long long)(value >> 63));
+        }
+        if (offset >= FLUSH_SIZE)
+          flush();
+      }
+
+      //------------------------------------------------------------------------
+      void BinarySpyLog::flush(void)
+      //------------------------------------------------------------------------
+      {
+        if (offset > 0)
+        {
+          fwrite(buffer, 1, offset, file);
+          offset = 0;
+        }
+        fflush(file);
+      }
+
+      //------------------------------------------------------------------------
+      void open_binary_log(const char *filename, AddressSpaceID space)
+      //------------------------------------------------------------------------
+      {
+#ifdef DEBUG_LEGION
+        assert(binary_log == NULL);
+#endif
+        // Replace % with the node number like -logfile does
+        std::string name(filename);
+        const size_t pct = name.find_first_of('%', 0);
+        if (pct != std::string::npos)
+        {
+          std::stringstream ss;
+          ss << name.substr(0, pct) << space << name.substr(pct + 1);
+          name = ss.str();
+        }
+        FILE *file = fopen(name.c_str(), "wb");
+        if (file == NULL)
+          REPORT_LEGION_ERROR(ERROR_INVALID_SPY_FILE,
+              "Unable to open Legion Spy logfile %s for writing!", name.c_str())
+        binary_log = new BinarySpyLog(file, space);
+      }
+
+      //------------------------------------------------------------------------
+      void close_binary_log(void)
+      //------------------------------------------------------------------------
+      {
+        if (binary_log == NULL)
+          return;
+        BinarySpyLog *to_delete = binary_log;
+        binary_log = NULL;
+        delete to_delete;
+      }
+
+      //------------------------------------------------------------------------
+      void log_binary_record(const char *fmt, va_list args)
+      //------------------------------------------------------------------------
+      {
+        // Records can still arrive after the log was closed at exit
+        BinarySpyLog *log = binary_log;
+        if (log != NULL)
+          log->record(fmt, args);
+      }
+
+    }; // namespace LegionSpy
 
     //--------------------------------------------------------------------------
     TreeStateLogger::TreeStateLogger(void)
@@ -33,7 +33,39 @@ namespace Legion {
 
       typedef ::realm_id_t IDType;
 
-      extern Realm::Logger log_spy;
+      // Legion Spy records are printed as text lines on the "legion_spy"
+      // Realm logger unless the runtime was started with -lg:spy_logfile
+      // (where a % in the name is replaced by the node number), in which
+      // case they are encoded into a compact binary log file per node
+      // instead. Records in a binary log are identified by the format
+      // string of the call that made them and carry their arguments as 
+      // variable-length integers, so nothing is formatted at runtime.
+      // tools/legion_spy_loader.cc reads binary logs, converts them back 
+      // to text for legion_spy.py, and performs the event graph checks.
+      class BinarySpyLog;
+      extern BinarySpyLog *binary_log;
+      extern Realm::Logger log_spy_text;
+
+      void open_binary_log(const char *filename, AddressSpaceID space);
+      void close_binary_log(void);
+      void log_binary_record(const char *fmt, va_list args);
+
+      class SpyLogger {
+      public:
+        REALM_ATTR_PRINTF_FORMAT(inline void print(const char *fmt, ...),2,3);
+      };
+      extern SpyLogger log_spy;
+
+      inline void SpyLogger::print(const char *fmt, ...)
+      {
+        va_list args;
+        va_start(args, fmt);
+        if (binary_log != NULL)
+          log_binary_record(fmt, args);
+        else if (log_spy_text.get_level() <= Realm::Logger::LEVEL_PRINT)
+          log_spy_text.print().vprintf(fmt, args);
+        va_end(args);
+      }
 
       // One time logger calls to record what gets logged
       static inline void log_legion_spy_config(void)
@@ -1024,104 +1056,119 @@ namespace Legion {
         LEGION_STATIC_ASSERT(DIM <= LEGION_MAX_DIM,
                       "DIM exceeds LEGION_MAX DIM");
 #if LEGION_MAX_DIM == 1
-        log_spy.print() << "Index Launch Rect " << unique_id << " "
-                        << DIM << " " << rect.lo[0] << " " << rect.hi[0];
+        log_spy.print("Index Launch Rect %llu %d "
+                      "%lld %lld", unique_id, DIM,
+                      (long long)(rect.lo[0]), (long long)(rect.hi[0]));
 #elif LEGION_MAX_DIM == 2
-        log_spy.print() << "Index Launch Rect " << unique_id << " "
-                        << DIM << " " << rect.lo[0] << " " << rect.hi[0]
-                        << " " << ((DIM < 2) ? 0 : rect.lo[1])
-                        << " " << ((DIM < 2) ? 0 : rect.hi[1]);
+        log_spy.print("Index Launch Rect %llu %d "
+                      "%lld %lld %lld %lld", unique_id, DIM,
+                      (long long)(rect.lo[0]), (long long)(rect.hi[0]),
+                      (long long)((DIM < 2) ? 0 : rect.lo[1]),
+                      (long long)((DIM < 2) ? 0 : rect.hi[1]));
 #elif LEGION_MAX_DIM == 3
-        log_spy.print() << "Index Launch Rect " << unique_id << " "
-                        << DIM << " " << rect.lo[0] << " " << rect.hi[0]
-                        << " " << ((DIM < 2) ? 0 : rect.lo[1])
-                        << " " << ((DIM < 2) ? 0 : rect.hi[1])
-                        << " " << ((DIM < 3) ? 0 : rect.lo[2])
-                        << " " << ((DIM < 3) ? 0 : rect.hi[2]);
+        log_spy.print("Index Launch Rect %llu %d "
+                      "%lld %lld %lld %lld %lld %lld", unique_id, DIM,
+                      (long long)(rect.lo[0]), (long long)(rect.hi[0]),
+                      (long long)((DIM < 2) ? 0 : rect.lo[1]),
+                      (long long)((DIM < 2) ? 0 : rect.hi[1]),
+                      (long long)((DIM < 3) ? 0 : rect.lo[2]),
+                      (long long)((DIM < 3) ? 0 : rect.hi[2]));
 #elif LEGION_MAX_DIM == 4
-        log_spy.print() << "Index Launch Rect " << unique_id << " "
-                        << DIM << " " << rect.lo[0] << " " << rect.hi[0]
-                        << " " << ((DIM < 2) ? 0 : rect.lo[1])
-                        << " " << ((DIM < 2) ? 0 : rect.hi[1])
-                        << " " << ((DIM < 3) ? 0 : rect.lo[2])
-                        << " " << ((DIM < 3) ? 0 : rect.hi[2])
-                        << " " << ((DIM < 4) ? 0 : rect.lo[3])
-                        << " " << ((DIM < 4) ? 0 : rect.hi[3]);
+        log_spy.print("Index Launch Rect %llu %d "
+                      "%lld %lld %lld %lld %lld %lld %lld %lld", unique_id, DIM,
+                      (long long)(rect.lo[0]), (long long)(rect.hi[0]),
+                      (long long)((DIM < 2) ? 0 : rect.lo[1]),
+                      (long long)((DIM < 2) ? 0 : rect.hi[1]),
+                      (long long)((DIM < 3) ? 0 : rect.lo[2]),
+                      (long long)((DIM < 3) ? 0 : rect.hi[2]),
+                      (long long)((DIM < 4) ? 0 : rect.lo[3]),
+                      (long long)((DIM < 4) ? 0 : rect.hi[3]));
 #elif LEGION_MAX_DIM == 5
-        log_spy.print() << "Index Launch Rect " << unique_id << " "
-                        << DIM << " " << rect.lo[0] << " " << rect.hi[0]
-                        << " " << ((DIM < 2) ? 0 : rect.lo[1])
-                        << " " << ((DIM < 2) ? 0 : rect.hi[1])
-                        << " " << ((DIM < 3) ? 0 : rect.lo[2])
-                        << " " << ((DIM < 3) ? 0 : rect.hi[2])
-                        << " " << ((DIM < 4) ? 0 : rect.lo[3])
-                        << " " << ((DIM < 4) ? 0 : rect.hi[3])
-                        << " " << ((DIM < 5) ? 0 : rect.lo[4])
-                        << " " << ((DIM < 5) ? 0 : rect.hi[4]);
+        log_spy.print("Index Launch Rect %llu %d "
+                      "%lld %lld %lld %lld %lld %lld %lld %lld "
+                      "%lld %lld", unique_id, DIM,
+                      (long long)(rect.lo[0]), (long long)(rect.hi[0]),
+                      (long long)((DIM < 2) ? 0 : rect.lo[1]),
+                      (long long)((DIM < 2) ? 0 : rect.hi[1]),
+                      (long long)((DIM < 3) ? 0 : rect.lo[2]),
+                      (long long)((DIM < 3) ? 0 : rect.hi[2]),
+                      (long long)((DIM < 4) ? 0 : rect.lo[3]),
+                      (long long)((DIM < 4) ? 0 : rect.hi[3]),
+                      (long long)((DIM < 5) ? 0 : rect.lo[4]),
+                      (long long)((DIM < 5) ? 0 : rect.hi[4]));
 #elif LEGION_MAX_DIM == 6
-        log_spy.print() << "Index Launch Rect " << unique_id << " "
-                        << DIM << " " << rect.lo[0] << " " << rect.hi[0]
-                        << " " << ((DIM < 2) ? 0 : rect.lo[1])
-                        << " " << ((DIM < 2) ? 0 : rect.hi[1])
-                        << " " << ((DIM < 3) ? 0 : rect.lo[2])
-                        << " " << ((DIM < 3) ? 0 : rect.hi[2])
-                        << " " << ((DIM < 4) ? 0 : rect.lo[3])
-                        << " " << ((DIM < 4) ? 0 : rect.hi[3])
-                        << " " << ((DIM < 5) ? 0 : rect.lo[4])
-                        << " " << ((DIM < 5) ? 0 : rect.hi[4])
-                        << " " << ((DIM < 6) ? 0 : rect.lo[5])
-                        << " " << ((DIM < 6) ? 0 : rect.hi[5]);
+        log_spy.print("Index Launch Rect %llu %d "
+                      "%lld %lld %lld %lld %lld %lld %lld %lld "
+                      "%lld %lld %lld %lld", unique_id, DIM,
+                      (long long)(rect.lo[0]), (long long)(rect.hi[0]),
+                      (long long)((DIM < 2) ? 0 : rect.lo[1]),
+                      (long long)((DIM < 2) ? 0 : rect.hi[1]),
+                      (long long)((DIM < 3) ? 0 : rect.lo[2]),
+                      (long long)((DIM < 3) ? 0 : rect.hi[2]),
+                      (long long)((DIM < 4) ? 0 : rect.lo[3]),
+                      (long long)((DIM < 4) ? 0 : rect.hi[3]),
+                      (long long)((DIM < 5) ? 0 : rect.lo[4]),
+                      (long long)((DIM < 5) ? 0 : rect.hi[4]),
+                      (long long)((DIM < 6) ? 0 : rect.lo[5]),
+                      (long long)((DIM < 6) ? 0 : rect.hi[5]));
 #elif LEGION_MAX_DIM == 7
-        log_spy.print() << "Index Launch Rect " << unique_id << " "
-                        << DIM << " " << rect.lo[0] << " " << rect.hi[0]
-                        << " " << ((DIM < 2) ? 0 : rect.lo[1])
-                        << " " << ((DIM < 2) ? 0 : rect.hi[1])
-                        << " " << ((DIM < 3) ? 0 : rect.lo[2])
-                        << " " << ((DIM < 3) ? 0 : rect.hi[2])
-                        << " " << ((DIM < 4) ? 0 : rect.lo[3])
-                        << " " << ((DIM < 4) ? 0 : rect.hi[3])
-                        << " " << ((DIM < 5) ? 0 : rect.lo[4])
-                        << " " << ((DIM < 5) ? 0 : rect.hi[4])
-                        << " " << ((DIM < 6) ? 0 : rect.lo[5])
-                        << " " << ((DIM < 6) ? 0 : rect.hi[5])
-                        << " " << ((DIM < 7) ? 0 : rect.lo[6])
-                        << " " << ((DIM < 7) ? 0 : rect.hi[6]);
+        log_spy.print("Index Launch Rect %llu %d "
+                      "%lld %lld %lld %lld %lld %lld %lld %lld "
+                      "%lld %lld %lld %lld %lld %lld", unique_id, DIM,
+                      (long long)(rect.lo[0]), (long long)(rect.hi[0]),
+                      (long long)((DIM < 2) ? 0 : rect.lo[1]),
+                      (long long)((DIM < 2) ? 0 : rect.hi[1]),
+                      (long long)((DIM < 3) ? 0 : rect.lo[2]),
+                      (long long)((DIM < 3) ? 0 : rect.hi[2]),
+                      (long long)((DIM < 4) ? 0 : rect.lo[3]),
+                      (long long)((DIM < 4) ? 0 : rect.hi[3]),
+                      (long long)((DIM < 5) ? 0 : rect.lo[4]),
+                      (long long)((DIM < 5) ? 0 : rect.hi[4]),
+                      (long long)((DIM < 6) ? 0 : rect.lo[5]),
+                      (long long)((DIM < 6) ? 0 : rect.hi[5]),
+                      (long long)((DIM < 7) ? 0 : rect.lo[6]),
+                      (long long)((DIM < 7) ? 0 : rect.hi[6]));
 #elif LEGION_MAX_DIM == 8
-        log_spy.print() << "Index Launch Rect " << unique_id << " "
-                        << DIM << " " << rect.lo[0] << " " << rect.hi[0]
-                        << " " << ((DIM < 2) ? 0 : rect.lo[1])
-                        << " " << ((DIM < 2) ? 0 : rect.hi[1])
-                        << " " << ((DIM < 3) ? 0 : rect.lo[2])
-                        << " " << ((DIM < 3) ? 0 : rect.hi[2])
-                        << " " << ((DIM < 4) ? 0 : rect.lo[3])
-                        << " " << ((DIM < 4) ? 0 : rect.hi[3])
-                        << " " << ((DIM < 5) ? 0 : rect.lo[4])
-                        << " " << ((DIM < 5) ? 0 : rect.hi[4])
-                        << " " << ((DIM < 6) ? 0 : rect.lo[5])
-                        << " " << ((DIM < 6) ? 0 : rect.hi[5])
-                        << " " << ((DIM < 7) ? 0 : rect.lo[6])
-                        << " " << ((DIM < 7) ? 0 : rect.hi[6])
-                        << " " << ((DIM < 8) ? 0 : rect.lo[7])
-                        << " " << ((DIM < 8) ? 0 : rect.hi[7]);
+        log_spy.print("Index Launch Rect %llu %d "
+                      "%lld %lld %lld %lld %lld %lld %lld %lld "
+                      "%lld %lld %lld %lld %lld %lld %lld %lld", unique_id, DIM,
+                      (long long)(rect.lo[0]), (long long)(rect.hi[0]),
+                      (long long)((DIM < 2) ? 0 : rect.lo[1]),
+                      (long long)((DIM < 2) ? 0 : rect.hi[1]),
+                      (long long)((DIM < 3) ? 0 : rect.lo[2]),
+                      (long long)((DIM < 3) ? 0 : rect.hi[2]),
+                      (long long)((DIM < 4) ? 0 : rect.lo[3]),
+                      (long long)((DIM < 4) ? 0 : rect.hi[3]),
+                      (long long)((DIM < 5) ? 0 : rect.lo[4]),
+                      (long long)((DIM < 5) ? 0 : rect.hi[4]),
+                      (long long)((DIM < 6) ? 0 : rect.lo[5]),
+                      (long long)((DIM < 6) ? 0 : rect.hi[5]),
+                      (long long)((DIM < 7) ? 0 : rect.lo[6]),
+                      (long long)((DIM < 7) ? 0 : rect.hi[6]),
+                      (long long)((DIM < 8) ? 0 : rect.lo[7]),
+                      (long long)((DIM < 8) ? 0 : rect.hi[7]));
 #elif LEGION_MAX_DIM == 9
-        log_spy.print() << "Index Launch Rect " << unique_id << " "
-                        << DIM << " " << rect.lo[0] << " " << rect.hi[0]
-                        << " " << ((DIM < 2) ? 0 : rect.lo[1])
-                        << " " << ((DIM < 2) ? 0 : rect.hi[1])
-                        << " " << ((DIM < 3) ? 0 : rect.lo[2])
-                        << " " << ((DIM < 3) ? 0 : rect.hi[2])
-                        << " " << ((DIM < 4) ? 0 : rect.lo[3])
-                        << " " << ((DIM < 4) ? 0 : rect.hi[3])
-                        << " " << ((DIM < 5) ? 0 : rect.lo[4])
-                        << " " << ((DIM < 5) ? 0 : rect.hi[4])
-                        << " " << ((DIM < 6) ? 0 : rect.lo[5])
-                        << " " << ((DIM < 6) ? 0 : rect.hi[5])
-                        << " " << ((DIM < 7) ? 0 : rect.lo[6])
-                        << " " << ((DIM < 7) ? 0 : rect.hi[6])
-                        << " " << ((DIM < 8) ? 0 : rect.lo[7])
-                        << " " << ((DIM < 8) ? 0 : rect.hi[7])
-                        << " " << ((DIM < 9) ? 0 : rect.lo[8])
-                        << " " << ((DIM < 9) ? 0 : rect.hi[8]);
+        log_spy.print("Index Launch Rect %llu %d "
+                      "%lld %lld %lld %lld %lld %lld %lld %lld "
+                      "%lld %lld %lld %lld %lld %lld %lld %lld "
+                      "%lld %lld", unique_id, DIM,
+                      (long long)(rect.lo[0]), (long long)(rect.hi[0]),
+                      (long long)((DIM < 2) ? 0 : rect.lo[1]),
+                      (long long)((DIM < 2) ? 0 : rect.hi[1]),
+                      (long long)((DIM < 3) ? 0 : rect.lo[2]),
+                      (long long)((DIM < 3) ? 0 : rect.hi[2]),
+                      (long long)((DIM < 4) ? 0 : rect.lo[3]),
+                      (long long)((DIM < 4) ? 0 : rect.hi[3]),
+                      (long long)((DIM < 5) ? 0 : rect.lo[4]),
+                      (long long)((DIM < 5) ? 0 : rect.hi[4]),
+                      (long long)((DIM < 6) ? 0 : rect.lo[5]),
+                      (long long)((DIM < 6) ? 0 : rect.hi[5]),
+                      (long long)((DIM < 7) ? 0 : rect.lo[6]),
+                      (long long)((DIM < 7) ? 0 : rect.hi[6]),
+                      (long long)((DIM < 8) ? 0 : rect.lo[7]),
+                      (long long)((DIM < 8) ? 0 : rect.hi[7]),
+                      (long long)((DIM < 9) ? 0 : rect.lo[8]),
+                      (long long)((DIM < 9) ? 0 : rect.hi[8]));
 #else
 #error "Illegal LEGION_MAX_DIM"
 #endif
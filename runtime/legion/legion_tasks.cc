@@ -2071,6 +2071,7 @@ namespace Legion {
       selected_variant = 0;
       task_priority = 0;
       perform_postmap = false;
+      batch_mapped = false;
       first_mapping = true;
       execution_context = NULL;
       remote_trace_info = NULL;
@@ -3284,6 +3285,16 @@ namespace Legion {
       if (mapper == NULL)
         mapper = runtime->find_mapper(current_proc, map_id);
       mapper->invoke_map_task(this, &input, &output);
+      apply_map_task_output(input, output, must_epoch_owner, valid_instances);
+    }
+
+    //--------------------------------------------------------------------------
+    void SingleTask::apply_map_task_output(Mapper::MapTaskInput &input,
+                                           Mapper::MapTaskOutput &output,
+                                           MustEpochOp *must_epoch_owner,
+                                      std::vector<InstanceSet> &valid_instances)
+    //--------------------------------------------------------------------------
+    {
       // Now we can convert the mapper output into our physical instances
       finalize_map_task_output(input, output, must_epoch_owner,valid_instances);
       // Sort out any profiling requests that we need to perform
@@ -3413,7 +3424,9 @@ namespace Legion {
             // call first and then see if we need to do any versioning analysis
             if (defer_args == NULL/*first invocation*/)
             {
-              invoke_mapper(must_epoch_op);
+              // Our slice might have already mapped us in a batch
+              if (!batch_mapped)
+                invoke_mapper(must_epoch_op);
               const RtEvent version_ready_event = 
                 perform_versioning_analysis(true/*post mapper*/);
               if (version_ready_event.exists() && 
@@ -8955,6 +8968,9 @@ namespace Legion {
         enumerate_points();
       // Once we start mapping then we are no longer stealable
       stealable = false;
+      // Must epoch launches have constraints that are handled point by point
+      if (epoch_owner == NULL)
+        batch_map_points();
       std::set<RtEvent> mapped_events;
       for (std::vector<PointTask*>::const_iterator it = 
             points.begin(); it != points.end(); it++)
@@ -9002,6 +9018,7 @@ namespace Legion {
 #ifdef DEBUG_LEGION
       assert(!points.empty());
 #endif
+      batch_map_points();
       const size_t num_points = points.size();
       for (unsigned idx = 0; idx < num_points; idx++)
       {
@@ -9014,6 +9031,50 @@ namespace Legion {
       }
     }
 
+    //--------------------------------------------------------------------------
+    void SliceTask::batch_map_points(void)
+    //--------------------------------------------------------------------------
+    {
+      // Points that want valid instances have to do their versioning 
+      // analysis before they can be mapped so they are mapped one by one
+      if (request_valid_instances || (points.size() < 2))
+        return;
+      if (mapper == NULL)
+        mapper = runtime->find_mapper(current_proc, map_id);
+      if (!mapper->request_batched_map_task)
+        return;
+      const size_t num_points = points.size();
+      Mapper::MapTaskBatchInput input;
+      Mapper::MapTaskBatchOutput output;
+      input.tasks.resize(num_points);
+      input.inputs.resize(num_points);
+      output.outputs.resize(num_points);
+      std::vector<std::vector<InstanceSet> > valid_instances(num_points);
+      for (unsigned idx = 0; idx < num_points; idx++)
+      {
+        PointTask *point = points[idx];
+#ifdef DEBUG_LEGION
+        assert(!point->batch_mapped);
+        assert(point->current_proc == current_proc);
+#endif
+        input.tasks[idx] = point;
+        output.outputs[idx].profiling_priority = LG_THROUGHPUT_WORK_PRIORITY;
+        point->initialize_map_task_input(input.inputs[idx], 
+            output.outputs[idx], NULL/*must epoch*/, valid_instances[idx]);
+      }
+      // One mapper call for all the points instead of one per point
+      mapper->invoke_map_task_batch(this, &input, &output);
+      for (unsigned idx = 0; idx < num_points; idx++)
+      {
+        PointTask *point = points[idx];
+        if (point->mapper == NULL)
+          point->mapper = mapper;
+        point->apply_map_task_output(input.inputs[idx], output.outputs[idx],
+                                     NULL/*must epoch*/, valid_instances[idx]);
+        point->batch_mapped = true;
+      }
+    }
+
     //--------------------------------------------------------------------------
     ApEvent SliceTask::get_task_completion(void) const
     //--------------------------------------------------------------------------
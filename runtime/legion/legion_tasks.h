@@ -473,6 +473,10 @@ namespace Legion {
           VariantImpl *impl, Processor::Kind kind, const char *call_name) const;
     protected:
       void invoke_mapper(MustEpochOp *must_epoch_owner);
+      void apply_map_task_output(Mapper::MapTaskInput &input,
+                                 Mapper::MapTaskOutput &output,
+                                 MustEpochOp *must_epoch_owner,
+                                 std::vector<InstanceSet> &valid_instances);
       RtEvent map_all_regions(ApEvent user_event, MustEpochOp *must_epoch_owner,
                               const DeferMappingArgs *defer_args);
       void perform_post_mapping(const TraceInfo &trace_info);
@@ -552,6 +556,9 @@ namespace Legion {
       VariantID                             selected_variant;
       TaskPriority                          task_priority;
       bool                                  perform_postmap;
+      // Set when the slice already invoked the mapper for this point 
+      // as part of a batched map_task_batch call
+      bool                                  batch_mapped;
     protected:
       // origin-mapped cases need to know if they've been mapped or not yet
       bool                                  first_mapping;
@@ -1094,6 +1101,8 @@ namespace Legion {
       PointTask* clone_as_point_task(const DomainPoint &point);
       void enumerate_points(void);
       const void* get_predicate_false_result(size_t &result_size);
+    protected:
+      void batch_map_points(void);
     public:
       std::map<PhysicalManager*,std::pair<unsigned,bool> >* 
                                      get_acquired_instances_ref(void);
@@ -22,6 +22,8 @@
 #include "legion/legion_instances.h"
 #include "legion/legion_views.h"
 #include "legion/legion_context.h"
+#include "legion/legion_profiling.h"
+#include <unistd.h> // unlink for the template cache
 
 namespace Legion {
   namespace Internal {
@@ -2491,10 +2493,22 @@ namespace Legion {
         operations[tasks[idx]]
           ->get_operation()->set_execution_fence_event(fence);
       std::vector<Instruction*> &instructions = slices[slice_idx];
+      LegionProfiler *profiler = trace->runtime->profiler;
+      const unsigned long long start = (profiler != NULL) ?
+        Realm::Clock::current_time_in_nanoseconds() : 0;
       for (std::vector<Instruction*>::const_iterator it = instructions.begin();
            it != instructions.end(); ++it)
         (*it)->execute();
+      // once the fence triggers the template can be recycled or deleted,
+      // so capture everything the profiler needs before triggering it
+      const unsigned num_instructions = instructions.size();
+      const unsigned long long cost = slice_costs[slice_idx];
+      const unsigned long long stop = (profiler != NULL) ?
+        Realm::Clock::current_time_in_nanoseconds() : 0;
       Runtime::trigger_event(NULL, fence);
+      if (profiler != NULL)
+        profiler->record_replay_slice(slice_idx, num_instructions, cost,
+                                      start, stop);
     }
 
     //--------------------------------------------------------------------------
@@ -2569,13 +2583,49 @@ namespace Legion {
       }
       if (!trace->runtime->no_trace_optimization)
       {
+        // Everything after fence elision only depends on the structure of
+        // the instruction graph, so see if we optimized the very same
+        // graph in a previous run and can reuse what we did then
+        const bool use_cache = !trace->runtime->trace_cache_directory.empty();
+        const unsigned long long start = use_cache ?
+          Realm::Clock::current_time_in_nanoseconds() : 0;
+        Serializer key;
+        if (use_cache)
+        {
+          pack_optimization_key(key, gen);
+          if (load_cached_optimization(key))
+          {
+            const unsigned long long stop =
+              Realm::Clock::current_time_in_nanoseconds();
+            log_tracing.info("Optimized template for trace %d in %llu us "
+                             "(loaded from the cache)",
+                             trace->logical_trace->get_trace_id(),
+                             (stop - start) / 1000);
+            return;
+          }
+        }
         propagate_merges(gen);
         transitive_reduction();
         propagate_copies(gen);
         eliminate_dead_code(gen);
+        prepare_parallel_replay(gen);
+        push_complete_replays();
+        if (use_cache)
+        {
+          save_cached_optimization(key);
+          const unsigned long long stop =
+            Realm::Clock::current_time_in_nanoseconds();
+          log_tracing.info("Optimized template for trace %d in %llu us "
+                           "(computed and saved to the cache)",
+                           trace->logical_trace->get_trace_id(),
+                           (stop - start) / 1000);
+        }
+      }
+      else
+      {
+        prepare_parallel_replay(gen);
+        push_complete_replays();
       }
-      prepare_parallel_replay(gen);
-      push_complete_replays();
     }
 
     //--------------------------------------------------------------------------
@@ -2843,70 +2893,26 @@ namespace Legion {
     {
       slices.resize(replay_parallelism);
       slice_tasks.resize(replay_parallelism);
-      std::map<TraceLocalID, unsigned> slice_indices_by_owner;
-      std::vector<unsigned> slice_indices_by_inst;
-      slice_indices_by_inst.resize(instructions.size());
+      slice_costs.resize(replay_parallelism, 0);
+      // The fence instruction is not part of any slice, but the events it
+      // generates are assigned before any of the slices start
+      std::vector<unsigned> slice_indices_by_inst(instructions.size(), -1U);
+      if (!instructions.empty())
+        slice_indices_by_inst[0] = 0;
+      if (trace->runtime->no_trace_optimization)
+        assign_round_robin_slices(slice_indices_by_inst);
+      else
+        assign_balanced_slices(gen, slice_indices_by_inst);
 
-#ifdef DEBUG_LEGION
       for (unsigned idx = 1; idx < instructions.size(); ++idx)
-        slice_indices_by_inst[idx] = -1U;
-#endif
-      bool round_robin_for_tasks = false;
-
-      std::set<Processor> distinct_targets;
-      for (CachedMappings::iterator it = cached_mappings.begin(); it !=
-           cached_mappings.end(); ++it)
-        distinct_targets.insert(it->second.target_procs[0]);
-      round_robin_for_tasks = distinct_targets.size() < replay_parallelism;
-
-      unsigned next_slice_id = 0;
-      for (std::map<TraceLocalID,std::pair<unsigned,bool> >::const_iterator 
-            it = memo_entries.begin(); it != memo_entries.end(); ++it)
       {
-        unsigned slice_index = -1U;
-        if (!round_robin_for_tasks && it->second.second)
-        {
-          CachedMappings::iterator finder = cached_mappings.find(it->first);
-#ifdef DEBUG_LEGION
-          assert(finder != cached_mappings.end());
-          assert(finder->second.target_procs.size() > 0);
-#endif
-          slice_index =
-            finder->second.target_procs[0].id % replay_parallelism;
-        }
-        else
-        {
-#ifdef DEBUG_LEGION
-          assert(slice_indices_by_owner.find(it->first) ==
-              slice_indices_by_owner.end());
-#endif
-          slice_index = next_slice_id;
-          next_slice_id = (next_slice_id + 1) % replay_parallelism;
-        }
-
+        Instruction *inst = instructions[idx];
+        const unsigned slice_index = slice_indices_by_inst[idx];
 #ifdef DEBUG_LEGION
-        assert(slice_index != -1U);
+        assert(slice_index < replay_parallelism);
 #endif
-        slice_indices_by_owner[it->first] = slice_index;
-        if (it->second.second)
-          slice_tasks[slice_index].push_back(it->first);
-      }
-      for (unsigned idx = 1; idx < instructions.size(); ++idx)
-      {
-        Instruction *inst = instructions[idx];
-        const TraceLocalID &owner = inst->owner;
-        std::map<TraceLocalID, unsigned>::iterator finder =
-          slice_indices_by_owner.find(owner);
-        unsigned slice_index = -1U;
-        if (finder != slice_indices_by_owner.end())
-          slice_index = finder->second;
-        else
-        {
-          slice_index = next_slice_id;
-          next_slice_id = (next_slice_id + 1) % replay_parallelism;
-        }
         slices[slice_index].push_back(inst);
-        slice_indices_by_inst[idx] = slice_index;
+        slice_costs[slice_index] += estimate_replay_cost(inst);
 
         if (inst->get_kind() == MERGE_EVENT)
         {
@@ -2941,9 +2947,10 @@ namespace Legion {
                   events.resize(events.size() + 1);
                   crossing_events[rh] = new_crossing_event;
                   new_rhs.insert(new_crossing_event);
-                  slices[generator_slice].push_back(
-                      new TriggerEvent(*this, new_crossing_event, rh,
-                        instructions[gen[rh]]->owner));
+                  Instruction *trigger = new TriggerEvent(*this,
+                      new_crossing_event, rh, instructions[gen[rh]]->owner);
+                  slices[generator_slice].push_back(trigger);
+                  slice_costs[generator_slice] += estimate_replay_cost(trigger);
                 }
               }
               else
@@ -2956,39 +2963,7 @@ namespace Legion {
         }
         else
         {
-          unsigned *event_to_check = NULL;
-          switch (inst->get_kind())
-          {
-            case TRIGGER_EVENT :
-              {
-                event_to_check = &inst->as_trigger_event()->rhs;
-                break;
-              }
-            case ISSUE_COPY :
-              {
-                event_to_check = &inst->as_issue_copy()->precondition_idx;
-                break;
-              }
-            case ISSUE_FILL :
-              {
-                event_to_check = &inst->as_issue_fill()->precondition_idx;
-                break;
-              }
-            case SET_EFFECTS :
-              {
-                event_to_check = &inst->as_set_effects()->rhs;
-                break;
-              }
-            case COMPLETE_REPLAY :
-              {
-                event_to_check = &inst->as_complete_replay()->rhs;
-                break;
-              }
-            default:
-              {
-                break;
-              }
-          }
+          unsigned *event_to_check = find_precondition_event(inst);
           if (event_to_check != NULL)
           {
             unsigned ev = *event_to_check;
@@ -2996,6 +2971,9 @@ namespace Legion {
 #ifdef DEBUG_LEGION
             assert(g != -1U && g < instructions.size());
 #endif
+            // events produced by the fence are ready before any slice runs
+            if (g == 0)
+              continue;
             unsigned generator_slice = slice_indices_by_inst[g];
 #ifdef DEBUG_LEGION
             assert(generator_slice != -1U);
@@ -3012,9 +2990,10 @@ namespace Legion {
                 events.resize(events.size() + 1);
                 crossing_events[ev] = new_crossing_event;
                 *event_to_check = new_crossing_event;
-                slices[generator_slice].push_back(
-                    new TriggerEvent(*this, new_crossing_event, ev,
-                      instructions[g]->owner));
+                Instruction *trigger = new TriggerEvent(*this,
+                    new_crossing_event, ev, instructions[g]->owner);
+                slices[generator_slice].push_back(trigger);
+                slice_costs[generator_slice] += estimate_replay_cost(trigger);
               }
             }
           }
@@ -3022,6 +3001,259 @@ namespace Legion {
       }
     }
 
+    //--------------------------------------------------------------------------
+    void PhysicalTemplate::assign_round_robin_slices(
+                                         std::vector<unsigned> &slice_by_inst)
+    //--------------------------------------------------------------------------
+    {
+      bool round_robin_for_tasks = false;
+
+      std::set<Processor> distinct_targets;
+      for (CachedMappings::iterator it = cached_mappings.begin(); it !=
+           cached_mappings.end(); ++it)
+        distinct_targets.insert(it->second.target_procs[0]);
+      round_robin_for_tasks = distinct_targets.size() < replay_parallelism;
+
+      std::map<TraceLocalID, unsigned> slice_indices_by_owner;
+      unsigned next_slice_id = 0;
+      for (std::map<TraceLocalID,std::pair<unsigned,bool> >::const_iterator 
+            it = memo_entries.begin(); it != memo_entries.end(); ++it)
+      {
+        unsigned slice_index = -1U;
+        if (!round_robin_for_tasks && it->second.second)
+        {
+          CachedMappings::iterator finder = cached_mappings.find(it->first);
+#ifdef DEBUG_LEGION
+          assert(finder != cached_mappings.end());
+          assert(finder->second.target_procs.size() > 0);
+#endif
+          slice_index =
+            finder->second.target_procs[0].id % replay_parallelism;
+        }
+        else
+        {
+#ifdef DEBUG_LEGION
+          assert(slice_indices_by_owner.find(it->first) ==
+              slice_indices_by_owner.end());
+#endif
+          slice_index = next_slice_id;
+          next_slice_id = (next_slice_id + 1) % replay_parallelism;
+        }
+
+#ifdef DEBUG_LEGION
+        assert(slice_index != -1U);
+#endif
+        slice_indices_by_owner[it->first] = slice_index;
+        if (it->second.second)
+          slice_tasks[slice_index].push_back(it->first);
+      }
+      for (unsigned idx = 1; idx < instructions.size(); ++idx)
+      {
+        std::map<TraceLocalID, unsigned>::const_iterator finder =
+          slice_indices_by_owner.find(instructions[idx]->owner);
+        if (finder != slice_indices_by_owner.end())
+          slice_by_inst[idx] = finder->second;
+        else
+        {
+          slice_by_inst[idx] = next_slice_id;
+          next_slice_id = (next_slice_id + 1) % replay_parallelism;
+        }
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    void PhysicalTemplate::assign_balanced_slices(
+                                         const std::vector<unsigned> &gen,
+                                         std::vector<unsigned> &slice_by_inst)
+    //--------------------------------------------------------------------------
+    {
+      // Every event that crosses between slices costs a user event that
+      // has to be made for each replay plus a trigger in the generating
+      // slice, and it delays the consumer until the producer slice runs,
+      // so charge a few instructions worth of cost for each of them
+      const unsigned long long crossing_cost = 4;
+      // All the instructions recorded for the same operation have to
+      // replay in the same slice so the operation can be fenced on it,
+      // so we partition groups of instructions rather than instructions.
+      // Instructions without a memoized owner each get their own group.
+      std::map<TraceLocalID, unsigned> group_by_owner;
+      std::vector<unsigned> group_by_inst(instructions.size(), -1U);
+      std::vector<unsigned long long> group_costs;
+      for (unsigned idx = 1; idx < instructions.size(); ++idx)
+      {
+        Instruction *inst = instructions[idx];
+        unsigned group = -1U;
+        if (memo_entries.find(inst->owner) != memo_entries.end())
+        {
+          std::map<TraceLocalID, unsigned>::const_iterator finder =
+            group_by_owner.find(inst->owner);
+          if (finder == group_by_owner.end())
+          {
+            group = group_costs.size();
+            group_by_owner[inst->owner] = group;
+            group_costs.push_back(0);
+          }
+          else
+            group = finder->second;
+        }
+        else
+        {
+          group = group_costs.size();
+          group_costs.push_back(0);
+        }
+        group_by_inst[idx] = group;
+        group_costs[group] += estimate_replay_cost(inst);
+      }
+      // Build the event edges between the groups, counting each event at
+      // most once per pair of groups since a crossing event is shared by
+      // all of its consumers in the same slice
+      std::vector<std::map<unsigned, unsigned> > producers(group_costs.size());
+      std::vector<std::map<unsigned, unsigned> > consumers(group_costs.size());
+      std::set<std::pair<unsigned, unsigned> > edge_events;
+      for (unsigned idx = 1; idx < instructions.size(); ++idx)
+      {
+        Instruction *inst = instructions[idx];
+        const unsigned group = group_by_inst[idx];
+        std::vector<unsigned> preconditions;
+        if (inst->get_kind() == MERGE_EVENT)
+        {
+          const std::set<unsigned> &rhs = inst->as_merge_event()->rhs;
+          preconditions.insert(preconditions.end(), rhs.begin(), rhs.end());
+        }
+        else
+        {
+          const unsigned *event = find_precondition_event(inst);
+          if (event != NULL)
+            preconditions.push_back(*event);
+        }
+        for (std::vector<unsigned>::const_iterator it = 
+              preconditions.begin(); it != preconditions.end(); it++)
+        {
+          // Events generated by the fence are ready in every slice
+          const unsigned g = gen[*it];
+          if ((g == 0) || (g == -1U))
+            continue;
+          const unsigned producer = group_by_inst[g];
+          if ((producer == group) ||
+              !edge_events.insert(std::make_pair(*it, group)).second)
+            continue;
+          producers[group][producer]++;
+          consumers[producer][group]++;
+        }
+      }
+      // Greedily place the groups in program order, putting each one on
+      // the slice that minimizes the slice's load plus the cost of the
+      // events that would have to cross from already placed neighbors
+      std::vector<unsigned> slice_by_group(group_costs.size(), -1U);
+      std::vector<unsigned long long> loads(replay_parallelism, 0);
+      for (unsigned group = 0; group < group_costs.size(); group++)
+      {
+        unsigned best_slice = 0;
+        unsigned long long best_score = 0;
+        for (unsigned slice = 0; slice < replay_parallelism; slice++)
+        {
+          unsigned long long crossings = 0;
+          for (std::map<unsigned, unsigned>::const_iterator it = 
+                producers[group].begin(); it != producers[group].end(); it++)
+            if ((slice_by_group[it->first] != -1U) &&
+                (slice_by_group[it->first] != slice))
+              crossings += it->second;
+          for (std::map<unsigned, unsigned>::const_iterator it = 
+                consumers[group].begin(); it != consumers[group].end(); it++)
+            if ((slice_by_group[it->first] != -1U) && 
+                (slice_by_group[it->first] != slice))
+              crossings += it->second;
+          const unsigned long long score = 
+            loads[slice] + group_costs[group] + crossings * crossing_cost;
+          if ((slice == 0) || (score < best_score) ||
+              ((score == best_score) && (loads[slice] < loads[best_slice])))
+          {
+            best_slice = slice;
+            best_score = score;
+          }
+        }
+        slice_by_group[group] = best_slice;
+        loads[best_slice] += group_costs[group];
+        // Charge the triggers for crossing events to the producer slices
+        for (std::map<unsigned, unsigned>::const_iterator it = 
+              producers[group].begin(); it != producers[group].end(); it++)
+          if ((slice_by_group[it->first] != -1U) &&
+              (slice_by_group[it->first] != best_slice))
+            loads[slice_by_group[it->first]] += it->second;
+        for (std::map<unsigned, unsigned>::const_iterator it = 
+              consumers[group].begin(); it != consumers[group].end(); it++)
+          if ((slice_by_group[it->first] != -1U) &&
+              (slice_by_group[it->first] != best_slice))
+            loads[best_slice] += it->second;
+      }
+      for (unsigned idx = 1; idx < instructions.size(); ++idx)
+        slice_by_inst[idx] = slice_by_group[group_by_inst[idx]];
+      // Tasks get fenced on the slice holding their instructions; any
+      // memoized tasks without instructions go to the least loaded slice
+      for (std::map<TraceLocalID,std::pair<unsigned,bool> >::const_iterator
+            it = memo_entries.begin(); it != memo_entries.end(); ++it)
+      {
+        if (!it->second.second)
+          continue;
+        std::map<TraceLocalID, unsigned>::const_iterator finder =
+          group_by_owner.find(it->first);
+        unsigned slice_index = 0;
+        if (finder != group_by_owner.end())
+          slice_index = slice_by_group[finder->second];
+        else
+          slice_index = std::min_element(loads.begin(), loads.end()) - 
+                          loads.begin();
+        slice_tasks[slice_index].push_back(it->first);
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    /*static*/ unsigned* PhysicalTemplate::find_precondition_event(
+                                                            Instruction *inst)
+    //--------------------------------------------------------------------------
+    {
+      switch (inst->get_kind())
+      {
+        case TRIGGER_EVENT :
+          return &inst->as_trigger_event()->rhs;
+        case ISSUE_COPY :
+          return &inst->as_issue_copy()->precondition_idx;
+        case ISSUE_FILL :
+          return &inst->as_issue_fill()->precondition_idx;
+        case SET_EFFECTS :
+          return &inst->as_set_effects()->rhs;
+        case COMPLETE_REPLAY :
+          return &inst->as_complete_replay()->rhs;
+        default:
+          break;
+      }
+      return NULL;
+    }
+
+    //--------------------------------------------------------------------------
+    /*static*/ unsigned long long PhysicalTemplate::estimate_replay_cost(
+                                                            Instruction *inst)
+    //--------------------------------------------------------------------------
+    {
+      // These are rough relative costs of replaying each instruction,
+      // issuing copies and fills to Realm and completing operations are
+      // far more expensive than the event bookkeeping instructions
+      switch (inst->get_kind())
+      {
+        case MERGE_EVENT :
+          return 1 + inst->as_merge_event()->rhs.size();
+        case ISSUE_COPY :
+          return 16 + inst->as_issue_copy()->src_fields.size();
+        case ISSUE_FILL :
+          return 16 + inst->as_issue_fill()->fields.size();
+        case COMPLETE_REPLAY :
+          return 8;
+        default:
+          break;
+      }
+      return 1;
+    }
+
     //--------------------------------------------------------------------------
     void PhysicalTemplate::transitive_reduction(void)
     //--------------------------------------------------------------------------
@@ -3538,6 +3770,560 @@ namespace Legion {
       }
     }
 
+    // Header of the files holding cached template optimizations. The key is
+    // the whole instruction graph before optimization, which must match
+    // exactly for the cached result to be used.
+    struct TemplateCacheHeader {
+      char magic[8];
+      unsigned version;
+      unsigned long long key_size;
+      unsigned long long result_size;
+      unsigned long long result_hash;
+    };
+    static const char *const template_cache_magic = "LGTPLOPT";
+    static const unsigned template_cache_version = 1;
+
+    //--------------------------------------------------------------------------
+    static inline unsigned long long hash_template_cache_bytes(const void *ptr,
+                                                               size_t size)
+    //--------------------------------------------------------------------------
+    {
+      // 64-bit FNV-1a
+      const unsigned char *bytes = (const unsigned char*)ptr;
+      unsigned long long hash = 0xcbf29ce484222325ULL;
+      for (size_t idx = 0; idx < size; idx++)
+      {
+        hash ^= bytes[idx];
+        hash *= 0x100000001b3ULL;
+      }
+      return hash;
+    }
+
+    //--------------------------------------------------------------------------
+    static inline void pack_template_cache_owner(Serializer &rez,
+                                                 const TraceLocalID &owner)
+    //--------------------------------------------------------------------------
+    {
+      // Not the DomainPoint serializer since it packs an uninitialized
+      // coordinate for zero-dimensional points and keys must be canonical
+      rez.serialize(owner.first);
+      rez.serialize(owner.second.dim);
+      for (int idx = 0; idx < owner.second.dim; idx++)
+        rez.serialize(owner.second.point_data[idx]);
+    }
+
+    //--------------------------------------------------------------------------
+    static inline bool unpack_template_cache_owner(Deserializer &derez,
+                                                   TraceLocalID &owner)
+    //--------------------------------------------------------------------------
+    {
+      derez.deserialize(owner.first);
+      int dim;
+      derez.deserialize(dim);
+      if ((dim < 0) || (dim > LEGION_MAX_DIM))
+        return false;
+      owner.second = DomainPoint();
+      owner.second.dim = dim;
+      for (int idx = 0; idx < dim; idx++)
+        derez.deserialize(owner.second.point_data[idx]);
+      return true;
+    }
+
+    //--------------------------------------------------------------------------
+    /*static*/ void PhysicalTemplate::pack_instruction(Serializer &rez,
+                                                       Instruction *inst)
+    //--------------------------------------------------------------------------
+    {
+      const InstructionKind kind = inst->get_kind();
+      rez.serialize(kind);
+      pack_template_cache_owner(rez, inst->owner);
+      switch (kind)
+      {
+        case GET_TERM_EVENT:
+          {
+            rez.serialize(inst->as_get_term_event()->lhs);
+            break;
+          }
+        case CREATE_AP_USER_EVENT:
+          {
+            rez.serialize(inst->as_create_ap_user_event()->lhs);
+            break;
+          }
+        case TRIGGER_EVENT:
+          {
+            TriggerEvent *trigger = inst->as_trigger_event();
+            rez.serialize(trigger->lhs);
+            rez.serialize(trigger->rhs);
+            break;
+          }
+        case MERGE_EVENT:
+          {
+            MergeEvent *merge = inst->as_merge_event();
+            rez.serialize(merge->lhs);
+            rez.serialize<size_t>(merge->rhs.size());
+            for (std::set<unsigned>::const_iterator it = 
+                  merge->rhs.begin(); it != merge->rhs.end(); it++)
+              rez.serialize(*it);
+            break;
+          }
+        case ISSUE_COPY:
+          {
+            // The copy itself is reused from the recording, so we only
+            // need enough of it to make sure it is the same copy
+            IssueCopy *copy = inst->as_issue_copy();
+            rez.serialize(copy->lhs);
+            rez.serialize(copy->precondition_idx);
+            rez.serialize<size_t>(copy->src_fields.size());
+            rez.serialize<size_t>(copy->dst_fields.size());
+            rez.serialize(copy->redop);
+            // Bools leave padding bytes uninitialized in the buffer
+            rez.serialize<unsigned>(copy->reduction_fold ? 1 : 0);
+            break;
+          }
+        case ISSUE_FILL:
+          {
+            IssueFill *fill = inst->as_issue_fill();
+            rez.serialize(fill->lhs);
+            rez.serialize(fill->precondition_idx);
+            rez.serialize<size_t>(fill->fields.size());
+            rez.serialize(fill->fill_size);
+            break;
+          }
+        case SET_OP_SYNC_EVENT:
+          {
+            rez.serialize(inst->as_set_op_sync_event()->lhs);
+            break;
+          }
+        case SET_EFFECTS:
+          {
+            rez.serialize(inst->as_set_effects()->rhs);
+            break;
+          }
+        case ASSIGN_FENCE_COMPLETION:
+          {
+            rez.serialize(inst->as_assignment_fence_completion()->lhs);
+            break;
+          }
+        case COMPLETE_REPLAY:
+          {
+            rez.serialize(inst->as_complete_replay()->rhs);
+            break;
+          }
+        default:
+          assert(false);
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    void PhysicalTemplate::pack_optimization_key(Serializer &rez,
+                                        const std::vector<unsigned> &gen) const
+    //--------------------------------------------------------------------------
+    {
+      rez.serialize(replay_parallelism);
+      rez.serialize<size_t>(events.size());
+      rez.serialize<size_t>(gen.size());
+      for (std::vector<unsigned>::const_iterator it = 
+            gen.begin(); it != gen.end(); it++)
+        rez.serialize(*it);
+      rez.serialize<size_t>(frontiers.size());
+      for (std::map<unsigned,unsigned>::const_iterator it = 
+            frontiers.begin(); it != frontiers.end(); it++)
+      {
+        rez.serialize(it->first);
+        rez.serialize(it->second);
+      }
+      rez.serialize<size_t>(memo_entries.size());
+      for (std::map<TraceLocalID,std::pair<unsigned,bool> >::const_iterator
+            it = memo_entries.begin(); it != memo_entries.end(); it++)
+      {
+        pack_template_cache_owner(rez, it->first);
+        rez.serialize<unsigned>(it->second.second ? 1 : 0);
+      }
+      rez.serialize<size_t>(instructions.size());
+      for (std::vector<Instruction*>::const_iterator it = 
+            instructions.begin(); it != instructions.end(); it++)
+        pack_instruction(rez, *it);
+    }
+
+    //--------------------------------------------------------------------------
+    void PhysicalTemplate::pack_optimization_result(Serializer &rez) const
+    //--------------------------------------------------------------------------
+    {
+      rez.serialize<size_t>(events.size());
+      rez.serialize<size_t>(crossing_events.size());
+      for (std::map<unsigned,unsigned>::const_iterator it = 
+            crossing_events.begin(); it != crossing_events.end(); it++)
+      {
+        rez.serialize(it->first);
+        rez.serialize(it->second);
+      }
+      for (unsigned sidx = 0; sidx < replay_parallelism; sidx++)
+      {
+        rez.serialize(slice_costs[sidx]);
+        const std::vector<Instruction*> &slice = slices[sidx];
+        rez.serialize<size_t>(slice.size());
+        for (std::vector<Instruction*>::const_iterator it = 
+              slice.begin(); it != slice.end(); it++)
+          pack_instruction(rez, *it);
+        const std::vector<TraceLocalID> &tasks = slice_tasks[sidx];
+        rez.serialize<size_t>(tasks.size());
+        for (std::vector<TraceLocalID>::const_iterator it = 
+              tasks.begin(); it != tasks.end(); it++)
+          pack_template_cache_owner(rez, *it);
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    bool PhysicalTemplate::unpack_optimization_result(Deserializer &derez)
+    //--------------------------------------------------------------------------
+    {
+      // The key matched so this should be exactly what we would have
+      // computed, but we still check everything we rely on so that a
+      // stale or damaged cache can never produce a broken template
+      size_t num_events;
+      derez.deserialize(num_events);
+      if (num_events < events.size())
+      {
+        derez.advance_pointer(derez.get_remaining_bytes());
+        return false;
+      }
+      // Instructions check their events against the size of the table
+      // so grow it for the crossing events before rebuilding them
+      const size_t original_events = events.size();
+      events.resize(num_events);
+      bool valid = true;
+      std::map<unsigned,unsigned> new_crossing_events;
+      size_t num_crossing;
+      derez.deserialize(num_crossing);
+      for (unsigned idx = 0; idx < num_crossing; idx++)
+      {
+        unsigned original, crossing;
+        derez.deserialize(original);
+        derez.deserialize(crossing);
+        if ((original >= num_events) || (crossing >= num_events))
+        {
+          valid = false;
+          break;
+        }
+        new_crossing_events[original] = crossing;
+      }
+      // Copies and fills carry payloads that only exist in this run so
+      // we reuse the recorded ones; everything else is rebuilt
+      std::map<unsigned,Instruction*> recorded_copies;
+      for (unsigned idx = 1; idx < instructions.size(); idx++)
+      {
+        Instruction *inst = instructions[idx];
+        if (inst->get_kind() == ISSUE_COPY)
+          recorded_copies[inst->as_issue_copy()->lhs] = inst;
+        else if (inst->get_kind() == ISSUE_FILL)
+          recorded_copies[inst->as_issue_fill()->lhs] = inst;
+      }
+      std::set<Instruction*> reused;
+      std::vector<Instruction*> created;
+      std::vector<std::vector<Instruction*> > new_slices(replay_parallelism);
+      std::vector<std::vector<TraceLocalID> > new_tasks(replay_parallelism);
+      std::vector<unsigned long long> new_costs(replay_parallelism, 0);
+      for (unsigned sidx = 0; valid && (sidx < replay_parallelism); sidx++)
+      {
+        derez.deserialize(new_costs[sidx]);
+        size_t num_instructions;
+        derez.deserialize(num_instructions);
+        for (unsigned idx = 0; valid && (idx < num_instructions); idx++)
+        {
+          InstructionKind kind;
+          derez.deserialize(kind);
+          TraceLocalID owner;
+          if (!unpack_template_cache_owner(derez, owner))
+            valid = false;
+          Instruction *inst = NULL;
+          switch (kind)
+          {
+            case GET_TERM_EVENT:
+              {
+                unsigned lhs;
+                derez.deserialize(lhs);
+                if (valid && (lhs < num_events))
+                  inst = new GetTermEvent(*this, lhs, owner);
+                break;
+              }
+            case CREATE_AP_USER_EVENT:
+              {
+                unsigned lhs;
+                derez.deserialize(lhs);
+                if (valid && (lhs < num_events))
+                  inst = new CreateApUserEvent(*this, lhs, owner);
+                break;
+              }
+            case TRIGGER_EVENT:
+              {
+                unsigned lhs, rhs;
+                derez.deserialize(lhs);
+                derez.deserialize(rhs);
+                if (valid && (lhs < num_events) && (rhs < num_events))
+                  inst = new TriggerEvent(*this, lhs, rhs, owner);
+                break;
+              }
+            case MERGE_EVENT:
+              {
+                unsigned lhs;
+                derez.deserialize(lhs);
+                size_t num_rhs;
+                derez.deserialize(num_rhs);
+                std::set<unsigned> rhs;
+                for (unsigned ridx = 0; ridx < num_rhs; ridx++)
+                {
+                  unsigned event;
+                  derez.deserialize(event);
+                  if (event >= num_events)
+                    valid = false;
+                  rhs.insert(event);
+                }
+                if (valid && (lhs < num_events) && !rhs.empty())
+                  inst = new MergeEvent(*this, lhs, rhs, owner);
+                break;
+              }
+            case ISSUE_COPY:
+              {
+                unsigned lhs, precondition_idx;
+                size_t num_src_fields, num_dst_fields;
+                ReductionOpID redop;
+                unsigned reduction_fold;
+                derez.deserialize(lhs);
+                derez.deserialize(precondition_idx);
+                derez.deserialize(num_src_fields);
+                derez.deserialize(num_dst_fields);
+                derez.deserialize(redop);
+                derez.deserialize(reduction_fold);
+                std::map<unsigned,Instruction*>::const_iterator finder =
+                  recorded_copies.find(lhs);
+                if (!valid || (finder == recorded_copies.end()) ||
+                    (finder->second->get_kind() != ISSUE_COPY) ||
+                    (precondition_idx >= num_events))
+                  break;
+                IssueCopy *copy = finder->second->as_issue_copy();
+                if ((copy->owner != owner) ||
+                    (copy->src_fields.size() != num_src_fields) ||
+                    (copy->dst_fields.size() != num_dst_fields) ||
+                    (copy->redop != redop) ||
+                    (copy->reduction_fold != (reduction_fold != 0)) ||
+                    !reused.insert(copy).second)
+                  break;
+                copy->precondition_idx = precondition_idx;
+                inst = copy;
+                break;
+              }
+            case ISSUE_FILL:
+              {
+                unsigned lhs, precondition_idx;
+                size_t num_fields, fill_size;
+                derez.deserialize(lhs);
+                derez.deserialize(precondition_idx);
+                derez.deserialize(num_fields);
+                derez.deserialize(fill_size);
+                std::map<unsigned,Instruction*>::const_iterator finder =
+                  recorded_copies.find(lhs);
+                if (!valid || (finder == recorded_copies.end()) ||
+                    (finder->second->get_kind() != ISSUE_FILL) ||
+                    (precondition_idx >= num_events))
+                  break;
+                IssueFill *fill = finder->second->as_issue_fill();
+                if ((fill->owner != owner) ||
+                    (fill->fields.size() != num_fields) ||
+                    (fill->fill_size != fill_size) ||
+                    !reused.insert(fill).second)
+                  break;
+                fill->precondition_idx = precondition_idx;
+                inst = fill;
+                break;
+              }
+            case SET_OP_SYNC_EVENT:
+              {
+                unsigned lhs;
+                derez.deserialize(lhs);
+                if (valid && (lhs < num_events))
+                  inst = new SetOpSyncEvent(*this, lhs, owner);
+                break;
+              }
+            case SET_EFFECTS:
+              {
+                unsigned rhs;
+                derez.deserialize(rhs);
+                if (valid && (rhs < num_events))
+                  inst = new SetEffects(*this, owner, rhs);
+                break;
+              }
+            case COMPLETE_REPLAY:
+              {
+                unsigned rhs;
+                derez.deserialize(rhs);
+                if (valid && (rhs < num_events))
+                  inst = new CompleteReplay(*this, owner, rhs);
+                break;
+              }
+            default:
+              break;
+          }
+          if (inst == NULL)
+          {
+            valid = false;
+            break;
+          }
+          if (reused.find(inst) == reused.end())
+            created.push_back(inst);
+          new_slices[sidx].push_back(inst);
+        }
+        if (!valid)
+          break;
+        size_t num_tasks;
+        derez.deserialize(num_tasks);
+        for (unsigned idx = 0; idx < num_tasks; idx++)
+        {
+          TraceLocalID task;
+          if (!unpack_template_cache_owner(derez, task))
+          {
+            valid = false;
+            break;
+          }
+          std::map<TraceLocalID,std::pair<unsigned,bool> >::const_iterator
+            finder = memo_entries.find(task);
+          if ((finder == memo_entries.end()) || !finder->second.second)
+            valid = false;
+          new_tasks[sidx].push_back(task);
+        }
+      }
+      if (!valid)
+      {
+        for (std::vector<Instruction*>::const_iterator it = 
+              created.begin(); it != created.end(); it++)
+          delete (*it);
+        events.resize(original_events);
+        // Make sure we consume the rest of the buffer
+        derez.advance_pointer(derez.get_remaining_bytes());
+        return false;
+      }
+      // Commit the cached result, keeping the fence instruction at the
+      // front and deleting the recorded instructions we did not reuse,
+      // which includes any copies that dead code elimination removed
+      std::vector<Instruction*> new_instructions;
+      new_instructions.reserve(1 + created.size() + reused.size());
+      new_instructions.push_back(instructions[0]);
+      for (unsigned idx = 1; idx < instructions.size(); idx++)
+        if (reused.find(instructions[idx]) == reused.end())
+          delete instructions[idx];
+      for (unsigned sidx = 0; sidx < replay_parallelism; sidx++)
+        new_instructions.insert(new_instructions.end(),
+            new_slices[sidx].begin(), new_slices[sidx].end());
+      instructions.swap(new_instructions);
+      crossing_events.swap(new_crossing_events);
+      slices.swap(new_slices);
+      slice_tasks.swap(new_tasks);
+      slice_costs.swap(new_costs);
+      return true;
+    }
+
+    //--------------------------------------------------------------------------
+    std::string PhysicalTemplate::find_optimization_cache_file(
+                                                  const Serializer &key) const
+    //--------------------------------------------------------------------------
+    {
+      std::stringstream ss;
+      ss << trace->runtime->trace_cache_directory << "/trace_"
+         << trace->logical_trace->get_trace_id() << "_" << std::hex
+         << hash_template_cache_bytes(key.get_buffer(), key.get_used_bytes())
+         << ".tpl";
+      return ss.str();
+    }
+
+    //--------------------------------------------------------------------------
+    bool PhysicalTemplate::load_cached_optimization(const Serializer &key)
+    //--------------------------------------------------------------------------
+    {
+      const std::string filename = find_optimization_cache_file(key);
+      FILE *f = fopen(filename.c_str(), "rb");
+      if (f == NULL)
+        return false;
+      TemplateCacheHeader header;
+      bool valid = 
+        (fread(&header, sizeof(header), 1, f) == 1) &&
+        (memcmp(header.magic, template_cache_magic, sizeof(header.magic)) == 0)
+        && (header.version == template_cache_version) &&
+        (header.key_size == key.get_used_bytes());
+      std::vector<char> buffer;
+      if (valid)
+      {
+        buffer.resize(header.key_size + header.result_size);
+        valid = (buffer.empty() || 
+            (fread(&buffer[0], 1, buffer.size(), f) == buffer.size())) &&
+          (memcmp(&buffer[0], key.get_buffer(), header.key_size) == 0) &&
+          (hash_template_cache_bytes(&buffer[header.key_size],
+                      header.result_size) == header.result_hash);
+      }
+      fclose(f);
+      if (valid)
+      {
+        Deserializer derez(&buffer[header.key_size], header.result_size);
+        valid = unpack_optimization_result(derez);
+      }
+      if (valid)
+        log_tracing.info("Loaded optimized template for trace %d from %s",
+                         trace->logical_trace->get_trace_id(),
+                         filename.c_str());
+      else
+        log_tracing.info("Ignoring mismatched template cache file %s",
+                         filename.c_str());
+      return valid;
+    }
+
+    //--------------------------------------------------------------------------
+    void PhysicalTemplate::save_cached_optimization(const Serializer &key) const
+    //--------------------------------------------------------------------------
+    {
+      Serializer result;
+      pack_optimization_result(result);
+      TemplateCacheHeader header;
+      memset(&header, 0, sizeof(header));
+      // The magic is a fixed tag without a terminating nul
+      memcpy(header.magic, template_cache_magic, sizeof(header.magic));
+      header.version = template_cache_version;
+      header.key_size = key.get_used_bytes();
+      header.result_size = result.get_used_bytes();
+      header.result_hash = hash_template_cache_bytes(result.get_buffer(),
+                                                     result.get_used_bytes());
+      // Write to a temporary file and rename it into place so readers
+      // never see partial files, even if several shards save at once
+      const std::string filename = find_optimization_cache_file(key);
+      std::stringstream tmpname;
+      tmpname << filename << ".tmp." << trace->runtime->address_space
+              << "." << this;
+      FILE *f = fopen(tmpname.str().c_str(), "wb");
+      if (f == NULL)
+      {
+        REPORT_LEGION_WARNING(LEGION_WARNING_TRACE_CACHE_FAILED,
+            "Unable to write template cache file %s for trace %d",
+            tmpname.str().c_str(), trace->logical_trace->get_trace_id())
+        return;
+      }
+      bool success = 
+        (fwrite(&header, sizeof(header), 1, f) == 1) &&
+        (fwrite(key.get_buffer(), 1, header.key_size, f) == header.key_size)
+        && (fwrite(result.get_buffer(), 1, header.result_size, f) ==
+            header.result_size);
+      success = (fclose(f) == 0) && success;
+      if (success)
+        success = (rename(tmpname.str().c_str(), filename.c_str()) == 0);
+      if (!success)
+      {
+        unlink(tmpname.str().c_str());
+        REPORT_LEGION_WARNING(LEGION_WARNING_TRACE_CACHE_FAILED,
+            "Unable to write template cache file %s for trace %d",
+            filename.c_str(), trace->logical_trace->get_trace_id())
+      }
+      else
+        log_tracing.info("Saved optimized template for trace %d to %s",
+                         trace->logical_trace->get_trace_id(),
+                         filename.c_str());
+    }
+
     //--------------------------------------------------------------------------
     void PhysicalTemplate::dump_template(void)
     //--------------------------------------------------------------------------
@@ -3545,7 +4331,8 @@ namespace Legion {
       log_tracing.info() << "#### " << replayable << " " << this << " ####";
       for (unsigned sidx = 0; sidx < replay_parallelism; ++sidx)
       {
-        log_tracing.info() << "[Slice " << sidx << "]";
+        log_tracing.info() << "[Slice " << sidx << "] (estimated cost "
+                           << slice_costs[sidx] << ")";
         dump_instructions(slices[sidx]);
       }
       for (std::map<unsigned, unsigned>::iterator it = frontiers.begin();
@@ -656,7 +656,26 @@ namespace Legion {
       void propagate_copies(std::vector<unsigned> &gen);
       void eliminate_dead_code(std::vector<unsigned> &gen);
       void prepare_parallel_replay(const std::vector<unsigned> &gen);
+      void assign_round_robin_slices(std::vector<unsigned> &slice_by_inst);
+      void assign_balanced_slices(const std::vector<unsigned> &gen,
+                                  std::vector<unsigned> &slice_by_inst);
       void push_complete_replays(void);
+      static unsigned* find_precondition_event(Instruction *inst);
+      static unsigned long long estimate_replay_cost(Instruction *inst);
+    private:
+      // Persistent caching of optimization results, see -lg:trace_cache.
+      // Only what optimize produces is cached: a template still has to be
+      // captured in every run since its instructions and its pre- and
+      // postconditions name instances, views and equivalence sets that
+      // only exist in the run that made them.
+      void pack_optimization_key(Serializer &rez,
+                                 const std::vector<unsigned> &gen) const;
+      void pack_optimization_result(Serializer &rez) const;
+      bool unpack_optimization_result(Deserializer &derez);
+      std::string find_optimization_cache_file(const Serializer &key) const;
+      bool load_cached_optimization(const Serializer &key);
+      void save_cached_optimization(const Serializer &key) const;
+      static void pack_instruction(Serializer &rez, Instruction *inst);
     public:
       bool check_preconditions(TraceReplayOp *op,
                                std::set<RtEvent> &applied_events);
@@ -849,6 +868,8 @@ namespace Legion {
       std::vector<Instruction*>               instructions;
       std::vector<std::vector<Instruction*> > slices;
       std::vector<std::vector<TraceLocalID> > slice_tasks;
+      // Estimated replay cost of each slice, see estimate_replay_cost
+      std::vector<unsigned long long>         slice_costs;
     private:
       std::map<unsigned,unsigned> crossing_events;
       // Frontiers of a template are a set of users whose events must
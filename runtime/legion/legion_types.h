@@ -383,10 +383,12 @@ namespace Legion {
       LG_DEFER_RELEASE_ACQUIRED_TASK_ID,
       LG_MALLOC_INSTANCE_TASK_ID,
       LG_FREE_INSTANCE_TASK_ID,
+      LG_DEFER_MESSAGE_FLUSH_TASK_ID,
       LG_YIELD_TASK_ID,
       // this marks the beginning of task IDs tracked by the shutdown algorithm
       LG_BEGIN_SHUTDOWN_TASK_IDS,
       LG_RETRY_SHUTDOWN_TASK_ID = LG_BEGIN_SHUTDOWN_TASK_IDS,
+      LG_PROFILER_WRITE_TASK_ID,
       // Message ID goes at the end so we can append additional 
       // message IDs here for the profiler
       LG_MESSAGE_ID,
@@ -518,8 +520,10 @@ namespace Legion {
         "Defer Release Acquired Instances",                       \
         "Malloc Instance",                                        \
         "Free Instance",                                          \
+        "Defer Message Flush",                                    \
         "Yield",                                                  \
         "Retry Shutdown",                                         \
+        "Profiler Write",                                         \
         "Remote Message",                                         \
       };
 
@@ -530,6 +534,7 @@ namespace Legion {
       PREMAP_TASK_CALL,
       SLICE_TASK_CALL,
       MAP_TASK_CALL,
+      MAP_TASK_BATCH_CALL,
       SELECT_VARIANT_CALL,
       POSTMAP_TASK_CALL,
       TASK_SELECT_SOURCES_CALL,
@@ -576,6 +581,7 @@ namespace Legion {
       "premap_task",                                \
       "slice_task",                                 \
       "map_task",                                   \
+      "map_task_batch",                             \
       "select_task_variant",                        \
       "postmap_task",                               \
       "select_task_sources",                        \
@@ -1567,6 +1573,8 @@ namespace Legion {
     class InstanceKey;
     class InstanceView;
     class CollectableView; // pure virtual class
+    class ExprView;
+    class ExprViewIndex;
     class DeferredView;
     class MaterializedView;
     class FillView;
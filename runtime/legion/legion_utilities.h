@@ -21,6 +21,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+
 #include "legion.h"
 #include "legion/bitmask.h"
 #include "legion/legion_allocation.h"
@@ -59,10 +61,19 @@ namespace Legion {
     // Serializer 
     /////////////////////////////////////////////////////////////
     class Serializer {
+    public:
+      // A range of bytes that logically sits at the given offset in the
+      // buffer but that is only referenced by the serializer
+      struct ExternalSegment {
+      public:
+        size_t offset;
+        const void *ptr;
+        size_t size;
+      };
     public:
       Serializer(size_t base_bytes = 4096)
         : total_bytes(base_bytes), buffer((char*)malloc(base_bytes)), 
-          index(0) 
+          index(0), external_bytes(0)
 #ifdef DEBUG_LEGION
           , context_bytes(0)
 #endif
@@ -110,22 +121,35 @@ namespace Legion {
       inline void serialize(const Domain &domain);
       inline void serialize(const DomainPoint &dp);
       inline void serialize(const void *src, size_t bytes);
+      // Same as serializing the bytes except large buffers are only
+      // referenced and not copied, so they must remain valid and
+      // unchanged until the message has been sent and the serializer
+      // must only be handed to the runtime's send routines
+      inline void serialize_external(const void *src, size_t bytes);
     public:
       inline void begin_context(void);
       inline void end_context(void);
     public:
       inline size_t get_index(void) const { return index; }
-      inline const void* get_buffer(void) const { return buffer; }
+      inline const void* get_buffer(void) const;
       inline size_t get_buffer_size(void) const { return total_bytes; }
-      inline size_t get_used_bytes(void) const { return index; }
+      inline size_t get_used_bytes(void) const 
+        { return (index + external_bytes); }
       inline void* reserve_bytes(size_t size);
       inline void reset(void);
+    public:
+      // For gathering the message including any external segments
+      inline const char* get_inline_buffer(void) const { return buffer; }
+      inline const std::vector<ExternalSegment>& get_external_segments(void)
+        const { return external_segments; }
     private:
-      inline void resize(void);
+      inline void resize(size_t needed);
     private:
       size_t total_bytes;
       char *buffer;
       size_t index;
+      std::vector<ExternalSegment> external_segments;
+      size_t external_bytes;
 #ifdef DEBUG_LEGION
       size_t context_bytes;
 #endif
@@ -610,8 +634,8 @@ namespace Legion {
     inline void Serializer::serialize(const T &element)
     //--------------------------------------------------------------------------
     {
-      while ((index + sizeof(T)) > total_bytes)
-        resize();
+      if ((index + sizeof(T)) > total_bytes)
+        resize(index + sizeof(T));
       *((T*)(buffer+index)) = element;
       index += sizeof(T);
 #ifdef DEBUG_LEGION
@@ -624,8 +648,8 @@ namespace Legion {
     inline void Serializer::serialize<bool>(const bool &element)
     //--------------------------------------------------------------------------
     {
-      while ((index + 4) > total_bytes)
-        resize();
+      if ((index + 4) > total_bytes)
+        resize(index + 4);
       *((bool*)buffer+index) = element;
       index += 4;
 #ifdef DEBUG_LEGION
@@ -739,8 +763,8 @@ namespace Legion {
     inline void Serializer::serialize(const void *src, size_t bytes)
     //--------------------------------------------------------------------------
     {
-      while ((index + bytes) > total_bytes)
-        resize();
+      if ((index + bytes) > total_bytes)
+        resize(index + bytes);
       memcpy(buffer+index,src,bytes);
       index += bytes;
 #ifdef DEBUG_LEGION
@@ -748,13 +772,45 @@ namespace Legion {
 #endif
     }
 
+    //--------------------------------------------------------------------------
+    inline void Serializer::serialize_external(const void *src, size_t bytes)
+    //--------------------------------------------------------------------------
+    {
+      // Not worth the trouble of tracking small buffers
+      if (bytes < LEGION_MIN_EXTERNAL_SERIALIZE_BYTES)
+      {
+        serialize(src, bytes);
+        return;
+      }
+      ExternalSegment segment;
+      segment.offset = index;
+      segment.ptr = src;
+      segment.size = bytes;
+      external_segments.push_back(segment);
+      external_bytes += bytes;
+#ifdef DEBUG_LEGION
+      context_bytes += bytes;
+#endif
+    }
+
+    //--------------------------------------------------------------------------
+    inline const void* Serializer::get_buffer(void) const
+    //--------------------------------------------------------------------------
+    {
+#ifdef DEBUG_LEGION
+      // The buffer is not contiguous if we have external segments
+      assert(external_segments.empty());
+#endif
+      return buffer;
+    }
+
     //--------------------------------------------------------------------------
     inline void Serializer::begin_context(void)
     //--------------------------------------------------------------------------
     {
 #ifdef DEBUG_LEGION
-      while ((index + sizeof(size_t)) > total_bytes)
-        resize();
+      if ((index + sizeof(size_t)) > total_bytes)
+        resize(index + sizeof(size_t));
       *((size_t*)(buffer+index)) = context_bytes;
       index += sizeof(size_t);
       context_bytes = 0;
@@ -767,8 +823,8 @@ namespace Legion {
     {
 #ifdef DEBUG_LEGION
       // Save the size into the buffer
-      while ((index + sizeof(size_t)) > total_bytes)
-        resize();
+      if ((index + sizeof(size_t)) > total_bytes)
+        resize(index + sizeof(size_t));
       *((size_t*)(buffer+index)) = context_bytes;
       index += sizeof(size_t);
       context_bytes = 0;
@@ -779,8 +835,8 @@ namespace Legion {
     inline void* Serializer::reserve_bytes(size_t bytes)
     //--------------------------------------------------------------------------
     {
-      while ((index + bytes) > total_bytes)
-        resize();
+      if ((index + bytes) > total_bytes)
+        resize(index + bytes);
       void *result = buffer+index;
       index += bytes;
 #ifdef DEBUG_LEGION
@@ -794,20 +850,24 @@ namespace Legion {
     //--------------------------------------------------------------------------
     {
       index = 0;
+      external_segments.clear();
+      external_bytes = 0;
 #ifdef DEBUG_LEGION
       context_bytes = 0;
 #endif
     }
 
     //--------------------------------------------------------------------------
-    inline void Serializer::resize(void)
+    inline void Serializer::resize(size_t needed)
     //--------------------------------------------------------------------------
     {
-      // Double the buffer size
-      total_bytes *= 2;
+      // Double the buffer size until it is big enough so that we only
+      // have to do one realloc even for large buffers
 #ifdef DEBUG_LEGION
       assert(total_bytes != 0); // this would cause deallocation
 #endif
+      while (total_bytes < needed)
+        total_bytes *= 2;
       char *next = (char*)realloc(buffer,total_bytes);
 #ifdef DEBUG_LEGION
       assert(next != NULL);
@@ -1926,11 +1986,24 @@ namespace Legion {
     /**
      * \class FieldMaskSet 
      * A template helper class for tracking collections of 
-     * objects associated with different sets of fields
+     * objects associated with different sets of fields.
+     * Sets with a single entry store it inline, sets with up to
+     * LEGION_FIELD_MASK_SET_FLAT_ENTRIES entries keep them in a
+     * sorted flat array, and larger sets fall back to a map.
+     * All three iterate in the same order.
      */
     template<typename T>
     class FieldMaskSet : 
       public LegionHeapify<FieldMaskSet<T> > {
+    public:
+      // Flat entries are laid out the same as the pairs in the map
+      typedef std::pair<T*,FieldMask> FlatEntry;
+      typedef typename LegionVector<FlatEntry>::aligned FlatEntries;
+      struct FlatEntryComparator {
+      public:
+        inline bool operator()(const FlatEntry &entry, T *key) const
+          { return std::less<T*>()(entry.first, key); }
+      };
     public:
       // forward declaration
       class const_iterator;
@@ -1938,19 +2011,20 @@ namespace Legion {
                               std::pair<T*const,FieldMask> > {
       public:
         iterator(FieldMaskSet *_set, 
-            std::pair<T*const,FieldMask> *_result)
-          : set(_set), result(_result), single(true) { }
+            std::pair<T*const,FieldMask> *_result,
+            std::pair<T*const,FieldMask> *_last = NULL)
+          : set(_set), result(_result), last(_last), single(true) { }
         iterator(FieldMaskSet *_set,
             typename LegionMap<T*,FieldMask>::aligned::iterator _it)
-          : set(_set), result(&(*_it)), it(_it), single(false) { }
+          : set(_set), result(&(*_it)), last(NULL), it(_it), single(false) { }
       public:
         iterator(const iterator &rhs)
-          : set(rhs.set), result(rhs.result), 
+          : set(rhs.set), result(rhs.result), last(rhs.last),
             it(rhs.it), single(rhs.single) { }
         ~iterator(void) { }
       public:
         inline iterator& operator=(const iterator &rhs)
-          { set = rhs.set; result = rhs.result; 
+          { set = rhs.set; result = rhs.result; last = rhs.last;
             it = rhs.it; single = rhs.single; return *this; }
       public:
         inline bool operator==(const iterator &rhs) const
@@ -1986,6 +2060,8 @@ namespace Legion {
               else
                 result = NULL;
             }
+            else if ((last != NULL) && (result != last))
+              result++;
             else
               result = NULL;
             return *this;
@@ -2001,6 +2077,8 @@ namespace Legion {
               else
                 result = NULL;
             }
+            else if ((last != NULL) && (result != last))
+              result++;
             else
               result = NULL;
             return copy;
@@ -2012,7 +2090,8 @@ namespace Legion {
         inline void merge(const FieldMask &mask)
           {
             result->second |= mask;
-            if (!single)
+            // Only the inline single entry aliases the valid fields
+            if (!single || (last != NULL))
               set->valid_fields |= mask;
           }
         inline void filter(const FieldMask &mask)
@@ -2038,8 +2117,11 @@ namespace Legion {
         }
       private:
         friend class const_iterator;
+        friend class FieldMaskSet;
         FieldMaskSet *set;
         std::pair<T*const,FieldMask> *result;
+        // Last entry for sets stored in a flat array
+        std::pair<T*const,FieldMask> *last;
         typename LegionMap<T*,FieldMask>::aligned::iterator it;
         bool single;
       };
@@ -2048,25 +2130,28 @@ namespace Legion {
                               std::pair<T*const,FieldMask> > {
       public:
         const_iterator(const FieldMaskSet *_set, 
-            const std::pair<T*const,FieldMask> *_result)
-          : set(_set), result(_result), single(true) { }
+            const std::pair<T*const,FieldMask> *_result,
+            const std::pair<T*const,FieldMask> *_last = NULL)
+          : set(_set), result(_result), last(_last), single(true) { }
         const_iterator(const FieldMaskSet *_set,
             typename LegionMap<T*,FieldMask>::aligned::const_iterator _it)
-          : set(_set), result(&(*_it)), it(_it), single(false) { }
+          : set(_set), result(&(*_it)), last(NULL), it(_it), single(false) { }
       public:
         const_iterator(const const_iterator &rhs)
-          : set(rhs.set), result(rhs.result), it(rhs.it), single(rhs.single) { }
+          : set(rhs.set), result(rhs.result), last(rhs.last), 
+            it(rhs.it), single(rhs.single) { }
         // We can also make a const_iterator from a normal iterator
         const_iterator(const iterator &rhs)
-          : set(rhs.set), result(rhs.result), it(rhs.it), single(rhs.single) { }
+          : set(rhs.set), result(rhs.result), last(rhs.last), 
+            it(rhs.it), single(rhs.single) { }
         ~const_iterator(void) { }
       public:
         inline const_iterator& operator=(const const_iterator &rhs)
-          { set = rhs.set; result = rhs.result; it = rhs.it;
-            single = rhs.single; return *this; }
+          { set = rhs.set; result = rhs.result; last = rhs.last; 
+            it = rhs.it; single = rhs.single; return *this; }
         inline const_iterator& operator=(const iterator &rhs)
-          { set = rhs.set; result = rhs.result; it = rhs.it;
-            single = rhs.single; return *this; }
+          { set = rhs.set; result = rhs.result; last = rhs.last;
+            it = rhs.it; single = rhs.single; return *this; }
       public:
         inline bool operator==(const const_iterator &rhs) const
           { 
@@ -2101,6 +2186,8 @@ namespace Legion {
               else
                 result = NULL;
             }
+            else if ((last != NULL) && (result != last))
+              result++;
             else
               result = NULL;
             return *this;
@@ -2116,6 +2203,8 @@ namespace Legion {
               else
                 result = NULL;
             }
+            else if ((last != NULL) && (result != last))
+              result++;
             else
               result = NULL;
             return copy;
@@ -2126,12 +2215,13 @@ namespace Legion {
       private:
         const FieldMaskSet *set;
         const std::pair<T*const,FieldMask> *result;
+        const std::pair<T*const,FieldMask> *last;
         typename LegionMap<T*,FieldMask>::aligned::const_iterator it;
         bool single;
       };
     public:
       FieldMaskSet(void)
-        : single(true) { entries.single_entry = NULL; }
+        : single(true), flat(false) { entries.single_entry = NULL; }
       inline FieldMaskSet(const FieldMaskSet &rhs);
       ~FieldMaskSet(void) { clear(); }
     public:
@@ -2168,6 +2258,9 @@ namespace Legion {
     public:
       inline void compute_field_sets(FieldMask universe_mask,
           typename LegionList<FieldSet<T*> >::aligned &output_sets) const;
+    protected:
+      inline std::pair<T*const,FieldMask>* flat_entry(size_t index) const;
+      inline void erase_flat_entry(size_t index);
     protected:
       // Fun with C, keep these two fields first and in this order
       // so that a FieldMaskSet of size 1 looks the same as an entry
@@ -2175,21 +2268,27 @@ namespace Legion {
       // provides goodness for the iterator
       union {
         T *single_entry;
+        FlatEntries *flat_entries;
         typename LegionMap<T*,FieldMask>::aligned *multi_entries;
       } entries;
       // This can be an overapproximation if we have multiple entries
       FieldMask valid_fields;
       bool single;
+      // Only meaningful when not single, says whether we're
+      // using the flat array or the map for the entries
+      bool flat;
     };
 
     //--------------------------------------------------------------------------
     template<typename T>
     inline FieldMaskSet<T>::FieldMaskSet(const FieldMaskSet<T> &rhs)
-      : valid_fields(rhs.valid_fields), single(rhs.single)
+      : valid_fields(rhs.valid_fields), single(rhs.single), flat(rhs.flat)
     //--------------------------------------------------------------------------
     {
       if (single)
         entries.single_entry = rhs.entries.single_entry;
+      else if (flat)
+        entries.flat_entries = new FlatEntries(*rhs.entries.flat_entries);
       else
         entries.multi_entries = new typename LegionMap<T*,FieldMask>::aligned(
             rhs.entries.multi_entries->begin(),
@@ -2203,28 +2302,35 @@ namespace Legion {
     //--------------------------------------------------------------------------
     {
       // Check our current state
-      if (single != rhs.single)
+      if ((single != rhs.single) || (!single && (flat != rhs.flat)))
       {
         // Different data structures
-        if (single)
+        if (!single)
         {
+          // Free our old data structure
+          if (flat)
+            delete entries.flat_entries;
+          else
+            delete entries.multi_entries;
+        }
+        if (rhs.single)
+          entries.single_entry = rhs.entries.single_entry;
+        else if (rhs.flat)
+          entries.flat_entries = new FlatEntries(*rhs.entries.flat_entries);
+        else
           entries.multi_entries = new typename LegionMap<T*,FieldMask>::aligned(
               rhs.entries.multi_entries->begin(),
               rhs.entries.multi_entries->end());
-        }
-        else
-        {
-          // Free our map
-          delete entries.multi_entries;
-          entries.single_entry = rhs.entries.single_entry;
-        }
         single = rhs.single;
+        flat = rhs.flat;
       }
       else
       {
         // Same data structures so we can just copy things over
         if (single)
           entries.single_entry = rhs.entries.single_entry;
+        else if (flat)
+          *(entries.flat_entries) = *(rhs.entries.flat_entries);
         else
         {
           entries.multi_entries->clear();
@@ -2246,10 +2352,20 @@ namespace Legion {
       if (single)
         return valid_fields;
       valid_fields.clear();
-      for (typename LegionMap<T*,FieldMask>::aligned::const_iterator it = 
-            entries.multi_entries->begin(); it !=
-            entries.multi_entries->end(); it++)
-        valid_fields |= it->second;
+      if (flat)
+      {
+        for (typename FlatEntries::const_iterator it = 
+              entries.flat_entries->begin(); it != 
+              entries.flat_entries->end(); it++)
+          valid_fields |= it->second;
+      }
+      else
+      {
+        for (typename LegionMap<T*,FieldMask>::aligned::const_iterator it = 
+              entries.multi_entries->begin(); it !=
+              entries.multi_entries->end(); it++)
+          valid_fields |= it->second;
+      }
       return valid_fields;
     }
 
@@ -2289,6 +2405,17 @@ namespace Legion {
 #endif
         return valid_fields;
       }
+      else if (flat)
+      {
+        typename FlatEntries::const_iterator finder = 
+          std::lower_bound(entries.flat_entries->begin(),
+              entries.flat_entries->end(), entry, FlatEntryComparator());
+#ifdef DEBUG_LEGION
+        assert(finder != entries.flat_entries->end());
+        assert(finder->first == entry);
+#endif
+        return finder->second;
+      }
       else
       {
         typename LegionMap<T*,FieldMask>::aligned::const_iterator finder =
@@ -2318,6 +2445,30 @@ namespace Legion {
           valid_fields |= mask;
           result = false;
         }
+        else if (LEGION_FIELD_MASK_SET_FLAT_ENTRIES > 1)
+        {
+          // Go to the flat array, keeping it sorted
+          FlatEntries *entries_array = new FlatEntries();
+          entries_array->reserve(
+              (LEGION_FIELD_MASK_SET_FLAT_ENTRIES < 4) ?
+                LEGION_FIELD_MASK_SET_FLAT_ENTRIES : 4);
+          if (std::less<T*>()(entry, entries.single_entry))
+          {
+            entries_array->push_back(FlatEntry(entry, mask));
+            entries_array->push_back(
+                FlatEntry(entries.single_entry, valid_fields));
+          }
+          else
+          {
+            entries_array->push_back(
+                FlatEntry(entries.single_entry, valid_fields));
+            entries_array->push_back(FlatEntry(entry, mask));
+          }
+          entries.flat_entries = entries_array;
+          single = false;
+          flat = true;
+          valid_fields |= mask;
+        }
         else
         {
           // Go to multi
@@ -2327,9 +2478,39 @@ namespace Legion {
           (*multi)[entry] = mask;
           entries.multi_entries = multi;
           single = false;
+          flat = false;
           valid_fields |= mask;
         }
       }
+      else if (flat)
+      {
+#ifdef DEBUG_LEGION
+        assert(entries.flat_entries != NULL);
+#endif
+        typename FlatEntries::iterator finder = 
+          std::lower_bound(entries.flat_entries->begin(),
+              entries.flat_entries->end(), entry, FlatEntryComparator());
+        if ((finder != entries.flat_entries->end()) && (finder->first == entry))
+        {
+          finder->second |= mask;
+          result = false;
+        }
+        else if (entries.flat_entries->size() < 
+                  LEGION_FIELD_MASK_SET_FLAT_ENTRIES)
+          entries.flat_entries->insert(finder, FlatEntry(entry, mask));
+        else
+        {
+          // Too big for the flat array so go to multi
+          typename LegionMap<T*,FieldMask>::aligned *multi = 
+            new typename LegionMap<T*,FieldMask>::aligned(
+                entries.flat_entries->begin(), entries.flat_entries->end());
+          (*multi)[entry] = mask;
+          delete entries.flat_entries;
+          entries.multi_entries = multi;
+          flat = false;
+        }
+        valid_fields |= mask;
+      }
       else
       {
  #ifdef DEBUG_LEGION
@@ -2363,6 +2544,48 @@ namespace Legion {
             entries.single_entry = NULL;
         }
       }
+      else if (flat)
+      {
+        valid_fields -= filter;
+        if (!valid_fields)
+        {
+          // No fields left so just clean everything up
+          delete entries.flat_entries;
+          entries.flat_entries = NULL;
+          single = true;
+        }
+        else
+        {
+          // Compact the remaining entries in place to keep them sorted
+          FlatEntries &flat_entries = *(entries.flat_entries);
+          unsigned next = 0;
+          for (unsigned idx = 0; idx < flat_entries.size(); idx++)
+          {
+            flat_entries[idx].second -= filter;
+            if (!flat_entries[idx].second)
+              continue;
+            if (next != idx)
+              flat_entries[next] = flat_entries[idx];
+            next++;
+          }
+          flat_entries.resize(next);
+          if (flat_entries.empty())
+          {
+            delete entries.flat_entries;
+            entries.flat_entries = NULL;
+            valid_fields.clear();
+            single = true;
+          }
+          else if (flat_entries.size() == 1)
+          {
+            T *temp = flat_entries.front().first;
+            valid_fields = flat_entries.front().second;
+            delete entries.flat_entries;
+            entries.single_entry = temp;
+            single = true;
+          }
+        }
+      }
       else
       {
         valid_fields -= filter;
@@ -2424,6 +2647,17 @@ namespace Legion {
         entries.single_entry = NULL;
         valid_fields.clear();
       }
+      else if (flat)
+      {
+        typename FlatEntries::iterator finder = 
+          std::lower_bound(entries.flat_entries->begin(),
+              entries.flat_entries->end(), to_erase, FlatEntryComparator());
+#ifdef DEBUG_LEGION
+        assert(finder != entries.flat_entries->end());
+        assert(finder->first == to_erase);
+#endif
+        erase_flat_entry(finder - entries.flat_entries->begin());
+      }
       else
       {
         typename LegionMap<T*,FieldMask>::aligned::iterator finder = 
@@ -2452,6 +2686,15 @@ namespace Legion {
     {
       if (single)
         entries.single_entry = NULL;
+      else if (flat)
+      {
+#ifdef DEBUG_LEGION
+        assert(entries.flat_entries != NULL);
+#endif
+        delete entries.flat_entries;
+        entries.flat_entries = NULL;
+        single = true;
+      }
       else
       {
 #ifdef DEBUG_LEGION
@@ -2476,6 +2719,8 @@ namespace Legion {
         else
           return 1;
       }
+      else if (flat)
+        return entries.flat_entries->size();
       else
         return entries.multi_entries->size();
     }
@@ -2494,6 +2739,10 @@ namespace Legion {
       other.single = single;
       single = temp_single;
 
+      bool temp_flat = other.flat;
+      other.flat = flat;
+      flat = temp_flat;
+
       FieldMask temp_valid_fields = other.valid_fields;
       other.valid_fields = valid_fields;
       valid_fields = temp_valid_fields;
@@ -2514,6 +2763,9 @@ namespace Legion {
             reinterpret_cast<std::pair<T*const,FieldMask>*>(
               const_cast<FieldMaskSet<T>*>(this)));
       }
+      else if (flat)
+        return iterator(this, flat_entry(0), 
+                        flat_entry(entries.flat_entries->size() - 1));
       else
         return iterator(this, entries.multi_entries->begin());
     }
@@ -2531,6 +2783,17 @@ namespace Legion {
             reinterpret_cast<std::pair<T*const,FieldMask>*>(
               const_cast<FieldMaskSet<T>*>(this)));
       }
+      else if (flat)
+      {
+        typename FlatEntries::iterator finder = 
+          std::lower_bound(entries.flat_entries->begin(),
+              entries.flat_entries->end(), e, FlatEntryComparator());
+        if ((finder == entries.flat_entries->end()) || (finder->first != e))
+          return end();
+        return iterator(this, 
+            flat_entry(finder - entries.flat_entries->begin()),
+            flat_entry(entries.flat_entries->size() - 1));
+      }
       else
       {
         typename LegionMap<T*,FieldMask>::aligned::iterator finder = 
@@ -2557,6 +2820,13 @@ namespace Legion {
         entries.single_entry = NULL;
         valid_fields.clear();
       }
+      else if (flat)
+      {
+        const size_t index = it.result - flat_entry(0);
+        // Invalidate the iterator
+        it.result = NULL;
+        erase_flat_entry(index);
+      }
       else
       {
         it.erase(*(entries.multi_entries));
@@ -2579,7 +2849,7 @@ namespace Legion {
     inline typename FieldMaskSet<T>::iterator FieldMaskSet<T>::end(void)
     //--------------------------------------------------------------------------
     {
-      if (single)
+      if (single || flat)
         return iterator(this, NULL);
       else
         return iterator(this, entries.multi_entries->end());
@@ -2601,6 +2871,9 @@ namespace Legion {
             reinterpret_cast<const std::pair<T*const,FieldMask>*>(
               const_cast<FieldMaskSet<T>*>(this)));
       }
+      else if (flat)
+        return const_iterator(this, flat_entry(0),
+                              flat_entry(entries.flat_entries->size() - 1));
       else
         return const_iterator(this, entries.multi_entries->begin());
     }
@@ -2619,6 +2892,17 @@ namespace Legion {
             reinterpret_cast<const std::pair<T*const,FieldMask>*>(
               const_cast<FieldMaskSet<T>*>(this)));
       }
+      else if (flat)
+      {
+        typename FlatEntries::const_iterator finder = 
+          std::lower_bound(entries.flat_entries->begin(),
+              entries.flat_entries->end(), e, FlatEntryComparator());
+        if ((finder == entries.flat_entries->end()) || (finder->first != e))
+          return end();
+        return const_iterator(this, 
+            flat_entry(finder - entries.flat_entries->begin()),
+            flat_entry(entries.flat_entries->size() - 1));
+      }
       else
       {
         typename LegionMap<T*,FieldMask>::aligned::const_iterator finder = 
@@ -2635,12 +2919,49 @@ namespace Legion {
                                                 FieldMaskSet<T>::end(void) const
     //--------------------------------------------------------------------------
     {
-      if (single)
+      if (single || flat)
         return const_iterator(this, NULL);
       else
         return const_iterator(this, entries.multi_entries->end());
     }
 
+    //--------------------------------------------------------------------------
+    template<typename T>
+    inline std::pair<T*const,FieldMask>* FieldMaskSet<T>::flat_entry(
+                                                            size_t index) const
+    //--------------------------------------------------------------------------
+    {
+#ifdef DEBUG_LEGION
+      assert(!single && flat);
+      assert(index < entries.flat_entries->size());
+#endif
+      // More scariness, the flat entries have the same layout as the
+      // pairs in the map so we can hand them out through the iterators
+      return reinterpret_cast<std::pair<T*const,FieldMask>*>(
+          &((*entries.flat_entries)[index]));
+    }
+
+    //--------------------------------------------------------------------------
+    template<typename T>
+    inline void FieldMaskSet<T>::erase_flat_entry(size_t index)
+    //--------------------------------------------------------------------------
+    {
+#ifdef DEBUG_LEGION
+      assert(!single && flat);
+      assert(index < entries.flat_entries->size());
+#endif
+      entries.flat_entries->erase(entries.flat_entries->begin() + index);
+      if (entries.flat_entries->size() == 1)
+      {
+        // go back to single
+        T *first = entries.flat_entries->front().first;
+        valid_fields = entries.flat_entries->front().second;
+        delete entries.flat_entries;
+        entries.single_entry = first;
+        single = true;
+      }
+    }
+
     //--------------------------------------------------------------------------
     template<typename T>
     inline void FieldMaskSet<T>::compute_field_sets(FieldMask universe_mask,
@@ -540,6 +540,208 @@ namespace Legion {
         delete view;
     }
 
+    /////////////////////////////////////////////////////////////
+    // ExprViewIndex
+    /////////////////////////////////////////////////////////////
+
+    //--------------------------------------------------------------------------
+    ExprViewIndex::ExprViewIndex(const FieldMaskSet<ExprView> &subviews)
+      : erased(0), dim(0)
+    //--------------------------------------------------------------------------
+    {
+      entries.reserve(subviews.size());
+      for (FieldMaskSet<ExprView>::const_iterator it = 
+            subviews.begin(); it != subviews.end(); it++)
+      {
+        Entry entry;
+        int entry_dim;
+        if (!compute_bounds(it->first->view_expr, entry_dim, entry.bounds) ||
+            ((dim > 0) && (entry_dim != dim)))
+        {
+          // Can't index these subviews so everyone has to do a full scan
+          dim = 0;
+          entries.clear();
+          return;
+        }
+        dim = entry_dim;
+        // Empty subviews can never overlap a non-empty expression
+        if (entry.bounds.empty(dim))
+          continue;
+        entry.view = it->first;
+        entries.push_back(entry);
+      }
+      if (!entries.empty())
+      {
+        nodes.reserve(2 * (entries.size() / LEAF_SIZE) + 1);
+        nodes.resize(1);
+        build(0/*root*/, 0, entries.size());
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    ExprViewIndex::ExprViewIndex(const ExprViewIndex &rhs)
+    //--------------------------------------------------------------------------
+    {
+      // should never be called
+      assert(false);
+    }
+
+    //--------------------------------------------------------------------------
+    ExprViewIndex::~ExprViewIndex(void)
+    //--------------------------------------------------------------------------
+    {
+    }
+
+    //--------------------------------------------------------------------------
+    ExprViewIndex& ExprViewIndex::operator=(const ExprViewIndex &rhs)
+    //--------------------------------------------------------------------------
+    {
+      // should never be called
+      assert(false);
+      return *this;
+    }
+
+    //--------------------------------------------------------------------------
+    /*static*/ bool ExprViewIndex::compute_bounds(IndexSpaceExpression *expr,
+                                                  int &dim, Bounds &bounds)
+    //--------------------------------------------------------------------------
+    {
+      // We only need a conservative bounding box here so there is no 
+      // need to wait for the index space to be tight or even ready
+      ApEvent ready;
+      const Domain domain = expr->get_domain(ready, false/*tight*/);
+      dim = domain.get_dim();
+      if ((dim < 1) || (dim > MAX_INDEX_DIM))
+        return false;
+      for (int d = 0; d < dim; d++)
+      {
+        bounds.lo[d] = domain.rect_data[d];
+        bounds.hi[d] = domain.rect_data[dim + d];
+      }
+      return true;
+    }
+
+    //--------------------------------------------------------------------------
+    bool ExprViewIndex::needs_rebuild(void) const
+    //--------------------------------------------------------------------------
+    {
+      if (!is_valid())
+        return false;
+      // Rebuild once the linear parts of the search start to dominate
+      if (pending.size() > ((entries.size() / 4) + LEAF_SIZE))
+        return true;
+      return ((2 * erased) > entries.size());
+    }
+
+    //--------------------------------------------------------------------------
+    void ExprViewIndex::record_insert(ExprView *subview)
+    //--------------------------------------------------------------------------
+    {
+      if (!is_valid())
+        return;
+      Entry entry;
+      int entry_dim;
+      if (!compute_bounds(subview->view_expr, entry_dim, entry.bounds) ||
+          (entry_dim != dim))
+      {
+        dim = 0;
+        entries.clear();
+        nodes.clear();
+        pending.clear();
+        return;
+      }
+      if (entry.bounds.empty(dim))
+        return;
+      entry.view = subview;
+      pending.push_back(entry);
+    }
+
+    //--------------------------------------------------------------------------
+    bool ExprViewIndex::find_overlapping(IndexSpaceExpression *expr,
+                                   std::vector<ExprView*> &overlapping) const
+    //--------------------------------------------------------------------------
+    {
+      if (!is_valid())
+        return false;
+      Bounds bounds;
+      int expr_dim;
+      if (!compute_bounds(expr, expr_dim, bounds) || (expr_dim != dim) ||
+          bounds.empty(dim))
+        return false;
+      if (!nodes.empty())
+      {
+        std::vector<unsigned> to_visit(1, 0/*root*/);
+        while (!to_visit.empty())
+        {
+          const Node &node = nodes[to_visit.back()];
+          to_visit.pop_back();
+          if (!node.bounds.overlaps(bounds, dim))
+            continue;
+          if (node.count > 0)
+          {
+            for (unsigned idx = 0; idx < node.count; idx++)
+            {
+              const Entry &entry = entries[node.first + idx];
+              if (entry.bounds.overlaps(bounds, dim))
+                overlapping.push_back(entry.view);
+            }
+          }
+          else
+          {
+            to_visit.push_back(node.first);
+            to_visit.push_back(node.first + 1);
+          }
+        }
+      }
+      for (std::vector<Entry>::const_iterator it = 
+            pending.begin(); it != pending.end(); it++)
+        if (it->bounds.overlaps(bounds, dim))
+          overlapping.push_back(it->view);
+      return true;
+    }
+
+    //--------------------------------------------------------------------------
+    void ExprViewIndex::build(unsigned node, unsigned first, unsigned count)
+    //--------------------------------------------------------------------------
+    {
+#ifdef DEBUG_LEGION
+      assert(count > 0);
+#endif
+      Bounds bounds = entries[first].bounds;
+      for (unsigned idx = 1; idx < count; idx++)
+        bounds.merge(entries[first + idx].bounds, dim);
+      nodes[node].bounds = bounds;
+      if (count <= LEAF_SIZE)
+      {
+        nodes[node].first = first;
+        nodes[node].count = count;
+        return;
+      }
+      // Split at the median center along the longest dimension
+      int split_dim = 0;
+      coord_t split_extent = bounds.hi[0] / 2 - bounds.lo[0] / 2;
+      for (int d = 1; d < dim; d++)
+      {
+        const coord_t extent = bounds.hi[d] / 2 - bounds.lo[d] / 2;
+        if (split_extent < extent)
+        {
+          split_dim = d;
+          split_extent = extent;
+        }
+      }
+      const unsigned half = count / 2;
+      std::nth_element(entries.begin() + first, entries.begin() + first + half,
+                       entries.begin() + first + count,
+                       EntryCenterCompare(split_dim));
+      // Children always go next to each other so we only need the first
+      const unsigned children = nodes.size();
+      nodes.resize(children + 2);
+      nodes[node].first = children;
+      nodes[node].count = 0;
+      build(children, first, half);
+      build(children + 1, first + half, count - half);
+    }
+
     /////////////////////////////////////////////////////////////
     // ExprView
     /////////////////////////////////////////////////////////////
@@ -549,7 +751,8 @@ namespace Legion {
                        InstanceView *view, IndexSpaceExpression *exp) 
       : context(ctx), manager(man), inst_view(view),
         view_expr(exp), view_volume(view_expr->get_volume()),
-        invalid_fields(FieldMask(LEGION_FIELD_MASK_FIELD_ALL_ONES))
+        invalid_fields(FieldMask(LEGION_FIELD_MASK_FIELD_ALL_ONES)),
+        subview_index(NULL)
     //--------------------------------------------------------------------------
     {
       view_expr->add_expression_reference();
@@ -558,7 +761,8 @@ namespace Legion {
     //--------------------------------------------------------------------------
     ExprView::ExprView(const ExprView &rhs)
       : context(rhs.context), manager(rhs.manager), inst_view(rhs.inst_view),
-        view_expr(rhs.view_expr), view_volume(rhs.view_volume)
+        view_expr(rhs.view_expr), view_volume(rhs.view_volume),
+        subview_index(NULL)
     //--------------------------------------------------------------------------
     {
       // should never be called
@@ -571,6 +775,8 @@ namespace Legion {
     {
       if (view_expr->remove_expression_reference())
         delete view_expr;
+      if (subview_index != NULL)
+        delete subview_index;
       if (!subviews.empty())
       {
         for (FieldMaskSet<ExprView>::iterator it = subviews.begin();
@@ -761,8 +967,12 @@ namespace Legion {
       {
         FieldMaskSet<ExprView> to_traverse;
         std::map<ExprView*,IndexSpaceExpression*> traverse_exprs;
+        // No need for the index if we're going to traverse everything
+        FieldMaskSet<ExprView> overlapping;
+        const FieldMaskSet<ExprView> &candidates = user_dominates ? subviews :
+          find_overlapping_subviews(user_expr, overlapping);
         for (FieldMaskSet<ExprView>::const_iterator it = 
-              subviews.begin(); it != subviews.end(); it++)
+              candidates.begin(); it != candidates.end(); it++)
         {
           FieldMask overlap = it->second & user_mask;
           if (!overlap)
@@ -908,8 +1118,12 @@ namespace Legion {
       if (!subviews.empty() && 
           !(subviews.get_valid_mask() * copy_mask))
       {
+        // No need for the index if we're going to traverse everything
+        FieldMaskSet<ExprView> overlapping;
+        const FieldMaskSet<ExprView> &candidates = copy_dominates ? subviews :
+          find_overlapping_subviews(copy_expr, overlapping);
         for (FieldMaskSet<ExprView>::const_iterator it = 
-              subviews.begin(); it != subviews.end(); it++)
+              candidates.begin(); it != candidates.end(); it++)
         {
           FieldMask overlap = it->second & copy_mask;
           if (!overlap)
@@ -952,8 +1166,11 @@ namespace Legion {
       // Handle the base case first
       if ((expr == view_expr) || (expr->get_volume() == view_volume))
         return const_cast<ExprView*>(this);
+      FieldMaskSet<ExprView> overlapping;
+      const FieldMaskSet<ExprView> &candidates = 
+        find_overlapping_subviews(expr, overlapping);
       for (FieldMaskSet<ExprView>::const_iterator it = 
-            subviews.begin(); it != subviews.end(); it++)
+            candidates.begin(); it != candidates.end(); it++)
       {
         if (it->first->view_expr == expr)
           return it->first;
@@ -993,8 +1210,11 @@ namespace Legion {
         bool need_tighten = true;
         std::vector<ExprView*> to_delete;
         FieldMaskSet<ExprView> dominating_subviews;
-        for (FieldMaskSet<ExprView>::iterator it = 
-              subviews.begin(); it != subviews.end(); it++)
+        FieldMaskSet<ExprView> overlapping;
+        const FieldMaskSet<ExprView> &candidates = 
+          find_overlapping_subviews(subview->view_expr, overlapping);
+        for (FieldMaskSet<ExprView>::const_iterator it = 
+              candidates.begin(); it != candidates.end(); it++)
         {
           // See if we intersect on fields
           FieldMask overlap_mask = it->second & subview_mask;
@@ -1024,11 +1244,12 @@ namespace Legion {
 #endif
             // We dominate this view so we can just pull it 
             // in underneath of us now
-            it.filter(overlap_mask);
+            FieldMaskSet<ExprView>::iterator finder = subviews.find(it->first);
+            finder.filter(overlap_mask);
             subview->insert_subview(it->first, overlap_mask);
             need_tighten = true;
             // See if we need to remove this subview
-            if (!it->second)
+            if (!finder->second)
               to_delete.push_back(it->first);
           }
           // Otherwise it's just a normal intersection
@@ -1084,6 +1305,8 @@ namespace Legion {
                 to_delete.begin(); it != to_delete.end(); it++)
           {
             subviews.erase(*it);
+            if (subview_index != NULL)
+              subview_index->record_erase();
             if ((*it)->remove_reference())
               delete (*it);
           }
@@ -1094,7 +1317,11 @@ namespace Legion {
       // If we make it here and there are still fields then we need to 
       // add it locally
       if (!!subview_mask && subviews.insert(subview, subview_mask))
+      {
         subview->add_reference();
+        if (subview_index != NULL)
+          subview_index->record_insert(subview);
+      }
     }
 
     //--------------------------------------------------------------------------
@@ -1107,8 +1334,11 @@ namespace Legion {
       if (!subviews.empty() && !(expr_mask * subviews.get_valid_mask()))
       {
         FieldMask dominated_mask;
-        for (FieldMaskSet<ExprView>::iterator it = subviews.begin();
-              it != subviews.end(); it++)
+        FieldMaskSet<ExprView> overlapping;
+        const FieldMaskSet<ExprView> &candidates = 
+          find_overlapping_subviews(expr, overlapping);
+        for (FieldMaskSet<ExprView>::const_iterator it = 
+              candidates.begin(); it != candidates.end(); it++)
         {
           // See if we intersect on fields
           FieldMask overlap_mask = it->second & expr_mask;
@@ -1162,8 +1392,11 @@ namespace Legion {
         // No need for the view lock anymore since we're protected
         // by the expr_lock at the top of the tree
         //AutoLock v_lock(view_lock,1,false/*exclusive*/); 
+        FieldMaskSet<ExprView> overlapping;
+        const FieldMaskSet<ExprView> &candidates = 
+          find_overlapping_subviews(user_expr, overlapping);
         for (FieldMaskSet<ExprView>::const_iterator it = 
-              subviews.begin(); it != subviews.end(); it++)
+              candidates.begin(); it != candidates.end(); it++)
         {
           // If the fields don't overlap then we don't care
           const FieldMask overlap_mask = it->second & user_mask;
@@ -1220,6 +1453,52 @@ namespace Legion {
       }
     }
 
+    //--------------------------------------------------------------------------
+    const FieldMaskSet<ExprView>& ExprView::find_overlapping_subviews(
+     IndexSpaceExpression *expr, FieldMaskSet<ExprView> &overlapping) const
+    //--------------------------------------------------------------------------
+    {
+      // Not worth the trouble for small numbers of subviews
+      if (subviews.size() < LEGION_EXPR_VIEW_INDEX_THRESHOLD)
+        return subviews;
+      // The subviews can only change while holding the expr_lock at the 
+      // top of the tree in exclusive mode so we only need the view_lock
+      // to protect against other readers building the index
+      bool found = false, indexed = false;
+      std::vector<ExprView*> candidates;
+      {
+        AutoLock v_lock(view_lock,1,false/*exclusive*/);
+        if ((subview_index != NULL) && !subview_index->needs_rebuild())
+        {
+          indexed = subview_index->find_overlapping(expr, candidates);
+          found = true;
+        }
+      }
+      if (!found)
+      {
+        AutoLock v_lock(view_lock);
+        if ((subview_index != NULL) && subview_index->needs_rebuild())
+        {
+          delete subview_index;
+          subview_index = NULL;
+        }
+        if (subview_index == NULL)
+          subview_index = new ExprViewIndex(subviews);
+        indexed = subview_index->find_overlapping(expr, candidates);
+      }
+      if (!indexed)
+        return subviews;
+      // Erased subviews can still be in the index so filter them here
+      for (std::vector<ExprView*>::const_iterator it = 
+            candidates.begin(); it != candidates.end(); it++)
+      {
+        FieldMaskSet<ExprView>::const_iterator finder = subviews.find(*it);
+        if (finder != subviews.end())
+          overlapping.insert(finder->first, finder->second);
+      }
+      return overlapping;
+    }
+
     //--------------------------------------------------------------------------
     void ExprView::add_current_user(PhysicalUser *user,const ApEvent term_event,
                               RtEvent collect_event, const FieldMask &user_mask,
@@ -1293,6 +1572,11 @@ namespace Legion {
           to_delete.push_back(it->first);
       }
       subviews.swap(new_subviews);
+      if (subview_index != NULL)
+      {
+        delete subview_index;
+        subview_index = NULL;
+      }
       if (!to_delete.empty())
       {
         for (std::vector<ExprView*>::const_iterator it = 
@@ -3977,7 +4261,7 @@ namespace Legion {
         rez.serialize(did);
         rez.serialize(owner_space);
         rez.serialize(value->value_size);
-        rez.serialize(value->value, value->value_size);
+        rez.serialize_external(value->value, value->value_size);
 #ifdef LEGION_SPY
         rez.serialize(fill_op_uid);
 #endif
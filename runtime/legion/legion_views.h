@@ -264,6 +264,103 @@ namespace Legion {
                                           const std::set<ApEvent> &to_collect);
     };
 
+    /**
+     * \class ExprViewIndex
+     * An ExprViewIndex is a bounding volume hierarchy over the bounding
+     * boxes of the subviews of an ExprView. It lets us find the subviews
+     * that might overlap an expression without having to do an index
+     * space intersection test against every subview. Results are
+     * conservative: a subview whose bounding box overlaps the query
+     * might still not intersect the expression. Subviews inserted after
+     * the hierarchy was built are kept in a pending list that is checked
+     * linearly until the next rebuild, and erased subviews are left in
+     * place and filtered by the caller.
+     */
+    class ExprViewIndex : public LegionHeapify<ExprViewIndex> {
+    public:
+      static const int MAX_INDEX_DIM = 3;
+      static const unsigned LEAF_SIZE = 4;
+      struct Bounds {
+      public:
+        inline bool overlaps(const Bounds &rhs, const int dim) const
+        {
+          for (int d = 0; d < dim; d++)
+            if ((hi[d] < rhs.lo[d]) || (rhs.hi[d] < lo[d]))
+              return false;
+          return true;
+        }
+        inline bool empty(const int dim) const
+        {
+          for (int d = 0; d < dim; d++)
+            if (hi[d] < lo[d])
+              return true;
+          return false;
+        }
+        inline void merge(const Bounds &rhs, const int dim)
+        {
+          for (int d = 0; d < dim; d++)
+          {
+            if (rhs.lo[d] < lo[d]) lo[d] = rhs.lo[d];
+            if (hi[d] < rhs.hi[d]) hi[d] = rhs.hi[d];
+          }
+        }
+      public:
+        coord_t lo[MAX_INDEX_DIM], hi[MAX_INDEX_DIM];
+      };
+      struct Entry {
+      public:
+        Bounds bounds;
+        ExprView *view;
+      };
+      struct Node {
+      public:
+        Bounds bounds;
+        // Leaves cover entries [first, first+count), interior nodes
+        // have a count of zero and their children at first and first+1
+        unsigned first, count;
+      };
+      struct EntryCenterCompare {
+      public:
+        EntryCenterCompare(int d) : dim(d) { }
+      public:
+        inline bool operator()(const Entry &lhs, const Entry &rhs) const
+        {
+          return ((lhs.bounds.lo[dim] / 2 + lhs.bounds.hi[dim] / 2) <
+                  (rhs.bounds.lo[dim] / 2 + rhs.bounds.hi[dim] / 2));
+        }
+      public:
+        const int dim;
+      };
+    public:
+      ExprViewIndex(const FieldMaskSet<ExprView> &subviews);
+      ExprViewIndex(const ExprViewIndex &rhs);
+      ~ExprViewIndex(void);
+    public:
+      ExprViewIndex& operator=(const ExprViewIndex &rhs);
+    public:
+      // Returns false if the expression can't be bounded by the index,
+      // in which case the caller must fall back to checking all subviews
+      static bool compute_bounds(IndexSpaceExpression *expr, 
+                                 int &dim, Bounds &bounds);
+    public:
+      inline bool is_valid(void) const { return (dim > 0); }
+      bool needs_rebuild(void) const;
+      void record_insert(ExprView *subview);
+      inline void record_erase(void) { erased++; }
+      // Returns false if the caller needs to check all the subviews
+      bool find_overlapping(IndexSpaceExpression *expr,
+                            std::vector<ExprView*> &overlapping) const;
+    protected:
+      void build(unsigned node, unsigned first, unsigned count);
+    protected:
+      std::vector<Entry> entries;
+      std::vector<Node> nodes;
+      std::vector<Entry> pending;
+      unsigned erased;
+      // Zero if any subview could not be bounded
+      int dim;
+    };
+
     /**
      * \class ExprView
      * A ExprView is a node in a tree of ExprViews for capturing users of a
@@ -409,6 +506,12 @@ namespace Legion {
                                       const UniqueID op_id,
                                       const unsigned index,
                                       const bool user_covers);
+    protected:
+      // Returns either all the subviews or just the ones in the
+      // overlapping set that might intersect with the expression
+      const FieldMaskSet<ExprView>& find_overlapping_subviews(
+                                 IndexSpaceExpression *expr,
+                                 FieldMaskSet<ExprView> &overlapping) const;
     protected:
       void filter_local_users(ApEvent term_event);
       void filter_current_users(const EventFieldUsers &to_filter);
@@ -450,6 +553,9 @@ namespace Legion {
     protected:
       // Subviews for fields that have users in subexpressions
       FieldMaskSet<ExprView> subviews;
+      // Bounding box index over the subviews once there are enough
+      // of them, built lazily and protected by the view_lock
+      mutable ExprViewIndex *subview_index;
     };
 
     /**
@@ -49,7 +49,8 @@ namespace Legion {
                                  MapperID mid, Processor p)
       : runtime(rt), mapper(mp), mapper_id(mid), processor(p),
         profile_mapper(runtime->profiler != NULL),
-        request_valid_instances(mp->request_valid_instances())
+        request_valid_instances(mp->request_valid_instances()),
+        request_batched_map_task(mp->request_batched_map_task())
     //--------------------------------------------------------------------------
     {
     }
@@ -179,6 +180,33 @@ namespace Legion {
       finish_mapper_call(info);
     }
 
+    //--------------------------------------------------------------------------
+    void MapperManager::invoke_map_task_batch(TaskOp *task,
+                                        Mapper::MapTaskBatchInput *input,
+                                        Mapper::MapTaskBatchOutput *output,
+                                        MappingCallInfo *info)
+    //--------------------------------------------------------------------------
+    {
+      if (info == NULL)
+      {
+        RtEvent continuation_precondition;
+        info = begin_mapper_call(MAP_TASK_BATCH_CALL,
+                                 task, continuation_precondition);
+        // Build a continuation if necessary
+        if (continuation_precondition.exists())
+        {
+          MapperContinuation3<TaskOp,Mapper::MapTaskBatchInput,
+                              Mapper::MapTaskBatchOutput,
+                              &MapperManager::invoke_map_task_batch>
+                                continuation(this, task, input, output, info);
+          continuation.defer(runtime, continuation_precondition, task);
+          return;
+        }
+      }
+      mapper->map_task_batch(info, *input, *output);
+      finish_mapper_call(info);
+    }
+
     //--------------------------------------------------------------------------
     void MapperManager::invoke_select_task_variant(TaskOp *task,
                                             Mapper::SelectVariantInput *input,
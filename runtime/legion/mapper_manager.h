@@ -87,6 +87,10 @@ namespace Legion {
       void invoke_map_task(TaskOp *task, Mapper::MapTaskInput *input,
                            Mapper::MapTaskOutput *output, 
                            MappingCallInfo *info = NULL);
+      void invoke_map_task_batch(TaskOp *task, 
+                                 Mapper::MapTaskBatchInput *input,
+                                 Mapper::MapTaskBatchOutput *output,
+                                 MappingCallInfo *info = NULL);
       void invoke_select_task_variant(TaskOp *task, 
                                       Mapper::SelectVariantInput *input,
                                       Mapper::SelectVariantOutput *output,
@@ -562,6 +566,7 @@ namespace Legion {
       const Processor processor;
       const bool profile_mapper;
       const bool request_valid_instances;
+      const bool request_batched_map_task;
     protected:
       mutable LocalLock mapper_lock;
     protected:
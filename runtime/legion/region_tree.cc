@@ -6535,44 +6535,34 @@ namespace Legion {
         // The next node should have the operation, but we might be
         // storing it until it actually gets made
         // See if we already have it or we have the next trie node
-        ExpressionTrieNode *next = NULL;
+        // No need for the lock to do the lookups, operations are always
+        // added to the nodes before they are removed from the operations
         const IndexSpaceExprID target_expr = expressions.back()->expr_id;
+        IndexSpaceExpression *op = operations.find(target_expr);
+        if (op != NULL)
         {
-          AutoLock t_lock(trie_lock,1,false/*exclusive*/);
-          std::map<IndexSpaceExprID,IndexSpaceExpression*>::const_iterator
-            op_finder = operations.find(target_expr);
-          if (op_finder != operations.end())
-          {
-            result = op_finder->second;
-            return true;
-          }
-          std::map<IndexSpaceExprID,ExpressionTrieNode*>::const_iterator
-            node_finder = nodes.find(target_expr);
-          if (node_finder != nodes.end())
-            next = node_finder->second;
+          result = op;
+          return true;
         }
-        // Didn't find either, retake the lock in exclusive mode and then
-        // see if we lost the race, if not make the operation or
+        ExpressionTrieNode *next = nodes.find(target_expr);
+        // Didn't find either, take the lock and then see if we
+        // lost the race, if not then we're the last node
         if (next == NULL)
         {
           AutoLock t_lock(trie_lock);
-          std::map<IndexSpaceExprID,IndexSpaceExpression*>::const_iterator
-            op_finder = operations.find(target_expr);
-          if (op_finder != operations.end())
+          op = operations.find(target_expr);
+          if (op != NULL)
           {
-            result = op_finder->second;
+            result = op;
             return true;
           }
           // Still don't have the op
-          std::map<IndexSpaceExprID,ExpressionTrieNode*>::const_iterator
-            node_finder = nodes.find(target_expr);
-          if (node_finder == nodes.end())
+          next = nodes.find(target_expr);
+          if (next == NULL)
           {
             last = this;
             return false;
           }
-          else
-            next = node_finder->second;
         }
 #ifdef DEBUG_LEGION
         assert(next != NULL);
@@ -6583,40 +6573,16 @@ namespace Legion {
       {
         // Intermediate case 
         // See if we have the next node, or if we have to make it
-        ExpressionTrieNode *next = NULL;
         const IndexSpaceExprID target_expr = expressions[depth+1]->expr_id;
-        {
-          AutoLock t_lock(trie_lock,1,false/*exclusive*/);
-          std::map<IndexSpaceExprID,ExpressionTrieNode*>::const_iterator
-            finder = nodes.find(target_expr);
-          if (finder != nodes.end())
-            next = finder->second;
-        }
+        ExpressionTrieNode *next = nodes.find(target_expr);
         // Still don't have it so we have to try and make it
         if (next == NULL)
         {
           AutoLock t_lock(trie_lock);
           // See if we lost the race
-          std::map<IndexSpaceExprID,ExpressionTrieNode*>::const_iterator
-            finder = nodes.find(target_expr);
-          if (finder == nodes.end())
-          {
-            // We have to make the next node, also check to see if we
-            // already made an operation expression for it or not
-            std::map<IndexSpaceExprID,IndexSpaceExpression*>::iterator
-              op_finder = operations.find(target_expr);
-            if (op_finder != operations.end())
-            {
-              next = new ExpressionTrieNode(depth+1, target_expr, 
-                                            op_finder->second);
-              operations.erase(op_finder);    
-            }
-            else
-              next = new ExpressionTrieNode(depth+1, target_expr);
-            nodes[target_expr] = next;
-          }
-          else // lost the race
-            next = finder->second;
+          next = nodes.find(target_expr);
+          if (next == NULL)
+            next = create_node(target_expr);
         }
 #ifdef DEBUG_LEGION
         assert(next != NULL);
@@ -6646,48 +6612,39 @@ namespace Legion {
         AutoLock t_lock(trie_lock);
         if (local_operation != NULL)
           return local_operation;
-        local_operation = creator.consume();
-        return local_operation;
+        IndexSpaceExpression *result = creator.consume();
+        // Make sure the operation is visible before we publish it
+        __sync_synchronize();
+        local_operation = result;
+        return result;
       }
       else if (expressions.size() == (depth+2))
       {
         // The next node should have the operation, but we might be
         // storing it until it actually gets made
         // See if we already have it or we have the next trie node
-        ExpressionTrieNode *next = NULL;
         const IndexSpaceExprID target_expr = expressions.back()->expr_id;
-        {
-          AutoLock t_lock(trie_lock,1,false/*exclusive*/);
-          std::map<IndexSpaceExprID,IndexSpaceExpression*>::const_iterator
-            op_finder = operations.find(target_expr);
-          if (op_finder != operations.end())
-            return op_finder->second;
-          std::map<IndexSpaceExprID,ExpressionTrieNode*>::const_iterator
-            node_finder = nodes.find(target_expr);
-          if (node_finder != nodes.end())
-            next = node_finder->second;
-        }
-        // Didn't find either, retake the lock in exclusive mode and then
-        // see if we lost the race, if not make the operation or
+        IndexSpaceExpression *op = operations.find(target_expr);
+        if (op != NULL)
+          return op;
+        ExpressionTrieNode *next = nodes.find(target_expr);
+        // Didn't find either, take the lock and then see if we
+        // lost the race, if not make the operation
         if (next == NULL)
         {
           AutoLock t_lock(trie_lock);
-          std::map<IndexSpaceExprID,IndexSpaceExpression*>::const_iterator
-            op_finder = operations.find(target_expr);
-          if (op_finder != operations.end())
-            return op_finder->second;
+          op = operations.find(target_expr);
+          if (op != NULL)
+            return op;
           // Still don't have the op
-          std::map<IndexSpaceExprID,ExpressionTrieNode*>::const_iterator
-            node_finder = nodes.find(target_expr);
-          if (node_finder == nodes.end())
+          next = nodes.find(target_expr);
+          if (next == NULL)
           {
             // Didn't find the sub-node, so make the operation here
             IndexSpaceExpression *result = creator.consume();
-            operations[target_expr] = result;
+            operations.insert(target_expr, result);
             return result;
           }
-          else
-            next = node_finder->second;
         }
 #ifdef DEBUG_LEGION
         assert(next != NULL);
@@ -6698,40 +6655,16 @@ namespace Legion {
       {
         // Intermediate case 
         // See if we have the next node, or if we have to make it
-        ExpressionTrieNode *next = NULL;
         const IndexSpaceExprID target_expr = expressions[depth+1]->expr_id;
-        {
-          AutoLock t_lock(trie_lock,1,false/*exclusive*/);
-          std::map<IndexSpaceExprID,ExpressionTrieNode*>::const_iterator
-            finder = nodes.find(target_expr);
-          if (finder != nodes.end())
-            next = finder->second;
-        }
+        ExpressionTrieNode *next = nodes.find(target_expr);
         // Still don't have it so we have to try and make it
         if (next == NULL)
         {
           AutoLock t_lock(trie_lock);
           // See if we lost the race
-          std::map<IndexSpaceExprID,ExpressionTrieNode*>::const_iterator
-            finder = nodes.find(target_expr);
-          if (finder == nodes.end())
-          {
-            // We have to make the next node, also check to see if we
-            // already made an operation expression for it or not
-            std::map<IndexSpaceExprID,IndexSpaceExpression*>::iterator
-              op_finder = operations.find(target_expr);
-            if (op_finder != operations.end())
-            {
-              next = new ExpressionTrieNode(depth+1, target_expr, 
-                                            op_finder->second);
-              operations.erase(op_finder);
-            }
-            else
-              next = new ExpressionTrieNode(depth+1, target_expr);
-            nodes[target_expr] = next;
-          }
-          else // lost the race
-            next = finder->second;
+          next = nodes.find(target_expr);
+          if (next == NULL)
+            next = create_node(target_expr);
         }
 #ifdef DEBUG_LEGION
         assert(next != NULL);
@@ -6740,6 +6673,25 @@ namespace Legion {
       }
     }
 
+    //--------------------------------------------------------------------------
+    ExpressionTrieNode* ExpressionTrieNode::create_node(
+                                                  IndexSpaceExprID target_expr)
+    //--------------------------------------------------------------------------
+    {
+      // Must be holding the trie lock
+      // We have to make the next node, also check to see if we
+      // already made an operation expression for it or not
+      IndexSpaceExpression *op = operations.find(target_expr);
+      ExpressionTrieNode *next = 
+        new ExpressionTrieNode(depth+1, target_expr, op);
+      // Publish the node before removing the operation so that lock-free
+      // readers will always be able to find the operation in one of them
+      nodes.insert(target_expr, next);
+      if (op != NULL)
+        operations.erase(target_expr);
+      return next;
+    }
+
     //--------------------------------------------------------------------------
     bool ExpressionTrieNode::remove_operation(
                           const std::vector<IndexSpaceExpression*> &expressions)
@@ -6750,6 +6702,8 @@ namespace Legion {
       assert(expressions[depth]->expr_id == expr); // these should match
 #endif
       // No need for locks here, we're protected by the big lock at the top
+      // which also means there are no readers in the trie so we can
+      // reclaim any memory that the tables are no longer using
       // Three cases here
       if (expressions.size() == (depth+1))
       {
@@ -6760,38 +6714,34 @@ namespace Legion {
       {
         // See if we should continue traversing or if we have the operation
         const IndexSpaceExprID target_expr = expressions.back()->expr_id;
-        std::map<IndexSpaceExprID,IndexSpaceExpression*>::iterator op_finder =
-          operations.find(target_expr);
-        if (op_finder == operations.end())
+        if (operations.erase(target_expr) == NULL)
         {
-          std::map<IndexSpaceExprID,ExpressionTrieNode*>::iterator
-            node_finder = nodes.find(target_expr);
+          ExpressionTrieNode *next = nodes.find(target_expr);
 #ifdef DEBUG_LEGION
-          assert(node_finder != nodes.end());
+          assert(next != NULL);
 #endif
-          if (node_finder->second->remove_operation(expressions))
+          if (next->remove_operation(expressions))
           {
-            delete node_finder->second;
-            nodes.erase(node_finder);
+            nodes.erase(target_expr);
+            delete next;
           }
         }
-        else
-          operations.erase(op_finder);
       }
       else
       {
         const IndexSpaceExprID target_expr = expressions[depth+1]->expr_id;
-        std::map<IndexSpaceExprID,ExpressionTrieNode*>::iterator finder =
-          nodes.find(target_expr);
+        ExpressionTrieNode *next = nodes.find(target_expr);
 #ifdef DEBUG_LEGION
-        assert(finder != nodes.end());
+        assert(next != NULL);
 #endif
-        if (finder->second->remove_operation(expressions))
+        if (next->remove_operation(expressions))
         {
-          delete finder->second;
-          nodes.erase(finder);
+          nodes.erase(target_expr);
+          delete next;
         }
       }
+      operations.reclaim();
+      nodes.reclaim();
       if (local_operation != NULL)
         return false;
       if (!operations.empty())
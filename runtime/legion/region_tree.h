@@ -1530,12 +1530,75 @@ namespace Legion {
       Deserializer &derez;
     };
 
+    /**
+     * \class ExpressionTrieTable
+     * This is an open-addressed hash table mapping expression IDs to
+     * the children of an ExpressionTrieNode. Lookups do not take any
+     * locks: an entry's value is always written before its key, and
+     * the slot array is never resized in place but replaced by a new
+     * one. Inserts and erases must be serialized by the caller's lock.
+     * Erased entries leave a tombstone behind until the next resize.
+     * Replaced slot arrays are kept until reclaim is called, which must
+     * only happen while no readers can be traversing the table (e.g.
+     * holding the lookup_is_op_lock of the forest in exclusive mode).
+     */
+    template<typename T>
+    class ExpressionTrieTable {
+    public:
+      static const IndexSpaceExprID EMPTY_KEY = 0;
+      static const IndexSpaceExprID DELETED_KEY = ~0ULL;
+      static const unsigned MIN_LOG2_SIZE = 2;
+      struct Entry {
+      public:
+        IndexSpaceExprID key;
+        T *value;
+      };
+      struct Slots {
+      public:
+        Slots(unsigned log2);
+        ~Slots(void);
+      public:
+        inline unsigned size(void) const { return (1U << log2_size); }
+        // Expression IDs are strided by the number of nodes so
+        // use a multiplicative hash to spread out the low bits
+        inline unsigned first_slot(IndexSpaceExprID key) const
+          { return (unsigned)((key * 0x9E3779B97F4A7C15ULL) >> 
+                              (64 - log2_size)); }
+      public:
+        Entry *const entries;
+        const unsigned log2_size;
+        Slots *next_retired;
+      };
+    public:
+      ExpressionTrieTable(void);
+      ExpressionTrieTable(const ExpressionTrieTable &rhs);
+      ~ExpressionTrieTable(void);
+    public:
+      ExpressionTrieTable& operator=(const ExpressionTrieTable &rhs);
+    public:
+      inline bool empty(void) const { return (live == 0); }
+      // Safe to call concurrently with inserts and erases
+      T* find(IndexSpaceExprID key) const;
+      // Caller must hold the lock protecting the table
+      void insert(IndexSpaceExprID key, T *value);
+      T* erase(IndexSpaceExprID key);
+      // Caller must guarantee there are no concurrent readers
+      void reclaim(void);
+    protected:
+      void resize(unsigned log2_size);
+    protected:
+      Slots *volatile slots;
+      Slots *retired;
+      unsigned live, used;
+    };
+
     /**
      * \class ExpressionTrieNode
      * This is a class for constructing a trie for index space
      * expressions so we can quickly detect commmon subexpression
-     * in O(log N)^M time where N is the number of expressions
-     * in total and M is the number of expression in the operation
+     * in O(M) time where M is the number of expressions in the
+     * operation. Lookups of existing operations are lock-free and
+     * the trie_lock is only taken when inserting new children.
      */
     class ExpressionTrieNode {
     public:
@@ -1553,13 +1616,15 @@ namespace Legion {
           const std::vector<IndexSpaceExpression*> &expressions,
           OperationCreator &creator);
       bool remove_operation(const std::vector<IndexSpaceExpression*> &exprs);
+    protected:
+      ExpressionTrieNode* create_node(IndexSpaceExprID target_expr);
     public:
       const unsigned depth;
       const IndexSpaceExprID expr;
     protected:
-      IndexSpaceExpression *local_operation;
-      std::map<IndexSpaceExprID,IndexSpaceExpression*> operations;
-      std::map<IndexSpaceExprID,ExpressionTrieNode*> nodes;
+      IndexSpaceExpression *volatile local_operation;
+      ExpressionTrieTable<IndexSpaceExpression> operations;
+      ExpressionTrieTable<ExpressionTrieNode> nodes;
     protected:
       mutable LocalLock trie_lock;
     };
@@ -3608,6 +3673,192 @@ namespace Legion {
     }
 #endif
 
+    //--------------------------------------------------------------------------
+    template<typename T>
+    ExpressionTrieTable<T>::Slots::Slots(unsigned log2)
+      : entries(new Entry[1U << log2]()), log2_size(log2), next_retired(NULL)
+    //--------------------------------------------------------------------------
+    {
+    }
+
+    //--------------------------------------------------------------------------
+    template<typename T>
+    ExpressionTrieTable<T>::Slots::~Slots(void)
+    //--------------------------------------------------------------------------
+    {
+      delete [] entries;
+    }
+
+    //--------------------------------------------------------------------------
+    template<typename T>
+    ExpressionTrieTable<T>::ExpressionTrieTable(void)
+      : slots(NULL), retired(NULL), live(0), used(0)
+    //--------------------------------------------------------------------------
+    {
+    }
+
+    //--------------------------------------------------------------------------
+    template<typename T>
+    ExpressionTrieTable<T>::ExpressionTrieTable(const ExpressionTrieTable &rhs)
+    //--------------------------------------------------------------------------
+    {
+      // should never be called
+      assert(false);
+    }
+
+    //--------------------------------------------------------------------------
+    template<typename T>
+    ExpressionTrieTable<T>::~ExpressionTrieTable(void)
+    //--------------------------------------------------------------------------
+    {
+      reclaim();
+      if (slots != NULL)
+        delete slots;
+    }
+
+    //--------------------------------------------------------------------------
+    template<typename T>
+    ExpressionTrieTable<T>& ExpressionTrieTable<T>::operator=(
+                                                 const ExpressionTrieTable &rhs)
+    //--------------------------------------------------------------------------
+    {
+      // should never be called
+      assert(false);
+      return *this;
+    }
+
+    //--------------------------------------------------------------------------
+    template<typename T>
+    T* ExpressionTrieTable<T>::find(IndexSpaceExprID key) const
+    //--------------------------------------------------------------------------
+    {
+      const Slots *current = __atomic_load_n(&slots, __ATOMIC_ACQUIRE);
+      if (current == NULL)
+        return NULL;
+      const unsigned mask = current->size() - 1;
+      unsigned index = current->first_slot(key);
+      for (unsigned probes = 0; probes <= mask; probes++)
+      {
+        const Entry &entry = current->entries[index];
+        const IndexSpaceExprID next_key =
+          __atomic_load_n(&entry.key, __ATOMIC_ACQUIRE);
+        // Values are never overwritten once their key has been published
+        // so it is safe to return it even if the entry is being erased
+        if (next_key == key)
+          return entry.value;
+        if (next_key == EMPTY_KEY)
+          return NULL;
+        index = (index + 1) & mask;
+      }
+      return NULL;
+    }
+
+    //--------------------------------------------------------------------------
+    template<typename T>
+    void ExpressionTrieTable<T>::insert(IndexSpaceExprID key, T *value)
+    //--------------------------------------------------------------------------
+    {
+#ifdef DEBUG_LEGION
+      assert(key != EMPTY_KEY);
+      assert(key != DELETED_KEY);
+      assert(value != NULL);
+      assert(find(key) == NULL);
+#endif
+      // Tombstones are never reused so that a reader can never see a
+      // different value for a key it matched, which means we have to
+      // count them when deciding whether it is time to resize
+      if (slots == NULL)
+        resize(MIN_LOG2_SIZE);
+      else if ((4 * (used + 1)) > (3 * slots->size()))
+      {
+        unsigned log2_size = MIN_LOG2_SIZE;
+        while ((1U << log2_size) < (2 * (live + 1)))
+          log2_size++;
+        resize(log2_size);
+      }
+      const unsigned mask = slots->size() - 1;
+      unsigned index = slots->first_slot(key);
+      while (slots->entries[index].key != EMPTY_KEY)
+        index = (index + 1) & mask;
+      Entry &entry = slots->entries[index];
+      entry.value = value;
+      __atomic_store_n(&entry.key, key, __ATOMIC_RELEASE);
+      live++;
+      used++;
+    }
+
+    //--------------------------------------------------------------------------
+    template<typename T>
+    T* ExpressionTrieTable<T>::erase(IndexSpaceExprID key)
+    //--------------------------------------------------------------------------
+    {
+      if (slots == NULL)
+        return NULL;
+      const unsigned mask = slots->size() - 1;
+      unsigned index = slots->first_slot(key);
+      for (unsigned probes = 0; probes <= mask; probes++)
+      {
+        Entry &entry = slots->entries[index];
+        if (entry.key == key)
+        {
+          __atomic_store_n(&entry.key, DELETED_KEY, __ATOMIC_RELEASE);
+          live--;
+          return entry.value;
+        }
+        if (entry.key == EMPTY_KEY)
+          return NULL;
+        index = (index + 1) & mask;
+      }
+      return NULL;
+    }
+
+    //--------------------------------------------------------------------------
+    template<typename T>
+    void ExpressionTrieTable<T>::reclaim(void)
+    //--------------------------------------------------------------------------
+    {
+      // No readers so we can also give back the slots if we are empty
+      if ((live == 0) && (slots != NULL))
+      {
+        delete slots;
+        slots = NULL;
+        used = 0;
+      }
+      while (retired != NULL)
+      {
+        Slots *next = retired->next_retired;
+        delete retired;
+        retired = next;
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    template<typename T>
+    void ExpressionTrieTable<T>::resize(unsigned log2_size)
+    //--------------------------------------------------------------------------
+    {
+      Slots *next = new Slots(log2_size);
+      const unsigned mask = next->size() - 1;
+      if (slots != NULL)
+      {
+        for (unsigned idx = 0; idx < slots->size(); idx++)
+        {
+          const Entry &entry = slots->entries[idx];
+          if ((entry.key == EMPTY_KEY) || (entry.key == DELETED_KEY))
+            continue;
+          unsigned index = next->first_slot(entry.key);
+          while (next->entries[index].key != EMPTY_KEY)
+            index = (index + 1) & mask;
+          next->entries[index] = entry;
+        }
+        // Readers might still be looking at the old slots
+        slots->next_retired = retired;
+        retired = slots;
+      }
+      __atomic_store_n(&slots, next, __ATOMIC_RELEASE);
+      used = live;
+    }
+
   }; // namespace Internal
 }; // namespace Legion
 
@@ -22,6 +22,7 @@
 #include "legion/region_tree.h"
 #include "legion/legion_spy.h"
 #include "legion/legion_profiling.h"
+#include "legion/legion_profiling_serializer.h"
 #include "legion/legion_instances.h"
 #include "legion/legion_views.h"
 #include "legion/legion_context.h"
@@ -64,7 +65,7 @@ namespace Legion {
     Realm::Logger log_shutdown("shutdown");
     Realm::Logger log_tracing("tracing");
     namespace LegionSpy {
-      Realm::Logger log_spy("legion_spy");
+      Realm::Logger log_spy_text("legion_spy");
     };
 
     __thread TaskContext *implicit_context = NULL;
@@ -909,7 +910,7 @@ namespace Legion {
           RezCheck z(rez);
           rez.serialize(result_size);
           if (result_size > 0)
-            rez.serialize(result,result_size);
+            rez.serialize_external(result,result_size);
           rez.serialize(complete);
         }
         runtime->send_future_result(*it, rez);
@@ -965,7 +966,7 @@ namespace Legion {
           RezCheck z(rez);
           rez.serialize(result_size);
           if (result_size > 0)
-            rez.serialize(result,result_size);
+            rez.serialize_external(result,result_size);
           rez.serialize(future_complete);
         }
         runtime->send_future_result(subscriber, rez);
@@ -7066,7 +7067,8 @@ namespace Legion {
     //--------------------------------------------------------------------------
     VirtualChannel::VirtualChannel(VirtualChannelKind kind, 
         AddressSpaceID local_address_space, size_t max_message_size, 
-        bool profile_outgoing, LegionProfiler *prof)
+        bool profile_outgoing, LegionProfiler *prof, size_t flush_bytes,
+        long long delay, bool coalesce)
       : sending_buffer((char*)malloc(max_message_size)), 
         sending_buffer_size(max_message_size), 
         ordered_channel((kind != DEFAULT_VIRTUAL_CHANNEL) &&
@@ -7078,7 +7080,13 @@ namespace Legion {
         response_priority((kind == THROUGHPUT_VIRTUAL_CHANNEL) ?
             LG_THROUGHPUT_RESPONSE_PRIORITY : (kind == UPDATE_VIRTUAL_CHANNEL) ?
             LG_LATENCY_MESSAGE_PRIORITY : LG_LATENCY_RESPONSE_PRIORITY),
-        partial_messages(0), observed_recent(true), profiler(prof)
+        channel_kind(kind), flush_index(((flush_bytes == 0) || 
+              (flush_bytes > max_message_size)) ? max_message_size : 
+              flush_bytes), max_delay(delay), coalesce_flushes(coalesce), 
+        first_buffered(0), last_flush(0), last_kind(LAST_SEND_KIND),
+        buffered_response(false), idle_flush_pending(false),
+        delay_flush_pending(false), partial_messages(0), 
+        observed_recent(true), profiler(prof)
     //--------------------------------------------------------------------------
     //
     {
@@ -7124,7 +7132,9 @@ namespace Legion {
       : sending_buffer(NULL), sending_buffer_size(0), 
         ordered_channel(false), profile_outgoing_messages(false),
         request_priority(rhs.request_priority),
-        response_priority(rhs.response_priority), profiler(NULL)
+        response_priority(rhs.response_priority), 
+        channel_kind(rhs.channel_kind), flush_index(0), max_delay(0),
+        coalesce_flushes(false), profiler(NULL)
     //--------------------------------------------------------------------------
     {
       // should never be called
@@ -7146,73 +7156,163 @@ namespace Legion {
     //--------------------------------------------------------------------------
     void VirtualChannel::package_message(Serializer &rez, MessageKind k,
                          bool flush, Runtime *runtime, Processor target, 
-                         bool response, bool shutdown)
+                         bool response, bool shutdown, MessageManager *manager)
     //--------------------------------------------------------------------------
     {
       // First check to see if the message fits in the current buffer    
       // including the overhead for the message: kind and size
       size_t buffer_size = rez.get_used_bytes();
-      const char *buffer = (const char*)rez.get_buffer();
+      const char *buffer = rez.get_inline_buffer();
       const size_t header_size = 
         sizeof(k) + sizeof(implicit_provenance) + sizeof(buffer_size);
+      // Only bother reading the clock if we have a delay policy
+      const long long now = (max_delay > 0) ? 
+        Realm::Clock::current_time_in_microseconds() : 0;
       // Need to hold the lock when manipulating the buffer
       AutoLock c_lock(channel_lock);
-      if ((sending_index+header_size+buffer_size) > sending_buffer_size)
-      {
-        // Make sure we can at least get the meta-data into the buffer
-        // Since there is no partial data we can fake the flush
-        if ((sending_buffer_size - sending_index) <= header_size)
-          send_message(true/*complete*/, runtime, target, k, response,shutdown);
-        // Now can package up the meta data
-        packaged_messages++;
-        *((MessageKind*)(sending_buffer+sending_index)) = k;
-        sending_index += sizeof(k);
-        *((UniqueID*)(sending_buffer+sending_index)) = implicit_provenance;
-        sending_index += sizeof(implicit_provenance);
-        *((size_t*)(sending_buffer+sending_index)) = buffer_size;
-        sending_index += sizeof(buffer_size);
-        while (buffer_size > 0)
-        {
-          unsigned remaining = sending_buffer_size - sending_index;
-          if (remaining == 0)
-            send_message(false/*complete*/, runtime, 
-                         target, k, response, shutdown);
-          remaining = sending_buffer_size - sending_index;
-#ifdef DEBUG_LEGION
-          assert(remaining > 0); // should be space after the send
-#endif
-          // Figure out how much to copy into the buffer
-          unsigned to_copy = (remaining < buffer_size) ? 
-                                            remaining : buffer_size;
-          memcpy(sending_buffer+sending_index,buffer,to_copy);
-          buffer_size -= to_copy;
-          buffer += to_copy;
-          sending_index += to_copy;
-        } 
+      // If the oldest buffered message has waited long enough then
+      // send it on its way before adding this one to the buffer
+      if ((max_delay > 0) && (packaged_messages > 0) && 
+          ((now - first_buffered) >= max_delay))
+        send_message(true/*complete*/, DELAY_FLUSH, runtime, target, 
+                     last_kind, buffered_response, shutdown);
+      // Make sure we can at least get the meta-data into the buffer
+      // Since there is no partial data we can fake the flush
+      if (((sending_index+header_size+buffer_size) > sending_buffer_size) &&
+          ((sending_buffer_size - sending_index) <= header_size))
+        send_message(true/*complete*/, FULL_FLUSH, runtime, target, k, 
+                     response, shutdown);
+      // Now can package up the meta data
+      if (packaged_messages++ == 0)
+        first_buffered = now;
+      last_kind = k;
+      if (response)
+        buffered_response = true;
+      statistics.messages++;
+      statistics.bytes += buffer_size;
+      *((MessageKind*)(sending_buffer+sending_index)) = k;
+      sending_index += sizeof(k);
+      *((UniqueID*)(sending_buffer+sending_index)) = implicit_provenance;
+      sending_index += sizeof(implicit_provenance);
+      *((size_t*)(sending_buffer+sending_index)) = buffer_size;
+      sending_index += sizeof(buffer_size);
+      // Then gather the inline bytes and any external segments straight
+      // into the sending buffer so large buffers are only copied once
+      const std::vector<Serializer::ExternalSegment> &segments = 
+        rez.get_external_segments();
+      size_t offset = 0;
+      for (std::vector<Serializer::ExternalSegment>::const_iterator it = 
+            segments.begin(); it != segments.end(); it++)
+      {
+        package_bytes(buffer + offset, it->offset - offset, runtime, 
+                      target, k, response, shutdown);
+        package_bytes((const char*)it->ptr, it->size, runtime, 
+                      target, k, response, shutdown);
+        offset = it->offset;
+      }
+      package_bytes(buffer + offset, rez.get_index() - offset, runtime,
+                    target, k, response, shutdown);
+      if (flush)
+      {
+        // Explicit flushes that arrive in quick succession on channels
+        // that allow it get coalesced into a single active message that
+        // is sent by a deferred flush at the priority of the message
+        if (coalesce_flushes && !shutdown && 
+            ((now - last_flush) < max_delay))
+        {
+          if (!delay_flush_pending)
+          {
+            delay_flush_pending = true;
+            MessageManager::DeferMessageFlushArgs args(manager, 
+                                          channel_kind, DELAY_FLUSH);
+            runtime->issue_runtime_meta_task(args, 
+                response ? response_priority : request_priority);
+          }
+        }
+        else
+          send_message(true/*complete*/, EXPLICIT_FLUSH, runtime, target, 
+                       k, response, shutdown);
       }
+      else if (sending_index >= flush_index)
+        send_message(true/*complete*/, SIZE_FLUSH, runtime, target,
+                     k, response, shutdown);
+      // If we still have buffered messages and a delay policy then make
+      // sure they go out once the utility processors run out of work
+      if ((max_delay > 0) && (packaged_messages > 0) && 
+          !idle_flush_pending && !delay_flush_pending)
+      {
+        idle_flush_pending = true;
+        MessageManager::DeferMessageFlushArgs args(manager, 
+                                      channel_kind, IDLE_FLUSH);
+        runtime->issue_runtime_meta_task(args, LG_LOW_PRIORITY);
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    void VirtualChannel::deferred_flush(FlushReason reason, Runtime *runtime,
+                                        Processor target)
+    //--------------------------------------------------------------------------
+    {
+      AutoLock c_lock(channel_lock);
+      if (reason == IDLE_FLUSH)
+        idle_flush_pending = false;
       else
+        delay_flush_pending = false;
+      // Messages might already have been sent by someone else
+      if (packaged_messages == 0)
+        return;
+      send_message(true/*complete*/, reason, runtime, target, last_kind,
+                   buffered_response, false/*shutdown*/);
+    }
+
+    //--------------------------------------------------------------------------
+    void VirtualChannel::get_statistics(MessageStatistics &stats) const
+    //--------------------------------------------------------------------------
+    {
+      AutoLock c_lock(channel_lock,1,false/*exclusive*/);
+      stats.merge(statistics);
+    }
+
+    //--------------------------------------------------------------------------
+    void VirtualChannel::package_bytes(const char *buffer, size_t buffer_size,
+                                   Runtime *runtime, Processor target,
+                                   MessageKind k, bool response, bool shutdown)
+    //--------------------------------------------------------------------------
+    {
+      // Lock held from caller
+      while (buffer_size > 0)
       {
-        packaged_messages++;
-        // Package up the kind and the size first
-        *((MessageKind*)(sending_buffer+sending_index)) = k;
-        sending_index += sizeof(k);
-        *((UniqueID*)(sending_buffer+sending_index)) = implicit_provenance;
-        sending_index += sizeof(implicit_provenance);
-        *((size_t*)(sending_buffer+sending_index)) = buffer_size;
-        sending_index += sizeof(buffer_size);
-        // Then copy over the buffer
-        memcpy(sending_buffer+sending_index,buffer,buffer_size); 
-        sending_index += buffer_size;
+        size_t remaining = sending_buffer_size - sending_index;
+        if (remaining == 0)
+        {
+          send_message(false/*complete*/, FULL_FLUSH, runtime, 
+                       target, k, response, shutdown);
+          remaining = sending_buffer_size - sending_index;
+        }
+#ifdef DEBUG_LEGION
+        assert(remaining > 0); // should be space after the send
+#endif
+        // Figure out how much to copy into the buffer
+        const size_t to_copy = (remaining < buffer_size) ? 
+                                          remaining : buffer_size;
+        memcpy(sending_buffer+sending_index,buffer,to_copy);
+        buffer_size -= to_copy;
+        buffer += to_copy;
+        sending_index += to_copy;
       }
-      if (flush)
-        send_message(true/*complete*/, runtime, target, k, response, shutdown);
     }
 
     //--------------------------------------------------------------------------
-    void VirtualChannel::send_message(bool complete, Runtime *runtime,
-               Processor target, MessageKind kind, bool response, bool shutdown)
+    void VirtualChannel::send_message(bool complete, FlushReason reason,
+                                      Runtime *runtime, Processor target, 
+                                      MessageKind kind, bool response, 
+                                      bool shutdown)
     //--------------------------------------------------------------------------
     {
+      statistics.active_messages++;
+      statistics.flushes[reason]++;
+      if (max_delay > 0)
+        last_flush = Realm::Clock::current_time_in_microseconds();
       // See if we need to switch the header file
       // and update the state of partial
       bool first_partial = false;
@@ -7303,6 +7403,7 @@ namespace Legion {
       else
         header = FULL_MESSAGE;
       packaged_messages = 0;
+      buffered_response = false;
     }
 
     //--------------------------------------------------------------------------
@@ -8601,7 +8702,8 @@ namespace Legion {
       : channels((VirtualChannel*)
                   malloc(MAX_NUM_VIRTUAL_CHANNELS*sizeof(VirtualChannel))), 
         runtime(rt), remote_address_space(remote), target(remote_util_group), 
-        always_flush(remote < rt->num_profiling_nodes)
+        always_flush((remote < rt->num_profiling_nodes) && 
+                     (rt->message_max_delay == 0))
     //--------------------------------------------------------------------------
     {
 #ifdef DEBUG_LEGION
@@ -8611,7 +8713,10 @@ namespace Legion {
       for (unsigned idx = 0; idx < MAX_NUM_VIRTUAL_CHANNELS; idx++)
       {
         new (channels+idx) VirtualChannel((VirtualChannelKind)idx,
-          rt->address_space, max_message_size, always_flush, runtime->profiler);
+          rt->address_space, max_message_size, 
+          (remote < rt->num_profiling_nodes), runtime->profiler,
+          rt->message_flush_bytes, rt->message_max_delay,
+          ((rt->message_coalesce_mask & (1 << idx)) != 0));
       }
     }
 
@@ -8654,7 +8759,7 @@ namespace Legion {
       if (!flush && always_flush)
         flush = true;
       channels[channel].package_message(rez, kind, flush, runtime, 
-                                        target, response, shutdown);
+                                        target, response, shutdown, this);
     }
 
     //--------------------------------------------------------------------------
@@ -8679,6 +8784,24 @@ namespace Legion {
         channels[idx].confirm_shutdown(shutdown_manager, phase_one);
     }
 
+    //--------------------------------------------------------------------------
+    void MessageManager::get_statistics(VirtualChannelKind channel,
+                              VirtualChannel::MessageStatistics &stats) const
+    //--------------------------------------------------------------------------
+    {
+      channels[channel].get_statistics(stats);
+    }
+
+    //--------------------------------------------------------------------------
+    /*static*/ void MessageManager::handle_deferred_flush(const void *args)
+    //--------------------------------------------------------------------------
+    {
+      const DeferMessageFlushArgs *fargs = (const DeferMessageFlushArgs*)args;
+      MessageManager *manager = fargs->manager;
+      manager->channels[fargs->channel].deferred_flush(fargs->reason,
+                                        manager->runtime, manager->target);
+    }
+
     /////////////////////////////////////////////////////////////
     // Shutdown Manager 
     /////////////////////////////////////////////////////////////
@@ -10993,6 +11116,9 @@ namespace Legion {
         initial_tasks_to_schedule(config.initial_tasks_to_schedule),
         initial_meta_task_vector_width(config.initial_meta_task_vector_width),
         max_message_size(config.max_message_size),
+        message_flush_bytes(config.message_flush_bytes),
+        message_max_delay(config.message_max_delay),
+        message_coalesce_mask(config.message_coalesce_mask),
         gc_epoch_size(config.gc_epoch_size),
         max_local_fields(config.max_local_fields),
         max_replay_parallelism(config.max_replay_parallelism),
@@ -11027,6 +11153,7 @@ namespace Legion {
         enable_test_mapper(config.enable_test_mapper),
         legion_ldb_enabled(!config.ldb_file.empty()),
         replay_file(legion_ldb_enabled ? config.ldb_file : config.replay_file),
+        trace_cache_directory(config.trace_cache_directory),
 #ifdef DEBUG_LEGION
         logging_region_tree_state(config.logging_region_tree_state),
         verbose_logging(config.verbose_logging),
@@ -11198,6 +11325,9 @@ namespace Legion {
         initial_tasks_to_schedule(rhs.initial_tasks_to_schedule),
         initial_meta_task_vector_width(rhs.initial_meta_task_vector_width),
         max_message_size(rhs.max_message_size),
+        message_flush_bytes(rhs.message_flush_bytes),
+        message_max_delay(rhs.message_max_delay),
+        message_coalesce_mask(rhs.message_coalesce_mask),
         gc_epoch_size(rhs.gc_epoch_size), 
         max_local_fields(rhs.max_local_fields),
         max_replay_parallelism(rhs.max_replay_parallelism),
@@ -11224,6 +11354,7 @@ namespace Legion {
         enable_test_mapper(rhs.enable_test_mapper),
         legion_ldb_enabled(rhs.legion_ldb_enabled),
         replay_file(rhs.replay_file),
+        trace_cache_directory(rhs.trace_cache_directory),
 #ifdef DEBUG_LEGION
         logging_region_tree_state(rhs.logging_region_tree_state),
         verbose_logging(rhs.verbose_logging),
@@ -11719,7 +11850,8 @@ namespace Legion {
                                     config.prof_logfile.c_str(),
                                     total_address_spaces,
                                     config.prof_footprint_threshold << 20,
-                                    config.prof_target_latency);
+                                    config.prof_target_latency,
+                                    config.prof_inflight_limit << 20);
       MAPPER_CALL_NAMES(lg_mapper_calls);
       profiler->record_mapper_call_kinds(lg_mapper_calls, LAST_MAPPER_CALL);
 #ifdef DETAILED_LEGION_PROF
@@ -12250,7 +12382,29 @@ namespace Legion {
            memory_managers.begin(); it != memory_managers.end(); it++)
         it->second->finalize();
       if (profiler != NULL)
+      {
+        // Record how well outgoing messages were aggregated on each
+        // virtual channel across all the nodes we talked to
+        for (unsigned idx = 0; idx < MAX_NUM_VIRTUAL_CHANNELS; idx++)
+        {
+          VirtualChannel::MessageStatistics stats;
+          for (unsigned sid = 0; sid < LEGION_MAX_NUM_NODES; sid++)
+            if (message_managers[sid] != NULL)
+              message_managers[sid]->get_statistics(
+                  (VirtualChannelKind)idx, stats);
+          if (stats.messages == 0)
+            continue;
+          unsigned long long counters[3 + VirtualChannel::LAST_FLUSH_REASON];
+          counters[0] = stats.messages;
+          counters[1] = stats.bytes;
+          counters[2] = stats.active_messages;
+          for (unsigned reason = 0; 
+                reason < VirtualChannel::LAST_FLUSH_REASON; reason++)
+            counters[3 + reason] = stats.flushes[reason];
+          profiler->record_message_channel(idx, counters);
+        }
         profiler->finalize();
+      }
     }
     
     //--------------------------------------------------------------------------
@@ -21430,6 +21584,23 @@ namespace Legion {
         it->second.diff_allocations = 0;
         it->second.diff_bytes = 0;
       }
+#ifdef LEGION_SLAB_ALLOCATION
+      for (SlabAllocationStats *stats = SlabAllocationStats::registry;
+            stats != NULL; stats = stats->next)
+      {
+        // Every refill either reused a returned batch or made a new slab
+        const unsigned long long reused = stats->cache_refills - stats->slabs;
+        log_allocation.info("Slab %s (%zd bytes) on %d: "
+            "cache_hits=%llu refills=%llu reused_batches=%llu "
+            "returned_batches=%llu slabs=%llu slab_bytes=%llu fallbacks=%llu",
+            stats->name, stats->object_size, address_space,
+            stats->cache_hits, stats->cache_refills, reused,
+            stats->global_returns, stats->slabs,
+            (unsigned long long)(stats->slabs * LEGION_SLAB_BATCH_SIZE *
+                                 stats->object_size),
+            stats->fallbacks);
+      }
+#endif
       log_allocation.info(" ");
     }
 
@@ -22136,7 +22307,18 @@ namespace Legion {
         perform_slow_config_checks(config);
       // Configure legion spy if necessary
       if (config.legion_spy_enabled)
+      {
+        // Write the records in binary to their own file if requested
+        if (!config.spy_logfile.empty())
+        {
+          Machine::ProcessorQuery local_procs(Machine::get_machine());
+          local_procs.local_address_space();
+          LegionSpy::open_binary_log(config.spy_logfile.c_str(),
+                                     local_procs.first().address_space());
+          atexit(LegionSpy::close_binary_log);
+        }
         LegionSpy::log_legion_spy_config();
+      }
       // Configure MPI Interoperability
       const std::vector<LegionHandshake> &pending_handshakes =
         get_pending_handshake_table();
@@ -22242,6 +22424,8 @@ namespace Legion {
                          config.no_physical_tracing, !filter)
         .add_option_bool("-lg:no_trace_optimization",
                          config.no_trace_optimization, !filter)
+        .add_option_string("-lg:trace_cache",
+                           config.trace_cache_directory, !filter)
         .add_option_bool("-lg:no_fence_elision",
                          config.no_fence_elision, !filter)
         .add_option_bool("-lg:replay_on_cpus",
@@ -22258,12 +22442,19 @@ namespace Legion {
         .add_option_int("-lg:vector", 
                         config.initial_meta_task_vector_width, !filter)
         .add_option_int("-lg:message",config.max_message_size, !filter)
+        .add_option_int("-lg:message_flush",
+                        config.message_flush_bytes, !filter)
+        .add_option_int("-lg:message_delay",
+                        config.message_max_delay, !filter)
+        .add_option_int("-lg:message_coalesce",
+                        config.message_coalesce_mask, !filter)
         .add_option_int("-lg:epoch", config.gc_epoch_size, !filter)
         .add_option_int("-lg:local", config.max_local_fields, !filter)
         .add_option_int("-lg:parallel_replay", 
                         config.max_replay_parallelism, !filter)
         .add_option_bool("-lg:no_dyn",config.disable_independence_tests,!filter)
         .add_option_bool("-lg:spy",config.legion_spy_enabled, !filter)
+        .add_option_string("-lg:spy_logfile", config.spy_logfile, !filter)
         .add_option_bool("-lg:test",config.enable_test_mapper, !filter)
         .add_option_int("-lg:delay", config.delay_start, !filter)
         .add_option_string("-lg:replay", config.replay_file, !filter)
@@ -22281,6 +22472,8 @@ namespace Legion {
         .add_option_int("-lg:prof_footprint", 
                         config.prof_footprint_threshold, !filter)
         .add_option_int("-lg:prof_latency",config.prof_target_latency, !filter)
+        .add_option_int("-lg:prof_inflight", 
+                        config.prof_inflight_limit, !filter)
         .add_option_bool("-lg:debug_ok",config.slow_config_ok, !filter)
         // These are all the deprecated versions of these flag
         .add_option_bool("-hl:separate",
@@ -24313,6 +24506,11 @@ namespace Legion {
             break;
           }
 #endif
+        case LG_DEFER_MESSAGE_FLUSH_TASK_ID:
+          {
+            MessageManager::handle_deferred_flush(args);
+            break;
+          }
         case LG_YIELD_TASK_ID:
           break; // nothing to do here
         case LG_RETRY_SHUTDOWN_TASK_ID:
@@ -24323,6 +24521,11 @@ namespace Legion {
                                                shutdown_args->phase);
             break;
           }
+        case LG_PROFILER_WRITE_TASK_ID:
+          {
+            LegionProfStream::handle_write_chunks(args);
+            break;
+          }
         default:
           assert(false); // should never get here
       }
@@ -24467,6 +24670,22 @@ namespace Legion {
         rt->trace_free(a, size, elems);
     }
 
+#ifdef LEGION_SLAB_ALLOCATION
+    /*static*/ SlabAllocationStats *SlabAllocationStats::registry = NULL;
+
+    //--------------------------------------------------------------------------
+    void SlabAllocationStats::register_stats(const char *n, size_t size)
+    //--------------------------------------------------------------------------
+    {
+      name = n;
+      object_size = size;
+      registered = true;
+      do {
+        next = registry;
+      } while (!__sync_bool_compare_and_swap(&registry, next, this));
+    }
+#endif
+
     //--------------------------------------------------------------------------
     /*static*/ Runtime* LegionAllocation::find_runtime(void)
     //--------------------------------------------------------------------------
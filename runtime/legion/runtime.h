@@ -999,9 +999,38 @@ namespace Legion {
         unsigned messages;
         unsigned total;
       };
+      // Why we sent a buffer of messages
+      enum FlushReason {
+        EXPLICIT_FLUSH, // a message asked to be flushed
+        FULL_FLUSH, // the buffer was full
+        SIZE_FLUSH, // the buffer reached the flush size threshold
+        DELAY_FLUSH, // a message was buffered longer than the max delay
+        IDLE_FLUSH, // a deferred flush ran on an idle utility processor
+        LAST_FLUSH_REASON,
+      };
+      // Counters so we can see how well messages are being aggregated
+      struct MessageStatistics {
+      public:
+        MessageStatistics(void)
+          : messages(0), bytes(0), active_messages(0)
+          { for (unsigned idx = 0; idx < LAST_FLUSH_REASON; idx++)
+              flushes[idx] = 0; }
+      public:
+        inline void merge(const MessageStatistics &rhs)
+          { messages += rhs.messages; bytes += rhs.bytes;
+            active_messages += rhs.active_messages;
+            for (unsigned idx = 0; idx < LAST_FLUSH_REASON; idx++)
+              flushes[idx] += rhs.flushes[idx]; }
+      public:
+        unsigned long long messages;
+        unsigned long long bytes;
+        unsigned long long active_messages;
+        unsigned long long flushes[LAST_FLUSH_REASON];
+      };
     public:
       VirtualChannel(VirtualChannelKind kind,AddressSpaceID local_address_space,
-               size_t max_message_size, bool profile, LegionProfiler *profiler);
+               size_t max_message_size, bool profile, LegionProfiler *profiler,
+               size_t flush_bytes, long long max_delay, bool coalesce_flushes);
       VirtualChannel(const VirtualChannel &rhs);
       ~VirtualChannel(void);
     public:
@@ -1009,13 +1038,21 @@ namespace Legion {
     public:
       void package_message(Serializer &rez, MessageKind k, bool flush,
                            Runtime *runtime, Processor target, 
-                           bool response, bool shutdown);
+                           bool response, bool shutdown,
+                           MessageManager *manager);
       void process_message(const void *args, size_t arglen, 
                         Runtime *runtime, AddressSpaceID remote_address_space);
       void confirm_shutdown(ShutdownManager *shutdown_manager, bool phase_one);
+      void deferred_flush(FlushReason reason, 
+                          Runtime *runtime, Processor target);
+      void get_statistics(MessageStatistics &stats) const;
     private:
-      void send_message(bool complete, Runtime *runtime, Processor target, 
-                        MessageKind kind, bool response, bool shutdown);
+      void package_bytes(const char *buffer, size_t buffer_size,
+                         Runtime *runtime, Processor target, MessageKind kind,
+                         bool response, bool shutdown);
+      void send_message(bool complete, FlushReason reason, Runtime *runtime,
+                        Processor target, MessageKind kind, 
+                        bool response, bool shutdown);
       bool handle_messages(unsigned num_messages, Runtime *runtime, 
                            AddressSpaceID remote_address_space,
                            const char *args, size_t arglen) const;
@@ -1046,6 +1083,20 @@ namespace Legion {
       const LgPriority response_priority;
       static const unsigned MAX_UNORDERED_EVENTS = 32;
       std::set<RtEvent> unordered_events;
+    private:
+      // Adaptive flushing policy for this channel
+      const VirtualChannelKind channel_kind;
+      const size_t flush_index;
+      const long long max_delay;
+      const bool coalesce_flushes;
+      // Time when the oldest message in the buffer was packaged
+      long long first_buffered;
+      long long last_flush;
+      MessageKind last_kind;
+      bool buffered_response;
+      bool idle_flush_pending;
+      bool delay_flush_pending;
+      MessageStatistics statistics;
     private:
       // State for receiving messages
       // No lock for receiving messages since we know
@@ -1082,6 +1133,20 @@ namespace Legion {
      * before handling the message.
      */
     class MessageManager { 
+    public:
+      struct DeferMessageFlushArgs : public LgTaskArgs<DeferMessageFlushArgs> {
+      public:
+        static const LgTaskID TASK_ID = LG_DEFER_MESSAGE_FLUSH_TASK_ID;
+      public:
+        DeferMessageFlushArgs(MessageManager *m, VirtualChannelKind k,
+                              VirtualChannel::FlushReason r)
+          : LgTaskArgs<DeferMessageFlushArgs>(0), 
+            manager(m), channel(k), reason(r) { }
+      public:
+        MessageManager *const manager;
+        const VirtualChannelKind channel;
+        const VirtualChannel::FlushReason reason;
+      };
     public:
       MessageManager(AddressSpaceID remote, 
                      Runtime *rt, size_t max,
@@ -1097,6 +1162,10 @@ namespace Legion {
       void receive_message(const void *args, size_t arglen);
       void confirm_shutdown(ShutdownManager *shutdown_manager,
                             bool phase_one);
+      void get_statistics(VirtualChannelKind channel,
+                          VirtualChannel::MessageStatistics &stats) const;
+    public:
+      static void handle_deferred_flush(const void *args);
     private:
       VirtualChannel *const channels;
     public:
@@ -1550,6 +1619,9 @@ namespace Legion {
             initial_meta_task_vector_width(
                 LEGION_DEFAULT_META_TASK_VECTOR_WIDTH),
             max_message_size(LEGION_DEFAULT_MAX_MESSAGE_SIZE),
+            message_flush_bytes(LEGION_DEFAULT_MESSAGE_FLUSH_BYTES),
+            message_max_delay(LEGION_DEFAULT_MESSAGE_MAX_DELAY),
+            message_coalesce_mask(LEGION_DEFAULT_MESSAGE_COALESCE_MASK),
             gc_epoch_size(LEGION_DEFAULT_GC_EPOCH_SIZE),
             max_local_fields(LEGION_DEFAULT_LOCAL_FIELDS),
             max_replay_parallelism(LEGION_DEFAULT_MAX_REPLAY_PARALLELISM),
@@ -1587,7 +1659,8 @@ namespace Legion {
             num_profiling_nodes(0),
             serializer_type("binary"),
             prof_footprint_threshold(128 << 20),
-            prof_target_latency(100) { }
+            prof_target_latency(100),
+            prof_inflight_limit(64) { }
       public:
         int delay_start;
         mutable int legion_collective_radix;
@@ -1600,6 +1673,9 @@ namespace Legion {
         unsigned initial_tasks_to_schedule;
         unsigned initial_meta_task_vector_width;
         unsigned max_message_size;
+        unsigned message_flush_bytes;
+        unsigned message_max_delay;
+        unsigned message_coalesce_mask;
         unsigned gc_epoch_size;
         unsigned max_local_fields;
         unsigned max_replay_parallelism;
@@ -1625,8 +1701,10 @@ namespace Legion {
         bool disable_independence_tests;
         bool legion_spy_enabled;
         bool enable_test_mapper;
+        std::string spy_logfile;
         std::string replay_file;
         std::string ldb_file;
+        std::string trace_cache_directory;
         bool slow_config_ok;
 #ifdef DEBUG_LEGION
         bool logging_region_tree_state;
@@ -1641,6 +1719,7 @@ namespace Legion {
         std::string prof_logfile;
         size_t prof_footprint_threshold;
         size_t prof_target_latency;
+        size_t prof_inflight_limit;
       public:
         void configure_collective_settings(int total_spaces) const;
       };
@@ -1745,6 +1824,9 @@ namespace Legion {
       const unsigned initial_tasks_to_schedule;
       const unsigned initial_meta_task_vector_width;
       const unsigned max_message_size;
+      const unsigned message_flush_bytes;
+      const unsigned message_max_delay;
+      const unsigned message_coalesce_mask;
       const unsigned gc_epoch_size;
       const unsigned max_local_fields;
       const unsigned max_replay_parallelism;
@@ -1772,6 +1854,7 @@ namespace Legion {
       const bool enable_test_mapper;
       const bool legion_ldb_enabled;
       const std::string replay_file;
+      const std::string trace_cache_directory;
 #ifdef DEBUG_LEGION
       const bool logging_region_tree_state;
       const bool verbose_logging;
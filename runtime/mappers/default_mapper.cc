@@ -28,6 +28,10 @@
 #define STATIC_MAX_SCHEDULE_COUNT     8
 #define STATIC_MEMOIZE                false
 #define STATIC_MAP_LOCALLY            false
+#define STATIC_SLICE_CACHE_CAPACITY   1024
+#define STATIC_MAPPING_CACHE_CAPACITY 4096
+#define STATIC_PRINT_CACHE_STATS      false
+#define STATIC_BATCH_MAP_TASKS        false
 
 // This is the default implementation of the mapper interface for 
 // the general low level runtime
@@ -70,7 +74,11 @@ namespace Legion {
         stealing_enabled(STATIC_STEALING_ENABLED),
         max_schedule_count(STATIC_MAX_SCHEDULE_COUNT),
         memoize(STATIC_MEMOIZE),
-        map_locally(STATIC_MAP_LOCALLY)
+        map_locally(STATIC_MAP_LOCALLY),
+        slice_cache_capacity(STATIC_SLICE_CACHE_CAPACITY),
+        mapping_cache_capacity(STATIC_MAPPING_CACHE_CAPACITY),
+        batch_map_tasks(STATIC_BATCH_MAP_TASKS),
+        print_cache_stats(STATIC_PRINT_CACHE_STATS)
     //--------------------------------------------------------------------------
     {
       log_mapper.spew("Initializing the default mapper for "
@@ -100,10 +108,21 @@ namespace Legion {
           INT_ARG("-dm:sched", max_schedule_count);
           BOOL_ARG("-dm:memoize", memoize);
           BOOL_ARG("-dm:map_locally", map_locally);
+          INT_ARG("-dm:slice_cache", slice_cache_capacity);
+          INT_ARG("-dm:mapping_cache", mapping_cache_capacity);
+          BOOL_ARG("-dm:cache_stats", print_cache_stats);
+          BOOL_ARG("-dm:batch_map", batch_map_tasks);
 #undef BOOL_ARG
 #undef INT_ARG
         }
       }
+      gpu_slices_cache.set_capacity(slice_cache_capacity);
+      cpu_slices_cache.set_capacity(slice_cache_capacity);
+      io_slices_cache.set_capacity(slice_cache_capacity);
+      procset_slices_cache.set_capacity(slice_cache_capacity);
+      omp_slices_cache.set_capacity(slice_cache_capacity);
+      py_slices_cache.set_capacity(slice_cache_capacity);
+      cached_task_mappings.set_capacity(mapping_cache_capacity);
       if (stealing_enabled)
       {
         log_mapper.warning("Default mapper does not have a stealing algorithm "
@@ -320,6 +339,25 @@ namespace Legion {
     {
       log_mapper.spew("Deleting default mapper for processor " IDFMT "",
                   local_proc.id);
+      if (print_cache_stats)
+      {
+        print_cache_statistics("cpu slices", cpu_slices_cache.get_statistics(),
+                               cpu_slices_cache.size());
+        print_cache_statistics("gpu slices", gpu_slices_cache.get_statistics(),
+                               gpu_slices_cache.size());
+        print_cache_statistics("io slices", io_slices_cache.get_statistics(),
+                               io_slices_cache.size());
+        print_cache_statistics("procset slices", 
+                               procset_slices_cache.get_statistics(),
+                               procset_slices_cache.size());
+        print_cache_statistics("omp slices", omp_slices_cache.get_statistics(),
+                               omp_slices_cache.size());
+        print_cache_statistics("py slices", py_slices_cache.get_statistics(),
+                               py_slices_cache.size());
+        print_cache_statistics("task mappings", 
+                               cached_task_mappings.get_statistics(),
+                               cached_task_mappings.size());
+      }
       free(const_cast<char*>(mapper_name));
     }
 
@@ -332,6 +370,21 @@ namespace Legion {
       return *this;
     }
 
+    //--------------------------------------------------------------------------
+    void DefaultMapper::print_cache_statistics(const char *cache_name,
+                         const Utilities::CacheStatistics &stats,
+                               size_t entries) const
+    //--------------------------------------------------------------------------
+    {
+      // Skip caches that were never used to keep the output short
+      if ((stats.hits == 0) && (stats.misses == 0))
+        return;
+      log_mapper.print("%s %s cache: %llu hits, %llu misses, "
+                       "%llu evictions, %zu entries", get_mapper_name(),
+                       cache_name, stats.hits, stats.misses, 
+                       stats.evictions, entries);
+    }
+
     //--------------------------------------------------------------------------
     const char* DefaultMapper::get_mapper_name(void) const
     //--------------------------------------------------------------------------
@@ -347,6 +400,13 @@ namespace Legion {
       return SERIALIZED_REENTRANT_MAPPER_MODEL;
     }
 
+    //--------------------------------------------------------------------------
+    bool DefaultMapper::request_batched_map_task(void) const
+    //--------------------------------------------------------------------------
+    {
+      return batch_map_tasks;
+    }
+
     //--------------------------------------------------------------------------
     void DefaultMapper::select_task_options(const MapperContext    ctx,
                                             const Task&            task,
@@ -360,6 +420,11 @@ namespace Legion {
       // This is the best choice for the default mapper assuming
       // there is locality in the remote mapped tasks
       output.map_locally = map_locally;
+      // Points can only be mapped in batches if they don't need valid
+      // instances, the default mapper will find or create instances 
+      // for them anyway so it can do without them
+      if (batch_map_tasks && task.is_index_space)
+        output.valid_instances = false;
     }
 
     //--------------------------------------------------------------------------
@@ -1209,10 +1274,10 @@ namespace Legion {
         if(exset.processor_constraint.can_use(Processor::PROC_SET)) {
 
            // Before we do anything else, see if it is in the cache
-           std::map<Domain,std::vector<TaskSlice> >::const_iterator finder =
+           const std::vector<TaskSlice> *cached =
              procset_slices_cache.find(input.domain);
-           if (finder != procset_slices_cache.end()) {
-                   output.slices = finder->second;
+           if (cached != NULL) {
+                   output.slices = *cached;
                    return;
            }
 
@@ -1228,7 +1293,7 @@ namespace Legion {
           }
 
           // Save the result in the cache
-          procset_slices_cache[input.domain] = output.slices;
+          procset_slices_cache.insert(input.domain, output.slices);
           return;
         }
       }
@@ -1287,14 +1352,13 @@ namespace Legion {
                                            const std::vector<Processor> &remote,
                                            const SliceTaskInput& input,
                                                  SliceTaskOutput &output,
-                  std::map<Domain,std::vector<TaskSlice> > &cached_slices) const
+                                           SliceCache &cached_slices) const
     //--------------------------------------------------------------------------
     {
       // Before we do anything else, see if it is in the cache
-      std::map<Domain,std::vector<TaskSlice> >::const_iterator finder = 
-        cached_slices.find(input.domain);
-      if (finder != cached_slices.end()) {
-        output.slices = finder->second;
+      const std::vector<TaskSlice> *cached = cached_slices.find(input.domain);
+      if (cached != NULL) {
+        output.slices = *cached;
         return;
       }
 
@@ -1416,7 +1480,7 @@ namespace Legion {
 #endif
 
       // Save the result in the cache
-      cached_slices[input.domain] = output.slices;
+      cached_slices.insert(input.domain, output.slices);
     }
 
     //--------------------------------------------------------------------------
@@ -1431,6 +1495,37 @@ namespace Legion {
       // Get the variant that we are going to use to map this task
       VariantInfo chosen = default_find_preferred_variant(task, ctx,
                         true/*needs tight bound*/, true/*cache*/, target_kind);
+      default_map_task(ctx, task, chosen, input, output);
+    }
+
+    //--------------------------------------------------------------------------
+    void DefaultMapper::map_task_batch(const MapperContext        ctx,
+                                       const MapTaskBatchInput&   input,
+                                             MapTaskBatchOutput&  output)
+    //--------------------------------------------------------------------------
+    {
+      log_mapper.spew("Default map_task_batch in %s", get_mapper_name());
+      assert(input.tasks.size() == output.outputs.size());
+      if (input.tasks.empty())
+        return;
+      // All the points in a batch come from the same slice so they have
+      // the same task ID and kind of target processor which means we 
+      // only need to pick the variant once for the whole batch
+      const Task &first = *input.tasks.front();
+      VariantInfo chosen = default_find_preferred_variant(first, ctx,
+          true/*needs tight bound*/, true/*cache*/, first.target_proc.kind());
+      for (unsigned idx = 0; idx < input.tasks.size(); idx++)
+        default_map_task(ctx, *input.tasks[idx], chosen, 
+                         input.inputs[idx], output.outputs[idx]);
+    }
+
+    //--------------------------------------------------------------------------
+    void DefaultMapper::default_map_task(MapperContext ctx, const Task &task,
+                                         const VariantInfo &chosen,
+                                         const MapTaskInput &input,
+                                               MapTaskOutput &output)
+    //--------------------------------------------------------------------------
+    {
       output.chosen_variant = chosen.variant;
       output.task_priority = default_policy_select_task_priority(ctx, task);
       output.postmap_task = false;
@@ -1500,35 +1595,21 @@ namespace Legion {
 
       // First, let's see if we've cached a result of this task mapping
       const unsigned long long task_hash = compute_task_hash(task);
-      std::pair<TaskID,Processor> cache_key(task.task_id, task.target_proc);
-      std::map<std::pair<TaskID,Processor>,
-               std::list<CachedTaskMapping> >::const_iterator 
-        finder = cached_task_mappings.find(cache_key);
+      const CachedTaskKey cache_key(task.task_id, task.target_proc,
+                                    output.chosen_variant, task_hash);
       // This flag says whether we need to recheck the field constraints,
       // possibly because a new field was allocated in a region, so our old
       // cached physical instance(s) is(are) no longer valid
       bool needs_field_constraint_check = false;
-      if (cache_policy == DEFAULT_CACHE_POLICY_ENABLE && finder != cached_task_mappings.end())
+      if (cache_policy == DEFAULT_CACHE_POLICY_ENABLE)
       {
-        bool found = false;
-        bool has_reductions = false;
-        // Iterate through and see if we can find one with our variant and hash
-        for (std::list<CachedTaskMapping>::const_iterator it = 
-              finder->second.begin(); it != finder->second.end(); it++)
-        {
-          if ((it->variant == output.chosen_variant) &&
-              (it->task_hash == task_hash))
-          {
-            // Have to copy it before we do the external call which 
-            // might invalidate our iterator
-            output.chosen_instances = it->mapping;
-            has_reductions = it->has_reductions;
-            found = true;
-            break;
-          }
-        }
-        if (found)
+        const CachedTaskMapping *cached = cached_task_mappings.find(cache_key);
+        if (cached != NULL)
         {
+          // Have to copy it before we do the external call which 
+          // might invalidate our pointer
+          output.chosen_instances = cached->mapping;
+          const bool has_reductions = cached->has_reductions;
           // If we have reductions, make those instances now since we
           // never cache the reduction instances
           if (has_reductions)
@@ -1567,8 +1648,7 @@ namespace Legion {
           // If some of them were deleted, go back and remove this entry
           // Have to renew our iterators since they might have been
           // invalidated during the 'acquire_and_filter_instances' call
-          default_remove_cached_task(ctx, output.chosen_variant,
-                        task_hash, cache_key, output.chosen_instances);
+          default_remove_cached_task(ctx, cache_key, output.chosen_instances);
         }
       }
       // We didn't find a cached version of the mapping so we need to 
@@ -1666,9 +1746,7 @@ namespace Legion {
       }
       if (cache_policy == DEFAULT_CACHE_POLICY_ENABLE) {
         // Now that we are done, let's cache the result so we can use it later
-        std::list<CachedTaskMapping> &map_list = cached_task_mappings[cache_key];
-        map_list.push_back(CachedTaskMapping());
-        CachedTaskMapping &cached_result = map_list.back();
+        CachedTaskMapping cached_result;
         cached_result.task_hash = task_hash;
         cached_result.variant = output.chosen_variant;
         cached_result.mapping = output.chosen_instances;
@@ -1681,6 +1759,24 @@ namespace Legion {
             cached_result.mapping[idx].clear();
           }
         }
+        std::vector<CachedTaskMapping> evicted;
+        cached_task_mappings.insert(cache_key, cached_result, &evicted);
+        // Downgrade the garbage collection priorities of the instances
+        // in any mappings that we no longer have room to cache
+        for (std::vector<CachedTaskMapping>::const_iterator eit =
+              evicted.begin(); eit != evicted.end(); eit++)
+        {
+          for (unsigned idx1 = 0; idx1 < eit->mapping.size(); idx1++)
+          {
+            for (unsigned idx2 = 0; idx2 < eit->mapping[idx1].size(); idx2++)
+            {
+              const PhysicalInstance &inst = eit->mapping[idx1][idx2];
+              if (inst.is_external_instance())
+                continue;
+              runtime->set_garbage_collection_priority(ctx, inst, 0/*prio*/);
+            }
+          }
+        }
       }
     }
 
@@ -1785,68 +1881,54 @@ namespace Legion {
 
     //--------------------------------------------------------------------------
     void DefaultMapper::default_remove_cached_task(MapperContext ctx,
-        VariantID chosen_variant, unsigned long long task_hash,
-        const std::pair<TaskID,Processor> &cache_key,
+        const CachedTaskKey &cache_key,
         const std::vector<std::vector<PhysicalInstance> > &post_filter)
     //--------------------------------------------------------------------------
     {
-      std::map<std::pair<TaskID,Processor>,
-               std::list<CachedTaskMapping> >::iterator
-                 finder = cached_task_mappings.find(cache_key);
-      if (finder != cached_task_mappings.end())
+      const CachedTaskMapping *cached = cached_task_mappings.peek(cache_key);
+      if (cached != NULL)
       {
         // Keep a list of instances for which we need to downgrade
         // their garbage collection priorities since we are no
         // longer caching the results
         std::deque<PhysicalInstance> to_downgrade;
-        for (std::list<CachedTaskMapping>::iterator it = 
-              finder->second.begin(); it != finder->second.end(); it++)
+        // Record all the instances for which we will need to
+        // down grade their garbage collection priority 
+        for (unsigned idx1 = 0; (idx1 < cached->mapping.size()) &&
+              (idx1 < post_filter.size()); idx1++)
         {
-          if ((it->variant == chosen_variant) &&
-              (it->task_hash == task_hash))
+          if (!cached->mapping[idx1].empty())
           {
-            // Record all the instances for which we will need to
-            // down grade their garbage collection priority 
-            for (unsigned idx1 = 0; (idx1 < it->mapping.size()) &&
-                  (idx1 < post_filter.size()); idx1++)
-            {
-              if (!it->mapping[idx1].empty())
+            if (!post_filter[idx1].empty()) {
+              // Still all the same
+              if (post_filter[idx1].size() == cached->mapping[idx1].size())
+                continue;
+              // See which ones are no longer in our set
+              for (unsigned idx2 = 0; 
+                    idx2 < cached->mapping[idx1].size(); idx2++)
               {
-                if (!post_filter[idx1].empty()) {
-                  // Still all the same
-                  if (post_filter[idx1].size() == it->mapping[idx1].size())
-                    continue;
-                  // See which ones are no longer in our set
-                  for (unsigned idx2 = 0; 
-                        idx2 < it->mapping[idx1].size(); idx2++)
+                PhysicalInstance current = cached->mapping[idx1][idx2];
+                bool still_valid = false;
+                for (unsigned idx3 = 0; 
+                      idx3 < post_filter[idx1].size(); idx3++)
+                {
+                  if (current == post_filter[idx1][idx3]) 
                   {
-                    PhysicalInstance current = it->mapping[idx1][idx2];
-                    bool still_valid = false;
-                    for (unsigned idx3 = 0; 
-                          idx3 < post_filter[idx1].size(); idx3++)
-                    {
-                      if (current == post_filter[idx1][idx3]) 
-                      {
-                        still_valid = true;
-                        break;
-                      }
-                    }
-                    if (!still_valid)
-                      to_downgrade.push_back(current);
+                    still_valid = true;
+                    break;
                   }
-                } else {
-                  // if the chosen instances are empty, record them all
-                  to_downgrade.insert(to_downgrade.end(),
-                      it->mapping[idx1].begin(), it->mapping[idx1].end());
                 }
+                if (!still_valid)
+                  to_downgrade.push_back(current);
               }
+            } else {
+              // if the chosen instances are empty, record them all
+              to_downgrade.insert(to_downgrade.end(),
+                  cached->mapping[idx1].begin(), cached->mapping[idx1].end());
             }
-            finder->second.erase(it);
-            break;
           }
         }
-        if (finder->second.empty())
-          cached_task_mappings.erase(finder);
+        cached_task_mappings.erase(cache_key);
         if (!to_downgrade.empty())
         {
           for (std::deque<PhysicalInstance>::const_iterator it =
@@ -111,6 +111,40 @@ namespace Legion {
         std::vector<std::vector<PhysicalInstance> > mapping;
         bool                                        has_reductions;
       };
+      struct CachedTaskKey {
+      public:
+        CachedTaskKey(void) 
+          : task_id(0), variant(0), task_hash(0) { }
+        CachedTaskKey(TaskID tid, Processor p, VariantID vid,
+                      unsigned long long hash)
+          : task_id(tid), target_proc(p), variant(vid), task_hash(hash) { }
+      public:
+        inline bool operator==(const CachedTaskKey &rhs) const
+          { return (task_id == rhs.task_id) && 
+                   (target_proc == rhs.target_proc) &&
+                   (variant == rhs.variant) && 
+                   (task_hash == rhs.task_hash); }
+      public:
+        TaskID                                      task_id;
+        Processor                                   target_proc;
+        VariantID                                   variant;
+        unsigned long long                          task_hash;
+      };
+      struct CachedTaskKeyHash {
+      public:
+        inline size_t operator()(const CachedTaskKey &key) const
+        {
+          size_t result = key.task_hash;
+          result = result * 0x9E3779B97F4A7C15ULL + key.task_id;
+          result = result * 0x9E3779B97F4A7C15ULL + key.target_proc.id;
+          result = result * 0x9E3779B97F4A7C15ULL + key.variant;
+          return (result ^ (result >> 29));
+        }
+      };
+      typedef Utilities::LRUCache<Domain,std::vector<TaskSlice>,
+                                  Utilities::DomainHash> SliceCache;
+      typedef Utilities::LRUCache<CachedTaskKey,CachedTaskMapping,
+                                  CachedTaskKeyHash> TaskMappingCache;
       struct MapperMsgHdr {
       public:
         MapperMsgHdr(void) : magic(0xABCD), type(INVALID_MESSAGE) { }
@@ -137,6 +171,7 @@ namespace Legion {
     public:
       virtual const char* get_mapper_name(void) const;
       virtual MapperSyncModel get_mapper_sync_model(void) const;
+      virtual bool request_batched_map_task(void) const;
     public: // Task mapping calls
       virtual void select_task_options(const MapperContext    ctx,
                                        const Task&            task,
@@ -153,6 +188,9 @@ namespace Legion {
                             const Task&              task,
                             const MapTaskInput&      input,
                                   MapTaskOutput&     output);
+      virtual void map_task_batch(const MapperContext        ctx,
+                                  const MapTaskBatchInput&   input,
+                                        MapTaskBatchOutput&  output);
       virtual void select_task_variant(const MapperContext          ctx,
                                        const Task&                  task,
                                        const SelectVariantInput&    input,
@@ -387,12 +425,15 @@ namespace Legion {
                                  const Task &task, MapperContext ctx,
                                  bool needs_tight_bound, bool cache = true,
                                  Processor::Kind kind = Processor::NO_KIND);
+      void default_map_task(MapperContext ctx, const Task &task,
+                            const VariantInfo &chosen,
+                            const MapTaskInput &input, MapTaskOutput &output);
       void default_slice_task(const Task &task,
                               const std::vector<Processor> &local_procs,
                               const std::vector<Processor> &remote_procs,
                               const SliceTaskInput &input,
                                     SliceTaskOutput &output,
-            std::map<Domain,std::vector<TaskSlice> > &cached_slices) const;
+                              SliceCache &cached_slices) const;
       bool default_create_custom_instances(MapperContext ctx, 
                               Processor target, Memory target_memory,
                               const RegionRequirement &req, unsigned index,
@@ -410,9 +451,8 @@ namespace Legion {
       void default_report_failed_instance_creation(const Task &task, 
                               unsigned index, Processor target_proc, 
                               Memory target_memory, size_t footprint = 0) const;
-      void default_remove_cached_task(MapperContext ctx, VariantID variant,
-                              unsigned long long task_hash,
-                              const std::pair<TaskID,Processor> &cache_key,
+      void default_remove_cached_task(MapperContext ctx,
+                              const CachedTaskKey &cache_key,
                               const std::vector<
                                 std::vector<PhysicalInstance> > &post_filter);
       template<bool IS_SRC>
@@ -444,6 +484,9 @@ namespace Legion {
       static Point<DIM,coord_t> default_select_num_blocks(
                             long long int factor, 
                             const Rect<DIM,coord_t> &rect_to_factor);
+      void print_cache_statistics(const char *cache_name,
+                              const Utilities::CacheStatistics &stats,
+                              size_t entries) const;
       static unsigned long long compute_task_hash(const Task &task);
       static inline bool physical_sort_func(
                          const std::pair<PhysicalInstance,unsigned> &left,
@@ -486,7 +529,9 @@ namespace Legion {
                               *global_omp_query, *global_py_query;
     protected: 
       // Cached mapping information about the application
-      std::map<Domain,std::vector<TaskSlice> > gpu_slices_cache,
+      // The slice and task mapping caches are bounded by -dm:slice_cache
+      // and -dm:mapping_cache and evict their least recently used entries
+      SliceCache                               gpu_slices_cache,
                                                cpu_slices_cache,
                                                io_slices_cache,
                                                procset_slices_cache,
@@ -494,8 +539,7 @@ namespace Legion {
                                                py_slices_cache;
       std::map<std::pair<TaskID,Processor::Kind>,
                VariantInfo>                    preferred_variants;
-      std::map<std::pair<TaskID,Processor>,
-               std::list<CachedTaskMapping> >  cached_task_mappings;
+      TaskMappingCache                         cached_task_mappings;
       std::map<std::pair<Memory::Kind,FieldSpace>,
                LayoutConstraintID>             layout_constraint_cache;
       std::map<std::pair<Memory::Kind,ReductionOpID>,
@@ -522,6 +566,18 @@ namespace Legion {
       // Whether to map tasks locally
       // Controlled by -dm:map_locally (false by default)
       bool map_locally;
+      // The maximum number of domains in each of the slice caches
+      // Controlled by -dm:slice_cache (0 means unbounded)
+      unsigned slice_cache_capacity;
+      // The maximum number of cached task mappings
+      // Controlled by -dm:mapping_cache (0 means unbounded)
+      unsigned mapping_cache_capacity;
+      // Map all the points of a slice with one map_task_batch call
+      // Controlled by -dm:batch_map (false by default)
+      bool batch_map_tasks;
+      // Print the cache statistics when the mapper is deleted
+      // Controlled by -dm:cache_stats (false by default)
+      bool print_cache_stats;
     };
 
   }; // namespace Mapping
@@ -282,6 +282,108 @@ namespace Legion {
         OptionMap profiling_options;
       };
 
+      /**
+       * Statistics about how well an LRUCache is working
+       */
+      struct CacheStatistics {
+      public:
+        CacheStatistics(void) : hits(0), misses(0), evictions(0) { }
+      public:
+        unsigned long long hits;
+        unsigned long long misses;
+        unsigned long long evictions;
+      };
+
+      /**
+       * A bounded cache that evicts its least recently used entry
+       * once it holds more than its capacity. Entries are found
+       * through a hash table using the HASH functor on the keys,
+       * which must also support operator==. The cache keeps
+       * statistics of its hits, misses, and evictions. A capacity
+       * of zero means the cache is unbounded.
+       */
+      template<typename KEY, typename VALUE, typename HASH>
+      class LRUCache {
+      public:
+        typedef CacheStatistics Statistics;
+      public:
+        LRUCache(size_t capacity = 0);
+        LRUCache(const LRUCache &rhs);
+        ~LRUCache(void);
+      public:
+        LRUCache& operator=(const LRUCache &rhs);
+      public:
+        /**
+         * Look up an entry in the cache and make it the most recently
+         * used one. Returns NULL if the entry is not in the cache.
+         */
+        inline VALUE* find(const KEY &key);
+        /**
+         * Look up an entry without counting it in the statistics
+         * or changing its position in the eviction order.
+         */
+        inline VALUE* peek(const KEY &key) const;
+        /**
+         * Add or replace an entry in the cache and make it the most
+         * recently used one. Values of any evicted entries are 
+         * appended to the evicted vector if it is provided.
+         */
+        inline VALUE& insert(const KEY &key, const VALUE &value,
+                             std::vector<VALUE> *evicted = NULL);
+        inline bool erase(const KEY &key);
+        inline void clear(void);
+      public:
+        inline size_t size(void) const { return num_entries; }
+        inline size_t get_capacity(void) const { return capacity; }
+        void set_capacity(size_t capacity, 
+                          std::vector<VALUE> *evicted = NULL);
+        inline const Statistics& get_statistics(void) const { return stats; }
+      protected:
+        struct Entry {
+        public:
+          Entry(const KEY &k, const VALUE &v, size_t h)
+            : key(k), value(v), hash(h), 
+              prev(NULL), next(NULL), chain(NULL) { }
+        public:
+          const KEY key;
+          VALUE value;
+          const size_t hash;
+          // Doubly linked list from most to least recently used
+          Entry *prev, *next;
+          // Next entry in the same hash bucket
+          Entry *chain;
+        };
+      protected:
+        inline Entry* find_entry(const KEY &key, size_t hash) const;
+        inline void unlink_entry(Entry *entry);
+        inline void push_front(Entry *entry);
+        inline void remove_entry(Entry *entry);
+        void evict_entries(std::vector<VALUE> *evicted);
+        void rehash(size_t num_buckets);
+      protected:
+        HASH hasher;
+        std::vector<Entry*> buckets;
+        Entry *head, *tail;
+        size_t num_entries;
+        size_t capacity;
+        Statistics stats;
+      };
+
+      /**
+       * Hash functor for using Domains as keys in an LRUCache
+       */
+      struct DomainHash {
+      public:
+        inline size_t operator()(const Domain &d) const
+        {
+          size_t result = d.is_id;
+          result = result * 0x9E3779B97F4A7C15ULL + d.get_dim();
+          for (int i = 0; i < (2 * d.get_dim()); i++)
+            result = result * 0x9E3779B97F4A7C15ULL + d.rect_data[i];
+          return (result ^ (result >> 29));
+        }
+      };
+
       // Functions for printing various runtime objects to strings from inside a
       // mapper.
 
@@ -323,6 +425,237 @@ namespace Legion {
                             const MapperContext ctx,
                             const Task& task);
 
+      //------------------------------------------------------------------------
+      template<typename KEY, typename VALUE, typename HASH>
+      LRUCache<KEY,VALUE,HASH>::LRUCache(size_t cap)
+        : buckets(16, NULL), head(NULL), tail(NULL), 
+          num_entries(0), capacity(cap)
+      //------------------------------------------------------------------------
+      {
+      }
+
+      //------------------------------------------------------------------------
+      template<typename KEY, typename VALUE, typename HASH>
+      LRUCache<KEY,VALUE,HASH>::LRUCache(const LRUCache &rhs)
+        : head(NULL), tail(NULL), num_entries(0), capacity(0)
+      //------------------------------------------------------------------------
+      {
+        // should never be called
+        assert(false);
+      }
+
+      //------------------------------------------------------------------------
+      template<typename KEY, typename VALUE, typename HASH>
+      LRUCache<KEY,VALUE,HASH>::~LRUCache(void)
+      //------------------------------------------------------------------------
+      {
+        clear();
+      }
+
+      //------------------------------------------------------------------------
+      template<typename KEY, typename VALUE, typename HASH>
+      LRUCache<KEY,VALUE,HASH>& LRUCache<KEY,VALUE,HASH>::operator=(
+                                                        const LRUCache &rhs)
+      //------------------------------------------------------------------------
+      {
+        // should never be called
+        assert(false);
+        return *this;
+      }
+
+      //------------------------------------------------------------------------
+      template<typename KEY, typename VALUE, typename HASH>
+      inline VALUE* LRUCache<KEY,VALUE,HASH>::find(const KEY &key)
+      //------------------------------------------------------------------------
+      {
+        Entry *entry = find_entry(key, hasher(key));
+        if (entry == NULL)
+        {
+          stats.misses++;
+          return NULL;
+        }
+        stats.hits++;
+        if (entry != head)
+        {
+          unlink_entry(entry);
+          push_front(entry);
+        }
+        return &entry->value;
+      }
+
+      //------------------------------------------------------------------------
+      template<typename KEY, typename VALUE, typename HASH>
+      inline VALUE* LRUCache<KEY,VALUE,HASH>::peek(const KEY &key) const
+      //------------------------------------------------------------------------
+      {
+        Entry *entry = find_entry(key, hasher(key));
+        if (entry == NULL)
+          return NULL;
+        return &entry->value;
+      }
+
+      //------------------------------------------------------------------------
+      template<typename KEY, typename VALUE, typename HASH>
+      inline VALUE& LRUCache<KEY,VALUE,HASH>::insert(const KEY &key,
+                          const VALUE &value, std::vector<VALUE> *evicted)
+      //------------------------------------------------------------------------
+      {
+        const size_t hash = hasher(key);
+        Entry *entry = find_entry(key, hash);
+        if (entry != NULL)
+        {
+          entry->value = value;
+          if (entry != head)
+          {
+            unlink_entry(entry);
+            push_front(entry);
+          }
+          return entry->value;
+        }
+        entry = new Entry(key, value, hash);
+        push_front(entry);
+        Entry *&bucket = buckets[hash & (buckets.size() - 1)];
+        entry->chain = bucket;
+        bucket = entry;
+        num_entries++;
+        // The new entry is the most recently used so it is never evicted
+        if ((capacity > 0) && (num_entries > capacity))
+          evict_entries(evicted);
+        if (num_entries > buckets.size())
+          rehash(2 * buckets.size());
+        return entry->value;
+      }
+
+      //------------------------------------------------------------------------
+      template<typename KEY, typename VALUE, typename HASH>
+      inline bool LRUCache<KEY,VALUE,HASH>::erase(const KEY &key)
+      //------------------------------------------------------------------------
+      {
+        Entry *entry = find_entry(key, hasher(key));
+        if (entry == NULL)
+          return false;
+        remove_entry(entry);
+        return true;
+      }
+
+      //------------------------------------------------------------------------
+      template<typename KEY, typename VALUE, typename HASH>
+      inline void LRUCache<KEY,VALUE,HASH>::clear(void)
+      //------------------------------------------------------------------------
+      {
+        while (head != NULL)
+        {
+          Entry *next = head->next;
+          delete head;
+          head = next;
+        }
+        tail = NULL;
+        num_entries = 0;
+        for (unsigned idx = 0; idx < buckets.size(); idx++)
+          buckets[idx] = NULL;
+      }
+
+      //------------------------------------------------------------------------
+      template<typename KEY, typename VALUE, typename HASH>
+      void LRUCache<KEY,VALUE,HASH>::set_capacity(size_t cap,
+                                                  std::vector<VALUE> *evicted)
+      //------------------------------------------------------------------------
+      {
+        capacity = cap;
+        if ((capacity > 0) && (num_entries > capacity))
+          evict_entries(evicted);
+      }
+
+      //------------------------------------------------------------------------
+      template<typename KEY, typename VALUE, typename HASH>
+      inline typename LRUCache<KEY,VALUE,HASH>::Entry* 
+        LRUCache<KEY,VALUE,HASH>::find_entry(const KEY &key, size_t hash) const
+      //------------------------------------------------------------------------
+      {
+        for (Entry *entry = buckets[hash & (buckets.size() - 1)]; 
+              entry != NULL; entry = entry->chain)
+          if ((entry->hash == hash) && (entry->key == key))
+            return entry;
+        return NULL;
+      }
+
+      //------------------------------------------------------------------------
+      template<typename KEY, typename VALUE, typename HASH>
+      inline void LRUCache<KEY,VALUE,HASH>::unlink_entry(Entry *entry)
+      //------------------------------------------------------------------------
+      {
+        if (entry->prev != NULL)
+          entry->prev->next = entry->next;
+        else
+          head = entry->next;
+        if (entry->next != NULL)
+          entry->next->prev = entry->prev;
+        else
+          tail = entry->prev;
+        entry->prev = NULL;
+        entry->next = NULL;
+      }
+
+      //------------------------------------------------------------------------
+      template<typename KEY, typename VALUE, typename HASH>
+      inline void LRUCache<KEY,VALUE,HASH>::push_front(Entry *entry)
+      //------------------------------------------------------------------------
+      {
+        entry->prev = NULL;
+        entry->next = head;
+        if (head != NULL)
+          head->prev = entry;
+        else
+          tail = entry;
+        head = entry;
+      }
+
+      //------------------------------------------------------------------------
+      template<typename KEY, typename VALUE, typename HASH>
+      inline void LRUCache<KEY,VALUE,HASH>::remove_entry(Entry *entry)
+      //------------------------------------------------------------------------
+      {
+        unlink_entry(entry);
+        Entry **prev = &buckets[entry->hash & (buckets.size() - 1)];
+        while (*prev != entry)
+          prev = &((*prev)->chain);
+        *prev = entry->chain;
+        num_entries--;
+        delete entry;
+      }
+
+      //------------------------------------------------------------------------
+      template<typename KEY, typename VALUE, typename HASH>
+      void LRUCache<KEY,VALUE,HASH>::evict_entries(std::vector<VALUE> *evicted)
+      //------------------------------------------------------------------------
+      {
+        while (num_entries > capacity)
+        {
+#ifdef DEBUG_LEGION
+          assert(tail != NULL);
+#endif
+          if (evicted != NULL)
+            evicted->push_back(tail->value);
+          remove_entry(tail);
+          stats.evictions++;
+        }
+      }
+
+      //------------------------------------------------------------------------
+      template<typename KEY, typename VALUE, typename HASH>
+      void LRUCache<KEY,VALUE,HASH>::rehash(size_t num_buckets)
+      //------------------------------------------------------------------------
+      {
+        std::vector<Entry*> new_buckets(num_buckets, NULL);
+        for (Entry *entry = head; entry != NULL; entry = entry->next)
+        {
+          Entry *&bucket = new_buckets[entry->hash & (num_buckets - 1)];
+          entry->chain = bucket;
+          bucket = entry;
+        }
+        buckets.swap(new_buckets);
+      }
+
     }; // namespace Utilities
   }; // namespace Mapping
 }; // namespace Legion
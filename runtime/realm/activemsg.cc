@@ -104,7 +104,7 @@ void SpanPayload::copy_data(void *dest)
 //
 
   ActiveMessageHandlerStats::ActiveMessageHandlerStats(void)
-    : count(0), sum(0), sum2(0), minval(0), maxval(0)
+    : count(0), sum(0), sum2(0), minval(0), maxval(0), batched(0)
   {}
 
   void ActiveMessageHandlerStats::record(long long t_start, long long t_end)
@@ -120,6 +120,11 @@ void SpanPayload::copy_data(void *dest)
     sum2 += val * val; // TODO: smarter math to avoid overflow
   }
 
+  void ActiveMessageHandlerStats::record_batch(size_t batch_size)
+  {
+    batched.fetch_add(batch_size);
+  }
+
 
 ////////////////////////////////////////////////////////////////////////
 //
@@ -158,6 +163,13 @@ void ActiveMessageHandlerTable::record_message_handler_call(MessageID id,
   handlers[id].stats.record(t_start, t_end);
 }
 
+void ActiveMessageHandlerTable::record_message_batch(MessageID id,
+						     size_t batch_size)
+{
+  assert(id < handlers.size());
+  handlers[id].stats.record_batch(batch_size);
+}
+
 void ActiveMessageHandlerTable::report_message_handler_stats()
 {
   if(Config::profile_activemsg_handlers) {
@@ -169,12 +181,17 @@ void ActiveMessageHandlerTable::report_message_handler_stats()
       double avg = double(stats.sum) / double(stats.count);
       double stddev = sqrt((double(stats.sum2) / double(stats.count)) -
 			   (avg * avg));
-      log_amhandler.print() << "handler " << std::hex << i << std::dec << ": " << handlers[i].name
-			    << " count=" << stats.count
-			    << " avg=" << avg
-			    << " dev=" << stddev
-			    << " min=" << stats.minval
-			    << " max=" << stats.maxval;
+      LoggerMessage msg(log_amhandler.print());
+      msg << "handler " << std::hex << i << std::dec << ": " << handlers[i].name
+	  << " count=" << stats.count
+	  << " avg=" << avg
+	  << " dev=" << stddev
+	  << " min=" << stats.minval
+	  << " max=" << stats.maxval;
+      size_t batched = stats.batched.load();
+      if(batched > 0)
+	msg << " batched=" << batched
+	    << " per_msg=" << (double(batched) / double(stats.count));
     }
   }
 }
@@ -21,6 +21,7 @@
 
 #include "realm/realm_config.h"
 #include "realm/mutex.h"
+#include "realm/atomics.h"
 #include "realm/serialize.h"
 #include "realm/nodeset.h"
 #include "realm/network.h"
@@ -101,9 +102,14 @@ class ActiveMessageHandlerRegBase;
 
 struct ActiveMessageHandlerStats {
   size_t count, sum, sum2, minval, maxval;
+  // for messages that carry several coalesced requests, the total number of
+  //  requests delivered - unlike the timing stats, this is updated by
+  //  every handler thread and has to be atomic
+  atomic<size_t> batched;
 
   ActiveMessageHandlerStats(void);
   void record(long long t_start, long long t_end);
+  void record_batch(size_t batch_size);
 };
 
 // singleton class that can convert message type->ID and ID->handler
@@ -123,6 +129,7 @@ public:
   const char *lookup_message_name(MessageID id);
   void record_message_handler_call(MessageID id,
 				   long long t_start, long long t_end);
+  void record_message_batch(MessageID id, size_t batch_size);
   void report_message_handler_stats();
 
   static void append_handler_reg(ActiveMessageHandlerRegBase *new_reg);
@@ -102,53 +102,220 @@ namespace Realm {
     sparsity_outputs[_val] = _sparsity;
   }
 
+  namespace {
+
+    // integer field values can index a dense table of colors - other field
+    //  types (e.g. points) always go through the map
+    template <typename FT>
+    struct DenseColorIndex {
+      static bool range(const FT& lo, const FT& hi, size_t& count) { return false; }
+      static bool index(const FT& val, const FT& lo, size_t count, size_t& idx) { return false; }
+    };
+
+#define INTEGER_CASE(IT) \
+    template <> \
+    struct DenseColorIndex<IT> { \
+      static bool range(IT lo, IT hi, size_t& count) \
+      { \
+        count = size_t((long long)hi - (long long)lo) + 1; \
+        return true; \
+      } \
+      static bool index(IT val, IT lo, size_t count, size_t& idx) \
+      { \
+        if(val < lo) return false; \
+        idx = size_t((long long)val - (long long)lo); \
+        return (idx < count); \
+      } \
+    }
+    INTEGER_CASE(int);
+    INTEGER_CASE(unsigned);
+    INTEGER_CASE(long long);
+#undef INTEGER_CASE
+
+    // finds the bitmask for each field value - remembers the most recent
+    //  value (runs of equal values are common) and uses an array instead of
+    //  the map when the requested colors are a small dense range of integers
+    template <int N, typename T, typename FT, typename BM>
+    class ByFieldBitmaskTable {
+    public:
+      // if 'outputs_only' is set, values that aren't in 'outputs' are
+      //  ignored - otherwise a bitmask is created for every value seen
+      ByFieldBitmaskTable(std::map<FT, BM *>& _bitmasks,
+			  const std::map<FT, SparsityMap<N,T> >& outputs,
+			  bool _outputs_only)
+	: bitmasks(_bitmasks)
+	, outputs_only(_outputs_only)
+	, last_slot(0)
+	, dense_count(0)
+      {
+	if(outputs_only) {
+	  // create (empty) entries for every output so that we can hold on
+	  //  to their addresses
+	  for(typename std::map<FT, SparsityMap<N,T> >::const_iterator it = outputs.begin();
+	      it != outputs.end();
+	      ++it)
+	    bitmasks[it->first] = 0;
+
+	  size_t count;
+	  if(!bitmasks.empty() &&
+	     DenseColorIndex<FT>::range(bitmasks.begin()->first,
+					bitmasks.rbegin()->first, count) &&
+	     (count <= (4 * bitmasks.size() + 64))) {
+	    dense_lo = bitmasks.begin()->first;
+	    dense_count = count;
+	    dense_slots.assign(count, 0);
+	    for(typename std::map<FT, BM *>::iterator it = bitmasks.begin();
+		it != bitmasks.end();
+		++it) {
+	      size_t idx;
+	      bool ok = DenseColorIndex<FT>::index(it->first, dense_lo,
+						   dense_count, idx);
+	      assert(ok);
+	      dense_slots[idx] = &(it->second);
+	    }
+	  }
+	}
+      }
+
+      void add_rect(const FT& val, const Rect<N,T>& r)
+      {
+	if(!last_slot || !(val == last_val)) {
+	  last_slot = lookup(val);
+	  last_val = val;
+	}
+	if(last_slot) {
+	  if(!*last_slot) *last_slot = new BM;
+	  (*last_slot)->add_rect(r);
+	}
+      }
+
+    protected:
+      BM **lookup(const FT& val)
+      {
+	if(dense_count > 0) {
+	  size_t idx;
+	  if(DenseColorIndex<FT>::index(val, dense_lo, dense_count, idx))
+	    return dense_slots[idx];
+	  else
+	    return 0;
+	}
+	if(outputs_only) {
+	  typename std::map<FT, BM *>::iterator it = bitmasks.find(val);
+	  return ((it != bitmasks.end()) ? &(it->second) : 0);
+	} else
+	  return &bitmasks[val];
+      }
+
+      std::map<FT, BM *>& bitmasks;
+      bool outputs_only;
+      FT last_val;
+      BM **last_slot;
+      FT dense_lo;
+      size_t dense_count;
+      std::vector<BM **> dense_slots;
+    };
+
+    // returns the number of entries (at least 1) starting at 'vals' that
+    //  are equal to vals[0]
+    template <typename FT>
+    size_t find_run_length(const FT *vals, size_t count)
+    {
+      static const size_t BLOCK = 16;
+      const FT val = vals[0];
+      size_t i = 1;
+      // short runs are common, so check the first block one value at a time
+      while((i < count) && (i < BLOCK)) {
+	if(!(vals[i] == val)) return i;
+	i++;
+      }
+      // long run - compare whole blocks, with no early exit from the inner
+      //  loop so that the compiler can vectorize it
+      while((i + BLOCK) <= count) {
+	bool diff = false;
+	for(size_t j = 0; j < BLOCK; j++)
+	  diff |= !(vals[i + j] == val);
+	if(diff) break;
+	i += BLOCK;
+      }
+      while((i < count) && (vals[i] == val))
+	i++;
+      return i;
+    }
+
+  };
+
   template <int N, typename T, typename FT>
   template <typename BM>
-  void ByFieldMicroOp<N,T,FT>::populate_bitmasks(std::map<FT, BM *>& bitmasks)
+  void ByFieldMicroOp<N,T,FT>::populate_bitmasks(std::map<FT, BM *>& bitmasks,
+						 bool outputs_only)
   {
     // for now, one access for the whole instance
     AffineAccessor<FT,N,T> a_data(inst, field_offset);
 
+    ByFieldBitmaskTable<N,T,FT,BM> table(bitmasks, sparsity_outputs,
+					 outputs_only);
+
+    // if the values along a row are contiguous in memory, runs can be found
+    //  by scanning the row directly
+    bool contiguous_rows = (a_data.strides[0] == sizeof(FT));
+
     // double iteration - use the instance's space first, since it's probably smaller
     for(IndexSpaceIterator<N,T> it(inst_space); it.valid; it.step()) {
       for(IndexSpaceIterator<N,T> it2(parent_space, it.rect); it2.valid; it2.step()) {
 	const Rect<N,T>& r = it2.rect;
 	Point<N,T> p = r.lo;
 	while(true) {
-	  FT val = a_data.read(p);
-	  Point<N,T> p2 = p;
-	  while(p2.x < r.hi.x) {
-	    Point<N,T> p3 = p2;
-	    p3.x++;
-	    FT val2 = a_data.read(p3);
-	    if(val != val2) {
-	      // record old strip
-	      BM *&bmp = bitmasks[val];
-	      if(!bmp) bmp = new BM;
-	      bmp->add_rect(Rect<N,T>(p,p2));
-	      //std::cout << val << ": " << p << ".." << p2 << std::endl;
-	      val = val2;
-	      p = p3;
+	  if(contiguous_rows) {
+	    const FT *row = a_data.ptr(p);
+	    size_t row_len = size_t(r.hi.x - r.lo.x) + 1;
+	    size_t pos = 0;
+	    while(pos < row_len) {
+	      size_t len = find_run_length(row + pos, row_len - pos);
+	      Rect<N,T> strip(p, p);
+	      strip.lo.x = r.lo.x + T(pos);
+	      strip.hi.x = r.lo.x + T(pos + len - 1);
+	      table.add_rect(row[pos], strip);
+	      pos += len;
+	    }
+	  } else {
+	    FT val = a_data.read(p);
+	    Point<N,T> p2 = p;
+	    while(p2.x < r.hi.x) {
+	      Point<N,T> p3 = p2;
+	      p3.x++;
+	      FT val2 = a_data.read(p3);
+	      if(val != val2) {
+		// record old strip
+		table.add_rect(val, Rect<N,T>(p,p2));
+		//std::cout << val << ": " << p << ".." << p2 << std::endl;
+		val = val2;
+		p = p3;
+	      }
+	      p2 = p3;
 	    }
-	    p2 = p3;
+	    // record whatever strip we have at the end
+	    table.add_rect(val, Rect<N,T>(p,p2));
+	    //std::cout << val << ": " << p << ".." << p2 << std::endl;
 	  }
-	  // record whatever strip we have at the end
-	  BM *&bmp = bitmasks[val];
-	  if(!bmp) bmp = new BM;
-	  bmp->add_rect(Rect<N,T>(p,p2));
-	  //std::cout << val << ": " << p << ".." << p2 << std::endl;
 
-	  // are we done?
-	  if(p2 == r.hi) break;
+	  // are we done? (only the non-x coordinates of p matter here)
+	  bool done = true;
+	  for(int i = 1; i < N; i++)
+	    if(p[i] != r.hi[i]) {
+	      done = false;
+	      break;
+	    }
+	  if(done) break;
 
 	  // now go to the next span, if there is one (can't be in 1-D)
 	  assert(N > 1);
-	  for(int i = 0; i < (N - 1); i++) {
-	    p[i] = r.lo[i];
-	    if(p[i + 1] < r.hi[i+1]) {
-	      p[i + 1] += 1;
+	  p.x = r.lo.x;
+	  for(int i = 1; i < N; i++) {
+	    if(p[i] < r.hi[i]) {
+	      p[i] += 1;
 	      break;
 	    }
+	    p[i] = r.lo[i];
 	  }
 	}
       }
@@ -162,7 +329,7 @@ namespace Realm {
 #ifdef DEBUG_PARTITIONING
     std::map<FT, CoverageCounter<N,T> *> values_present;
 
-    populate_bitmasks(values_present);
+    populate_bitmasks(values_present, false /*!outputs_only*/);
 
     std::cout << values_present.size() << " values present in instance " << inst << std::endl;
     for(typename std::map<FT, CoverageCounter<N,T> *>::const_iterator it = values_present.begin();
@@ -173,14 +340,14 @@ namespace Realm {
 
     std::map<FT, DenseRectangleList<N,T> *> rect_map;
 
-    populate_bitmasks(rect_map);
+    populate_bitmasks(rect_map, true /*outputs_only*/);
 
 #ifdef DEBUG_PARTITIONING
     std::cout << values_present.size() << " values present in instance " << inst << std::endl;
     for(typename std::map<FT, DenseRectangleList<N,T> *>::const_iterator it = rect_map.begin();
 	it != rect_map.end();
 	it++)
-      std::cout << "  " << it->first << " = " << it->second->rects.size() << " rectangles" << std::endl;
+      std::cout << "  " << it->first << " = " << (it->second ? it->second->rects.size() : 0) << " rectangles" << std::endl;
 #endif
 
     // iterate over sparsity outputs and contribute to all (even if we didn't have any
@@ -190,7 +357,7 @@ namespace Realm {
 	it++) {
       SparsityMapImpl<N,T> *impl = SparsityMapImpl<N,T>::lookup(it->second);
       typename std::map<FT, DenseRectangleList<N,T> *>::const_iterator it2 = rect_map.find(it->first);
-      if(it2 != rect_map.end()) {
+      if((it2 != rect_map.end()) && it2->second) {
 	impl->contribute_dense_rect_list(it2->second->rects);
 	delete it2->second;
       } else
@@ -299,19 +466,29 @@ namespace Realm {
   template <int N, typename T, typename FT>
   void ByFieldOperation<N,T,FT>::execute(void)
   {
-    for(size_t i = 0; i < subspaces.size(); i++)
-      SparsityMapImpl<N,T>::lookup(subspaces[i])->set_contributor_count(field_data.size());
-
+    // large instances are split into several microops so that the
+    //  partitioning workers can scan them in parallel
+    std::vector<std::vector<IndexSpace<N,T> > > pieces(field_data.size());
+    size_t total_pieces = 0;
     for(size_t i = 0; i < field_data.size(); i++) {
-      ByFieldMicroOp<N,T,FT> *uop = new ByFieldMicroOp<N,T,FT>(parent,
-							       field_data[i].index_space,
-							       field_data[i].inst,
-							       field_data[i].field_offset);
-      for(size_t j = 0; j < colors.size(); j++)
-	uop->add_sparsity_output(colors[j], subspaces[j]);
-      //uop.set_value_set(colors);
-      uop->dispatch(this, true /* ok to run in this thread */);
+      split_for_microops(field_data[i].index_space, pieces[i]);
+      total_pieces += pieces[i].size();
     }
+
+    for(size_t i = 0; i < subspaces.size(); i++)
+      SparsityMapImpl<N,T>::lookup(subspaces[i])->set_contributor_count(total_pieces);
+
+    for(size_t i = 0; i < field_data.size(); i++)
+      for(size_t k = 0; k < pieces[i].size(); k++) {
+	ByFieldMicroOp<N,T,FT> *uop = new ByFieldMicroOp<N,T,FT>(parent,
+								 pieces[i][k],
+								 field_data[i].inst,
+								 field_data[i].field_offset);
+	for(size_t j = 0; j < colors.size(); j++)
+	  uop->add_sparsity_output(colors[j], subspaces[j]);
+	//uop.set_value_set(colors);
+	uop->dispatch(this, true /* ok to run in this thread */);
+      }
   }
 
   template <int N, typename T, typename FT>
@@ -53,8 +53,11 @@ namespace Realm {
     template <typename S>
     ByFieldMicroOp(NodeID _requestor, AsyncMicroOp *_async_microop, S& s);
 
+    // if 'outputs_only' is set, bitmasks are only built for the values in
+    //  'sparsity_outputs' (and entries for all of those are added to the map,
+    //  even if the value isn't present)
     template <typename BM>
-    void populate_bitmasks(std::map<FT, BM *>& bitmasks);
+    void populate_bitmasks(std::map<FT, BM *>& bitmasks, bool outputs_only);
 
     IndexSpace<N,T> parent_space, inst_space;
     RegionInstance inst;
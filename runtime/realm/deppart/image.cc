@@ -167,12 +167,14 @@ namespace Realm {
     // for now, one access for the whole instance
     AffineAccessor<Point<N,T>,N2,T2> a_data(inst, field_offset);
 
+    // pointers are gathered per source and added to the bitmasks in sorted
+    //  batches of runs, rather than one point at a time
+    std::vector<PointRunCompressor<N,T> > compressors(sources.size());
+
     // double iteration - use the instance's space first, since it's probably smaller
     for(IndexSpaceIterator<N2,T2> it(inst_space); it.valid; it.step()) {
       for(size_t i = 0; i < sources.size(); i++) {
 	for(IndexSpaceIterator<N2,T2> it2(sources[i], it.rect); it2.valid; it2.step()) {
-	  BM **bmpp = 0;
-
 	  // iterate over each point in the source and see if it points into the parent space	  
 	  for(PointInRectIterator<N2,T2> pir(it2.rect); pir.valid; pir.step()) {
 	    Point<N,T> ptr = a_data.read(pir.p);
@@ -185,14 +187,23 @@ namespace Realm {
                   continue;
                 }
 	      //std::cout << "image " << i << "(" << sources[i] << ") -> " << pir.p << " -> " << ptr << std::endl;
-	      if(!bmpp) bmpp = &bitmasks[i];
-	      if(!*bmpp) *bmpp = new BM;
-	      (*bmpp)->add_point(ptr);
+	      if(compressors[i].add_point(ptr)) {
+		BM *&bmp = bitmasks[i];
+		if(!bmp) bmp = new BM;
+		compressors[i].flush(*bmp);
+	      }
 	    }
 	  }
 	}
       }
     }
+
+    for(size_t i = 0; i < sources.size(); i++)
+      if(!compressors[i].empty()) {
+	BM *&bmp = bitmasks[i];
+	if(!bmp) bmp = new BM;
+	compressors[i].flush(*bmp);
+      }
   }
 
   template <int N, typename T, int N2, typename T2>
@@ -543,40 +554,64 @@ namespace Realm {
 
       uop->dispatch(this, true /* ok to run in this thread */);
     } else {
-      // launch full cross-product of image micro ops right away
+      // launch full cross-product of image micro ops right away (with large
+      //  instances split into pieces)
+      std::vector<std::vector<IndexSpace<N2,T2> > > pieces;
+      size_t total_pieces = split_field_data(pieces);
+
       for(size_t i = 0; i < sources.size(); i++)
-	SparsityMapImpl<N,T>::lookup(images[i])->set_contributor_count(ptr_data.size() +
-								       range_data.size());
-
-      for(size_t i = 0; i < ptr_data.size(); i++) {
-	ImageMicroOp<N,T,N2,T2> *uop = new ImageMicroOp<N,T,N2,T2>(parent,
-								   ptr_data[i].index_space,
-								   ptr_data[i].inst,
-								   ptr_data[i].field_offset,
-								   false /*ptrs*/);
-	for(size_t j = 0; j < sources.size(); j++)
-          if(diff_rhss.empty())
-	    uop->add_sparsity_output(sources[j], images[j]);
-          else
-	    uop->add_sparsity_output_with_difference(sources[j], diff_rhss[j], images[j]);
-
-	uop->dispatch(this, true /* ok to run in this thread */);
-      }
+	SparsityMapImpl<N,T>::lookup(images[i])->set_contributor_count(total_pieces);
+
+      std::set<int> all_sources;
+      for(size_t j = 0; j < sources.size(); j++)
+	all_sources.insert(j);
+
+      for(size_t i = 0; i < pieces.size(); i++)
+	dispatch_microops(i, pieces[i], all_sources);
+    }
+  }
+
+  template <int N, typename T, int N2, typename T2>
+  size_t ImageOperation<N,T,N2,T2>::split_field_data(std::vector<std::vector<IndexSpace<N2,T2> > >& pieces) const
+  {
+    pieces.resize(ptr_data.size() + range_data.size());
+    size_t total_pieces = 0;
+    for(size_t i = 0; i < ptr_data.size(); i++) {
+      split_for_microops(ptr_data[i].index_space, pieces[i]);
+      total_pieces += pieces[i].size();
+    }
+    for(size_t i = 0; i < range_data.size(); i++) {
+      split_for_microops(range_data[i].index_space, pieces[i + ptr_data.size()]);
+      total_pieces += pieces[i + ptr_data.size()].size();
+    }
+    return total_pieces;
+  }
 
-      for(size_t i = 0; i < range_data.size(); i++) {
-	ImageMicroOp<N,T,N2,T2> *uop = new ImageMicroOp<N,T,N2,T2>(parent,
-								   range_data[i].index_space,
-								   range_data[i].inst,
-								   range_data[i].field_offset,
-								   true /*ranges*/);
-	for(size_t j = 0; j < sources.size(); j++)
-          if(diff_rhss.empty())
-	    uop->add_sparsity_output(sources[j], images[j]);
-          else
-	    uop->add_sparsity_output_with_difference(sources[j], diff_rhss[j], images[j]);
-
-	uop->dispatch(this, true /* ok to run in this thread */);
+  template <int N, typename T, int N2, typename T2>
+  void ImageOperation<N,T,N2,T2>::dispatch_microops(size_t idx,
+						    const std::vector<IndexSpace<N2,T2> >& pieces,
+						    const std::set<int>& overlaps)
+  {
+    bool is_ranged = (idx >= ptr_data.size());
+    const FieldDataDescriptor<IndexSpace<N2,T2>,Point<N,T> > *pd = (is_ranged ? 0 : &ptr_data[idx]);
+    const FieldDataDescriptor<IndexSpace<N2,T2>,Rect<N,T> > *rd = (is_ranged ? &range_data[idx - ptr_data.size()] : 0);
+
+    for(size_t k = 0; k < pieces.size(); k++) {
+      ImageMicroOp<N,T,N2,T2> *uop = new ImageMicroOp<N,T,N2,T2>(parent,
+								 pieces[k],
+								 (is_ranged ? rd->inst : pd->inst),
+								 (is_ranged ? rd->field_offset : pd->field_offset),
+								 is_ranged);
+      for(std::set<int>::const_iterator it = overlaps.begin();
+	  it != overlaps.end();
+	  it++) {
+	int j = *it;
+        if(diff_rhss.empty())
+	  uop->add_sparsity_output(sources[j], images[j]);
+        else
+	  uop->add_sparsity_output_with_difference(sources[j], diff_rhss[j], images[j]);
       }
+      uop->dispatch(this, true /* ok to run in this thread */);
     }
   }
 
@@ -587,6 +622,9 @@ namespace Realm {
 
     // we asked the overlap tester to prefetch all the source data we need, so we can use it
     //  right away (and then delete it)
+    std::vector<std::vector<IndexSpace<N2,T2> > > pieces;
+    split_field_data(pieces);
+
     std::vector<std::set<int> > overlaps_by_field_data(ptr_data.size() +
 						       range_data.size());
     for(size_t i = 0; i < sources.size(); i++) {
@@ -596,7 +634,13 @@ namespace Realm {
 
       log_part.info() << overlaps_by_source.size() << " overlaps for source " << i;
 
-      SparsityMapImpl<N,T>::lookup(images[i])->set_contributor_count(overlaps_by_source.size());
+      // each piece of an overlapping instance contributes
+      size_t contributors = 0;
+      for(std::set<int>::const_iterator it = overlaps_by_source.begin();
+	  it != overlaps_by_source.end();
+	  it++)
+	contributors += pieces[*it].size();
+      SparsityMapImpl<N,T>::lookup(images[i])->set_contributor_count(contributors);
 
       // now scatter these values into the overlaps_by_field_data
       for(std::set<int>::const_iterator it = overlaps_by_source.begin();
@@ -606,48 +650,10 @@ namespace Realm {
     }
     delete overlap_tester;
 
-    for(size_t i = 0; i < ptr_data.size(); i++) {
-      const std::set<int>& overlaps = overlaps_by_field_data[i];
-      size_t n = overlaps.size();
-      if(n == 0) continue;
-
-      ImageMicroOp<N,T,N2,T2> *uop = new ImageMicroOp<N,T,N2,T2>(parent,
-								 ptr_data[i].index_space,
-								 ptr_data[i].inst,
-								 ptr_data[i].field_offset,
-								 false /*ptrs*/);
-      for(std::set<int>::const_iterator it = overlaps.begin();
-	  it != overlaps.end();
-	  it++) {
-	int j = *it;
-        if(diff_rhss.empty())
-	  uop->add_sparsity_output(sources[j], images[j]);
-        else
-	  uop->add_sparsity_output_with_difference(sources[j], diff_rhss[j], images[j]);
-      }
-      uop->dispatch(this, true /* ok to run in this thread */);
-    }
-
-    for(size_t i = 0; i < range_data.size(); i++) {
-      const std::set<int>& overlaps = overlaps_by_field_data[i + ptr_data.size()];
-      size_t n = overlaps.size();
-      if(n == 0) continue;
+    for(size_t i = 0; i < overlaps_by_field_data.size(); i++) {
+      if(overlaps_by_field_data[i].empty()) continue;
 
-      ImageMicroOp<N,T,N2,T2> *uop = new ImageMicroOp<N,T,N2,T2>(parent,
-								 range_data[i].index_space,
-								 range_data[i].inst,
-								 range_data[i].field_offset,
-								 true /*ranges*/);
-      for(std::set<int>::const_iterator it = overlaps.begin();
-	  it != overlaps.end();
-	  it++) {
-	int j = *it;
-        if(diff_rhss.empty())
-	  uop->add_sparsity_output(sources[j], images[j]);
-        else
-	  uop->add_sparsity_output_with_difference(sources[j], diff_rhss[j], images[j]);
-      }
-      uop->dispatch(this, true /* ok to run in this thread */);
+      dispatch_microops(i, pieces[i], overlaps_by_field_data[i]);
     }
   }
 
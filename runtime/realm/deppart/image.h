@@ -106,6 +106,16 @@ namespace Realm {
     virtual void set_overlap_tester(void *tester);
 
   protected:
+    // splits each instance's index space (pointer fields first, then range
+    //  fields) into pieces for microops - returns the total number of pieces
+    size_t split_field_data(std::vector<std::vector<IndexSpace<N2,T2> > >& pieces) const;
+
+    // creates and dispatches a microop for each piece of field data 'idx'
+    //  that computes the images of the sources in 'overlaps'
+    void dispatch_microops(size_t idx,
+			   const std::vector<IndexSpace<N2,T2> >& pieces,
+			   const std::set<int>& overlaps);
+
     IndexSpace<N,T> parent;
     std::vector<FieldDataDescriptor<IndexSpace<N2,T2>,Point<N,T> > > ptr_data;
     std::vector<FieldDataDescriptor<IndexSpace<N2,T2>,Rect<N,T> > > range_data;
@@ -160,6 +160,13 @@ namespace Realm {
     static void do_inline_profiling(const ProfilingRequestSet &reqs,
 				    long long inline_start_time);
 
+    // splits an index space into pieces (by narrowing its bounds) so that the
+    //  work on a large instance can be spread across the partitioning
+    //  workers - returns just the original space if it isn't worth splitting
+    template <int N, typename T>
+    static void split_for_microops(const IndexSpace<N,T>& space,
+				   std::vector<IndexSpace<N,T> >& pieces);
+
     class DeferredLaunch : public EventWaiter {
     public:
       void defer(PartitioningOperation *_op, Event wait_on);
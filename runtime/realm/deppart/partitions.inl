@@ -20,6 +20,8 @@
 // this is a nop, but it's for the benefit of IDEs trying to parse this file
 #include "realm/deppart/partitions.h"
 
+#include "realm/deppart/deppart_config.h"
+
 
 namespace Realm {
 
@@ -54,5 +56,54 @@ namespace Realm {
   }
 
 
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class PartitioningOperation
+  //
+
+  template <int N, typename T>
+  /*static*/ void PartitioningOperation::split_for_microops(const IndexSpace<N,T>& space,
+							  std::vector<IndexSpace<N,T> >& pieces)
+  {
+    size_t num_pieces = 1;
+    if((DeppartConfig::cfg_num_partitioning_workers > 1) &&
+       (DeppartConfig::cfg_min_points_per_microop > 0) &&
+       !space.empty()) {
+      size_t volume = space.bounds.volume();
+      num_pieces = std::min(size_t(DeppartConfig::cfg_num_partitioning_workers),
+			    volume / DeppartConfig::cfg_min_points_per_microop);
+    }
+
+    if(num_pieces <= 1) {
+      pieces.push_back(space);
+      return;
+    }
+
+    // split along the slowest-varying dimension that has enough extent, so
+    //  that each piece covers whole rows of a (fortran-order) instance
+    int split_dim = -1;
+    for(int i = N - 1; i >= 0; i--)
+      if(size_t(space.bounds.hi[i] - space.bounds.lo[i] + 1) >= num_pieces) {
+	split_dim = i;
+	break;
+      }
+    if(split_dim < 0) {
+      pieces.push_back(space);
+      return;
+    }
+
+    size_t extent = size_t(space.bounds.hi[split_dim] - space.bounds.lo[split_dim] + 1);
+    T lo = space.bounds.lo[split_dim];
+    for(size_t i = 0; i < num_pieces; i++) {
+      IndexSpace<N,T> piece = space;
+      piece.bounds.lo[split_dim] = lo;
+      piece.bounds.hi[split_dim] = (space.bounds.lo[split_dim] +
+				    T((extent * (i + 1) / num_pieces) - 1));
+      lo = piece.bounds.hi[split_dim] + 1;
+      pieces.push_back(piece);
+    }
+  }
+
+
 };
 
@@ -120,6 +120,9 @@ namespace Realm {
     // for now, one access for the whole instance
     AffineAccessor<Point<N2,T2>,N,T> a_data(inst, field_offset);
 
+    // matching points are added to the bitmasks as runs
+    std::vector<PointRunCompressor<N,T> > compressors(targets.size());
+
     // double iteration - use the instance's space first, since it's probably smaller
     for(IndexSpaceIterator<N,T> it(inst_space); it.valid; it.step()) {
       for(IndexSpaceIterator<N,T> it2(parent_space, it.rect); it2.valid; it2.step()) {
@@ -129,14 +132,21 @@ namespace Realm {
 	  Point<N2,T2> ptr = a_data.read(pir.p);
 
 	  for(size_t i = 0; i < targets.size(); i++)
-	    if(targets[i].contains(ptr)) {
+	    if(targets[i].contains(ptr) && compressors[i].add_point(pir.p)) {
 	      BM *&bmp = bitmasks[i];
 	      if(!bmp) bmp = new BM;
-	      bmp->add_point(pir.p);
+	      compressors[i].flush(*bmp);
 	    }
 	}
       }
     }
+
+    for(size_t i = 0; i < targets.size(); i++)
+      if(!compressors[i].empty()) {
+	BM *&bmp = bitmasks[i];
+	if(!bmp) bmp = new BM;
+	compressors[i].flush(*bmp);
+      }
   }
 
   template <int N, typename T, int N2, typename T2>
@@ -146,6 +156,9 @@ namespace Realm {
     // for now, one access for the whole instance
     AffineAccessor<Rect<N2,T2>,N,T> a_data(inst, field_offset);
 
+    // matching points are added to the bitmasks as runs
+    std::vector<PointRunCompressor<N,T> > compressors(targets.size());
+
     // double iteration - use the instance's space first, since it's probably smaller
     for(IndexSpaceIterator<N,T> it(inst_space); it.valid; it.step()) {
       for(IndexSpaceIterator<N,T> it2(parent_space, it.rect); it2.valid; it2.step()) {
@@ -155,14 +168,21 @@ namespace Realm {
 	  Rect<N2,T2> rng = a_data.read(pir.p);
 
 	  for(size_t i = 0; i < targets.size(); i++)
-	    if(targets[i].contains_any(rng)) {
+	    if(targets[i].contains_any(rng) && compressors[i].add_point(pir.p)) {
 	      BM *&bmp = bitmasks[i];
 	      if(!bmp) bmp = new BM;
-	      bmp->add_point(pir.p);
+	      compressors[i].flush(*bmp);
 	    }
 	}
       }
     }
+
+    for(size_t i = 0; i < targets.size(); i++)
+      if(!compressors[i].empty()) {
+	BM *&bmp = bitmasks[i];
+	if(!bmp) bmp = new BM;
+	compressors[i].flush(*bmp);
+      }
   }
 
   template <int N, typename T, int N2, typename T2>
@@ -388,34 +408,92 @@ namespace Realm {
 
       uop->dispatch(this, true /* ok to run in this thread */);
     } else {
+      // large instances are split into several microops
+      std::vector<std::vector<IndexSpace<N,T> > > pieces(ptr_data.size() +
+							 range_data.size());
+      size_t total_pieces = 0;
+      for(size_t i = 0; i < pieces.size(); i++) {
+	split_for_microops(field_data_space(i), pieces[i]);
+	total_pieces += pieces[i].size();
+      }
+
       for(size_t i = 0; i < preimages.size(); i++)
-	SparsityMapImpl<N,T>::lookup(preimages[i])->set_contributor_count(ptr_data.size() +
-									  range_data.size());
+	SparsityMapImpl<N,T>::lookup(preimages[i])->set_contributor_count(total_pieces);
 
-      for(size_t i = 0; i < ptr_data.size(); i++) {
-	PreimageMicroOp<N,T,N2,T2> *uop = new PreimageMicroOp<N,T,N2,T2>(parent,
-									 ptr_data[i].index_space,
-									 ptr_data[i].inst,
-									 ptr_data[i].field_offset,
-									 false /*ptrs*/);
-	for(size_t j = 0; j < targets.size(); j++)
-	  uop->add_sparsity_output(targets[j], preimages[j]);
-	uop->dispatch(this, true /* ok to run in this thread */);
-      }
+      std::set<int> all_targets;
+      for(size_t j = 0; j < targets.size(); j++)
+	all_targets.insert(j);
 
-      for(size_t i = 0; i < range_data.size(); i++) {
-	PreimageMicroOp<N,T,N2,T2> *uop = new PreimageMicroOp<N,T,N2,T2>(parent,
-									 range_data[i].index_space,
-									 range_data[i].inst,
-									 range_data[i].field_offset,
-									 true /*ranges*/);
-	for(size_t j = 0; j < targets.size(); j++)
-	  uop->add_sparsity_output(targets[j], preimages[j]);
-	uop->dispatch(this, true /* ok to run in this thread */);
+      for(size_t i = 0; i < pieces.size(); i++)
+	dispatch_microops(i, pieces[i], all_targets, true /* ok to run in this thread */);
+    }
+  }
+
+  template <int N, typename T, int N2, typename T2>
+  const IndexSpace<N,T>& PreimageOperation<N,T,N2,T2>::field_data_space(size_t idx) const
+  {
+    if(idx < ptr_data.size())
+      return ptr_data[idx].index_space;
+    else
+      return range_data[idx - ptr_data.size()].index_space;
+  }
+
+  template <int N, typename T, int N2, typename T2>
+  void PreimageOperation<N,T,N2,T2>::dispatch_microops(size_t idx,
+						       const std::vector<IndexSpace<N,T> >& pieces,
+						       const std::set<int>& overlaps,
+						       bool inline_ok)
+  {
+    bool is_ranged = (idx >= ptr_data.size());
+    RegionInstance inst;
+    size_t field_offset;
+    if(is_ranged) {
+      size_t rel_index = idx - ptr_data.size();
+      assert(rel_index < range_data.size());
+      inst = range_data[rel_index].inst;
+      field_offset = range_data[rel_index].field_offset;
+    } else {
+      inst = ptr_data[idx].inst;
+      field_offset = ptr_data[idx].field_offset;
+    }
+
+    for(size_t k = 0; k < pieces.size(); k++) {
+      PreimageMicroOp<N,T,N2,T2> *uop = new PreimageMicroOp<N,T,N2,T2>(parent,
+								       pieces[k],
+								       inst,
+								       field_offset,
+								       is_ranged);
+      for(std::set<int>::const_iterator it = overlaps.begin();
+	  it != overlaps.end();
+	  it++) {
+	int j = *it;
+	uop->add_sparsity_output(targets[j], preimages[j]);
       }
+      uop->dispatch(this, inline_ok);
     }
   }
 
+  template <int N, typename T, int N2, typename T2>
+  void PreimageOperation<N,T,N2,T2>::dispatch_overlapping_microops(size_t idx,
+								   const std::set<int>& overlaps,
+								   bool inline_ok)
+  {
+    if(idx < ptr_data.size())
+      log_part.info() << "image of ptr_data[" << idx << "] overlaps " << overlaps.size() << " targets";
+    else
+      log_part.info() << "image of range_data[" << (idx - ptr_data.size()) << "] overlaps " << overlaps.size() << " targets";
+
+    std::vector<IndexSpace<N,T> > pieces;
+    split_for_microops(field_data_space(idx), pieces);
+
+    for(std::set<int>::const_iterator it = overlaps.begin();
+	it != overlaps.end();
+	it++)
+      contrib_counts[*it].fetch_add(pieces.size());
+
+    dispatch_microops(idx, pieces, overlaps, inline_ok);
+  }
+
   template <int N, typename T, int N2, typename T2>
   void PreimageOperation<N,T,N2,T2>::provide_sparse_image(int index, const Rect<N2,T2> *rects, size_t count)
   {
@@ -435,39 +513,8 @@ namespace Realm {
       // see which of the targets this image overlaps
       std::set<int> overlaps;
       overlap_tester->test_overlap(rects, count, overlaps);
-      if((size_t)index < ptr_data.size()) {
-	log_part.info() << "image of ptr_data[" << index << "] overlaps " << overlaps.size() << " targets";
-	PreimageMicroOp<N,T,N2,T2> *uop = new PreimageMicroOp<N,T,N2,T2>(parent,
-									 ptr_data[index].index_space,
-									 ptr_data[index].inst,
-									 ptr_data[index].field_offset,
-									 false /*ptrs*/);
-	for(std::set<int>::const_iterator it2 = overlaps.begin();
-	    it2 != overlaps.end();
-	    it2++) {
-	  int j = *it2;
-	  contrib_counts[j].fetch_add(1);
-	  uop->add_sparsity_output(targets[j], preimages[j]);
-	}
-	uop->dispatch(this, false /* do not run in this thread */);
-      } else {
-	size_t rel_index = index - ptr_data.size();
-	assert(rel_index < range_data.size());
-	log_part.info() << "image of range_data[" << rel_index << "] overlaps " << overlaps.size() << " targets";
-	PreimageMicroOp<N,T,N2,T2> *uop = new PreimageMicroOp<N,T,N2,T2>(parent,
-									 range_data[rel_index].index_space,
-									 range_data[rel_index].inst,
-									 range_data[rel_index].field_offset,
-									 true /*ranges*/);
-	for(std::set<int>::const_iterator it2 = overlaps.begin();
-	    it2 != overlaps.end();
-	    it2++) {
-	  int j = *it2;
-	  contrib_counts[j].fetch_add(1);
-	  uop->add_sparsity_output(targets[j], preimages[j]);
-	}
-	uop->dispatch(this, false /* do not run in this thread */);
-      }
+      dispatch_overlapping_microops(index, overlaps,
+				    false /* do not run in this thread */);
 
       // if these were the last sparse images, we can now set the contributor counts
       int v = remaining_sparse_images.fetch_sub(1) - 1;
@@ -503,39 +550,8 @@ namespace Realm {
 	// see which of the targets that image overlaps
 	std::set<int> overlaps;
 	overlap_tester->test_overlap(&it->second[0], it->second.size(), overlaps);
-	if(idx < ptr_data.size()) {
-	  log_part.info() << "image of ptr_data[" << idx << "] overlaps " << overlaps.size() << " targets";
-	  PreimageMicroOp<N,T,N2,T2> *uop = new PreimageMicroOp<N,T,N2,T2>(parent,
-									   ptr_data[idx].index_space,
-									   ptr_data[idx].inst,
-									   ptr_data[idx].field_offset,
-									   false /*ptrs*/);
-	  for(std::set<int>::const_iterator it2 = overlaps.begin();
-	      it2 != overlaps.end();
-	      it2++) {
-	    int j = *it2;
-	    contrib_counts[j].fetch_add(1);
-	    uop->add_sparsity_output(targets[j], preimages[j]);
-	  }
-	  uop->dispatch(this, true /* ok to run in this thread */);
-	} else {
-	  size_t rel_index = idx - ptr_data.size();
-	  assert(rel_index < range_data.size());
-	  log_part.info() << "image of range_data[" << rel_index << "] overlaps " << overlaps.size() << " targets";
-	  PreimageMicroOp<N,T,N2,T2> *uop = new PreimageMicroOp<N,T,N2,T2>(parent,
-									   range_data[rel_index].index_space,
-									   range_data[rel_index].inst,
-									   range_data[rel_index].field_offset,
-									   true /*ranges*/);
-	  for(std::set<int>::const_iterator it2 = overlaps.begin();
-	      it2 != overlaps.end();
-	      it2++) {
-	    int j = *it2;
-	    contrib_counts[j].fetch_add(1);
-	    uop->add_sparsity_output(targets[j], preimages[j]);
-	  }
-	  uop->dispatch(this, true /* ok to run in this thread */);
-	}
+	dispatch_overlapping_microops(idx, overlaps,
+				      true /* ok to run in this thread */);
       }
 
       // if these were the last sparse images, we can now set the contributor counts
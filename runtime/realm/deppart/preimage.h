@@ -101,6 +101,22 @@ namespace Realm {
 
   protected:
     static ActiveMessageHandlerReg<ApproxImageResponseMessage<PreimageOperation<N,T,N2,T2> > > areg;
+
+    // field data 'idx' refers to ptr_data first, then range_data
+    const IndexSpace<N,T>& field_data_space(size_t idx) const;
+
+    // creates and dispatches a microop for each piece of field data 'idx'
+    //  that computes the preimages of the targets in 'overlaps'
+    void dispatch_microops(size_t idx,
+			   const std::vector<IndexSpace<N,T> >& pieces,
+			   const std::set<int>& overlaps,
+			   bool inline_ok);
+
+    // splits field data 'idx', adds its pieces to the contributor counts
+    //  of the overlapping targets and dispatches the microops
+    void dispatch_overlapping_microops(size_t idx,
+				       const std::set<int>& overlaps,
+				       bool inline_ok);
     
     IndexSpace<N,T> parent;
     std::vector<FieldDataDescriptor<IndexSpace<N,T>,Point<N2,T2> > > ptr_data;
@@ -82,6 +82,31 @@ namespace Realm {
   template <int N, typename T>
   std::ostream& operator<<(std::ostream& os, const HybridRectangleList<N,T>& hrl);
 
+  // the PointRunCompressor buffers individual points (e.g. the values of a
+  //  pointer field) and hands them to a rectangle list as rectangles - each
+  //  batch is sorted, duplicates are dropped, and consecutive points along
+  //  the first dimension are merged, so the list sees one add_rect per run
+  //  instead of one add_point per point
+  template <int N, typename T>
+  class PointRunCompressor {
+  public:
+    static const size_t MAX_BUFFERED = 16384;
+
+    PointRunCompressor(void);
+
+    // returns true if the buffer is full and should be flushed
+    bool add_point(const Point<N,T>& p);
+
+    bool empty(void) const;
+
+    template <typename BM>
+    void flush(BM& bitmask);
+
+  protected:
+    std::vector<Point<N,T> > points;
+    bool sorted;
+  };
+
 };
 
 #endif // REALM_DEPPART_RECTLIST_H
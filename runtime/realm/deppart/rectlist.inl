@@ -20,6 +20,8 @@
 
 #include "realm/deppart/rectlist.h"
 
+#include <algorithm>
+
 namespace Realm {
 
   ////////////////////////////////////////////////////////////////////////
@@ -650,6 +652,81 @@ namespace Realm {
     return os;
   }
     
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class PointRunCompressor<N,T>
+
+  // orders points so that the first dimension varies fastest, making
+  //  points that can be merged into a run adjacent to each other
+  template <int N, typename T>
+  struct PointRunOrder {
+    bool operator()(const Point<N,T>& a, const Point<N,T>& b) const
+    {
+      for(int i = N - 1; i >= 0; i--)
+	if(a[i] != b[i])
+	  return (a[i] < b[i]);
+      return false;
+    }
+  };
+
+  template <int N, typename T>
+  inline PointRunCompressor<N,T>::PointRunCompressor(void)
+    : sorted(true)
+  {}
+
+  template <int N, typename T>
+  inline bool PointRunCompressor<N,T>::add_point(const Point<N,T>& p)
+  {
+    // points often arrive in order already (e.g. when iterating over an
+    //  instance), in which case the sort can be skipped
+    if(sorted && !points.empty() && PointRunOrder<N,T>()(p, points.back()))
+      sorted = false;
+    points.push_back(p);
+    return (points.size() >= MAX_BUFFERED);
+  }
+
+  template <int N, typename T>
+  inline bool PointRunCompressor<N,T>::empty(void) const
+  {
+    return points.empty();
+  }
+
+  template <int N, typename T>
+  template <typename BM>
+  inline void PointRunCompressor<N,T>::flush(BM& bitmask)
+  {
+    if(points.empty()) return;
+
+    if(!sorted)
+      std::sort(points.begin(), points.end(), PointRunOrder<N,T>());
+
+    Rect<N,T> run(points[0], points[0]);
+    for(size_t i = 1; i < points.size(); i++) {
+      const Point<N,T>& p = points[i];
+      // same row as the current run?
+      bool same_row = true;
+      for(int j = 1; j < N; j++)
+	if(p[j] != run.hi[j]) {
+	  same_row = false;
+	  break;
+	}
+      if(same_row) {
+	if(p.x == run.hi.x) continue;  // duplicate
+	if(p.x == (run.hi.x + 1)) {
+	  run.hi.x = p.x;
+	  continue;
+	}
+      }
+      bitmask.add_rect(run);
+      run = Rect<N,T>(p, p);
+    }
+    bitmask.add_rect(run);
+
+    points.clear();
+    sorted = true;
+  }
+
 };
 
 #endif // REALM_DEPPART_RECTLIST_INL
@@ -376,6 +376,9 @@ namespace Realm {
     // if non-zero, eagerly checks deferred user event triggers for loops up to the
     //  specified limit
     int event_loop_detection_limit = 0;
+
+    int event_batch_window = 0;
+    int event_batch_max_size = 128;
   };
 
   void UserEvent::trigger(Event wait_on, bool ignore_faults) const
@@ -1224,12 +1227,9 @@ namespace Realm {
 	}
       }
 
-      if((subscribe_owner != -1)) {
-	ActiveMessage<EventSubscribeMessage> amsg(owner);
-	amsg->event = make_event(needed_gen);
-	amsg->previous_subscribe_gen = previous_subscribe_gen;
-	amsg.commit();
-      }
+      if((subscribe_owner != -1))
+	EventSubscribeMessage::send_request(owner, make_event(needed_gen),
+					    previous_subscribe_gen);
 
       if(trigger_now)
 	waiter->event_triggered(trigger_poisoned);
@@ -1344,10 +1344,8 @@ namespace Realm {
 	// always updated before the generation - the load_acquire above makes
 	// sure we read in the correct order
 	int npg_cached = impl->num_poisoned_generations.load_acquire();
-	ActiveMessage<EventUpdateMessage> amsg(sender, npg_cached*sizeof(EventImpl::gen_t));
-	amsg->event = triggered;
-	amsg.add_payload(impl->poisoned_generations, npg_cached*sizeof(EventImpl::gen_t), PAYLOAD_KEEP);
-	amsg.commit();
+	EventUpdateMessage::send_request(sender, triggered,
+					 impl->poisoned_generations, npg_cached);
       }
     } 
 
@@ -1515,6 +1513,362 @@ namespace Realm {
     }
 
 
+    /*static*/ void EventSubscribeMessage::send_request(NodeID target, Event event,
+							EventImpl::gen_t previous_subscribe_gen)
+    {
+      EventBatchRecord rec;
+      rec.event = event;
+      rec.aux = previous_subscribe_gen;
+      rec.kind = EventBatchRecord::SUBSCRIBE;
+      if(event_message_batcher.add_record(target, rec))
+	return;
+
+      ActiveMessage<EventSubscribeMessage> amsg(target);
+      amsg->event = event;
+      amsg->previous_subscribe_gen = previous_subscribe_gen;
+      amsg.commit();
+    }
+
+    /*static*/ void EventTriggerMessage::send_request(NodeID target, Event event,
+						      bool poisoned)
+    {
+      EventBatchRecord rec;
+      rec.event = event;
+      rec.aux = (poisoned ? 1 : 0);
+      rec.kind = EventBatchRecord::TRIGGER;
+      if(event_message_batcher.add_record(target, rec))
+	return;
+
+      ActiveMessage<EventTriggerMessage> amsg(target);
+      amsg->event = event;
+      amsg->poisoned = poisoned;
+      amsg.commit();
+    }
+
+    /*static*/ void EventUpdateMessage::send_request(NodeID target, Event event,
+						     const EventImpl::gen_t *poisoned_gens,
+						     int num_poisoned)
+    {
+      EventBatchRecord rec;
+      rec.event = event;
+      rec.aux = num_poisoned;
+      rec.kind = EventBatchRecord::UPDATE;
+      if(event_message_batcher.add_record(target, rec,
+					  poisoned_gens, num_poisoned))
+	return;
+
+      ActiveMessage<EventUpdateMessage> amsg(target, num_poisoned*sizeof(EventImpl::gen_t));
+      amsg->event = event;
+      amsg.add_payload(poisoned_gens, num_poisoned*sizeof(EventImpl::gen_t), PAYLOAD_KEEP);
+      amsg.commit();
+    }
+
+    /*static*/ void EventUpdateMessage::send_request(const NodeSet& targets, Event event,
+						     const EventImpl::gen_t *poisoned_gens,
+						     int num_poisoned)
+    {
+      EventBatchRecord rec;
+      rec.event = event;
+      rec.aux = num_poisoned;
+      rec.kind = EventBatchRecord::UPDATE;
+      // batching is all-or-nothing, so if the first target is accepted,
+      //  the rest will be too
+      NodeSet::const_iterator it = targets.begin();
+      if(event_message_batcher.add_record(*it, rec,
+					  poisoned_gens, num_poisoned)) {
+	for(++it; it != targets.end(); ++it) {
+	  bool ok = event_message_batcher.add_record(*it, rec,
+						     poisoned_gens, num_poisoned);
+	  if(!ok)
+	    send_request(*it, event, poisoned_gens, num_poisoned);
+	}
+	return;
+      }
+
+      ActiveMessage<EventUpdateMessage> amsg(targets, num_poisoned*sizeof(EventImpl::gen_t));
+      amsg->event = event;
+      amsg.add_payload(poisoned_gens, num_poisoned*sizeof(EventImpl::gen_t), PAYLOAD_KEEP);
+      amsg.commit();
+    }
+
+    /*static*/ void EventBatchMessage::handle_message(NodeID sender, const EventBatchMessage &args,
+						      const void *data, size_t datalen)
+    {
+      log_event.debug() << "event batch: node=" << sender << " count=" << args.count;
+
+      if(Config::profile_activemsg_handlers)
+	activemsg_handler_table.record_message_batch(activemsg_handler_table.lookup_message_id<EventBatchMessage>(),
+						     args.count);
+
+      // replay the records in the order they were added by the sender
+      const char *pos = static_cast<const char *>(data);
+      const char *end = pos + datalen;
+      for(unsigned i = 0; i < args.count; i++) {
+	EventBatchRecord rec;
+	assert((pos + sizeof(EventBatchRecord)) <= end);
+	memcpy(&rec, pos, sizeof(EventBatchRecord));
+	pos += sizeof(EventBatchRecord);
+
+	switch(rec.kind) {
+	case EventBatchRecord::SUBSCRIBE:
+	  {
+	    EventSubscribeMessage msg;
+	    msg.event = rec.event;
+	    msg.previous_subscribe_gen = rec.aux;
+	    EventSubscribeMessage::handle_message(sender, msg, 0, 0);
+	    break;
+	  }
+
+	case EventBatchRecord::TRIGGER:
+	  {
+	    EventTriggerMessage msg;
+	    msg.event = rec.event;
+	    msg.poisoned = (rec.aux != 0);
+	    EventTriggerMessage::handle_message(sender, msg, 0, 0);
+	    break;
+	  }
+
+	case EventBatchRecord::UPDATE:
+	  {
+	    // poisoned generations are copied out to get the alignment right
+	    size_t bytes = rec.aux * sizeof(EventImpl::gen_t);
+	    assert((pos + bytes) <= end);
+	    EventImpl::gen_t poisoned_gens[GenEventImpl::POISONED_GENERATION_LIMIT];
+	    assert(rec.aux <= unsigned(GenEventImpl::POISONED_GENERATION_LIMIT));
+	    memcpy(poisoned_gens, pos, bytes);
+	    pos += bytes;
+	    EventUpdateMessage msg;
+	    msg.event = rec.event;
+	    EventUpdateMessage::handle_message(sender, msg, poisoned_gens, bytes);
+	    break;
+	  }
+
+	default:
+	  assert(0);
+	}
+      }
+      assert(pos == end);
+    }
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class EventMessageBatcher
+  //
+
+  EventMessageBatcher event_message_batcher;
+
+  EventMessageBatcher::PendingBatch::PendingBatch(void)
+    : count(0)
+    , sending(false)
+    , resend(false)
+    , oldest_time(0)
+  {}
+
+  EventMessageBatcher::EventMessageBatcher(void)
+    : enabled(false)
+    , window_ns(0)
+    , max_batch_size(0)
+    , pending_records(0)
+    , condvar(mutex)
+    , shutdown_flag(false)
+    , core_rsrv(0)
+    , flush_thread(0)
+    , records_batched(0)
+    , batches_sent(0)
+  {
+    for(int i = 0; i < NUM_FLUSH_REASONS; i++)
+      flush_counts[i].store(0);
+  }
+
+  EventMessageBatcher::~EventMessageBatcher(void)
+  {
+    assert(flush_thread == 0);
+    for(size_t i = 0; i < batches.size(); i++)
+      delete batches[i];
+  }
+
+  void EventMessageBatcher::start(CoreReservationSet& crs)
+  {
+    // nothing to do on a single node or if batching wasn't requested
+    if((Config::event_batch_window <= 0) || (Network::max_node_id == 0))
+      return;
+
+    window_ns = 1000LL * Config::event_batch_window;
+    max_batch_size = std::max(Config::event_batch_max_size, 1);
+    batches.resize(Network::max_node_id + 1);
+    for(NodeID i = 0; i <= Network::max_node_id; i++)
+      batches[i] = new PendingBatch;
+
+    core_rsrv = new CoreReservation("event batcher", crs,
+				    CoreReservationParameters());
+    ThreadLaunchParameters tlp;
+    flush_thread = Thread::create_kernel_thread<EventMessageBatcher,
+						&EventMessageBatcher::flush_thread_loop>(this,
+											 tlp,
+											 *core_rsrv);
+
+    log_event.info() << "event message batching enabled: window="
+		     << Config::event_batch_window << " us, max="
+		     << max_batch_size;
+    enabled.store(true);
+  }
+
+  void EventMessageBatcher::stop(void)
+  {
+    if(!flush_thread)
+      return;
+
+    // disable new records before the final flush - adders check the flag
+    //  while holding the per-node lock, so nothing can sneak in after
+    enabled.store(false);
+    flush_all();
+
+    {
+      AutoLock<> al(mutex);
+      shutdown_flag = true;
+      condvar.broadcast();
+    }
+    flush_thread->join();
+    delete flush_thread;
+    flush_thread = 0;
+    delete core_rsrv;
+    core_rsrv = 0;
+  }
+
+  bool EventMessageBatcher::add_record(NodeID target,
+				       const EventBatchRecord& record,
+				       const EventImpl::gen_t *extra,
+				       int num_extra)
+  {
+    // quick check without the lock - the definitive one is below
+    if(!enabled.load())
+      return false;
+
+    PendingBatch *pb = batches[target];
+    bool full;
+    {
+      AutoLock<> al(pb->mutex);
+      if(!enabled.load())
+	return false;
+
+      size_t offset = pb->data.size();
+      size_t extra_bytes = num_extra * sizeof(EventImpl::gen_t);
+      pb->data.resize(offset + sizeof(EventBatchRecord) + extra_bytes);
+      memcpy(&pb->data[offset], &record, sizeof(EventBatchRecord));
+      if(extra_bytes > 0)
+	memcpy(&pb->data[offset + sizeof(EventBatchRecord)], extra, extra_bytes);
+      if(pb->count++ == 0)
+	pb->oldest_time.store(Clock::current_time_in_nanoseconds());
+      full = (pb->count >= max_batch_size);
+    }
+    pending_records.fetch_add(1);
+    records_batched.fetch_add(1);
+
+    if(full)
+      flush_node(target, FLUSH_FULL);
+
+    return true;
+  }
+
+  void EventMessageBatcher::flush_all(void)
+  {
+    // common case: nothing to do
+    if(pending_records.load() == 0)
+      return;
+
+    for(size_t i = 0; i < batches.size(); i++)
+      if(batches[i]->oldest_time.load() != 0)
+	flush_node(NodeID(i), FLUSH_IDLE);
+  }
+
+  void EventMessageBatcher::flush_node(NodeID target, FlushReason reason)
+  {
+    PendingBatch *pb = batches[target];
+
+    pb->mutex.lock();
+
+    // if somebody else is already sending for this node, ask them to look
+    //  again when they're done rather than risk reordering notifications
+    if(pb->sending) {
+      pb->resend = true;
+      pb->mutex.unlock();
+      return;
+    }
+
+    while(pb->count > 0) {
+      std::vector<char> to_send;
+      to_send.swap(pb->data);
+      unsigned count = pb->count;
+      pb->count = 0;
+      pb->oldest_time.store(0);
+      pb->sending = true;
+      pb->resend = false;
+      pb->mutex.unlock();
+
+      pending_records.fetch_sub(count);
+      batches_sent.fetch_add(1);
+      flush_counts[reason].fetch_add(1);
+
+      // don't hold the lock while sending - the network may call back into
+      //  handlers that add records of their own
+      ActiveMessage<EventBatchMessage> amsg(target, to_send.size());
+      amsg->count = count;
+      amsg.add_payload(&to_send[0], to_send.size(), PAYLOAD_COPY);
+      amsg.commit();
+
+      pb->mutex.lock();
+      pb->sending = false;
+      if(!pb->resend)
+	break;
+    }
+
+    pb->mutex.unlock();
+  }
+
+  void EventMessageBatcher::flush_thread_loop(void)
+  {
+    // wake up often enough that nothing waits much longer than the window
+    long long interval = std::max(window_ns / 2, 1000LL);
+
+    while(true) {
+      {
+	AutoLock<> al(mutex);
+	if(shutdown_flag)
+	  break;
+	condvar.timedwait(interval);
+	if(shutdown_flag)
+	  break;
+      }
+
+      if(pending_records.load() == 0)
+	continue;
+
+      long long now = Clock::current_time_in_nanoseconds();
+      for(size_t i = 0; i < batches.size(); i++) {
+	long long oldest = batches[i]->oldest_time.load();
+	if((oldest != 0) && ((now - oldest) >= window_ns))
+	  flush_node(NodeID(i), FLUSH_WINDOW);
+      }
+    }
+  }
+
+  void EventMessageBatcher::report_stats(void)
+  {
+    if(batches.empty())
+      return;
+
+    size_t nrec = records_batched.load();
+    size_t nsent = batches_sent.load();
+    log_event.print() << "event batching: records=" << nrec
+		      << " batches=" << nsent
+		      << " per_batch=" << (nsent ? (double(nrec) / double(nsent)) : 0.0)
+		      << " full=" << flush_counts[FLUSH_FULL].load()
+		      << " window=" << flush_counts[FLUSH_WINDOW].load()
+		      << " idle=" << flush_counts[FLUSH_IDLE].load();
+  }
+
+
   /*static*/ atomic<Barrier::timestamp_t> BarrierImpl::barrier_adjustment_timestamp(0);
 
 
@@ -1593,19 +1947,19 @@ namespace Realm {
 	}
       }
 
-      if(subscribe_needed) {
-	ActiveMessage<EventSubscribeMessage> amsg(owner);
-	amsg->event = make_event(subscribe_gen);
-	amsg->previous_subscribe_gen = previous_subscribe_gen;
-	amsg.commit();
-      }
+      if(subscribe_needed)
+	EventSubscribeMessage::send_request(owner, make_event(subscribe_gen),
+					    previous_subscribe_gen);
     }
   
     void GenEventImpl::external_wait(gen_t gen_needed, bool& poisoned)
     {
-      // if the event is remote, make sure we've subscribed
-      if(this->owner != Network::my_node_id)
+      // if the event is remote, make sure we've subscribed - this thread is
+      //  about to block, so don't leave the subscription sitting in a batch
+      if(this->owner != Network::my_node_id) {
 	this->subscribe(gen_needed);
+	event_message_batcher.flush_all();
+      }
 
       {
 	AutoLock<> a(mutex);
@@ -1717,10 +2071,8 @@ namespace Realm {
 	// any remote nodes to notify?
 	if(!to_update.empty()) {
 	  int npg_cached = num_poisoned_generations.load_acquire();
-	  ActiveMessage<EventUpdateMessage> amsg(to_update, npg_cached*sizeof(EventImpl::gen_t));
-	  amsg->event = make_event(update_gen);
-	  amsg.add_payload(poisoned_generations, npg_cached*sizeof(EventImpl::gen_t), PAYLOAD_KEEP);
-	  amsg.commit();
+	  EventUpdateMessage::send_request(to_update, make_event(update_gen),
+					   poisoned_generations, npg_cached);
 	}
 
 	// free event?
@@ -1735,10 +2087,8 @@ namespace Realm {
 	// (the alternative is to not send the message until after we update local state, but
 	// that adds latency for everybody else)
 	assert(gen_triggered > generation.load());
-	ActiveMessage<EventTriggerMessage> amsg(owner);
-	amsg->event = make_event(gen_triggered);
-	amsg->poisoned = poisoned;
-	amsg.commit();
+	EventTriggerMessage::send_request(owner, make_event(gen_triggered),
+					  poisoned);
 	// we might need to subscribe to intermediate generations
 	bool subscribe_needed = false;
 	gen_t previous_subscribe_gen = 0;
@@ -1808,12 +2158,9 @@ namespace Realm {
 	  }
 	}
 
-	if(subscribe_needed) {
-	  ActiveMessage<EventSubscribeMessage> amsg(owner);
-	  amsg->event = make_event(gen_triggered);
-	  amsg->previous_subscribe_gen = previous_subscribe_gen;
-	  amsg.commit();
-	}
+	if(subscribe_needed)
+	  EventSubscribeMessage::send_request(owner, make_event(gen_triggered),
+					      previous_subscribe_gen);
       }
 
       // finally, trigger any local waiters
@@ -3612,6 +3959,7 @@ static void *bytedup(const void *data, size_t datalen)
   ActiveMessageHandlerReg<EventSubscribeMessage> event_subscribe_message_handler;
   ActiveMessageHandlerReg<EventTriggerMessage> event_trigger_message_handler;
   ActiveMessageHandlerReg<EventUpdateMessage> event_update_message_handler;
+  ActiveMessageHandlerReg<EventBatchMessage> event_batch_message_handler;
   ActiveMessageHandlerReg<BarrierAdjustMessage> barrier_adjust_message_handler;
   ActiveMessageHandlerReg<BarrierSubscribeMessage> barrier_subscribe_message_handler;
   ActiveMessageHandlerReg<BarrierTriggerMessage> barrier_trigger_message_handler;
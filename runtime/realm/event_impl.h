@@ -27,6 +27,7 @@
 
 #include "realm/lists.h"
 #include "realm/threads.h"
+#include "realm/mutex.h"
 #include "realm/logging.h"
 #include "realm/redop.h"
 
@@ -35,6 +36,14 @@
 
 namespace Realm {
 
+    namespace Config {
+      // if non-zero, event subscribe/trigger/update notifications headed to
+      //  the same node are coalesced for up to this many microseconds
+      extern int event_batch_window;
+      // maximum number of notifications carried by a single batch message
+      extern int event_batch_max_size;
+    };
+
 #ifdef EVENT_TRACING
     // For event tracing
     struct EventTraceItem {
@@ -444,6 +453,8 @@ namespace Realm {
     static void handle_message(NodeID sender, const EventSubscribeMessage &msg,
 			       const void *data, size_t datalen);
 
+    static void send_request(NodeID target, Event event,
+			     EventImpl::gen_t previous_subscribe_gen);
   };
 
   struct EventTriggerMessage {
@@ -453,6 +464,7 @@ namespace Realm {
     static void handle_message(NodeID sender, const EventTriggerMessage &msg,
 			       const void *data, size_t datalen);
 
+    static void send_request(NodeID target, Event event, bool poisoned);
   };
 
   struct EventUpdateMessage {
@@ -461,8 +473,102 @@ namespace Realm {
     static void handle_message(NodeID sender, const EventUpdateMessage &msg,
 			       const void *data, size_t datalen);
 
+    static void send_request(NodeID target, Event event,
+			     const EventImpl::gen_t *poisoned_gens, int num_poisoned);
+    static void send_request(const NodeSet& targets, Event event,
+			     const EventImpl::gen_t *poisoned_gens, int num_poisoned);
+  };
+
+  // carries a sequence of subscribe/trigger/update notifications that were
+  //  coalesced by the EventMessageBatcher - the payload is a list of
+  //  EventBatchRecords, each update record followed by its poisoned
+  //  generations
+  struct EventBatchMessage {
+    unsigned count;
+
+    static void handle_message(NodeID sender, const EventBatchMessage &msg,
+			       const void *data, size_t datalen);
+  };
+
+  struct EventBatchRecord {
+    enum Kind {
+      SUBSCRIBE, // aux = previous subscribed generation
+      TRIGGER,   // aux = poisoned
+      UPDATE,    // aux = number of poisoned generations that follow
+    };
+
+    Event event;
+    EventImpl::gen_t aux;
+    unsigned kind;
   };
 
+  // per-destination coalescing of event notifications - messages are
+  //  accumulated for each target node and sent when the batch fills, when
+  //  the oldest notification has waited for the flush window, or right
+  //  away if a local scheduler runs out of work
+  class EventMessageBatcher {
+  public:
+    EventMessageBatcher(void);
+    ~EventMessageBatcher(void);
+
+    // creates the flush thread - must be called before core reservations
+    //  are satisfied
+    void start(CoreReservationSet& crs);
+    // sends anything still pending and disables further batching
+    void stop(void);
+
+    // each of these returns false if batching is disabled, in which case the
+    //  caller is responsible for sending an individual message
+    bool add_record(NodeID target, const EventBatchRecord& record,
+		    const EventImpl::gen_t *extra = 0, int num_extra = 0);
+
+    // sends whatever is pending for every node - cheap when nothing is
+    void flush_all(void);
+
+    void report_stats(void);
+
+  protected:
+    enum FlushReason {
+      FLUSH_FULL,
+      FLUSH_WINDOW,
+      FLUSH_IDLE,
+      NUM_FLUSH_REASONS
+    };
+
+    struct PendingBatch {
+      PendingBatch(void);
+
+      Mutex mutex;
+      std::vector<char> data;
+      unsigned count;
+      bool sending; // a thread is sending a batch for this node right now
+      bool resend;  // ... and should check for more before it stops
+      // time at which the oldest pending record was added (0 = empty)
+      atomic<long long> oldest_time;
+    };
+
+    void flush_node(NodeID target, FlushReason reason);
+    void flush_thread_loop(void);
+
+    atomic<bool> enabled;
+    long long window_ns;
+    unsigned max_batch_size;
+    std::vector<PendingBatch *> batches;
+    atomic<size_t> pending_records;
+
+    Mutex mutex;
+    CondVar condvar;
+    bool shutdown_flag;
+    CoreReservation *core_rsrv;
+    Thread *flush_thread;
+
+    // statistics
+    atomic<size_t> records_batched, batches_sent;
+    atomic<size_t> flush_counts[NUM_FLUSH_REASONS];
+  };
+
+  extern EventMessageBatcher event_message_batcher;
+
   struct BarrierAdjustMessage {
     NodeID sender;
     int forwarded;
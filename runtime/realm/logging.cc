@@ -21,12 +21,15 @@
 
 #include "realm/cmdline.h"
 #include "realm/timers.h"
+#include "realm/atomics.h"
 
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <errno.h>
+#include <pthread.h>
+#include <time.h>
 
 #include <set>
 #include <map>
@@ -46,27 +49,42 @@ namespace Realm {
     }
 
     virtual void log_msg(Logger::LoggingLevel level, const char *name, const char *msgdata, size_t msglen)
+    {
+      double now = 0;
+      if(include_timestamp)
+        now = current_log_time();
+      log_msg_from(level, name, msgdata, msglen,
+                   now, (unsigned long)pthread_self());
+    }
+
+    // special case - log messages before we've agreed on common time base
+    //  across all nodes show as 0.0
+    static double current_log_time(void)
+    {
+      if(Clock::get_zero_time() != 0)
+        return Clock::current_time();
+      else
+        return 0;
+    }
+
+    // writes a message that was logged by 'thread_id' at time 'now' - used
+    //  directly by the asynchronous stream, which captures both when the
+    //  message is logged and writes it later from its own thread
+    void log_msg_from(Logger::LoggingLevel level, const char *name,
+                      const char *msgdata, size_t msglen,
+                      double now, unsigned long thread_id)
     {
       // build message string, including prefix
       static const int MAXLEN = 4096;
       char buffer[MAXLEN];
       int pfxlen;
-      if(include_timestamp) {
-	// special case - log messages before we've agreed on common time base
-	//  across all nodes show as 0.0
-	double now;
-	if(Clock::get_zero_time() != 0)
-	  now = Clock::current_time();
-	else
-	  now = 0;
+      if(include_timestamp)
 	pfxlen = snprintf(buffer, MAXLEN - 2, "[%d - %lx] %11.6f {%d}{%s}: ",
-			  Network::my_node_id,
-			  (unsigned long)pthread_self(),
+			  Network::my_node_id, thread_id,
 			  now, level, name);
-      } else
+      else
 	pfxlen = snprintf(buffer, MAXLEN - 2, "[%d - %lx] {%d}{%s}: ",
-			  Network::my_node_id,
-			  (unsigned long)pthread_self(),
+			  Network::my_node_id, thread_id,
 			  level, name);
 
       // would simply concatenating this message overflow the buffer?
@@ -121,6 +139,242 @@ namespace Realm {
     Mutex mutex;
   };
 
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class LoggerAsyncStream
+
+  // each thread that logs through an asynchronous stream gets its own
+  //  single-producer/single-consumer ring of binary records, so logging
+  //  threads never wait on each other or on the output file
+  struct AsyncLogRing {
+    AsyncLogRing *next_ring;
+    const void *owner;
+    size_t size;  // power of two
+    atomic<size_t> head;  // bytes written - only updated by the producer
+    atomic<size_t> tail;  // bytes consumed - only updated by the consumer
+    char *data;
+  };
+
+  // the record header - a header with 'bytes' == 0 marks the unused space
+  //  at the end of the ring when a record had to wrap around to the start
+  struct AsyncLogRecord {
+    size_t bytes;  // including header and padding
+    double timestamp;
+    unsigned long thread_id;
+    int level;
+    unsigned name_len;  // including the terminating NUL
+    unsigned msg_len;
+    char *name() { return reinterpret_cast<char *>(this + 1); }
+    char *msgdata() { return name() + name_len; }
+  };
+
+  static REALM_THREAD_LOCAL AsyncLogRing *local_async_ring = 0;
+
+  class LoggerAsyncStream : public LoggerOutputStream {
+  public:
+    LoggerAsyncStream(LoggerFileStream *_target, size_t _ring_size);
+    virtual ~LoggerAsyncStream(void);
+
+    virtual void log_msg(Logger::LoggingLevel level, const char *name,
+                         const char *msgdata, size_t msglen);
+    virtual void flush();
+
+    // non-critical messages longer than this are truncated, just as the
+    //  file stream does
+    static const size_t MAX_MSGLEN = 4096;
+    static const size_t MIN_RING_SIZE = 8 * MAX_MSGLEN;
+
+  protected:
+    AsyncLogRing *get_local_ring(void);
+    bool drain_rings(void);
+    static void *background_thread(void *arg);
+
+    LoggerFileStream *target;
+    size_t ring_size;
+    atomic<AsyncLogRing *> rings;
+    atomic<bool> shutdown_requested;
+    atomic<size_t> dropped;
+    pthread_t thread;
+  };
+
+  LoggerAsyncStream::LoggerAsyncStream(LoggerFileStream *_target,
+                                       size_t _ring_size)
+    : target(_target)
+    , ring_size(MIN_RING_SIZE)
+    , rings(0)
+    , shutdown_requested(false)
+    , dropped(0)
+  {
+    while(ring_size < _ring_size)
+      ring_size <<= 1;
+    int ret = pthread_create(&thread, 0, background_thread, this);
+    if(ret != 0) {
+      fprintf(stderr, "could not create asynchronous logging thread: %s\n",
+              strerror(ret));
+      exit(1);
+    }
+  }
+
+  LoggerAsyncStream::~LoggerAsyncStream(void)
+  {
+    // the background thread drains everything before it exits
+    shutdown_requested.store_release(true);
+    pthread_join(thread, 0);
+
+    size_t num_dropped = dropped.load();
+    if(num_dropped > 0) {
+      char msg[128];
+      int len = snprintf(msg, sizeof(msg),
+                         "asynchronous logging dropped %zd messages - "
+                         "increase -logasync to keep them", num_dropped);
+      target->log_msg(Logger::LEVEL_WARNING, "logging", msg, len);
+    }
+    target->flush();
+
+    // rings of threads that have exited are never reclaimed while the
+    //  stream exists, so they're all still on the list
+    AsyncLogRing *ring = rings.load();
+    while(ring != 0) {
+      AsyncLogRing *next = ring->next_ring;
+      free(ring->data);
+      delete ring;
+      ring = next;
+    }
+    delete target;
+  }
+
+  AsyncLogRing *LoggerAsyncStream::get_local_ring(void)
+  {
+    AsyncLogRing *ring = local_async_ring;
+    if((ring != 0) && (ring->owner == this))
+      return ring;
+
+    ring = new AsyncLogRing;
+    ring->owner = this;
+    ring->size = ring_size;
+    ring->head.store(0);
+    ring->tail.store(0);
+    ring->data = static_cast<char *>(malloc(ring_size));
+    assert(ring->data != 0);
+    // push onto the list the background thread walks
+    AsyncLogRing *old_head = rings.load();
+    do {
+      ring->next_ring = old_head;
+    } while(!rings.compare_exchange(old_head, ring));
+    local_async_ring = ring;
+    return ring;
+  }
+
+  void LoggerAsyncStream::log_msg(Logger::LoggingLevel level, const char *name,
+                                  const char *msgdata, size_t msglen)
+  {
+    // warnings and errors must not be lost or delayed (an error is often
+    //  followed by an abort), so write everything buffered so far and then
+    //  this message synchronously
+    if(level >= Logger::LEVEL_WARNING) {
+      flush();
+      target->log_msg(level, name, msgdata, msglen);
+      target->flush();
+      return;
+    }
+
+    if(msglen > MAX_MSGLEN)
+      msglen = MAX_MSGLEN;
+    size_t name_len = strlen(name) + 1;
+    size_t needed = sizeof(AsyncLogRecord) + name_len + msglen;
+    // keep records 8-byte aligned
+    needed = (needed + 7) & ~size_t(7);
+
+    AsyncLogRing *ring = get_local_ring();
+    size_t head = ring->head.load();
+    size_t tail = ring->tail.load_acquire();
+    size_t offset = head & (ring->size - 1);
+    size_t contiguous = ring->size - offset;
+    // a record that doesn't fit before the end of the ring skips the rest
+    size_t skip = (contiguous < needed) ? contiguous : 0;
+    if(((head - tail) + skip + needed) > ring->size) {
+      // bounded memory - drop the message rather than wait for the writer
+      dropped.fetch_add(1);
+      return;
+    }
+    if(skip > 0) {
+      reinterpret_cast<AsyncLogRecord *>(ring->data + offset)->bytes = 0;
+      head += skip;
+      offset = 0;
+    }
+
+    AsyncLogRecord *rec = reinterpret_cast<AsyncLogRecord *>(ring->data + offset);
+    rec->bytes = needed;
+    rec->timestamp = LoggerFileStream::current_log_time();
+    rec->thread_id = (unsigned long)pthread_self();
+    rec->level = level;
+    rec->name_len = name_len;
+    rec->msg_len = msglen;
+    memcpy(rec->name(), name, name_len);
+    memcpy(rec->msgdata(), msgdata, msglen);
+    ring->head.store_release(head + needed);
+  }
+
+  void LoggerAsyncStream::flush()
+  {
+    // wait for the background thread to consume everything logged so far
+    for(AsyncLogRing *ring = rings.load_acquire();
+        ring != 0;
+        ring = ring->next_ring) {
+      size_t head = ring->head.load_acquire();
+      while(ring->tail.load_acquire() < head) {
+        struct timespec ts = { 0, 50000 };
+        nanosleep(&ts, 0);
+      }
+    }
+    target->flush();
+  }
+
+  bool LoggerAsyncStream::drain_rings(void)
+  {
+    bool any_work = false;
+    for(AsyncLogRing *ring = rings.load_acquire();
+        ring != 0;
+        ring = ring->next_ring) {
+      size_t tail = ring->tail.load();
+      size_t head = ring->head.load_acquire();
+      while(tail != head) {
+        size_t offset = tail & (ring->size - 1);
+        AsyncLogRecord *rec = reinterpret_cast<AsyncLogRecord *>(ring->data + offset);
+        if(rec->bytes == 0) {
+          // skip to the start of the ring
+          tail += ring->size - offset;
+        } else {
+          target->log_msg_from(static_cast<Logger::LoggingLevel>(rec->level),
+                               rec->name(), rec->msgdata(), rec->msg_len,
+                               rec->timestamp, rec->thread_id);
+          tail += rec->bytes;
+        }
+        // release the space as we go so producers can keep logging
+        ring->tail.store_release(tail);
+        any_work = true;
+      }
+    }
+    return any_work;
+  }
+
+  /*static*/ void *LoggerAsyncStream::background_thread(void *arg)
+  {
+    LoggerAsyncStream *stream = static_cast<LoggerAsyncStream *>(arg);
+    while(true) {
+      if(stream->drain_rings())
+        continue;
+      if(stream->shutdown_requested.load_acquire()) {
+        // one last pass for anything logged before the request
+        stream->drain_rings();
+        break;
+      }
+      struct timespec ts = { 0, 100000 };
+      nanosleep(&ts, 0);
+    }
+    return 0;
+  }
+
   class LoggerConfig {
   protected:
     LoggerConfig(void);
@@ -145,6 +399,7 @@ namespace Realm {
     bool cmdline_read;
     Logger::LoggingLevel default_level, stderr_level;
     bool include_timestamp;
+    size_t async_buffer_size;
     std::map<std::string, Logger::LoggingLevel> category_levels;
     std::string cats_enabled;
     std::set<Logger *> pending_configs;
@@ -157,6 +412,7 @@ namespace Realm {
     , default_level(Logger::LEVEL_PRINT)
     , stderr_level(Logger::LEVEL_ERROR)
     , include_timestamp(true)
+    , async_buffer_size(0)
     , stream(0)
     , stderr_stream(0)
     , default_output(0)
@@ -286,6 +542,7 @@ namespace Realm {
       .add_option_method("-level", this, &LoggerConfig::parse_level_argument)
       .add_option_int("-errlevel", stderr_level)
       .add_option_int("-logtime", include_timestamp)
+      .add_option_int_units("-logasync", async_buffer_size, 'k')
       .parse_command_line(cmdline);
 
     if(!ok) {
@@ -294,17 +551,18 @@ namespace Realm {
     }
 
     // lots of choices for log output
+    LoggerFileStream *file_stream = 0;
     if(logname.empty()) {
       // the gasnet UDP job spawner (amudprun) seems to buffer stdout, so make stderr the default
 #ifdef GASNET_CONDUIT_UDP
-      stream = new LoggerFileStream(stderr, false, include_timestamp);
+      file_stream = new LoggerFileStream(stderr, false, include_timestamp);
 #else
-      stream = new LoggerFileStream(stdout, false, include_timestamp);
+      file_stream = new LoggerFileStream(stdout, false, include_timestamp);
 #endif
     } else if(logname == "stdout") {
-      stream = new LoggerFileStream(stdout, false, include_timestamp);
+      file_stream = new LoggerFileStream(stdout, false, include_timestamp);
     } else if(logname == "stderr") {
-      stream = new LoggerFileStream(stderr, false, include_timestamp);
+      file_stream = new LoggerFileStream(stderr, false, include_timestamp);
     } else {
       // we're going to open a file, but key off a + for appending and
       //  look for a % for node number insertion
@@ -346,14 +604,24 @@ namespace Realm {
         }
       }
       // TODO: consider buffering in some cases?
-      setbuf(f, 0); // disable output buffering
-      stream = new LoggerFileStream(f, true, include_timestamp);
+      // the asynchronous writer does its own batching, so only buffer
+      //  the file when it's in use
+      if(async_buffer_size == 0)
+        setbuf(f, 0); // disable output buffering
+      file_stream = new LoggerFileStream(f, true, include_timestamp);
 
       // when logging to a file, also sent critical-enough messages to stderr
       if(stderr_level < Logger::LEVEL_NONE)
         stderr_stream = new LoggerFileStream(stderr, false, include_timestamp);
     }
 
+    // with -logasync, messages are handed to a background thread through
+    //  per-thread ring buffers of the requested size
+    if(async_buffer_size > 0)
+      stream = new LoggerAsyncStream(file_stream, async_buffer_size);
+    else
+      stream = file_stream;
+
     atexit(LoggerConfig::flush_all_streams);
 
     cmdline_read = true;
@@ -1117,7 +1117,7 @@ namespace Realm {
     }
     log_malloc.debug("CPU memory at %p, size = %zd%s%s", base, _size, 
 		     prealloced ? " (prealloced)" : "",
-		     (segment && segment->single_network) ? " (registered)" : "");
+		     (segment && !segment->networks.empty()) ? " (registered)" : "");
     free_blocks[0] = _size;
   }
 
@@ -42,8 +42,25 @@ namespace Realm {
   class NetworkSegment;
   class ByteArray;
 
+  // hash functor used by BasicRangeAllocator's tag table - the default
+  //  hashes the raw bytes of the tag, which is fine for the POD handle types
+  //  used as tags
+  template <typename TT>
+  struct RangeAllocatorTagHash {
+    size_t operator()(const TT& tag) const;
+  };
+
+  template <>
+  struct RangeAllocatorTagHash<RegionInstance> {
+    size_t operator()(const RegionInstance& tag) const;
+  };
+
   // manages a basic free list of ranges (using range type RT) and allocated
   //  ranges, which are tagged (tag type TT)
+  // free ranges are kept in size-segregated lists (one per power of two), so
+  //  a fitting range can usually be found without walking the whole free
+  //  list, and allocated ranges are found by tag through an open-addressed
+  //  hash table
   // NOT thread-safe - must be protected from outside
   template <typename RT, typename TT>
   class BasicRangeAllocator {
@@ -53,19 +70,53 @@ namespace Realm {
 
       RT first, last;  // half-open range: [first, last)
       unsigned prev, next;  // double-linked list of all ranges (by index)
-      unsigned prev_free, next_free;  // double-linked list of just free ranges
+      unsigned prev_free, next_free;  // double-linked list of free ranges in
+                                      //  the same size class
+    };
+
+    // direct lookup of allocated ranges by tag - linear probing with
+    //  backward-shift deletion, so no tombstones accumulate
+    class TagTable {
+    public:
+      TagTable(void);
+
+      void swap(TagTable& swap_with);
+
+      // returns a pointer to the range index for 'tag', or null if missing
+      unsigned *find(const TT& tag);
+      // inserts or overwrites the range index for 'tag'
+      void insert(const TT& tag, unsigned range_idx);
+      // returns true if the tag was present
+      bool erase(const TT& tag);
+
+      size_t size(void) const;
+
+    protected:
+      struct Entry {
+	TT tag;
+	unsigned range_idx;
+	bool valid;
+      };
+
+      size_t slot_for(const TT& tag) const;
+      void grow(void);
+
+      std::vector<Entry> entries;  // capacity is always zero or a power of 2
+      size_t count;
     };
 
-    std::map<TT, unsigned> allocated;  // direct lookup of allocated ranges by tag
+    TagTable allocated;
 #ifdef DEBUG_REALM
     std::map<RT, unsigned> by_first;   // direct lookup of all ranges by first
-    // TODO: sized-based lookup of free ranges
 #endif
 
     static const unsigned SENTINEL = 0;
     // TODO: small (medium?) vector opt
     std::vector<Range> ranges;
 
+    // free ranges are binned by floor(log2(size))
+    static const unsigned NUM_SIZE_CLASSES = 8 * sizeof(RT);
+
     BasicRangeAllocator(void);
     ~BasicRangeAllocator(void);
 
@@ -81,6 +132,18 @@ namespace Realm {
     unsigned first_free_range;
     unsigned alloc_range(RT first, RT last);
     void free_range(unsigned index);
+
+    static unsigned size_class(RT size);
+    void free_list_insert(unsigned index);
+    void free_list_remove(unsigned index);
+    // finds a free range that can hold an aligned allocation of 'size',
+    //  returning SENTINEL if none exists
+    unsigned find_free_range(RT size, RT alignment);
+    unsigned scan_size_classes(unsigned lo, unsigned hi, RT size, RT alignment,
+			       unsigned max_probes);
+
+    std::vector<unsigned> free_class_heads;
+    unsigned long long nonempty_classes;  // bit i set if class i has ranges
   };
   
     class MemoryImpl {
@@ -23,6 +23,159 @@
 
 namespace Realm {
 
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // struct RangeAllocatorTagHash<TT>
+  //
+
+  template <typename TT>
+  inline size_t RangeAllocatorTagHash<TT>::operator()(const TT& tag) const
+  {
+    // FNV-1a over the bytes of the tag
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(&tag);
+    unsigned long long h = 14695981039346656037ULL;
+    for(size_t i = 0; i < sizeof(TT); i++) {
+      h ^= p[i];
+      h *= 1099511628211ULL;
+    }
+    return size_t(h);
+  }
+
+  inline size_t RangeAllocatorTagHash<RegionInstance>::operator()(const RegionInstance& tag) const
+  {
+    // instance IDs from a given memory differ mostly in the low bits, so
+    //  mix those into the high bits with a multiplicative hash
+    unsigned long long h = tag.id * 0x9E3779B97F4A7C15ULL;
+    return size_t(h ^ (h >> 32));
+  }
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class BasicRangeAllocator<RT,TT>::TagTable
+  //
+
+  template <typename RT, typename TT>
+  inline BasicRangeAllocator<RT,TT>::TagTable::TagTable(void)
+    : count(0)
+  {}
+
+  template <typename RT, typename TT>
+  inline void BasicRangeAllocator<RT,TT>::TagTable::swap(TagTable& swap_with)
+  {
+    entries.swap(swap_with.entries);
+    std::swap(count, swap_with.count);
+  }
+
+  template <typename RT, typename TT>
+  inline size_t BasicRangeAllocator<RT,TT>::TagTable::size(void) const
+  {
+    return count;
+  }
+
+  template <typename RT, typename TT>
+  inline size_t BasicRangeAllocator<RT,TT>::TagTable::slot_for(const TT& tag) const
+  {
+    return RangeAllocatorTagHash<TT>()(tag) & (entries.size() - 1);
+  }
+
+  template <typename RT, typename TT>
+  inline unsigned *BasicRangeAllocator<RT,TT>::TagTable::find(const TT& tag)
+  {
+    if(count == 0)
+      return 0;
+
+    size_t mask = entries.size() - 1;
+    size_t slot = slot_for(tag);
+    while(entries[slot].valid) {
+      if(entries[slot].tag == tag)
+	return &entries[slot].range_idx;
+      slot = (slot + 1) & mask;
+    }
+    return 0;
+  }
+
+  template <typename RT, typename TT>
+  inline void BasicRangeAllocator<RT,TT>::TagTable::insert(const TT& tag,
+							   unsigned range_idx)
+  {
+    // keep the load factor at or below 1/2
+    if(2 * (count + 1) > entries.size())
+      grow();
+
+    size_t mask = entries.size() - 1;
+    size_t slot = slot_for(tag);
+    while(entries[slot].valid) {
+      if(entries[slot].tag == tag) {
+	entries[slot].range_idx = range_idx;
+	return;
+      }
+      slot = (slot + 1) & mask;
+    }
+    entries[slot].tag = tag;
+    entries[slot].range_idx = range_idx;
+    entries[slot].valid = true;
+    count++;
+  }
+
+  template <typename RT, typename TT>
+  inline bool BasicRangeAllocator<RT,TT>::TagTable::erase(const TT& tag)
+  {
+    if(count == 0)
+      return false;
+
+    size_t mask = entries.size() - 1;
+    size_t slot = slot_for(tag);
+    while(true) {
+      if(!entries[slot].valid)
+	return false;
+      if(entries[slot].tag == tag)
+	break;
+      slot = (slot + 1) & mask;
+    }
+
+    // backward-shift deletion: pull later members of the probe sequence
+    //  into the hole as long as that doesn't move them before their home slot
+    size_t hole = slot;
+    size_t next = (hole + 1) & mask;
+    while(entries[next].valid) {
+      size_t home = slot_for(entries[next].tag);
+      // can 'next' move to 'hole'? only if 'home' is not cyclically in
+      //  (hole, next]
+      bool movable = ((hole <= next) ?
+		        ((home <= hole) || (home > next)) :
+		        ((home <= hole) && (home > next)));
+      if(movable) {
+	entries[hole] = entries[next];
+	hole = next;
+      }
+      next = (next + 1) & mask;
+    }
+    entries[hole].valid = false;
+    count--;
+    return true;
+  }
+
+  template <typename RT, typename TT>
+  inline void BasicRangeAllocator<RT,TT>::TagTable::grow(void)
+  {
+    std::vector<Entry> old_entries;
+    old_entries.swap(entries);
+
+    size_t new_size = (old_entries.empty() ? 16 : (2 * old_entries.size()));
+    Entry empty;
+    empty.tag = TT();
+    empty.range_idx = SENTINEL;
+    empty.valid = false;
+    entries.resize(new_size, empty);
+    count = 0;
+
+    for(size_t i = 0; i < old_entries.size(); i++)
+      if(old_entries[i].valid)
+	insert(old_entries[i].tag, old_entries[i].range_idx);
+  }
+
+
   ////////////////////////////////////////////////////////////////////////
   //
   // class BasicRangeAllocator<RT,TT>
@@ -40,6 +193,8 @@ namespace Realm {
   template <typename RT, typename TT>
   inline BasicRangeAllocator<RT,TT>::BasicRangeAllocator(void)
     : first_free_range(SENTINEL)
+    , free_class_heads(NUM_SIZE_CLASSES, unsigned(SENTINEL))
+    , nonempty_classes(0)
   {
     ranges.resize(1);
     Range& s = ranges[SENTINEL];
@@ -61,6 +216,8 @@ namespace Realm {
 #endif
     ranges.swap(swap_with.ranges);
     std::swap(first_free_range, swap_with.first_free_range);
+    free_class_heads.swap(swap_with.free_class_heads);
+    std::swap(nonempty_classes, swap_with.nonempty_classes);
   }
 
   template <typename RT, typename TT>
@@ -81,8 +238,7 @@ namespace Realm {
       newr.prev = newr.next = SENTINEL;
       sentinel.prev = sentinel.next = new_idx;
       // free block list
-      newr.prev_free = newr.next_free = SENTINEL;
-      sentinel.prev_free = sentinel.next_free = new_idx;
+      free_list_insert(new_idx);
 
 #ifdef DEBUG_REALM
       by_first[first] = new_idx;
@@ -116,6 +272,117 @@ namespace Realm {
     ranges[index].next = first_free_range;
     first_free_range = index;
   }
+
+  template <typename RT, typename TT>
+  inline /*static*/ unsigned BasicRangeAllocator<RT,TT>::size_class(RT size)
+  {
+    // floor(log2(size)) - size is never zero here
+    assert(size > 0);
+    return (8 * sizeof(unsigned long long) - 1 -
+	    __builtin_clzll((unsigned long long)size));
+  }
+
+  template <typename RT, typename TT>
+  inline void BasicRangeAllocator<RT,TT>::free_list_insert(unsigned index)
+  {
+    Range& r = ranges[index];
+    unsigned sc = size_class(r.last - r.first);
+    unsigned head = free_class_heads[sc];
+    r.prev_free = SENTINEL;
+    r.next_free = head;
+    if(head != SENTINEL)
+      ranges[head].prev_free = index;
+    free_class_heads[sc] = index;
+    nonempty_classes |= (1ULL << sc);
+  }
+
+  template <typename RT, typename TT>
+  inline void BasicRangeAllocator<RT,TT>::free_list_remove(unsigned index)
+  {
+    Range& r = ranges[index];
+    unsigned sc = size_class(r.last - r.first);
+    if(r.prev_free != SENTINEL) {
+      ranges[r.prev_free].next_free = r.next_free;
+    } else {
+      assert(free_class_heads[sc] == index);
+      free_class_heads[sc] = r.next_free;
+      if(r.next_free == SENTINEL)
+	nonempty_classes &= ~(1ULL << sc);
+    }
+    if(r.next_free != SENTINEL)
+      ranges[r.next_free].prev_free = r.prev_free;
+
+    // tie this off because we use it to detect allocated-ness
+    r.prev_free = r.next_free = index;
+  }
+
+  template <typename RT, typename TT>
+  inline unsigned BasicRangeAllocator<RT,TT>::scan_size_classes(unsigned lo,
+								unsigned hi,
+								RT size,
+								RT alignment,
+								unsigned max_probes)
+  {
+    // walks the free lists for classes [lo, hi) looking for a fit, giving
+    //  up after 'max_probes' ranges (if nonzero)
+    unsigned probes = 0;
+    for(unsigned sc = lo; sc < hi; sc++) {
+      unsigned idx = free_class_heads[sc];
+      while(idx != SENTINEL) {
+	const Range& r = ranges[idx];
+	RT ofs = 0;
+	if(alignment) {
+	  RT rem = r.first % alignment;
+	  if(rem > 0)
+	    ofs = alignment - rem;
+	}
+	// do we have enough space?
+	if((r.last - r.first) >= (size + ofs))
+	  return idx;
+
+	if(max_probes && (++probes >= max_probes))
+	  return SENTINEL;
+	idx = r.next_free;
+      }
+    }
+    return SENTINEL;
+  }
+
+  template <typename RT, typename TT>
+  inline unsigned BasicRangeAllocator<RT,TT>::find_free_range(RT size,
+							      RT alignment)
+  {
+    // any range in a class whose lower bound is at least (size + alignment - 1)
+    //  is guaranteed to fit, whereas ranges in smaller classes need to be
+    //  checked individually
+    unsigned lo = size_class(size);
+    unsigned hi = NUM_SIZE_CLASSES;
+    RT worst = size + (alignment ? (alignment - 1) : 0);
+    if(worst >= size) {
+      hi = size_class(worst);
+      // round up unless 'worst' is a power of two
+      if((worst & (worst - 1)) != 0)
+	hi++;
+    }
+
+    // prefer a nearby fit in the smaller classes to limit fragmentation, but
+    //  don't let a long list of near-misses make this linear
+    static const unsigned MAX_NEAR_FIT_PROBES = 16;
+    unsigned idx = scan_size_classes(lo, hi, size, alignment,
+				     MAX_NEAR_FIT_PROBES);
+    if(idx != SENTINEL)
+      return idx;
+
+    // next, take the head of the smallest guaranteed-fit class
+    if(hi < NUM_SIZE_CLASSES) {
+      unsigned long long mask = nonempty_classes & ~((1ULL << hi) - 1);
+      if(mask != 0)
+	return free_class_heads[__builtin_ctzll(mask)];
+    }
+
+    // last resort: exhaustive walk of the classes that might fit
+    return scan_size_classes(lo, hi, size, alignment, 0);
+  }
   
   template <typename RT, typename TT>
   inline bool BasicRangeAllocator<RT,TT>::can_allocate(TT tag,
@@ -126,27 +393,7 @@ namespace Realm {
       return true;
     }
 
-    // walk free ranges and just take the first that fits
-    unsigned idx = ranges[SENTINEL].next_free;
-    while(idx != SENTINEL) {
-      Range *r = &ranges[idx];
-
-      RT ofs = 0;
-      if(alignment) {
-	RT rem = r->first % alignment;
-	if(rem > 0)
-	  ofs = alignment - rem;
-      }
-      // do we have enough space?
-      if((r->last - r->first) >= (size + ofs))
-	return true;
-
-      // no, go to next one
-      idx = r->next_free;
-    }
-
-    // allocation failed
-    return false;
+    return (find_free_range(size, alignment) != SENTINEL);
   }
 
   template <typename RT, typename TT>
@@ -154,141 +401,119 @@ namespace Realm {
   {
     // empty allocation requests are trivial
     if(size == 0) {
-      allocated[tag] = SENTINEL;
+      allocated.insert(tag, SENTINEL);
       return true;
     }
 
-    // walk free ranges and just take the first that fits
-    unsigned idx = ranges[SENTINEL].next_free;
-    while(idx != SENTINEL) {
-      Range *r = &ranges[idx];
+    unsigned idx = find_free_range(size, alignment);
+    if(idx == SENTINEL) {
+      // allocation failed
+      return false;
+    }
 
-      RT ofs = 0;
-      if(alignment) {
-	RT rem = r->first % alignment;
-	if(rem > 0)
-	  ofs = alignment - rem;
-      }
-      // do we have enough space?
-      if((r->last - r->first) >= (size + ofs)) {
-	// yes, but we may need to chop things up to make the exact range we want
-	alloc_first = r->first + ofs;
-	RT alloc_last = alloc_first + size;
-
-        // do we need to carve off a new (free) block before us?
-        if(alloc_first != r->first) {
-	  unsigned new_idx = alloc_range(r->first, alloc_first);
-	  Range *new_prev = &ranges[new_idx];
-	  r = &ranges[idx];  // alloc may have moved this!
-	  
-	  r->first = alloc_first;
-	  // insert into all-block dllist
-	  new_prev->prev = r->prev;
-	  new_prev->next = idx;
-	  ranges[r->prev].next = new_idx;
-	  r->prev = new_idx;
-	  // insert into free-block dllist
-	  new_prev->prev_free = r->prev_free;
-	  new_prev->next_free = idx;
-	  ranges[r->prev_free].next_free = new_idx;
-	  r->prev_free = new_idx;
+    // pull the chosen range off its free list - any leftover pieces are
+    //  (re-)inserted into the appropriate size class below
+    free_list_remove(idx);
+    Range *r = &ranges[idx];
+
+    RT ofs = 0;
+    if(alignment) {
+      RT rem = r->first % alignment;
+      if(rem > 0)
+	ofs = alignment - rem;
+    }
+    alloc_first = r->first + ofs;
+    RT alloc_last = alloc_first + size;
+
+    // do we need to carve off a new (free) block before us?
+    if(alloc_first != r->first) {
+      unsigned new_idx = alloc_range(r->first, alloc_first);
+      Range *new_prev = &ranges[new_idx];
+      r = &ranges[idx];  // alloc may have moved this!
 
 #ifdef DEBUG_REALM
-	  // fix up by_first entries
-	  by_first[r->first] = new_idx;
-	  by_first[alloc_first] = idx;
+      // fix up by_first entries
+      by_first[r->first] = new_idx;
+      by_first[alloc_first] = idx;
 #endif
-        }
-
-	// two cases to deal with
-	if(alloc_last == r->last) {
-	  // case 1 - exact fit
-	  //
-	  // all we have to do here is remove this range from the free range dlist
-	  //  and add to the allocated lookup map
-	  ranges[r->prev_free].next_free = r->next_free;
-	  ranges[r->next_free].prev_free = r->prev_free;
-	} else {
-	  // case 2 - leftover at end - put in new range
-	  unsigned after_idx = alloc_range(alloc_last, r->last);
-	  Range *r_after = &ranges[after_idx];
-	  r = &ranges[idx];  // alloc may have moved this!
+
+      r->first = alloc_first;
+      // insert into all-block dllist
+      new_prev->prev = r->prev;
+      new_prev->next = idx;
+      ranges[r->prev].next = new_idx;
+      r->prev = new_idx;
+      // and into the free lists
+      free_list_insert(new_idx);
+      r = &ranges[idx];
+    }
+
+    // is there leftover at the end?  if so, put it in a new range
+    if(alloc_last != r->last) {
+      unsigned after_idx = alloc_range(alloc_last, r->last);
+      Range *r_after = &ranges[after_idx];
+      r = &ranges[idx];  // alloc may have moved this!
 
 #ifdef DEBUG_REALM
-	  by_first[alloc_last] = after_idx;
+      by_first[alloc_last] = after_idx;
 #endif
-	  r->last = alloc_last;
-	  
-	  // r_after goes after r in all block list
-	  r_after->prev = idx;
-	  r_after->next = r->next;
-	  r->next = after_idx;
-	  ranges[r_after->next].prev = after_idx;
-
-	  // r_after replaces r in the free block list
-	  r_after->prev_free = r->prev_free;
-	  r_after->next_free = r->next_free;
-	  ranges[r_after->next_free].prev_free = after_idx;
-	  ranges[r_after->prev_free].next_free = after_idx;
-	}
-
-	// tie this off because we use it to detect allocated-ness
-	r->prev_free = r->next_free = idx;
+      r->last = alloc_last;
 
-	allocated[tag] = idx;
-	return true;
-      }
+      // r_after goes after r in all block list
+      r_after->prev = idx;
+      r_after->next = r->next;
+      r->next = after_idx;
+      ranges[r_after->next].prev = after_idx;
 
-      // no, go to next one
-      idx = r->next_free;
+      free_list_insert(after_idx);
     }
-    // allocation failed
-    return false;
+
+    allocated.insert(tag, idx);
+    return true;
   }
 
   template <typename RT, typename TT>
   inline void BasicRangeAllocator<RT,TT>::deallocate(TT tag,
 						     bool missing_ok /*= false*/)
   {
-    typename std::map<TT, unsigned>::iterator it = allocated.find(tag);
-    if(it == allocated.end()) {
+    unsigned *entry = allocated.find(tag);
+    if(entry == 0) {
       assert(missing_ok);
       return;
     }
-    unsigned del_idx = it->second;
-    allocated.erase(it);
+    unsigned del_idx = *entry;
+    allocated.erase(tag);
 
     // if there was no Range associated with this tag, it was an zero-size
     //  allocation, and there's nothing to add to the free list
     if(del_idx == SENTINEL)
       return;
 
-    Range& r = ranges[del_idx];
+    // adjacent free ranges are always merged, so only the immediate
+    //  neighbors need to be examined - an allocated range's free links
+    //  point at itself
+    unsigned pf_idx = ranges[del_idx].prev;
+    unsigned nf_idx = ranges[del_idx].next;
+    bool merge_prev = ((pf_idx != SENTINEL) &&
+		       (ranges[pf_idx].prev_free != pf_idx));
+    bool merge_next = ((nf_idx != SENTINEL) &&
+		       (ranges[nf_idx].prev_free != nf_idx));
+
+    // merged ranges change size, so they have to leave their current size
+    //  class before they're modified
+    if(merge_prev)
+      free_list_remove(pf_idx);
+    if(merge_next)
+      free_list_remove(nf_idx);
 
-    unsigned pf_idx = r.prev;
-    while((pf_idx != SENTINEL) && (ranges[pf_idx].prev_free == pf_idx)) {
-      pf_idx = ranges[pf_idx].prev;
-      assert(pf_idx != del_idx);  // wrapping around would be bad
-    }
-    unsigned nf_idx = r.next;
-    while((nf_idx != SENTINEL) && (ranges[nf_idx].next_free == nf_idx)) {
-      nf_idx = ranges[nf_idx].next;
-      assert(nf_idx != del_idx);
-    }
-
-    // do we need to merge?
-    bool merge_prev = (pf_idx == r.prev) && (pf_idx != SENTINEL);
-    bool merge_next = (nf_idx == r.next) && (nf_idx != SENTINEL);
+    Range& r = ranges[del_idx];
 
     // four cases - ordered to match the allocation cases
     if(!merge_next) {
       if(!merge_prev) {
 	// case 1 - no merging (exact match)
 	// just add ourselves to the free list
-	r.prev_free = pf_idx;
-	r.next_free = nf_idx;
-	ranges[pf_idx].next_free = del_idx;
-	ranges[nf_idx].prev_free = del_idx;
+	free_list_insert(del_idx);
       } else {
 	// case 2 - merge before
 	// merge ourselves into the range before
@@ -297,12 +522,12 @@ namespace Realm {
 	r_before.last = r.last;
 	r_before.next = r.next;
 	ranges[r.next].prev = pf_idx;
-	// r_before was already in free list, so no changes to that
 
 #ifdef DEBUG_REALM
 	by_first.erase(r.first);
 #endif
 	free_range(del_idx);
+	free_list_insert(pf_idx);
       }
     } else {
       if(!merge_prev) {
@@ -318,9 +543,9 @@ namespace Realm {
 	r_after.first = r.first;
 	r_after.prev = r.prev;
 	ranges[r.prev].next = nf_idx;
-	// r_after was already in the free list, so no changes to that
 
 	free_range(del_idx);
+	free_list_insert(nf_idx);
       } else {
 	// case 4 - merge both
 	// merge both ourselves and range after into range before
@@ -333,15 +558,12 @@ namespace Realm {
 	by_first.erase(r_after.first);
 #endif
 
-	// adjust both normal list and free list
 	r_before.next = r_after.next;
 	ranges[r_after.next].prev = pf_idx;
 
-	r_before.next_free = r_after.next_free;
-	ranges[r_after.next_free].prev_free = pf_idx;
-
 	free_range(del_idx);
 	free_range(nf_idx);
+	free_list_insert(pf_idx);
       }
     }
   }
@@ -349,16 +571,16 @@ namespace Realm {
   template <typename RT, typename TT>
   inline bool BasicRangeAllocator<RT,TT>::lookup(TT tag, RT& first, RT& size)
   {
-    typename std::map<TT, unsigned>::iterator it = allocated.find(tag);
+    unsigned *entry = allocated.find(tag);
 
-    if(it != allocated.end()) {
+    if(entry != 0) {
       // if there was no Range associated with this tag, it was an zero-size
       //  allocation
-      if(it->second == SENTINEL) {
+      if(*entry == SENTINEL) {
 	first = 0;
 	size = 0;
       } else {
-	const Range& r = ranges[it->second];
+	const Range& r = ranges[*entry];
 	first = r.first;
 	size = r.last - r.first;
       }
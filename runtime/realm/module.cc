@@ -56,6 +56,10 @@
 #if defined REALM_USE_MPI
 #include "realm/mpi/mpi_module.h"
 #endif
+// must come after any inter-node network so that it can be an overlay
+#ifdef REALM_USE_SHM
+#include "realm/shm/shm_module.h"
+#endif
 
 namespace Realm {
 
@@ -14,6 +14,11 @@
  */
 
 #include "am_mpi.h"
+#include "realm/timers.h"
+#include "realm/mutex.h"
+
+#include <deque>
+#include <vector>
 
 
 static MPI_Win g_am_win = MPI_WIN_NULL;
@@ -21,10 +26,11 @@ static void *g_am_base = NULL;
 static __thread int thread_id = 0;
 static __thread int am_seq = 0;
 static Realm::atomic<unsigned int> num_threads(0);
-static unsigned char buf_recv_list[AM_BUF_COUNT][1024];
-static unsigned char *buf_recv = buf_recv_list[0];
+// uint64_t rows keep the packed messages 8-byte aligned
+static uint64_t buf_recv_list[AM_BUF_COUNT][AM_BUF_SIZE / sizeof(uint64_t)];
 static MPI_Request req_recv_list[AM_BUF_COUNT];
 static int n_am_mult_recv = 5;
+static int n_am_max_inflight = AM_MAX_INFLIGHT;
 static int pre_initialized;
 static int node_size;
 static int node_this;
@@ -35,6 +41,377 @@ namespace Realm {
 namespace MPI {
 
 #define AM_MSG_HEADER_SIZE 4 * sizeof(int)
+// medium and long messages put a 64-bit tag/offset in front of the header
+#define AM_MSG_AUX_SIZE 8
+
+static inline int am_msg_padded(int bytes)
+{
+    return (bytes + 7) & ~7;
+}
+
+/*---- outgoing messages ---------------------*/
+
+// one or more messages packed into an eager buffer, along with the number
+//  of medium message payloads that are sent right after it
+struct AMPacket {
+    char *buf;
+    int size;
+    int num_payloads;
+};
+
+// the payload of a medium message
+struct AMPayload {
+    char *buf;
+    int size;
+    int tag;
+};
+
+/* everything headed to one target rank - messages are packed into
+ * eager buffers, handed to MPI_Isend while fewer than n_am_max_inflight
+ * sends (and medium payload sends) are outstanding and queued (and
+ * aggregated) otherwise.  Headers of long messages wait in put_headers
+ * until the window is flushed
+ */
+class AMDestQueue {
+public:
+    AMDestQueue();
+    ~AMDestQueue();
+
+    // returns space for a message of 'bytes' bytes at the end of 'packets'
+    char *append_msg(std::deque<AMPacket>& packets, int bytes);
+    // the header must have just been added to 'queued'
+    void add_medium_payload(char *payload, int payload_size, int msg_tag);
+    void add_put_payload(int tgt, void *payload);
+    // must be called with the mutex held
+    void flush_puts(int tgt);
+    void test_sends();
+    void issue_sends(int tgt);
+    bool is_idle() const;
+    bool can_issue() const;
+
+    Mutex mutex;
+    atomic<bool> active;
+    std::deque<AMPacket> queued;
+    std::deque<AMPayload> queued_payloads;
+    std::deque<AMPacket> put_headers;
+    std::vector<void *> put_payloads;
+
+protected:
+    char *alloc_buffer();
+    void release_buffer(char *buf);
+    static void test_requests(std::vector<MPI_Request>& reqs, std::vector<char *>& bufs,
+                              std::vector<int>& indices, std::vector<char *>& done);
+
+    std::vector<MPI_Request> send_reqs;
+    std::vector<char *> send_bufs;
+    std::vector<MPI_Request> payload_reqs;
+    std::vector<char *> payload_bufs;
+    std::vector<int> indices;
+    std::vector<char *> done;
+    std::vector<char *> free_bufs;
+};
+
+static AMDestQueue *dest_queues = NULL;
+// packets handed to MPI_Isend so far (used by AM_Drain to detect quiescence)
+static atomic<long long> packets_sent(0);
+
+AMDestQueue::AMDestQueue()
+    : active(false)
+{}
+
+AMDestQueue::~AMDestQueue()
+{
+    assert(is_idle());
+    for (size_t i = 0; i < free_bufs.size(); i++) {
+        free(free_bufs[i]);
+    }
+}
+
+char *AMDestQueue::alloc_buffer()
+{
+    if (free_bufs.empty()) {
+        return (char *) malloc(AM_BUF_SIZE);
+    }
+    char *buf = free_bufs.back();
+    free_bufs.pop_back();
+    return buf;
+}
+
+void AMDestQueue::release_buffer(char *buf)
+{
+    if (free_bufs.size() < (size_t) n_am_max_inflight) {
+        free_bufs.push_back(buf);
+    } else {
+        free(buf);
+    }
+}
+
+char *AMDestQueue::append_msg(std::deque<AMPacket>& packets, int bytes)
+{
+    int padded = am_msg_padded(bytes);
+    assert(padded <= AM_BUF_SIZE);
+    active.store(true);
+    if (!packets.empty() && (packets.back().size + padded <= AM_BUF_SIZE)) {
+        AMPacket& pkt = packets.back();
+        char *msg = pkt.buf + pkt.size;
+        pkt.size += padded;
+        return msg;
+    }
+    AMPacket pkt;
+    pkt.buf = alloc_buffer();
+    pkt.size = padded;
+    pkt.num_payloads = 0;
+    packets.push_back(pkt);
+    return pkt.buf;
+}
+
+void AMDestQueue::add_medium_payload(char *payload, int payload_size, int msg_tag)
+{
+    AMPayload p;
+    p.buf = payload;
+    p.size = payload_size;
+    p.tag = msg_tag;
+    queued_payloads.push_back(p);
+    queued.back().num_payloads++;
+}
+
+void AMDestQueue::add_put_payload(int tgt, void *payload)
+{
+    put_payloads.push_back(payload);
+    if (put_payloads.size() >= AM_MAX_PENDING_PUTS) {
+        flush_puts(tgt);
+    }
+}
+
+void AMDestQueue::flush_puts(int tgt)
+{
+    if (put_payloads.empty()) {
+        return;
+    }
+    // one flush covers every put issued to this target so far, including
+    //  all of those whose headers are in put_headers
+    CHECK_MPI( MPI_Win_flush(tgt, g_am_win) );
+    for (size_t i = 0; i < put_payloads.size(); i++) {
+        free(put_payloads[i]);
+    }
+    put_payloads.clear();
+    queued.insert(queued.end(), put_headers.begin(), put_headers.end());
+    put_headers.clear();
+}
+
+/*static*/ void AMDestQueue::test_requests(std::vector<MPI_Request>& reqs, std::vector<char *>& bufs,
+                                           std::vector<int>& indices, std::vector<char *>& done)
+{
+    if (reqs.empty()) {
+        return;
+    }
+    indices.resize(reqs.size());
+    int outcount;
+    CHECK_MPI( MPI_Testsome(reqs.size(), &reqs[0], &outcount, &indices[0], MPI_STATUSES_IGNORE) );
+    if ((outcount == 0) || (outcount == MPI_UNDEFINED)) {
+        return;
+    }
+    for (int i = 0; i < outcount; i++) {
+        done.push_back(bufs[indices[i]]);
+    }
+    // completed requests have been set to MPI_REQUEST_NULL - compact
+    size_t j = 0;
+    for (size_t i = 0; i < reqs.size(); i++) {
+        if (reqs[i] != MPI_REQUEST_NULL) {
+            reqs[j] = reqs[i];
+            bufs[j] = bufs[i];
+            j++;
+        }
+    }
+    reqs.resize(j);
+    bufs.resize(j);
+}
+
+void AMDestQueue::test_sends()
+{
+    test_requests(send_reqs, send_bufs, indices, done);
+    for (size_t i = 0; i < done.size(); i++) {
+        release_buffer(done[i]);
+    }
+    done.clear();
+    test_requests(payload_reqs, payload_bufs, indices, done);
+    for (size_t i = 0; i < done.size(); i++) {
+        free(done[i]);
+    }
+    done.clear();
+}
+
+bool AMDestQueue::can_issue() const
+{
+    if (queued.empty() || (send_reqs.size() >= (size_t) n_am_max_inflight)) {
+        return false;
+    }
+    // a packet's payloads go out with it (a rendezvous payload send can't
+    //  complete before the receiver has seen the header)
+    return (payload_reqs.empty() ||
+            (payload_reqs.size() + queued.front().num_payloads <= (size_t) n_am_max_inflight));
+}
+
+void AMDestQueue::issue_sends(int tgt)
+{
+    if (!queued.empty() && !can_issue()) {
+        test_sends();
+    }
+    while (can_issue()) {
+        AMPacket& pkt = queued.front();
+        MPI_Request req;
+        CHECK_MPI( MPI_Isend(pkt.buf, pkt.size, MPI_BYTE, tgt, 0x1, MPI_COMM_WORLD, &req) );
+        packets_sent.fetch_add(1);
+        send_reqs.push_back(req);
+        send_bufs.push_back(pkt.buf);
+        for (int i = 0; i < pkt.num_payloads; i++) {
+            AMPayload& p = queued_payloads.front();
+            CHECK_MPI( MPI_Isend(p.buf, p.size, MPI_BYTE, tgt, p.tag, comm_medium, &req) );
+            payload_reqs.push_back(req);
+            payload_bufs.push_back(p.buf);
+            queued_payloads.pop_front();
+        }
+        queued.pop_front();
+    }
+}
+
+bool AMDestQueue::is_idle() const
+{
+    return (queued.empty() && put_payloads.empty() &&
+            send_reqs.empty() && payload_reqs.empty());
+}
+
+// flushes puts, retires completed sends and issues queued ones for every
+//  target with outstanding work - returns true if nothing is left
+static bool progress_sends(bool wait_for_lock)
+{
+    bool idle = true;
+    for (int i = 0; i < node_size; i++) {
+        AMDestQueue& q = dest_queues[i];
+        if (!q.active.load()) {
+            continue;
+        }
+        if (wait_for_lock) {
+            q.mutex.lock();
+        } else if (!q.mutex.trylock()) {
+            // somebody else is already making progress on it
+            idle = false;
+            continue;
+        }
+        q.flush_puts(i);
+        q.test_sends();
+        q.issue_sends(i);
+        if (q.is_idle()) {
+            q.active.store(false);
+        } else {
+            idle = false;
+        }
+        q.mutex.unlock();
+    }
+    return idle;
+}
+
+/*---- incoming messages ---------------------*/
+
+// a medium message whose payload is still being received
+struct AMPendingRecv {
+    MPI_Request req;
+    int src;
+    int msgid;
+    int header_size;
+    int payload_size;
+    char *header;
+    char *payload;
+};
+
+// only touched by the polling thread
+static std::vector<AMPendingRecv> pending_recvs;
+static long long packets_received = 0;
+
+static void run_handler(int src, int msgid, const void *header,
+                        const void *payload, int payload_size)
+{
+    Realm::ActiveMessageHandlerTable::MessageHandler handler = Realm::activemsg_handler_table.lookup_message_handler(msgid);
+    long long t_start = 0;
+    if (Realm::Config::profile_activemsg_handlers)
+        t_start = Realm::Clock::current_time_in_nanoseconds();
+    (*handler) (src, header, payload, payload_size);
+    if (Realm::Config::profile_activemsg_handlers)
+        Realm::activemsg_handler_table.record_message_handler_call(msgid, t_start,
+                                                                   Realm::Clock::current_time_in_nanoseconds());
+}
+
+static bool poll_pending_recvs()
+{
+    bool handled = false;
+    size_t i = 0;
+    while (i < pending_recvs.size()) {
+        int done;
+        CHECK_MPI( MPI_Test(&pending_recvs[i].req, &done, MPI_STATUS_IGNORE) );
+        if (!done) {
+            i++;
+            continue;
+        }
+        AMPendingRecv r = pending_recvs[i];
+        pending_recvs[i] = pending_recvs.back();
+        pending_recvs.pop_back();
+        run_handler(r.src, r.msgid, r.header, r.payload, r.payload_size);
+        free(r.header);
+        free(r.payload);
+        handled = true;
+    }
+    return handled;
+}
+
+// handles every message packed into a received buffer
+static void handle_packet(int tn_src, char *buf, int bytes)
+{
+    int offset = 0;
+    while (offset < bytes) {
+        struct AM_msg *msg = (struct AM_msg *)(buf + offset);
+        int msg_size;
+        if (msg->type == 0) {
+            char *header = msg->stuff;
+            char *payload = msg->stuff + msg->header_size;
+            msg_size = AM_MSG_HEADER_SIZE + msg->header_size + msg->payload_size;
+            run_handler(tn_src, msg->msgid, header, payload, msg->payload_size);
+        } else if (msg->type == 1) {
+            // the payload follows as a separate message - receive it without
+            //  blocking and run the handler once it is here
+            AMPendingRecv r;
+            int msg_tag = (int) *(int64_t *)(msg->stuff);
+            r.src = tn_src;
+            r.msgid = msg->msgid;
+            r.header_size = msg->header_size;
+            r.payload_size = msg->payload_size;
+            r.header = (char *) malloc(msg->header_size > 0 ? msg->header_size : 1);
+            memcpy(r.header, msg->stuff + AM_MSG_AUX_SIZE, msg->header_size);
+            r.payload = (char *) malloc(msg->payload_size);
+            CHECK_MPI( MPI_Irecv(r.payload, msg->payload_size, MPI_BYTE, tn_src, msg_tag, comm_medium, &r.req) );
+            // the payload has often already arrived
+            int done;
+            CHECK_MPI( MPI_Test(&r.req, &done, MPI_STATUS_IGNORE) );
+            if (done) {
+                run_handler(r.src, r.msgid, r.header, r.payload, r.payload_size);
+                free(r.header);
+                free(r.payload);
+            } else {
+                pending_recvs.push_back(r);
+            }
+            msg_size = AM_MSG_HEADER_SIZE + AM_MSG_AUX_SIZE + msg->header_size;
+        } else if (msg->type == 2) {
+            MPI_Aint disp = (MPI_Aint) *(int64_t *)(msg->stuff);
+            char *header = msg->stuff + AM_MSG_AUX_SIZE;
+            char *payload = (char *) g_am_base + disp;
+            msg_size = AM_MSG_HEADER_SIZE + AM_MSG_AUX_SIZE + msg->header_size;
+            run_handler(tn_src, msg->msgid, header, payload, msg->payload_size);
+        } else {
+            assert(0 && "invalid message type");
+            break;
+        }
+        offset += am_msg_padded(msg_size);
+    }
+}
 
 
 void AM_Init(int *p_node_this, int *p_node_size)
@@ -59,30 +436,66 @@ void AM_Init(int *p_node_this, int *p_node_size)
     s = getenv("AM_MULT_RECV");
     if (s) {
         n_am_mult_recv = atoi(s);
+        assert((n_am_mult_recv > 0) && (n_am_mult_recv <= AM_BUF_COUNT));
+    }
+    s = getenv("AM_MAX_INFLIGHT");
+    if (s) {
+        n_am_max_inflight = atoi(s);
+        assert(n_am_max_inflight > 0);
     }
     for (int  i = 0; i<n_am_mult_recv; i++) {
-        CHECK_MPI( MPI_Irecv(buf_recv_list[i], 1024, MPI_CHAR, MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &req_recv_list[i]) );
+        CHECK_MPI( MPI_Irecv(buf_recv_list[i], AM_BUF_SIZE, MPI_BYTE, MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &req_recv_list[i]) );
     }
     MPI_Comm_dup(MPI_COMM_WORLD, &comm_medium);
+    dest_queues = new AMDestQueue[node_size];
 }
 
-void AM_Finalize()
+void AM_Drain()
 {
-    MPI_Request req_final;
-
-    CHECK_MPI( MPI_Ibarrier(MPI_COMM_WORLD, &req_final) );
+    /* handlers that run while we wait can send replies, so a single barrier
+     * isn't enough - instead, each round every rank gets its sends out the
+     * door and then all ranks add up (while continuing to poll) how many
+     * packets have been sent and received.  The drain is over once a round
+     * finds them balanced and no rank has sent or handled anything since
+     * the previous round, as nothing can be in flight at that point
+     */
+    long long last_sent = -1;
+    long long last_received = -1;
     while (1) {
-        int is_done;
-        MPI_Status status;
-        CHECK_MPI( MPI_Test(&req_final, &is_done, &status) );
-        if (req_final == MPI_REQUEST_NULL) {
+        while (!progress_sends(true) || !pending_recvs.empty()) {
+            AMPoll();
+        }
+
+        long long sent = packets_sent.load();
+        long long local[2], global[2];
+        local[0] = sent - packets_received;
+        local[1] = (((sent != last_sent) || (packets_received != last_received)) ? 1 : 0);
+        last_sent = sent;
+        last_received = packets_received;
+
+        MPI_Request req_round;
+        CHECK_MPI( MPI_Iallreduce(local, global, 2, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD, &req_round) );
+        while (1) {
+            int is_done;
+            CHECK_MPI( MPI_Test(&req_round, &is_done, MPI_STATUS_IGNORE) );
+            if (is_done) {
+                break;
+            }
+            AMPoll();
+        }
+
+        if ((global[0] == 0) && (global[1] == 0)) {
             break;
         }
-        AMPoll();
     }
+}
 
+void AM_Finalize()
+{
     AMPoll_cancel();
     CHECK_MPI( MPI_Comm_free(&comm_medium) );
+    delete[] dest_queues;
+    dest_queues = NULL;
 
     if (!pre_initialized) {
         MPI_Finalize();
@@ -95,10 +508,13 @@ void AM_init_long_messages(MPI_Win win, void *am_base)
     g_am_base = am_base;
 }
 
-void AMPoll()
+bool AMPoll()
 {
-    struct AM_msg *msg;
-    int tn_src;
+    bool handled = false;
+    progress_sends(false);
+    if (!pending_recvs.empty()) {
+        handled = poll_pending_recvs();
+    }
 
     while (1) {
         int got_am;
@@ -107,47 +523,16 @@ void AMPoll()
         if (!got_am) {
             break;
         }
-        msg = (struct AM_msg *) buf_recv;
+        int bytes;
+        CHECK_MPI( MPI_Get_count(&status, MPI_BYTE, &bytes) );
+        packets_received++;
+        handle_packet(status.MPI_SOURCE, (char *) buf_recv_list[i_recv_list], bytes);
 
-        tn_src = status.MPI_SOURCE;
-
-        char *header;
-        char *payload;
-        int payload_type = 0;
-        if (msg->type == 0) {
-            header = msg->stuff;
-            payload = msg->stuff + msg->header_size;
-        } else if (msg->type == 1) {
-            header = msg->stuff + 4;
-
-            int msg_tag = *(int32_t *)(msg->stuff);
-            payload = (char *) malloc(msg->payload_size);
-            payload_type = 1;    // need_free;
-            CHECK_MPI( MPI_Recv(payload, msg->payload_size, MPI_BYTE, tn_src, msg_tag, comm_medium, &status) );
-        } else if (msg->type == 2) {
-            int offset = *(int32_t *)(msg->stuff);
-            header = msg->stuff + 4;
-            payload = (char *) g_am_base + offset;
-        } else {
-            assert(0 && "invalid message type");
-            header = 0;
-            payload = 0;
-            msg->msgid = 0x7fff; // skips handler below
-        }
-
-        if (msg->msgid != 0x7fff) {
-            Realm::ActiveMessageHandlerTable::MessageHandler handler = Realm::activemsg_handler_table.lookup_message_handler(msg->msgid);
-            (*handler) (tn_src, header, payload, msg->payload_size);
-        }
-
-        if (payload_type == 1) {
-            free(payload);
-        }
-        CHECK_MPI( MPI_Irecv(buf_recv_list[i_recv_list], 1024, MPI_CHAR, MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &req_recv_list[i_recv_list]) );
+        CHECK_MPI( MPI_Irecv(buf_recv_list[i_recv_list], AM_BUF_SIZE, MPI_BYTE, MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &req_recv_list[i_recv_list]) );
         i_recv_list = (i_recv_list + 1) % n_am_mult_recv;
-        buf_recv = buf_recv_list[i_recv_list];
+        handled = true;
     }
-
+    return handled;
 }
 
 void AMPoll_cancel()
@@ -157,54 +542,63 @@ void AMPoll_cancel()
     }
 }
 
-void AMSend(int tgt, int msgid, int header_size, int payload_size, const char *header, const char *payload, int has_dest, MPI_Aint dest)
+void AMSend(int tgt, int msgid, int header_size, int payload_size, const char *header, char *payload, int has_dest, MPI_Aint dest)
 {
-    char buf_send[1024];
-
-    struct AM_msg *msg = (struct AM_msg *)(buf_send);
-    msg->msgid = msgid;
-    msg->header_size = header_size;
-    msg->payload_size = payload_size;
-    char *msg_header = msg->stuff;
+    assert(tgt != node_this);
+    AMDestQueue& q = dest_queues[tgt];
 
     if (has_dest) {
         assert(g_am_win);
+        // the payload is only known to have arrived after the window is
+        //  flushed, so the header waits for the next (batched) flush
         CHECK_MPI( MPI_Put(payload, payload_size, MPI_BYTE, tgt, dest, payload_size, MPI_BYTE, g_am_win) );
-        CHECK_MPI( MPI_Win_flush(tgt, g_am_win) );
 
+        AutoLock<> al(q.mutex);
+        struct AM_msg *msg = (struct AM_msg *) q.append_msg(q.put_headers, AM_MSG_HEADER_SIZE + AM_MSG_AUX_SIZE + header_size);
         msg->type = 2;
-        *((int32_t *) msg_header) = (int32_t) dest;
-        memcpy(msg_header + 4, header, header_size);
-        int n = AM_MSG_HEADER_SIZE + 4 + header_size;
-        assert(tgt != node_this);
-        CHECK_MPI( MPI_Send(buf_send, n, MPI_BYTE, tgt, 0x1, MPI_COMM_WORLD) );
-    } else if (AM_MSG_HEADER_SIZE + header_size + payload_size < 1024) {
+        msg->msgid = msgid;
+        msg->header_size = header_size;
+        msg->payload_size = payload_size;
+        *((int64_t *) msg->stuff) = (int64_t) dest;
+        memcpy(msg->stuff + AM_MSG_AUX_SIZE, header, header_size);
+        q.add_put_payload(tgt, payload);
+        q.issue_sends(tgt);
+    } else if (am_msg_padded(AM_MSG_HEADER_SIZE + header_size + payload_size) <= AM_BUF_SIZE) {
+        AutoLock<> al(q.mutex);
+        struct AM_msg *msg = (struct AM_msg *) q.append_msg(q.queued, AM_MSG_HEADER_SIZE + header_size + payload_size);
         msg->type = 0;
+        msg->msgid = msgid;
+        msg->header_size = header_size;
+        msg->payload_size = payload_size;
         if (header_size > 0) {
-            memcpy(msg_header, header, header_size);
+            memcpy(msg->stuff, header, header_size);
         }
         if (payload_size > 0) {
-            memcpy(msg_header + header_size, payload, payload_size);
+            memcpy(msg->stuff + header_size, payload, payload_size);
         }
-        int n = AM_MSG_HEADER_SIZE + header_size + payload_size;
-        assert(tgt != node_this);
-        CHECK_MPI( MPI_Send(buf_send, n, MPI_CHAR, tgt, 0x1, MPI_COMM_WORLD) );
+        q.issue_sends(tgt);
+        al.release();
+        free(payload);
     } else {
-        msg->type = 1;
         int msg_tag = 0x0;
         if (thread_id == 0) {
             thread_id = num_threads.fetch_add_acqrel(1) + 1;
         }
         am_seq = (am_seq + 1) & 0x1f;
         msg_tag = (thread_id << 10) + am_seq;
-        *((int32_t *) msg_header) = (int32_t) msg_tag;
-        memcpy(msg_header + 4, header, header_size);
-        int n = AM_MSG_HEADER_SIZE + 4 + header_size;
-        assert(tgt != node_this);
-        CHECK_MPI( MPI_Send(buf_send, n, MPI_BYTE, tgt, 0x1, MPI_COMM_WORLD) );
-        assert(tgt != node_this);
-        CHECK_MPI( MPI_Send(payload, payload_size, MPI_BYTE, tgt, msg_tag, comm_medium) );
 
+        // headers and payloads are both issued in order under the lock, so
+        //  the receiver matches them up correctly even if tags repeat
+        AutoLock<> al(q.mutex);
+        struct AM_msg *msg = (struct AM_msg *) q.append_msg(q.queued, AM_MSG_HEADER_SIZE + AM_MSG_AUX_SIZE + header_size);
+        msg->type = 1;
+        msg->msgid = msgid;
+        msg->header_size = header_size;
+        msg->payload_size = payload_size;
+        *((int64_t *) msg->stuff) = (int64_t) msg_tag;
+        memcpy(msg->stuff + AM_MSG_AUX_SIZE, header, header_size);
+        q.add_medium_payload(payload, payload_size, msg_tag);
+        q.issue_sends(tgt);
     }
 }
 
@@ -25,6 +25,15 @@
 #include "realm/activemsg.h"
 
 #define AM_BUF_COUNT 128
+// size of the eager buffers - every message whose header and payload fit
+//  is sent in one of these, and several such messages to the same target
+//  may be packed into a single buffer when sends are backed up
+#define AM_BUF_SIZE 1024
+// default limit on the number of eager sends in flight to each target
+//  (override with the AM_MAX_INFLIGHT environment variable)
+#define AM_MAX_INFLIGHT 64
+// long message puts to a target are flushed in batches of at most this many
+#define AM_MAX_PENDING_PUTS 16
 
 
 #define CHECK_MPI(cmd) do { \
@@ -38,6 +47,11 @@
 namespace Realm {
 namespace MPI {
 
+/* messages are packed back to back into eager buffers, each one starting
+ * on an 8-byte boundary.  type 0 carries the header and payload inline,
+ * types 1 (medium) and 2 (long) carry a 64-bit tag or window offset
+ * followed by the header
+ */
 struct AM_msg {
     int type;
     int msgid;
@@ -49,9 +63,16 @@ struct AM_msg {
 void AM_Init(int *p_node_this, int *p_node_size);
 void AM_Finalize();
 void AM_init_long_messages(MPI_Win win, void *am_base);
-void AMPoll();
+// returns true if any incoming messages were handled
+bool AMPoll();
 void AMPoll_cancel();
-void AMSend(int tgt, int msgid, int header_size, int payload_size, const char *header, const char *payload, int has_dest, MPI_Aint dest);
+// sends everything still queued, servicing incoming messages meanwhile,
+//  and then waits for all ranks to do the same
+void AM_Drain();
+// never blocks - messages that cannot be handed to MPI right away are
+//  queued and sent by AMPoll.  The payload (if any) must be a malloc'd
+//  buffer, which AMSend takes ownership of and frees once it is sent
+void AMSend(int tgt, int msgid, int header_size, int payload_size, const char *header, char *payload, int has_dest, MPI_Aint dest);
 
 
 } /* namespace MPI */
@@ -26,17 +26,18 @@
 
 #define DISP_OFFSET 0x100
 
+// takes ownership of the (malloc'd) payload
 void enqueue_message(int target, int msgid,
                      const void *args, size_t arg_size,
-                     const void *payload, size_t payload_size,
+                     void *payload, size_t payload_size,
                      void *dstptr)
 {
     MPI_Aint disp = (MPI_Aint)dstptr;
     if (disp) {
         /* Displacement is shifted by DISP_OFFSET */
-        Realm::MPI::AMSend(target, msgid, arg_size, payload_size, (const char *) args, (const char *) payload, 1, disp - DISP_OFFSET);
+        Realm::MPI::AMSend(target, msgid, arg_size, payload_size, (const char *) args, (char *) payload, 1, disp - DISP_OFFSET);
     } else {
-        Realm::MPI::AMSend(target, msgid, arg_size, payload_size, (const char *) args, (const char *) payload, 0, 0);
+        Realm::MPI::AMSend(target, msgid, arg_size, payload_size, (const char *) args, (char *) payload, 0, 0);
     }
 }
 
@@ -401,18 +402,30 @@ namespace Realm {
 
     void MPIMessageImpl::commit(size_t act_payload_size)
     {
+        // the send engine takes ownership of the payload buffer, so every
+        //  target but the last of a multicast gets its own copy
         if(is_multicast) {
 	    assert(dest_payload_addr == 0);
+	    size_t remaining = targets.size();
 	    for(NodeSet::const_iterator it = targets.begin();
 		it != targets.end();
-		++it)
+		++it) {
+	       void *payload = payload_base;
+	       if(act_payload_size == 0) {
+		   payload = 0;
+	       } else if(--remaining > 0) {
+		   payload = malloc(act_payload_size);
+		   memcpy(payload, payload_base, act_payload_size);
+	       }
 	       enqueue_message(*it, msgid, &msg_header, header_size,
-			       payload_base, act_payload_size, NULL);
+			       payload, act_payload_size, NULL);
+	    }
+	    if(targets.empty() || (act_payload_size == 0))
+		free(payload_base);
         } else {
             enqueue_message(target, msgid, &msg_header, header_size,
                             payload_base, act_payload_size, dest_payload_addr);
         }
-        free(payload_base);
     }
 
     void MPIMessageImpl::cancel()
@@ -446,7 +459,10 @@ namespace Realm {
                 if (shutdown_flag.load()) {
                     break;
                 }
-                Realm::MPI::AMPoll();
+                // don't hog a core that the other threads of this rank (or
+                //  other ranks) could be using when there's nothing to do
+                if (!Realm::MPI::AMPoll())
+                    Realm::Thread::yield();
             }
         }
         void stop_threads(){
@@ -579,12 +595,14 @@ namespace Realm {
   void MPIModule::detach(RuntimeImpl *runtime,
 			     std::vector<NetworkSegment *>& segments)
   {
+    g_am_manager.stop_threads();
+    g_am_manager.release_corereservation();
+    // queued long messages still need the window to be flushed
+    Realm::MPI::AM_Drain();
     if (g_am_win != MPI_WIN_NULL) {
         CHECK_MPI( MPI_Win_unlock_all(g_am_win) );
         CHECK_MPI( MPI_Win_free(&g_am_win) );
     }
-    g_am_manager.stop_threads();
-    g_am_manager.release_corereservation();
     Realm::MPI::AM_Finalize();
   }
 
@@ -17,6 +17,7 @@
 
 #include "realm/network.h"
 #include "realm/cmdline.h"
+#include "realm/activemsg.h"
 
 namespace Realm {
 
@@ -25,6 +26,126 @@ namespace Realm {
     NodeID max_node_id = 0;
     NodeSet all_peers;
     NetworkModule *single_network = 0;
+#ifdef REALM_USE_MULTIPLE_NETWORKS
+    NetworkModule *primary_network = 0;
+    std::vector<NetworkModule *> node_networks;
+
+    void set_network(NodeID node, NetworkModule *network)
+    {
+      // done during attach, before any messages are sent, or by an overlay
+      //  network handing its nodes back to the primary network on detach
+      if(node_networks.empty())
+	node_networks.assign(max_node_id + 1, primary_network);
+      node_networks[node] = network;
+      single_network = 0;
+    }
+
+    // a multicast message whose targets are reached via more than one
+    //  network - the header and payload are captured and a separate message
+    //  is sent on each network when committed
+    class MultiNetworkMessageImpl : public ActiveMessageImpl {
+    public:
+      MultiNetworkMessageImpl(const NodeSet& _targets,
+			      unsigned short _msgid,
+			      size_t _header_size,
+			      size_t _max_payload_size)
+	: targets(_targets)
+	, msgid(_msgid)
+	, header_size(_header_size)
+      {
+	header_base = malloc(header_size);
+	assert(header_base != 0);
+	if(_max_payload_size) {
+	  payload_base = malloc(_max_payload_size);
+	  assert(payload_base != 0);
+	} else
+	  payload_base = 0;
+	payload_size = _max_payload_size;
+      }
+
+      virtual ~MultiNetworkMessageImpl()
+      {
+	free(header_base);
+	if(payload_base)
+	  free(payload_base);
+      }
+
+      virtual void commit(size_t act_payload_size)
+      {
+	// group the targets by network
+	std::map<NetworkModule *, NodeSet> by_network;
+	for(NodeSet::const_iterator it = targets.begin();
+	    it != targets.end();
+	    ++it)
+	  by_network[node_networks[*it]].add(*it);
+
+	for(std::map<NetworkModule *, NodeSet>::const_iterator it = by_network.begin();
+	    it != by_network.end();
+	    ++it) {
+	  uint64_t storage[256 / sizeof(uint64_t)];
+	  ActiveMessageImpl *impl = it->first->create_active_message_impl(it->second,
+									  msgid,
+									  header_size,
+									  act_payload_size,
+									  storage,
+									  sizeof(storage));
+	  memcpy(impl->header_base, header_base, header_size);
+	  if(act_payload_size)
+	    memcpy(impl->payload_base, payload_base, act_payload_size);
+	  impl->commit(act_payload_size);
+	  impl->~ActiveMessageImpl();
+	}
+      }
+
+      virtual void cancel()
+      {
+	// nothing was sent
+      }
+
+    protected:
+      NodeSet targets;
+      unsigned short msgid;
+      size_t header_size;
+    };
+
+    ActiveMessageImpl *create_multi_network_message_impl(const NodeSet& targets,
+							 unsigned short msgid,
+							 size_t header_size,
+							 size_t max_payload_size,
+							 void *storage_base,
+							 size_t storage_size)
+    {
+      // common case is that all the targets use the same network
+      NetworkModule *network = 0;
+      bool mixed = false;
+      for(NodeSet::const_iterator it = targets.begin();
+	  it != targets.end();
+	  ++it) {
+	if(!network)
+	  network = node_networks[*it];
+	else if(node_networks[*it] != network) {
+	  mixed = true;
+	  break;
+	}
+      }
+
+      if(!mixed) {
+	if(!network) network = primary_network;
+	return network->create_active_message_impl(targets,
+						   msgid,
+						   header_size,
+						   max_payload_size,
+						   storage_base,
+						   storage_size);
+      }
+
+      assert(sizeof(MultiNetworkMessageImpl) <= storage_size);
+      return new(storage_base) MultiNetworkMessageImpl(targets,
+						       msgid,
+						       header_size,
+						       max_payload_size);
+    }
+#endif
   }
 
 
@@ -225,6 +346,14 @@ namespace Realm {
     ByteArray& ba = networks[network];
     ba.set(data, len);
 #ifdef REALM_USE_MULTIPLE_NETWORKS
+    // the fast path only applies while a single network has bound the segment
+    if(networks.size() == 1) {
+      single_network = network;
+      single_network_data = &ba;
+    } else {
+      single_network = 0;
+      single_network_data = 0;
+    }
 #else
     assert(single_network == 0);
     single_network = network;
@@ -238,7 +367,7 @@ namespace Realm {
       return single_network_data;
     } else {
 #ifdef REALM_USE_MULTIPLE_NETWORKS
-      std::map<NetworkModule *, ByteArray>::iterator it = networks.find(network);
+      std::map<NetworkModule *, ByteArray>::const_iterator it = networks.find(network);
       if(it != networks.end())
 	return &(it->second);
 #endif
@@ -269,10 +398,17 @@ namespace Realm {
       NetworkModule *m = nreg->create_network_module(runtime, argc, argv);
       if(m) {
 	modules.push_back(m);
-#ifndef REALM_USE_MULTIPLE_NETWORKS
+#ifdef REALM_USE_MULTIPLE_NETWORKS
+	// the first module created is the primary network - later ones may
+	//  claim some of the nodes for themselves during attach
+	if(Network::primary_network == 0) {
+	  Network::primary_network = m;
+	  Network::single_network = m;
+	}
+#else
 	assert(Network::single_network == 0);
-#endif
 	Network::single_network = m;
+#endif
 	need_loopback = false;
       }
     }
@@ -283,6 +419,9 @@ namespace Realm {
       modules.push_back(m);
       assert(Network::single_network == 0);
       Network::single_network = m;
+#ifdef REALM_USE_MULTIPLE_NETWORKS
+      Network::primary_network = m;
+#endif
     }
   }
 
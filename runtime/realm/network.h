@@ -25,6 +25,7 @@
 #include "realm/bytearray.h"
 
 #include <map>
+#include <vector>
 
 namespace Realm {
 
@@ -45,6 +46,26 @@ namespace Realm {
     //  this so we don't have to do a per-node lookup
     extern NetworkModule *single_network;
 
+#ifdef REALM_USE_MULTIPLE_NETWORKS
+    // the first network module loaded assigns node IDs and handles all
+    //  collective operations - other modules may take over the traffic to
+    //  some of the nodes (e.g. peers on the same host), in which case
+    //  single_network is cleared and each node's network is looked up here
+    extern NetworkModule *primary_network;
+    extern std::vector<NetworkModule *> node_networks;
+
+    // called by a network module (normally during attach) to claim a node
+    void set_network(NodeID node, NetworkModule *network);
+
+    // multicasts whose targets may be spread across networks
+    ActiveMessageImpl *create_multi_network_message_impl(const NodeSet& targets,
+							 unsigned short msgid,
+							 size_t header_size,
+							 size_t max_payload_size,
+							 void *storage_base,
+							 size_t storage_size);
+#endif
+
     // gets the network for a given node
     NetworkModule *get_network(NodeID node);
 
@@ -26,7 +26,8 @@ namespace Realm {
     inline NetworkModule *get_network(NodeID node)
     {
 #ifdef REALM_USE_MULTIPLE_NETWORKS
-      if(REALM_UNLILELY(single_network == 0)) {
+      if(REALM_UNLIKELY(single_network == 0)) {
+	return node_networks[node];
       } else
 #endif
 	return single_network;
@@ -36,6 +37,7 @@ namespace Realm {
     {
 #ifdef REALM_USE_MULTIPLE_NETWORKS
       if(REALM_UNLIKELY(single_network == 0)) {
+	primary_network->barrier();
       } else
 #endif
 	single_network->barrier();
@@ -68,6 +70,7 @@ namespace Realm {
     {
 #ifdef REALM_USE_MULTIPLE_NETWORKS
       if(REALM_UNLIKELY(single_network == 0)) {
+	primary_network->broadcast(root, val_in, val_out, bytes);
       } else
 #endif
 	single_network->broadcast(root, val_in, val_out, bytes);
@@ -78,6 +81,7 @@ namespace Realm {
     {
 #ifdef REALM_USE_MULTIPLE_NETWORKS
       if(REALM_UNLIKELY(single_network == 0)) {
+	primary_network->gather(root, val_in, vals_out, bytes);
       } else
 #endif
 	single_network->gather(root, val_in, vals_out, bytes);
@@ -93,6 +97,13 @@ namespace Realm {
     {
 #ifdef REALM_USE_MULTIPLE_NETWORKS
       if(REALM_UNLIKELY(single_network == 0)) {
+	return node_networks[target]->create_active_message_impl(target,
+								 msgid,
+								 header_size,
+								 max_payload_size,
+								 dest_payload_addr,
+								 storage_base,
+								 storage_size);
       } else
 #endif
 	return single_network->create_active_message_impl(target,
@@ -113,6 +124,13 @@ namespace Realm {
     {
 #ifdef REALM_USE_MULTIPLE_NETWORKS
       if(REALM_UNLIKELY(single_network == 0)) {
+	// targets may be spread across networks
+	return create_multi_network_message_impl(targets,
+						 msgid,
+						 header_size,
+						 max_payload_size,
+						 storage_base,
+						 storage_size);
       } else
 #endif
 	return single_network->create_active_message_impl(targets,
@@ -190,30 +190,7 @@ namespace Realm {
       //log_omp.print() << "barrier enter: id=" << wi->thread_id;
 
       if(wi->work_item && (wi->num_threads > 1)) {
-	// step 1: observe that barrier is not still being exited
-	int c;
-	do {
-	  c = wi->work_item->barrier_count.load();
-	} while(c >= wi->num_threads);
-	// step 2: increment counter to enter
-	c = wi->work_item->barrier_count.fetch_add(1) + 1;
-	if(c == wi->num_threads) {
-	  // last arriver - reset count once all others have exited
-	  //   reset "single" winner too
-	  wi->work_item->single_winner.store(-1);
-	  while(true) {
-	    int expval = 2 * wi->num_threads - 1;
-	    if(wi->work_item->barrier_count.compare_exchange(expval, 0))
-	      break;
-	  }
-	} else {
-	  // step 3: observe that all threads have entered
-	  do {
-	    c = wi->work_item->barrier_count.load();
-	  } while(c < wi->num_threads);
-	  // step 4: increment counter again to exit
-	  wi->work_item->barrier_count.fetch_add(1);
-	}
+	wi->work_item->barrier(wi->thread_id);
       } else {
 	// not inside a larger construct - nothing to do
       }
@@ -253,8 +230,8 @@ namespace Realm {
       return more;
     }
 
-    bool GOMP_loop_dynamic_start(long start, long end, long incr, long chunk,
-				 long *istart, long *iend)
+    static bool gomp_loop_dynamic_start(long start, long end, long incr, long chunk,
+					long *istart, long *iend, bool guided)
     {
       Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info();
       if(!wi) {
@@ -268,14 +245,18 @@ namespace Realm {
       // loops must be inside work items
       assert(wi->work_item != 0);
 
-      log_omp.debug() << "loop dynamic start: start=" << start
+      log_omp.debug() << "loop " << (guided ? "guided" : "dynamic")
+		      << " start: start=" << start
 		      << " end=" << end << " incr=" << incr
 		      << " chunk=" << chunk;
 
-      wi->work_item->schedule.start_dynamic(start, end, incr, chunk);
+      wi->work_item->schedule.start_dynamic(start, end, incr, chunk,
+					    wi->thread_id, guided);
       int64_t span_start, span_end;
-      long stride = 0; // not used
-      bool more = wi->work_item->schedule.next_dynamic(span_start, span_end, stride);
+      int64_t stride = 0; // not used
+      bool more = wi->work_item->schedule.next_dynamic(wi->thread_id,
+						       span_start, span_end,
+						       stride);
       if(more) {
 	*istart = span_start;
 	*iend = span_end;
@@ -283,6 +264,54 @@ namespace Realm {
       return more;
     }
 
+    bool GOMP_loop_dynamic_start(long start, long end, long incr, long chunk,
+				 long *istart, long *iend)
+    {
+      return gomp_loop_dynamic_start(start, end, incr, chunk,
+				     istart, iend, false /*!guided*/);
+    }
+
+    bool GOMP_loop_nonmonotonic_dynamic_start(long start, long end,
+					      long incr, long chunk,
+					      long *istart, long *iend)
+    {
+      return gomp_loop_dynamic_start(start, end, incr, chunk,
+				     istart, iend, false /*!guided*/);
+    }
+
+    bool GOMP_loop_guided_start(long start, long end, long incr, long chunk,
+				long *istart, long *iend)
+    {
+      return gomp_loop_dynamic_start(start, end, incr, chunk,
+				     istart, iend, true /*guided*/);
+    }
+
+    bool GOMP_loop_nonmonotonic_guided_start(long start, long end,
+					     long incr, long chunk,
+					     long *istart, long *iend)
+    {
+      return gomp_loop_dynamic_start(start, end, incr, chunk,
+				     istart, iend, true /*guided*/);
+    }
+
+    // there's no run-sched-var to consult, so schedule(runtime) loops get
+    //  the guided schedule, which balances load with far fewer dispatches
+    //  than a dynamic one
+    bool GOMP_loop_runtime_start(long start, long end, long incr,
+				 long *istart, long *iend)
+    {
+      return gomp_loop_dynamic_start(start, end, incr, 1 /*chunk*/,
+				     istart, iend, true /*guided*/);
+    }
+
+    bool GOMP_loop_maybe_nonmonotonic_runtime_start(long start, long end,
+						    long incr,
+						    long *istart, long *iend)
+    {
+      return gomp_loop_dynamic_start(start, end, incr, 1 /*chunk*/,
+				     istart, iend, true /*guided*/);
+    }
+
     void GOMP_loop_end_nowait(void)
     {
       Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info();
@@ -343,8 +372,10 @@ namespace Realm {
       log_omp.debug() << "loop dynamic next: pstart=" << *istart
 		      << " pend=" << *iend;
 
+      // guided loops are continued the same way
       int64_t span_start, span_end, stride;
-      bool more = wi->work_item->schedule.next_dynamic(span_start, span_end,
+      bool more = wi->work_item->schedule.next_dynamic(wi->thread_id,
+						       span_start, span_end,
 						       stride);
 
       if(more) {
@@ -358,6 +389,31 @@ namespace Realm {
       return more;
     }
 
+    bool GOMP_loop_nonmonotonic_dynamic_next(long *istart, long *iend)
+    {
+      return GOMP_loop_dynamic_next(istart, iend);
+    }
+
+    bool GOMP_loop_guided_next(long *istart, long *iend)
+    {
+      return GOMP_loop_dynamic_next(istart, iend);
+    }
+
+    bool GOMP_loop_nonmonotonic_guided_next(long *istart, long *iend)
+    {
+      return GOMP_loop_dynamic_next(istart, iend);
+    }
+
+    bool GOMP_loop_runtime_next(long *istart, long *iend)
+    {
+      return GOMP_loop_dynamic_next(istart, iend);
+    }
+
+    bool GOMP_loop_maybe_nonmonotonic_runtime_next(long *istart, long *iend)
+    {
+      return GOMP_loop_dynamic_next(istart, iend);
+    }
+
     static unsigned hash_gomp_critical_name(void **pptr)
     {
       uintptr_t v = reinterpret_cast<uintptr_t>(pptr);
@@ -870,12 +926,29 @@ namespace Realm {
     // kmp uses an inclusive upper bound, so add the increment to get
     //  the exclusive form
     ub += st;
-      
-    log_omp.debug() << "loop dynamic start: start=" << lb
+
+    // ignore the monotonic/nonmonotonic modifiers - guided and auto
+    //  schedules get guided loops, everything else is dynamic (static
+    //  loops don't come through here unless they're chunked or ordered)
+    bool guided;
+    switch(schedtype & ~((1 << 29) | (1 << 30))) {
+    case 36 /* kmp_sch_guided_chunked */:
+    case 37 /* kmp_sch_runtime */:
+    case 38 /* kmp_sch_auto */:
+    case 42 /* kmp_sch_guided_iterative_chunked */:
+    case 43 /* kmp_sch_guided_analytical_chunked */:
+      guided = true; break;
+    default:
+      guided = false; break;
+    }
+
+    log_omp.debug() << "loop " << (guided ? "guided" : "dynamic")
+		    << " start: start=" << lb
 		    << " end=" << ub << " incr=" << st
 		    << " chunk=" << chunk;
 
-    wi->work_item->schedule.start_dynamic(lb, ub, st, chunk);
+    wi->work_item->schedule.start_dynamic(lb, ub, st, chunk,
+					  wi->thread_id, guided);
   }
 
   void __kmpc_dispatch_init_4(ident_t *loc, kmp_int32 global_tid,
@@ -932,7 +1005,8 @@ namespace Realm {
     assert(wi->work_item != 0);
 
     int64_t span_start, span_end, stride;
-    if(wi->work_item->schedule.next_dynamic(span_start, span_end,
+    if(wi->work_item->schedule.next_dynamic(wi->thread_id,
+					    span_start, span_end,
 					    stride)) {
       log_omp.debug() << "loop dynamic next: start=" << span_start
 		      << " end=" << span_end;
@@ -1077,30 +1151,7 @@ namespace Realm {
     //log_omp.print() << "barrier enter: id=" << wi->thread_id;
 
     if(wi->work_item && (wi->num_threads > 1)) {
-      // step 1: observe that barrier is not still being exited
-      int c;
-      do {
-	c = wi->work_item->barrier_count.load();
-      } while(c >= wi->num_threads);
-      // step 2: increment counter to enter
-      c = wi->work_item->barrier_count.fetch_add(1) + 1;
-      if(c == wi->num_threads) {
-	// last arriver - reset count once all others have exited
-	//   reset "single" winner too
-	wi->work_item->single_winner.store(-1);
-	while(true) {
-	  int expval = 2 * wi->num_threads - 1;
-	  if(wi->work_item->barrier_count.compare_exchange(expval, 0))
-	    break;
-	}
-      } else {
-	// step 3: observe that all threads have entered
-	do {
-	  c = wi->work_item->barrier_count.load();
-	} while(c < wi->num_threads);
-	// step 4: increment counter again to exit
-	wi->work_item->barrier_count.fetch_add(1);
-      }
+      wi->work_item->barrier(wi->thread_id);
     } else {
       // not inside a larger construct - nothing to do
     }
@@ -34,7 +34,11 @@ namespace Realm {
   {
     num_workers = _num_workers;
     loop_pos.store(0);
+    loop_guided.store(false);
     loop_barrier.store(0);
+    chunk_caches.resize(num_workers);
+    for(int i = 0; i < num_workers; i++)
+      chunk_caches[i].next = chunk_caches[i].limit = 0;
   }
 
   static inline uint64_t index_to_pos(int64_t index,
@@ -138,7 +142,8 @@ namespace Realm {
   }
 
   void LoopSchedule::start_dynamic(int64_t start, int64_t end,
-				   int64_t incr, int64_t chunk)
+				   int64_t incr, int64_t chunk,
+				   int thread_id, bool guided /*= false*/)
   {
     // make sure nobody's still on the previous loop
     while(loop_barrier.load() >= num_workers) Thread::yield();
@@ -162,10 +167,10 @@ namespace Realm {
       if(chunk == 0) chunk = 1;
     }
 
-    // if the chunk size is so large that n-1 of the workers can
-    //  cause an overshoot that wraps around, we have a problem
-    uint64_t limit_overshoot = (limit + ((num_workers - 1) *
-					 (uint64_t)chunk));
+    // if the chunk size is so large that the final (failed) claims of the
+    //  workers can cause an overshoot that wraps around, we have a problem
+    uint64_t limit_overshoot = (limit + (num_workers *
+					 (uint64_t)chunk * CACHED_CHUNKS));
     assert(limit_overshoot > limit);
 
     // the compiler promises all threads will have the same value, so
@@ -176,26 +181,87 @@ namespace Realm {
     loop_base.store(start);
     loop_incr.store(incr);
     loop_chunk.store(chunk);
+    loop_guided.store(guided);
+
+    // nothing cached from the previous loop
+    chunk_caches[thread_id].next = chunk_caches[thread_id].limit = 0;
 
     // signal that we're in the loop
     loop_barrier.fetch_add(1);
   }
 
-  bool LoopSchedule::next_dynamic(int64_t& span_start, int64_t& span_end,
+  bool LoopSchedule::claim_dynamic(int thread_id,
+				   uint64_t& pos, uint64_t& count)
+  {
+    uint64_t chunk = loop_chunk.load();
+    uint64_t limit = loop_limit.load();
+    ChunkCache& cache = chunk_caches[thread_id];
+
+    // anything left from our last claim?
+    if(cache.next < cache.limit) {
+      pos = cache.next;
+      count = std::min(chunk, (cache.limit - pos));
+      cache.next += count;
+      return true;
+    }
+
+    // while each worker still has several batches left, claim a batch of
+    //  chunks with a single atomic increment - near the end of the loop,
+    //  go back to single chunks to keep the load balanced
+    uint64_t claim = chunk;
+    uint64_t cur_pos = loop_pos.load();
+    if((cur_pos < limit) &&
+       (((limit - cur_pos) / num_workers) >= (4 * CACHED_CHUNKS * chunk)))
+      claim = CACHED_CHUNKS * chunk;
+
+    // atomic increment to claim new chunk(s)
+    uint64_t new_pos = loop_pos.fetch_add(claim);
+    if(new_pos >= limit)
+      return false;
+
+    uint64_t claim_end = std::min(new_pos + claim, limit);
+    pos = new_pos;
+    count = std::min(chunk, (claim_end - new_pos));
+    cache.next = new_pos + count;
+    cache.limit = claim_end;
+    return true;
+  }
+
+  bool LoopSchedule::claim_guided(uint64_t& pos, uint64_t& count)
+  {
+    uint64_t chunk = loop_chunk.load();
+    uint64_t limit = loop_limit.load();
+
+    // each claim takes a share of what's left (but at least a chunk), so
+    //  this needs a compare-and-swap rather than an increment
+    uint64_t cur_pos = loop_pos.load();
+    while(cur_pos < limit) {
+      uint64_t remaining = limit - cur_pos;
+      uint64_t want = (remaining + (2 * num_workers) - 1) / (2 * num_workers);
+      if(want < chunk) want = chunk;
+      if(want > remaining) want = remaining;
+      if(loop_pos.compare_exchange(cur_pos, cur_pos + want)) {
+	pos = cur_pos;
+	count = want;
+	return true;
+      }
+    }
+    return false;
+  }
+
+  bool LoopSchedule::next_dynamic(int thread_id,
+				  int64_t& span_start, int64_t& span_end,
 				  int64_t& stride)
   {
     // we use these a bunch, and it's ok to cache them
     int64_t base = loop_base.load();
     int64_t incr = loop_incr.load();
-    int64_t chunk = loop_chunk.load();
-    uint64_t limit = loop_limit.load();
-      
-    // atomic increment to claim a new chunk
-    uint64_t new_pos = loop_pos.fetch_add(chunk);
 
-    if(new_pos < limit) {
-      uint64_t count = std::min((uint64_t)chunk,
-				(limit - new_pos));
+    uint64_t new_pos, count;
+    bool ok = (loop_guided.load() ?
+	         claim_guided(new_pos, count) :
+	         claim_dynamic(thread_id, new_pos, count));
+    if(ok) {
       span_start = pos_to_index(new_pos, base, incr);
       span_end = pos_to_index(new_pos + count, base, incr);
       stride = incr;
@@ -244,14 +310,46 @@ namespace Realm {
   // class ThreadPool::WorkItem
 
   ThreadPool::WorkItem::WorkItem(int _num_threads)
-    : remaining_workers(_num_threads)
+    : num_threads(_num_threads)
+    , remaining_workers(_num_threads)
     , single_winner(-1)
-    , barrier_count(0)
+    , barrier_generation(0)
+    , barrier_arrivals(_num_threads)
     , critical_flags(0)
   {
     schedule.initialize(_num_threads);
   }
 
+  void ThreadPool::WorkItem::barrier(int thread_id)
+  {
+    if(num_threads <= 1) return;
+
+    // the generation can't advance until we've arrived, so this is the
+    //  one we're waiting to see end
+    unsigned gen = barrier_generation.load_acquire();
+    unsigned target = gen + 1;
+
+    // wait for our subtree to arrive
+    for(int i = 1; i <= BARRIER_FANIN; i++) {
+      int child = (thread_id * BARRIER_FANIN) + i;
+      if(child >= num_threads) break;
+      while(barrier_arrivals[child].count.load_acquire() != target)
+	Thread::yield();
+    }
+
+    if(thread_id != 0) {
+      // report the arrival of our subtree and wait to be released
+      barrier_arrivals[thread_id].count.store_release(target);
+      while(barrier_generation.load_acquire() == gen)
+	Thread::yield();
+    } else {
+      // everybody has arrived - reset the "single" winner before anybody
+      //  can leave, and then release the team
+      single_winner.store(-1);
+      barrier_generation.store_release(target);
+    }
+  }
+
 
   ////////////////////////////////////////////////////////////////////////
   //
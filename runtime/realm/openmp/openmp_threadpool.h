@@ -19,6 +19,8 @@
 
 #include "realm/threads.h"
 
+#include <vector>
+
 namespace Realm {
 
   class LoopSchedule {
@@ -42,11 +44,15 @@ namespace Realm {
     // starts a dynamic loop, blocking if the previous loop in the
     //  work item has any stragglers - does not actually request any
     //  work - use next_dynamic for that
+    // a guided loop hands out chunks proportional to the remaining work
+    //  (but no smaller than 'chunk')
     void start_dynamic(int64_t start, int64_t end,
-		       int64_t incr, int64_t chunk);
+		       int64_t incr, int64_t chunk,
+		       int thread_id, bool guided = false);
 
-    // continues a dynamic loop
-    bool next_dynamic(int64_t& span_start, int64_t& span_end,
+    // continues a dynamic (or guided) loop
+    bool next_dynamic(int thread_id,
+		      int64_t& span_start, int64_t& span_end,
 		      int64_t& stride);
 
     // indicates this thread is done with the current loop - blocks
@@ -55,12 +61,28 @@ namespace Realm {
     void end_loop(bool wait);
 
   protected:
+    // while there's plenty of work left, a thread claims this many chunks
+    //  of a dynamic loop at once and hands them out from its own cache
+    static const int CACHED_CHUNKS = 4;
+
+    bool claim_dynamic(int thread_id, uint64_t& pos, uint64_t& count);
+    bool claim_guided(uint64_t& pos, uint64_t& count);
+
+    // claimed but not yet issued positions of a dynamic loop - padded so
+    //  that threads don't share cache lines
+    struct ChunkCache {
+      uint64_t next, limit;
+      char pad[64 - 2 * sizeof(uint64_t)];
+    };
+
     int num_workers;
     // loop bounds and position are done with unsigned values to
     //  allow detection of overflow
     atomic<uint64_t> loop_pos, loop_limit;
     atomic<int64_t> loop_base, loop_incr, loop_chunk;
+    atomic<bool> loop_guided;
     atomic<int> loop_barrier;
+    std::vector<ChunkCache> chunk_caches;
   };
 
   class ThreadPool {
@@ -77,12 +99,31 @@ namespace Realm {
     struct WorkItem {
       WorkItem(int _num_threads);
 
+      // blocks until every thread in the team has reached the barrier
+      // arrivals are combined up a tree (each thread waits for at most
+      //  BARRIER_FANIN children) and thread 0 releases everybody by
+      //  advancing the barrier generation, so no location is updated by
+      //  more than a handful of threads
+      void barrier(int thread_id);
+
+      static const int BARRIER_FANIN = 4;
+
+      // per-thread arrival counters, padded to avoid false sharing
+      struct BarrierArrival {
+	atomic<unsigned> count;
+	char pad[64 - sizeof(atomic<unsigned>)];
+
+	BarrierArrival(void) : count(0) {}
+      };
+
+      int num_threads;
       int prev_thread_id;
       int prev_num_threads;
       WorkItem *parent_work_item;
       atomic<int> remaining_workers;
       atomic<int> single_winner;  // worker currently assigned as the "single" one
-      atomic<int> barrier_count;
+      atomic<unsigned> barrier_generation;
+      std::vector<BarrierArrival> barrier_arrivals;
       atomic<uint64_t> critical_flags;
       LoopSchedule schedule;
     };
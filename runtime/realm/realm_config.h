@@ -44,6 +44,16 @@
 //define REALM_USE_KERNEL_AIO
 #endif
 
+// if set, async file I/O can also use Linux's io_uring interface (selected
+//  at runtime with -ll:io_uring)
+#if defined(REALM_ON_LINUX) && !defined(REALM_NO_USE_IO_URING)
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define REALM_USE_IO_URING
+#endif
+#endif
+#endif
+
 // dynamic loading via dlfcn and a not-completely standard dladdr extension
 #ifdef REALM_USE_LIBDL
 #define REALM_USE_DLFCN
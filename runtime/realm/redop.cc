@@ -0,0 +1,428 @@
+/* Copyright 2020 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// vectorized kernels for exclusive reductions of contiguous data
+
+#include "realm/redop.h"
+
+#include <assert.h>
+
+// the SIMD kernels are compiled for each instruction set with target
+//  attributes rather than compiler flags, and the best one is picked when
+//  first used, so a baseline build still uses AVX2/AVX-512 when available
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define REALM_REDOP_USE_X86_SIMD
+#include <immintrin.h>
+#define REALM_TARGET_AVX2   __attribute__((target("avx2")))
+#define REALM_TARGET_AVX512 __attribute__((target("avx512f,avx512dq")))
+// gcc's own avx512 headers trip this warning when the intrinsics are inlined
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#endif
+
+namespace Realm {
+
+  namespace SIMDReductions {
+
+    // the element-wise definitions every kernel has to match exactly,
+    //  including for NaNs, which is why MIN/MAX are written as compares
+    //  with the rhs first (this is also what the x86 min/max do)
+    template <class T, int OP>
+    static inline T scalar_op(T lhs, T rhs)
+    {
+      switch(OP) {
+      case SUM: return lhs + rhs;
+      case PROD: return lhs * rhs;
+      case MIN: return ((rhs < lhs) ? rhs : lhs);
+      case MAX: return ((rhs > lhs) ? rhs : lhs);
+      }
+      return lhs;
+    }
+
+    template <class T, int OP>
+    static void reduce_scalar(T *lhs, const T *rhs, size_t count)
+    {
+      for(size_t i = 0; i < count; i++)
+	lhs[i] = scalar_op<T,OP>(lhs[i], rhs[i]);
+    }
+
+#ifdef REALM_REDOP_USE_X86_SIMD
+    // each vector type provides load/store and op<OP>(rhs, lhs) - ops an
+    //  instruction set lacks are never selected by the dispatch below
+
+    // the loop is the same for every instruction set, but has to be
+    //  compiled with the matching target for the intrinsics to inline
+#define REALM_REDOP_SIMD_LOOP(name, target)				\
+    template <class VT, int OP>						\
+    target static void name(typename VT::T *lhs,			\
+			    const typename VT::T *rhs, size_t count)	\
+    {									\
+      size_t i = 0;							\
+      for(; (i + VT::N) <= count; i += VT::N)				\
+	VT::store(lhs + i, VT::template op<OP>(VT::load(rhs + i),	\
+					       VT::load(lhs + i)));	\
+      for(; i < count; i++)						\
+	lhs[i] = scalar_op<typename VT::T,OP>(lhs[i], rhs[i]);		\
+    }
+
+    // SSE2 is part of x86_64, so no target attribute is needed
+    struct SSE2_F32 {
+      typedef float T;
+      typedef __m128 V;
+      enum { N = 4 };
+      static V load(const T *p) { return _mm_loadu_ps(p); }
+      static void store(T *p, V v) { _mm_storeu_ps(p, v); }
+      template <int OP>
+      static V op(V r, V l)
+      {
+	switch(OP) {
+	case SUM: return _mm_add_ps(r, l);
+	case PROD: return _mm_mul_ps(r, l);
+	case MIN: return _mm_min_ps(r, l);
+	case MAX: return _mm_max_ps(r, l);
+	}
+	return l;
+      }
+    };
+
+    struct SSE2_F64 {
+      typedef double T;
+      typedef __m128d V;
+      enum { N = 2 };
+      static V load(const T *p) { return _mm_loadu_pd(p); }
+      static void store(T *p, V v) { _mm_storeu_pd(p, v); }
+      template <int OP>
+      static V op(V r, V l)
+      {
+	switch(OP) {
+	case SUM: return _mm_add_pd(r, l);
+	case PROD: return _mm_mul_pd(r, l);
+	case MIN: return _mm_min_pd(r, l);
+	case MAX: return _mm_max_pd(r, l);
+	}
+	return l;
+      }
+    };
+
+    // only SUM is available for integers without SSE4.1
+    template <class IT>
+    struct SSE2_Int {
+      typedef IT T;
+      typedef __m128i V;
+      enum { N = 16 / sizeof(IT) };
+      static V load(const T *p) { return _mm_loadu_si128((const V *)p); }
+      static void store(T *p, V v) { _mm_storeu_si128((V *)p, v); }
+      template <int OP>
+      static V op(V r, V l)
+      {
+	if(sizeof(IT) == 4)
+	  return _mm_add_epi32(r, l);
+	else
+	  return _mm_add_epi64(r, l);
+      }
+    };
+
+    REALM_REDOP_SIMD_LOOP(reduce_sse2, )
+
+    struct AVX2_F32 {
+      typedef float T;
+      typedef __m256 V;
+      enum { N = 8 };
+      REALM_TARGET_AVX2 static V load(const T *p) { return _mm256_loadu_ps(p); }
+      REALM_TARGET_AVX2 static void store(T *p, V v) { _mm256_storeu_ps(p, v); }
+      template <int OP>
+      REALM_TARGET_AVX2 static V op(V r, V l)
+      {
+	switch(OP) {
+	case SUM: return _mm256_add_ps(r, l);
+	case PROD: return _mm256_mul_ps(r, l);
+	case MIN: return _mm256_min_ps(r, l);
+	case MAX: return _mm256_max_ps(r, l);
+	}
+	return l;
+      }
+    };
+
+    struct AVX2_F64 {
+      typedef double T;
+      typedef __m256d V;
+      enum { N = 4 };
+      REALM_TARGET_AVX2 static V load(const T *p) { return _mm256_loadu_pd(p); }
+      REALM_TARGET_AVX2 static void store(T *p, V v) { _mm256_storeu_pd(p, v); }
+      template <int OP>
+      REALM_TARGET_AVX2 static V op(V r, V l)
+      {
+	switch(OP) {
+	case SUM: return _mm256_add_pd(r, l);
+	case PROD: return _mm256_mul_pd(r, l);
+	case MIN: return _mm256_min_pd(r, l);
+	case MAX: return _mm256_max_pd(r, l);
+	}
+	return l;
+      }
+    };
+
+    struct AVX2_I32 {
+      typedef int32_t T;
+      typedef __m256i V;
+      enum { N = 8 };
+      REALM_TARGET_AVX2 static V load(const T *p) { return _mm256_loadu_si256((const V *)p); }
+      REALM_TARGET_AVX2 static void store(T *p, V v) { _mm256_storeu_si256((V *)p, v); }
+      template <int OP>
+      REALM_TARGET_AVX2 static V op(V r, V l)
+      {
+	switch(OP) {
+	case SUM: return _mm256_add_epi32(r, l);
+	case PROD: return _mm256_mullo_epi32(r, l);
+	case MIN: return _mm256_min_epi32(r, l);
+	case MAX: return _mm256_max_epi32(r, l);
+	}
+	return l;
+      }
+    };
+
+    // no 64-bit multiply in AVX2, and min/max have to be built from compares
+    struct AVX2_I64 {
+      typedef int64_t T;
+      typedef __m256i V;
+      enum { N = 4 };
+      REALM_TARGET_AVX2 static V load(const T *p) { return _mm256_loadu_si256((const V *)p); }
+      REALM_TARGET_AVX2 static void store(T *p, V v) { _mm256_storeu_si256((V *)p, v); }
+      template <int OP>
+      REALM_TARGET_AVX2 static V op(V r, V l)
+      {
+	switch(OP) {
+	case SUM: return _mm256_add_epi64(r, l);
+	case MIN: return _mm256_blendv_epi8(r, l, _mm256_cmpgt_epi64(r, l));
+	case MAX: return _mm256_blendv_epi8(l, r, _mm256_cmpgt_epi64(r, l));
+	}
+	return l;
+      }
+    };
+
+    REALM_REDOP_SIMD_LOOP(reduce_avx2, REALM_TARGET_AVX2)
+
+    struct AVX512_F32 {
+      typedef float T;
+      typedef __m512 V;
+      enum { N = 16 };
+      REALM_TARGET_AVX512 static V load(const T *p) { return _mm512_loadu_ps(p); }
+      REALM_TARGET_AVX512 static void store(T *p, V v) { _mm512_storeu_ps(p, v); }
+      template <int OP>
+      REALM_TARGET_AVX512 static V op(V r, V l)
+      {
+	switch(OP) {
+	case SUM: return _mm512_add_ps(r, l);
+	case PROD: return _mm512_mul_ps(r, l);
+	case MIN: return _mm512_min_ps(r, l);
+	case MAX: return _mm512_max_ps(r, l);
+	}
+	return l;
+      }
+    };
+
+    struct AVX512_F64 {
+      typedef double T;
+      typedef __m512d V;
+      enum { N = 8 };
+      REALM_TARGET_AVX512 static V load(const T *p) { return _mm512_loadu_pd(p); }
+      REALM_TARGET_AVX512 static void store(T *p, V v) { _mm512_storeu_pd(p, v); }
+      template <int OP>
+      REALM_TARGET_AVX512 static V op(V r, V l)
+      {
+	switch(OP) {
+	case SUM: return _mm512_add_pd(r, l);
+	case PROD: return _mm512_mul_pd(r, l);
+	case MIN: return _mm512_min_pd(r, l);
+	case MAX: return _mm512_max_pd(r, l);
+	}
+	return l;
+      }
+    };
+
+    struct AVX512_I32 {
+      typedef int32_t T;
+      typedef __m512i V;
+      enum { N = 16 };
+      REALM_TARGET_AVX512 static V load(const T *p) { return _mm512_loadu_si512(p); }
+      REALM_TARGET_AVX512 static void store(T *p, V v) { _mm512_storeu_si512(p, v); }
+      template <int OP>
+      REALM_TARGET_AVX512 static V op(V r, V l)
+      {
+	switch(OP) {
+	case SUM: return _mm512_add_epi32(r, l);
+	case PROD: return _mm512_mullo_epi32(r, l);
+	case MIN: return _mm512_min_epi32(r, l);
+	case MAX: return _mm512_max_epi32(r, l);
+	}
+	return l;
+      }
+    };
+
+    struct AVX512_I64 {
+      typedef int64_t T;
+      typedef __m512i V;
+      enum { N = 8 };
+      REALM_TARGET_AVX512 static V load(const T *p) { return _mm512_loadu_si512(p); }
+      REALM_TARGET_AVX512 static void store(T *p, V v) { _mm512_storeu_si512(p, v); }
+      template <int OP>
+      REALM_TARGET_AVX512 static V op(V r, V l)
+      {
+	switch(OP) {
+	case SUM: return _mm512_add_epi64(r, l);
+	case PROD: return _mm512_mullo_epi64(r, l);
+	case MIN: return _mm512_min_epi64(r, l);
+	case MAX: return _mm512_max_epi64(r, l);
+	}
+	return l;
+      }
+    };
+
+    REALM_REDOP_SIMD_LOOP(reduce_avx512, REALM_TARGET_AVX512)
+#endif
+
+    template <class T>
+    struct KernelTable {
+      typedef void (*Kernel)(T *lhs, const T *rhs, size_t count);
+      Kernel kernels[4];
+
+      KernelTable(void)
+      {
+	kernels[SUM] = &reduce_scalar<T,SUM>;
+	kernels[PROD] = &reduce_scalar<T,PROD>;
+	kernels[MIN] = &reduce_scalar<T,MIN>;
+	kernels[MAX] = &reduce_scalar<T,MAX>;
+      }
+
+      template <class VT>
+      void use_sse2(int first_op, int last_op)
+      {
+#ifdef REALM_REDOP_USE_X86_SIMD
+	if((first_op <= SUM) && (SUM <= last_op))
+	  kernels[SUM] = &reduce_sse2<VT,SUM>;
+	if((first_op <= PROD) && (PROD <= last_op))
+	  kernels[PROD] = &reduce_sse2<VT,PROD>;
+	if((first_op <= MIN) && (MIN <= last_op))
+	  kernels[MIN] = &reduce_sse2<VT,MIN>;
+	if((first_op <= MAX) && (MAX <= last_op))
+	  kernels[MAX] = &reduce_sse2<VT,MAX>;
+#endif
+      }
+    };
+
+    struct Dispatch {
+      KernelTable<float> f32;
+      KernelTable<double> f64;
+      KernelTable<int32_t> i32;
+      KernelTable<int64_t> i64;
+      const char *isa;
+
+      Dispatch(void)
+	: isa("scalar")
+      {
+#ifdef REALM_REDOP_USE_X86_SIMD
+	__builtin_cpu_init();
+	// SSE2 is always there on x86_64
+	isa = "sse2";
+	f32.use_sse2<SSE2_F32>(SUM, MAX);
+	f64.use_sse2<SSE2_F64>(SUM, MAX);
+	i32.use_sse2<SSE2_Int<int32_t> >(SUM, SUM);
+	i64.use_sse2<SSE2_Int<int64_t> >(SUM, SUM);
+	if(__builtin_cpu_supports("avx2")) {
+	  isa = "avx2";
+	  set_all<float, AVX2_F32, reduce_avx2_table>(f32);
+	  set_all<double, AVX2_F64, reduce_avx2_table>(f64);
+	  set_all<int32_t, AVX2_I32, reduce_avx2_table>(i32);
+	  i64.kernels[SUM] = &reduce_avx2<AVX2_I64,SUM>;
+	  i64.kernels[MIN] = &reduce_avx2<AVX2_I64,MIN>;
+	  i64.kernels[MAX] = &reduce_avx2<AVX2_I64,MAX>;
+	}
+	if(__builtin_cpu_supports("avx512f") &&
+	   __builtin_cpu_supports("avx512dq")) {
+	  isa = "avx512";
+	  set_all<float, AVX512_F32, reduce_avx512_table>(f32);
+	  set_all<double, AVX512_F64, reduce_avx512_table>(f64);
+	  set_all<int32_t, AVX512_I32, reduce_avx512_table>(i32);
+	  set_all<int64_t, AVX512_I64, reduce_avx512_table>(i64);
+	}
+#endif
+      }
+
+#ifdef REALM_REDOP_USE_X86_SIMD
+      // function templates can't be template template arguments, so the
+      //  loops are wrapped up in these
+      struct reduce_avx2_table {
+	template <class VT, int OP>
+	static void (*get(void))(typename VT::T *, const typename VT::T *, size_t)
+	{ return &reduce_avx2<VT,OP>; }
+      };
+
+      struct reduce_avx512_table {
+	template <class VT, int OP>
+	static void (*get(void))(typename VT::T *, const typename VT::T *, size_t)
+	{ return &reduce_avx512<VT,OP>; }
+      };
+
+      template <class T, class VT, class LOOPS>
+      static void set_all(KernelTable<T>& table)
+      {
+	table.kernels[SUM] = LOOPS::template get<VT,SUM>();
+	table.kernels[PROD] = LOOPS::template get<VT,PROD>();
+	table.kernels[MIN] = LOOPS::template get<VT,MIN>();
+	table.kernels[MAX] = LOOPS::template get<VT,MAX>();
+      }
+#endif
+    };
+
+    static const Dispatch& get_dispatch(void)
+    {
+      // initialized on first use, which is thread-safe
+      static Dispatch dispatch;
+      return dispatch;
+    }
+
+    void reduce(Operator op, float *lhs, const float *rhs, size_t count)
+    {
+      assert((op >= SUM) && (op <= MAX));
+      (*get_dispatch().f32.kernels[op])(lhs, rhs, count);
+    }
+
+    void reduce(Operator op, double *lhs, const double *rhs, size_t count)
+    {
+      assert((op >= SUM) && (op <= MAX));
+      (*get_dispatch().f64.kernels[op])(lhs, rhs, count);
+    }
+
+    void reduce(Operator op, int32_t *lhs, const int32_t *rhs, size_t count)
+    {
+      assert((op >= SUM) && (op <= MAX));
+      (*get_dispatch().i32.kernels[op])(lhs, rhs, count);
+    }
+
+    void reduce(Operator op, int64_t *lhs, const int64_t *rhs, size_t count)
+    {
+      assert((op >= SUM) && (op <= MAX));
+      (*get_dispatch().i64.kernels[op])(lhs, rhs, count);
+    }
+
+    const char *instruction_set(void)
+    {
+      return get_dispatch().isa;
+    }
+
+  }; // namespace SIMDReductions
+
+}; // namespace Realm
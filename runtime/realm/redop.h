@@ -19,6 +19,7 @@
 #define REALM_REDOP_H
 
 #include <sys/types.h>
+#include <stdint.h>
 
 namespace Realm {
 
@@ -81,6 +82,66 @@ namespace Realm {
   	  has_identity(_has_identity), is_foldable(_is_foldable) {}
     };
 
+    // vectorized exclusive reductions of contiguous arrays - these are
+    //  dispatched at runtime to the widest SIMD instruction set (SSE2, AVX2,
+    //  AVX-512) the processor supports, and produce exactly the same
+    //  results as the element-wise loops:
+    //    SUM:  lhs[i] += rhs[i]
+    //    PROD: lhs[i] *= rhs[i]
+    //    MIN:  if(rhs[i] < lhs[i]) lhs[i] = rhs[i]
+    //    MAX:  if(rhs[i] > lhs[i]) lhs[i] = rhs[i]
+    namespace SIMDReductions {
+      enum Operator {
+	SUM,
+	PROD,
+	MIN,
+	MAX
+      };
+
+      void reduce(Operator op, float *lhs, const float *rhs, size_t count);
+      void reduce(Operator op, double *lhs, const double *rhs, size_t count);
+      void reduce(Operator op, int32_t *lhs, const int32_t *rhs, size_t count);
+      void reduce(Operator op, int64_t *lhs, const int64_t *rhs, size_t count);
+
+      // the instruction set used by the kernels, for reporting
+      const char *instruction_set(void);
+    };
+
+    // exclusive apply/fold of contiguous arrays - the default is the
+    //  element-wise loop, but reduction ops that match one of the
+    //  SIMDReductions can specialize this to use them instead
+    template <class REDOP>
+    struct ReductionKernels {
+      static void apply_exclusive(typename REDOP::LHS *lhs,
+				  const typename REDOP::RHS *rhs, size_t count)
+      {
+	for(size_t i = 0; i < count; i++)
+	  REDOP::template apply<true>(lhs[i], rhs[i]);
+      }
+
+      static void fold_exclusive(typename REDOP::RHS *rhs1,
+				 const typename REDOP::RHS *rhs2, size_t count)
+      {
+	for(size_t i = 0; i < count; i++)
+	  REDOP::template fold<true>(rhs1[i], rhs2[i]);
+      }
+    };
+
+    // helper for specializations of ReductionKernels whose apply and fold
+    //  are both the same SIMDReductions operator on T
+    template <class T, SIMDReductions::Operator OP>
+    struct SIMDReductionKernels {
+      static void apply_exclusive(T *lhs, const T *rhs, size_t count)
+      {
+	SIMDReductions::reduce(OP, lhs, rhs, count);
+      }
+
+      static void fold_exclusive(T *rhs1, const T *rhs2, size_t count)
+      {
+	SIMDReductions::reduce(OP, rhs1, rhs2, count);
+      }
+    };
+
 #ifdef NEED_TO_FIX_REDUCTION_LISTS_FOR_DEPPART
     template <class LHS, class RHS>
     struct ReductionListEntry {
@@ -114,8 +175,7 @@ namespace Realm {
 	typename REDOP::LHS *lhs = static_cast<typename REDOP::LHS *>(lhs_ptr);
 	const typename REDOP::RHS *rhs = static_cast<const typename REDOP::RHS *>(rhs_ptr);
 	if(exclusive) {
-	  for(size_t i = 0; i < count; i++)
-	    REDOP::template apply<true>(lhs[i], rhs[i]);
+	  ReductionKernels<REDOP>::apply_exclusive(lhs, rhs, count);
 	} else {
 	  for(size_t i = 0; i < count; i++)
 	    REDOP::template apply<false>(lhs[i], rhs[i]);
@@ -126,7 +186,14 @@ namespace Realm {
 				 off_t lhs_stride, off_t rhs_stride, size_t count,
 				 bool exclusive = false) const
       {
-	if(exclusive) {
+	if(exclusive &&
+	   (lhs_stride == sizeof(typename REDOP::LHS)) &&
+	   (rhs_stride == sizeof(typename REDOP::RHS))) {
+	  // dense - same as the non-strided case
+	  ReductionKernels<REDOP>::apply_exclusive(static_cast<typename REDOP::LHS *>(lhs_ptr),
+						   static_cast<const typename REDOP::RHS *>(rhs_ptr),
+						   count);
+	} else if(exclusive) {
 	  for(size_t i = 0; i < count; i++) {
 	    REDOP::template apply<true>(*static_cast<typename REDOP::LHS *>(lhs_ptr),
 					*static_cast<const typename REDOP::RHS *>(rhs_ptr));
@@ -149,8 +216,7 @@ namespace Realm {
 	typename REDOP::RHS *rhs1 = static_cast<typename REDOP::RHS *>(rhs1_ptr);
 	const typename REDOP::RHS *rhs2 = static_cast<const typename REDOP::RHS *>(rhs2_ptr);
 	if(exclusive) {
-	  for(size_t i = 0; i < count; i++)
-	    REDOP::template fold<true>(rhs1[i], rhs2[i]);
+	  ReductionKernels<REDOP>::fold_exclusive(rhs1, rhs2, count);
 	} else {
 	  for(size_t i = 0; i < count; i++)
 	    REDOP::template fold<false>(rhs1[i], rhs2[i]);
@@ -161,7 +227,14 @@ namespace Realm {
 				off_t lhs_stride, off_t rhs_stride, size_t count,
 				bool exclusive = false) const
       {
-	if(exclusive) {
+	if(exclusive &&
+	   (lhs_stride == sizeof(typename REDOP::RHS)) &&
+	   (rhs_stride == sizeof(typename REDOP::RHS))) {
+	  // dense - same as the non-strided case
+	  ReductionKernels<REDOP>::fold_exclusive(static_cast<typename REDOP::RHS *>(lhs_ptr),
+						  static_cast<const typename REDOP::RHS *>(rhs_ptr),
+						  count);
+	} else if(exclusive) {
 	  for(size_t i = 0; i < count; i++) {
 	    REDOP::template fold<true>(*static_cast<typename REDOP::RHS *>(lhs_ptr),
 				       *static_cast<const typename REDOP::RHS *>(rhs_ptr));
@@ -1096,6 +1096,10 @@ namespace Realm {
       // are hyperthreads considered to share a physical core
       bool hyperthread_sharing = true;
       bool pin_dma_threads = false;
+      // should file/disk channels use io_uring instead of AIO?
+      bool use_io_uring = false;
+      // copy threads for large memcpy channel copies
+      MemcpyPoolConfig memcpy_pool;
       size_t bitset_chunk_size = 32 << 10; // 32KB
       // based on some empirical measurements, 1024 nodes seems like
       //  a reasonable cutoff for switching to twolevel nodeset bitmasks
@@ -1109,6 +1113,11 @@ namespace Realm {
 	.add_option_int_units("-ll:stacksize", stack_size, 'm')
 	.add_option_int("-ll:dma", dma_worker_threads)
         .add_option_bool("-ll:pin_dma", pin_dma_threads)
+	.add_option_bool("-ll:io_uring", use_io_uring)
+	.add_option_int_units("-ll:io_uring_maxrw", Config::io_uring_max_rw)
+	.add_option_int("-ll:memcpy_threads", memcpy_pool.num_threads)
+	.add_option_int_units("-ll:memcpy_split", memcpy_pool.split_size, 'k')
+	.add_option_int_units("-ll:memcpy_nt", memcpy_pool.nontemporal_size, 'm')
 	.add_option_int("-ll:dummy_rsrv_ok", dummy_reservation_ok)
 	.add_option_bool("-ll:show_rsrv", show_reservations)
 	.add_option_int("-ll:ht_sharing", hyperthread_sharing)
@@ -1129,10 +1138,13 @@ namespace Realm {
 
       cp.add_option_int("-realm:eventloopcheck", Config::event_loop_detection_limit);
       cp.add_option_bool("-ll:force_kthreads", Config::force_kernel_threads);
+      cp.add_option_bool("-ll:worksteal", Config::use_work_stealing);
       cp.add_option_bool("-ll:frsrv_fallback", Config::use_fast_reservation_fallback);
       cp.add_option_int("-ll:machine_query_cache", Config::use_machine_query_cache);
       cp.add_option_int("-ll:defalloc", Config::deferred_instance_allocation);
       cp.add_option_int("-ll:amprofile", Config::profile_activemsg_handlers);
+      cp.add_option_int("-ll:event_batch", Config::event_batch_window);
+      cp.add_option_int("-ll:event_batch_max", Config::event_batch_max_size);
 
       bool cmdline_ok = cp.parse_command_line(cmdline);
 
@@ -1327,6 +1339,8 @@ namespace Realm {
 
       PartitioningOpQueue::start_worker_threads(*core_reservations);
 
+      event_message_batcher.start(*core_reservations);
+
 #ifdef EVENT_TRACING
       // Always initialize even if we won't dump to file, otherwise segfaults happen
       // when we try to save event info
@@ -1425,8 +1439,10 @@ namespace Realm {
       // start dma system at the very ending of initialization
       // since we need list of local gpus to create channels
       start_dma_system(dma_worker_threads,
-		       pin_dma_threads, 100
-		       ,*core_reservations);
+		       pin_dma_threads, 100,
+		       use_io_uring,
+		       memcpy_pool,
+		       *core_reservations);
 
       // now that we've created all the processors/etc., we can try to come up with core
       //  allocations that satisfy everybody's requirements - this will also start up any
@@ -2111,6 +2127,11 @@ namespace Realm {
 
       // the operation tables on every rank should be clear of work
       optable.shutdown_check();
+
+      // no more batching of event notifications - anything still pending
+      //  has to be sent before the barrier
+      event_message_batcher.stop();
+
       Network::barrier();
       
       // mark that a shutdown is in progress so that we can hopefully catch
@@ -2129,16 +2150,19 @@ namespace Realm {
       stop_dma_worker_threads();
       stop_dma_system();
 
-      // detach from the network
-      for(std::vector<NetworkModule *>::const_iterator it = network_modules.begin();
-	  it != network_modules.end();
+      // detach from the network - in reverse order so that networks layered
+      //  on top of the primary one go first
+      for(std::vector<NetworkModule *>::const_reverse_iterator it = network_modules.rbegin();
+	  it != network_modules.rend();
 	  it++)
 	(*it)->detach(this, network_segments);
 
       sampling_profiler.shutdown();
 
-      if(Config::profile_activemsg_handlers)
+      if(Config::profile_activemsg_handlers) {
 	activemsg_handler_table.report_message_handler_stats();
+	event_message_batcher.report_stats();
+      }
 
       {
 	std::vector<ProcessorImpl *>& local_procs = nodes[Network::my_node_id].processors;
@@ -0,0 +1,1278 @@
+/* Copyright 2020 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// shared memory network module implementation for Realm
+
+#include "realm/shm/shm_module.h"
+
+#include "realm/runtime_impl.h"
+#include "realm/mem_impl.h"
+#include "realm/activemsg.h"
+#include "realm/cmdline.h"
+#include "realm/logging.h"
+#include "realm/threads.h"
+#include "realm/timers.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#include <sstream>
+
+namespace Realm {
+
+  Logger log_shm("shm");
+
+  namespace Shm {
+
+    static const uint64_t REGION_MAGIC = 0x5245414c4d53484dULL;  // "REALMSHM"
+
+    // the first thing in each process's shared region
+    struct RegionHeader {
+      uint64_t magic;
+      uintptr_t owner_base;  // where the owner has the region mapped
+      size_t total_size;
+      size_t num_rings, ring_size;
+      size_t rings_offset;   // RingControl[num_rings], then the ring buffers
+    };
+
+    // one ring per sender in each receiver's region - the head is only
+    //  written by the sender and the tail only by the receiver, so they live
+    //  on separate cache lines
+    struct RingControl {
+      atomic<size_t> head;
+      char pad1[64 - sizeof(atomic<size_t>)];
+      atomic<size_t> tail;
+      char pad2[64 - sizeof(atomic<size_t>)];
+    };
+
+    // used for barriers and to move data for the standalone collectives
+    struct ControlRegion {
+      uint64_t magic;
+      atomic<unsigned> barrier_count;
+      atomic<unsigned> barrier_generation;
+      size_t scratch_size;
+      char scratch[1];  // actually scratch_size bytes
+    };
+
+    static const size_t CONTROL_SCRATCH_SIZE = 64 << 10;
+
+    enum {
+      REC_INLINE = 0,      // header and payload follow
+      REC_DEST = 1,        // payload already copied to 'extra' (receiver's address)
+      REC_FRAG_START = 2,  // header and first chunk follow, 'extra' is total size
+      REC_FRAG_CONT = 3,   // next chunk of the payload
+    };
+
+    // every record in a ring starts with one of these, followed by the
+    //  message header, padded to a multiple of 8 bytes so that the payload is
+    //  aligned (deserialization depends on it) - a zero 'bytes' field means
+    //  the rest of the ring buffer is unused and the next record is at the
+    //  start
+    struct RecordHeader {
+      uint32_t bytes;
+      unsigned short msgid;
+      unsigned short type;
+      uint32_t header_size;
+      uint32_t payload_size;
+      uint64_t extra;
+    };
+
+    // a record that did not fit in a ring (yet)
+    struct OverflowRecord {
+      RecordHeader rh;
+      size_t len;
+      char data[1];  // actually len bytes
+    };
+
+    static inline size_t round_up(size_t v, size_t align)
+    {
+      return ((v + align - 1) / align) * align;
+    }
+
+    // children forked by rank 0 in standalone mode
+    static std::vector<pid_t> child_pids;
+
+    static void wait_for_children(void)
+    {
+      int failures = 0;
+      for(size_t i = 0; i < child_pids.size(); i++) {
+	int status;
+	pid_t ret;
+	do {
+	  ret = waitpid(child_pids[i], &status, 0);
+	} while((ret < 0) && (errno == EINTR));
+	if((ret < 0) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+	  fprintf(stderr, "shm: rank %zd (pid %d) did not exit cleanly\n",
+		  i + 1, (int)child_pids[i]);
+	  failures++;
+	}
+      }
+      if(failures > 0)
+	_exit(1);
+    }
+
+  }; // namespace Shm
+
+  using namespace Shm;
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class ShmRemoteMemory
+  //
+
+  // a memory in another process's shared region - it's mapped here too, so
+  //  RDMA is just a memcpy
+  class ShmRemoteMemory : public RemoteMemory {
+  public:
+    ShmRemoteMemory(Memory _me, size_t _size, Memory::Kind k,
+		    char *_local_base, char *_owner_base);
+
+    virtual void get_bytes(off_t offset, void *dst, size_t size);
+    virtual void put_bytes(off_t offset, const void *src, size_t size);
+
+    virtual void *get_remote_addr(off_t offset);
+
+  protected:
+    char *local_base;  // where we have it mapped
+    char *owner_base;  // where the owner has it mapped
+  };
+
+  ShmRemoteMemory::ShmRemoteMemory(Memory _me, size_t _size, Memory::Kind k,
+				   char *_local_base, char *_owner_base)
+    : RemoteMemory(_me, _size, k, MKIND_RDMA)
+    , local_base(_local_base)
+    , owner_base(_owner_base)
+  {}
+
+  void ShmRemoteMemory::get_bytes(off_t offset, void *dst, size_t size)
+  {
+    memcpy(dst, local_base + offset, size);
+  }
+
+  void ShmRemoteMemory::put_bytes(off_t offset, const void *src, size_t size)
+  {
+    memcpy(local_base + offset, src, size);
+    // the owner may be polling for the data
+    __sync_synchronize();
+  }
+
+  void *ShmRemoteMemory::get_remote_addr(off_t offset)
+  {
+    // long messages are addressed in the receiver's address space and
+    //  translated by the sender
+    return owner_base + offset;
+  }
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class ShmMessageImpl
+  //
+
+  class ShmMessageImpl : public ActiveMessageImpl {
+  public:
+    ShmMessageImpl(ShmModule *_module,
+		   NodeID _target,
+		   unsigned short _msgid,
+		   size_t _header_size,
+		   size_t _max_payload_size,
+		   void *_dest_payload_addr);
+    ShmMessageImpl(ShmModule *_module,
+		   const NodeSet &_targets,
+		   unsigned short _msgid,
+		   size_t _header_size,
+		   size_t _max_payload_size);
+
+    virtual ~ShmMessageImpl();
+
+    virtual void commit(size_t act_payload_size);
+    virtual void cancel();
+
+  protected:
+    ShmModule *module;
+    NodeID target;
+    NodeSet targets;
+    bool is_multicast;
+    void *dest_payload_addr;
+    size_t header_size;
+    unsigned short msgid;
+    uint64_t msg_header;  // must be last - header may extend past it
+  };
+
+  ShmMessageImpl::ShmMessageImpl(ShmModule *_module,
+				 NodeID _target,
+				 unsigned short _msgid,
+				 size_t _header_size,
+				 size_t _max_payload_size,
+				 void *_dest_payload_addr)
+    : module(_module)
+    , target(_target)
+    , is_multicast(false)
+    , dest_payload_addr(_dest_payload_addr)
+    , header_size(_header_size)
+    , msgid(_msgid)
+  {
+    if(_max_payload_size) {
+      payload_base = malloc(_max_payload_size);
+      assert(payload_base != 0);
+    } else
+      payload_base = 0;
+    payload_size = _max_payload_size;
+    header_base = &msg_header;
+  }
+
+  ShmMessageImpl::ShmMessageImpl(ShmModule *_module,
+				 const NodeSet &_targets,
+				 unsigned short _msgid,
+				 size_t _header_size,
+				 size_t _max_payload_size)
+    : module(_module)
+    , targets(_targets)
+    , is_multicast(true)
+    , dest_payload_addr(0)
+    , header_size(_header_size)
+    , msgid(_msgid)
+  {
+    if(_max_payload_size) {
+      payload_base = malloc(_max_payload_size);
+      assert(payload_base != 0);
+    } else
+      payload_base = 0;
+    payload_size = _max_payload_size;
+    header_base = &msg_header;
+  }
+
+  ShmMessageImpl::~ShmMessageImpl()
+  {}
+
+  void ShmMessageImpl::commit(size_t act_payload_size)
+  {
+    // the payload is copied into the rings, so we keep ownership
+    if(is_multicast) {
+      for(NodeSet::const_iterator it = targets.begin();
+	  it != targets.end();
+	  ++it)
+	module->send(*it, msgid, &msg_header, header_size,
+		     payload_base, act_payload_size, 0);
+    } else
+      module->send(target, msgid, &msg_header, header_size,
+		   payload_base, act_payload_size, dest_payload_addr);
+
+    if(payload_size)
+      free(payload_base);
+  }
+
+  void ShmMessageImpl::cancel()
+  {
+    if(payload_size)
+      free(payload_base);
+  }
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class ShmModule
+  //
+
+  ShmModule::ShmModule(bool _overlay)
+    : NetworkModule("shm")
+    , overlay(_overlay)
+    , enabled(true)
+    , ring_size(1 << 20)
+    , my_index(-1)
+    , control(0)
+    , control_size(0)
+    , max_record_size(0)
+    , records_sent(0)
+    , records_received(0)
+    , core_rsrv(0)
+    , poll_thread(0)
+    , shutdown_flag(false)
+  {}
+
+  /*static*/ NetworkModule *ShmModule::create_network_module(RuntimeImpl *runtime,
+							    int *argc,
+							    const char ***argv)
+  {
+#ifdef REALM_USE_MULTIPLE_NETWORKS
+    // if an inter-node network has already been created, we just carry the
+    //  traffic between processes on the same host - whether there are any
+    //  is decided in attach
+    if(Network::primary_network != 0)
+      return new ShmModule(true /*overlay*/);
+#endif
+
+    // standalone mode has to be requested explicitly
+    const char *e = getenv("REALM_SHM_RANKS");
+    if(!e)
+      return 0;
+    int num_ranks = atoi(e);
+    if(num_ranks < 1) {
+      fprintf(stderr, "shm: illegal REALM_SHM_RANKS value: '%s'\n", e);
+      exit(1);
+    }
+
+    int rank;
+    std::string session;
+    const char *e_rank = getenv("REALM_SHM_RANK");
+    const char *e_name = getenv("REALM_SHM_NAME");
+    bool do_fork = (e_rank == 0);
+    if(do_fork) {
+      rank = 0;
+      if(e_name) {
+	session = e_name;
+      } else {
+	std::ostringstream oss;
+	oss << getuid() << "." << getpid();
+	session = oss.str();
+      }
+    } else {
+      rank = atoi(e_rank);
+      if((rank < 0) || (rank >= num_ranks)) {
+	fprintf(stderr, "shm: illegal REALM_SHM_RANK value: '%s'\n", e_rank);
+	exit(1);
+      }
+      if(e_name) {
+	session = e_name;
+      } else {
+	// processes started by the same launcher will agree on this
+	std::ostringstream oss;
+	oss << getuid() << "." << getppid();
+	session = oss.str();
+      }
+    }
+
+    ShmModule *m = new ShmModule(false /*!overlay*/);
+    m->session_name = "/realm_shm." + session;
+    for(int i = 0; i < num_ranks; i++)
+      m->local_nodes.push_back(i);
+    m->local_index.resize(num_ranks);
+    for(int i = 0; i < num_ranks; i++)
+      m->local_index[i] = i;
+
+    // rank 0 creates the control region before anybody else can need it
+    m->control_size = sizeof(ControlRegion) + CONTROL_SCRATCH_SIZE;
+    std::string ctrl_name = m->session_name + ".ctrl";
+    if(rank == 0) {
+      // a stale region from a previous (crashed) run is discarded
+      shm_unlink(ctrl_name.c_str());
+      m->control = static_cast<ControlRegion *>(m->create_region(ctrl_name,
+								  m->control_size));
+      m->control->barrier_count.store(0);
+      m->control->barrier_generation.store(0);
+      m->control->scratch_size = CONTROL_SCRATCH_SIZE;
+      __sync_synchronize();
+      m->control->magic = REGION_MAGIC;
+    }
+
+    if(do_fork) {
+      // forked children inherit the control region mapping - flush buffered
+      //  output so it isn't duplicated
+      fflush(stdout);
+      fflush(stderr);
+      for(int i = 1; i < num_ranks; i++) {
+	pid_t pid = fork();
+	if(pid < 0) {
+	  fprintf(stderr, "shm: fork failed: %s\n", strerror(errno));
+	  exit(1);
+	}
+	if(pid == 0) {
+	  rank = i;
+#ifdef __linux__
+	  // don't outlive rank 0
+	  prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+	  child_pids.clear();
+	  break;
+	}
+	child_pids.push_back(pid);
+      }
+      if(rank == 0)
+	atexit(wait_for_children);
+    } else if(rank != 0) {
+      // wait (for a while) for rank 0 to create the control region
+      size_t bytes = 0;
+      for(int tries = 0; tries < 3000; tries++) {
+	int fd = shm_open(ctrl_name.c_str(), O_RDWR, 0);
+	if(fd >= 0) {
+	  close(fd);
+	  void *base = m->open_region(ctrl_name, bytes);
+	  ControlRegion *ctrl = static_cast<ControlRegion *>(base);
+	  if((bytes >= m->control_size) &&
+	     (*static_cast<volatile uint64_t *>(&ctrl->magic) == REGION_MAGIC)) {
+	    m->control = ctrl;
+	    break;
+	  }
+	  munmap(base, bytes);
+	}
+	usleep(10000);
+      }
+      if(!m->control) {
+	fprintf(stderr, "shm: rank %d timed out waiting for '%s'\n",
+		rank, ctrl_name.c_str());
+	exit(1);
+      }
+    }
+
+    m->my_index = rank;
+    Network::my_node_id = rank;
+    Network::max_node_id = num_ranks - 1;
+    return m;
+  }
+
+  // actual parsing of the command line should wait until here if at all
+  //  possible
+  void ShmModule::parse_command_line(RuntimeImpl *runtime,
+				     std::vector<std::string>& cmdline)
+  {
+    NetworkModule::parse_command_line(runtime, cmdline);
+
+    size_t global_size = 0;
+    CommandLineParser cp;
+    cp.add_option_int_units("-ll:shm_ring", ring_size, 'k')
+      .add_option_bool("-ll:shm", enabled);
+    if(!overlay)
+      cp.add_option_int_units("-ll:gsize", global_size, 'm');
+    bool ok = cp.parse_command_line(cmdline);
+    assert(ok);
+    assert((global_size == 0) && "no global mem support in shm network yet");
+
+    // rings must hold a few maximal records and keep them 8-byte aligned
+    ring_size = round_up(std::max(ring_size, size_t(64 << 10)), 64);
+    max_record_size = ring_size / 4;
+  }
+
+  void *ShmModule::create_region(const std::string& name, size_t bytes)
+  {
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if(fd < 0) {
+      log_shm.fatal() << "shm_open('" << name << "') failed: " << strerror(errno);
+      abort();
+    }
+    if(ftruncate(fd, bytes) < 0) {
+      log_shm.fatal() << "could not size '" << name << "' to " << bytes
+		      << " bytes: " << strerror(errno);
+      abort();
+    }
+    void *base = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(base == MAP_FAILED) {
+      log_shm.fatal() << "mmap of '" << name << "' failed: " << strerror(errno);
+      abort();
+    }
+    close(fd);
+    return base;
+  }
+
+  void *ShmModule::open_region(const std::string& name, size_t& bytes)
+  {
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if(fd < 0) {
+      log_shm.fatal() << "shm_open('" << name << "') failed: " << strerror(errno);
+      abort();
+    }
+    struct stat st;
+    int ret = fstat(fd, &st);
+    assert(ret == 0);
+    bytes = st.st_size;
+    void *base = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(base == MAP_FAILED) {
+      log_shm.fatal() << "mmap of '" << name << "' failed: " << strerror(errno);
+      abort();
+    }
+    close(fd);
+    return base;
+  }
+
+  // finds the other processes on this host by exchanging host names over
+  //  the primary network - returns false if there are none
+  bool ShmModule::setup_overlay(void)
+  {
+#ifdef REALM_USE_MULTIPLE_NETWORKS
+    NetworkModule *primary = Network::primary_network;
+    int num_nodes = Network::max_node_id + 1;
+
+    struct HostInfo {
+      char hostname[64];
+      int enabled;
+    };
+    HostInfo mine;
+    memset(&mine, 0, sizeof(mine));
+    gethostname(mine.hostname, sizeof(mine.hostname) - 1);
+    mine.enabled = enabled ? 1 : 0;
+
+    std::vector<HostInfo> gathered(num_nodes), all(num_nodes);
+    primary->gather(0, &mine, &gathered[0], sizeof(HostInfo));
+    primary->broadcast(0, &gathered[0], &all[0], num_nodes * sizeof(HostInfo));
+
+    // node 0 picks a session name for everybody
+    uint64_t my_token = 0, token;
+    if(Network::my_node_id == 0)
+      my_token = (uint64_t(getpid()) << 32) ^ uint64_t(Clock::current_time_in_nanoseconds());
+    primary->broadcast(0, &my_token, &token, sizeof(token));
+
+    local_index.assign(num_nodes, -1);
+    for(int i = 0; i < num_nodes; i++)
+      if(all[i].enabled &&
+	 !strncmp(all[i].hostname, mine.hostname, sizeof(mine.hostname))) {
+	local_index[i] = local_nodes.size();
+	local_nodes.push_back(i);
+      }
+
+    if(!enabled || (local_nodes.size() < 2)) {
+      local_nodes.clear();
+      local_index.clear();
+      // everybody has to participate in the barrier below
+      primary->barrier();
+      return false;
+    }
+
+    my_index = local_index[Network::my_node_id];
+    {
+      std::ostringstream oss;
+      oss << "/realm_shm." << getuid() << "." << std::hex << token
+	  << std::dec << "." << local_nodes[0];
+      session_name = oss.str();
+    }
+
+    // the lowest node on each host creates the control region
+    control_size = sizeof(ControlRegion) + CONTROL_SCRATCH_SIZE;
+    std::string ctrl_name = session_name + ".ctrl";
+    if(my_index == 0) {
+      control = static_cast<ControlRegion *>(create_region(ctrl_name,
+							   control_size));
+      control->barrier_count.store(0);
+      control->barrier_generation.store(0);
+      control->scratch_size = CONTROL_SCRATCH_SIZE;
+      control->magic = REGION_MAGIC;
+    }
+    primary->barrier();
+    if(my_index != 0) {
+      size_t bytes;
+      control = static_cast<ControlRegion *>(open_region(ctrl_name, bytes));
+      assert((bytes >= control_size) && (control->magic == REGION_MAGIC));
+    }
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  void ShmModule::local_barrier(bool with_polling)
+  {
+    unsigned count = local_nodes.size();
+    unsigned gen = control->barrier_generation.load_acquire();
+    if((control->barrier_count.fetch_add_acqrel(1) + 1) == count) {
+      control->barrier_count.store(0);
+      control->barrier_generation.store_release(gen + 1);
+      return;
+    }
+    while(control->barrier_generation.load_acquire() == gen) {
+      // keep our peers' messages flowing if they are waiting on us
+      if(!with_polling || !poll())
+	sched_yield();
+    }
+  }
+
+  void ShmModule::drain_messages(void)
+  {
+    // handlers that run while we wait can send replies, so a single barrier
+    //  isn't enough - instead, each round every process gets its queued
+    //  records out the door and then all of them add up (while continuing
+    //  to poll) how many records have been sent and handled - the drain is
+    //  over once a round finds them balanced and nobody has sent or handled
+    //  anything since the previous round, as nothing can be in flight then
+    size_t num_peers = local_nodes.size();
+    long long *slots = reinterpret_cast<long long *>(control->scratch);
+    assert(control->scratch_size >= (2 * num_peers * sizeof(long long)));
+    long long last_sent = -1;
+    long long last_received = -1;
+    while(true) {
+      bool queued = true;
+      while(queued) {
+	queued = false;
+	for(size_t i = 0; i < peers_out.size(); i++)
+	  if(peers_out[i] && peers_out[i]->has_overflow.load())
+	    queued = true;
+	if(queued && !poll())
+	  sched_yield();
+      }
+
+      long long sent = records_sent.load();
+      long long received = records_received;
+      slots[2 * my_index] = sent - received;
+      slots[2 * my_index + 1] = (((sent != last_sent) ||
+				  (received != last_received)) ? 1 : 0);
+      last_sent = sent;
+      last_received = received;
+
+      local_barrier(true /*with_polling*/);
+      long long balance = 0;
+      long long changed = 0;
+      for(size_t i = 0; i < num_peers; i++) {
+	balance += slots[2 * i];
+	changed += slots[2 * i + 1];
+      }
+      // nobody may write the next round's counts until everybody has read
+      //  this round's
+      local_barrier(true /*with_polling*/);
+
+      if((balance == 0) && (changed == 0))
+	break;
+    }
+  }
+
+  // "attaches" to the network, if that is meaningful - attempts to
+  //  bind/register/(pick your network-specific verb) the requested memory
+  //  segments with the network
+  void ShmModule::attach(RuntimeImpl *runtime,
+			 std::vector<NetworkSegment *>& segments)
+  {
+    if(overlay) {
+      if(!setup_overlay())
+	return;
+    }
+
+    size_t num_peers = local_nodes.size();
+
+    // our region holds a ring for each sender and (standalone only) all the
+    //  unbound segments
+    size_t rings_offset = round_up(sizeof(RegionHeader), 64);
+    size_t data_offset = round_up(rings_offset +
+				  num_peers * (sizeof(RingControl) + ring_size),
+				  4096);
+    size_t total_size = data_offset;
+    if(!overlay) {
+      for(std::vector<NetworkSegment *>::iterator it = segments.begin();
+	  it != segments.end();
+	  ++it) {
+	if(((*it)->bytes == 0) || ((*it)->base != 0)) continue;
+	total_size = round_up(total_size, std::max((*it)->alignment, size_t(64)));
+	total_size += (*it)->bytes;
+      }
+    }
+
+    std::ostringstream oss;
+    oss << session_name << "." << local_nodes[my_index];
+    std::string my_name = oss.str();
+    shm_unlink(my_name.c_str());
+    char *my_base = static_cast<char *>(create_region(my_name, total_size));
+
+    RegionHeader *hdr = reinterpret_cast<RegionHeader *>(my_base);
+    hdr->owner_base = reinterpret_cast<uintptr_t>(my_base);
+    hdr->total_size = total_size;
+    hdr->num_rings = num_peers;
+    hdr->ring_size = ring_size;
+    hdr->rings_offset = rings_offset;
+    RingControl *rings = reinterpret_cast<RingControl *>(my_base + rings_offset);
+    for(size_t i = 0; i < num_peers; i++) {
+      rings[i].head.store(0);
+      rings[i].tail.store(0);
+    }
+    hdr->magic = REGION_MAGIC;
+
+    if(!overlay) {
+      size_t offset = data_offset;
+      for(std::vector<NetworkSegment *>::iterator it = segments.begin();
+	  it != segments.end();
+	  ++it) {
+	if(((*it)->bytes == 0) || ((*it)->base != 0)) continue;
+	offset = round_up(offset, std::max((*it)->alignment, size_t(64)));
+	void *seg_base = my_base + offset;
+	(*it)->base = seg_base;
+	(*it)->add_rdma_info(this, &seg_base, sizeof(void *));
+	offset += (*it)->bytes;
+      }
+    } else {
+      // RDMA to our local peers is still done by the primary network, but
+      //  the memories are announced by us, so pass its info along
+      for(std::vector<NetworkSegment *>::iterator it = segments.begin();
+	  it != segments.end();
+	  ++it) {
+	if((*it)->base == 0) continue;
+	for(std::map<NetworkModule *, ByteArray>::const_iterator it2 = (*it)->networks.begin();
+	    it2 != (*it)->networks.end();
+	    ++it2)
+	  if(it2->first != this) {
+	    ByteArray info(it2->second);
+	    (*it)->add_rdma_info(this, info.base(), info.size());
+	    break;
+	  }
+      }
+    }
+
+    // once everybody has created their region, map everybody else's and
+    //  then remove the names so nothing is left behind if we crash
+    local_barrier(false /*!with_polling*/);
+
+    region_bases.resize(num_peers);
+    region_sizes.resize(num_peers);
+    owner_bases.resize(num_peers);
+    for(size_t i = 0; i < num_peers; i++) {
+      if(int(i) == my_index) {
+	region_bases[i] = my_base;
+	region_sizes[i] = total_size;
+      } else {
+	std::ostringstream oss;
+	oss << session_name << "." << local_nodes[i];
+	region_bases[i] = static_cast<char *>(open_region(oss.str(),
+							  region_sizes[i]));
+      }
+      const RegionHeader *rh = reinterpret_cast<const RegionHeader *>(region_bases[i]);
+      assert((rh->magic == REGION_MAGIC) &&
+	     (rh->num_rings == num_peers) &&
+	     (rh->ring_size == ring_size) &&
+	     (rh->total_size == region_sizes[i]));
+      owner_bases[i] = rh->owner_base;
+    }
+
+    local_barrier(false /*!with_polling*/);
+    shm_unlink(my_name.c_str());
+    if(my_index == 0)
+      shm_unlink((session_name + ".ctrl").c_str());
+
+    // our ring in each peer's region is the one with our index
+    peers_out.resize(num_peers, 0);
+    peers_in.resize(num_peers);
+    for(size_t i = 0; i < num_peers; i++) {
+      char *peer_base = region_bases[i];
+      RingControl *peer_rings = reinterpret_cast<RingControl *>(peer_base + rings_offset);
+      char *peer_data = peer_base + rings_offset + num_peers * sizeof(RingControl);
+
+      if(int(i) != my_index) {
+	PeerOut *out = new PeerOut;
+	out->ring = &peer_rings[my_index];
+	out->ring_data = peer_data + my_index * ring_size;
+	out->has_overflow.store(false);
+	peers_out[i] = out;
+      }
+
+      PeerIn& in = peers_in[i];
+      in.ring = &rings[i];
+      in.ring_data = (my_base + rings_offset + num_peers * sizeof(RingControl) +
+		      i * ring_size);
+      in.frag_msgid = 0;
+      in.frag_header = 0;
+      in.frag_header_size = 0;
+      in.frag_payload = 0;
+      in.frag_total = in.frag_received = 0;
+    }
+
+#ifdef REALM_USE_MULTIPLE_NETWORKS
+    // from now on, messages to our local peers come through us
+    if(overlay)
+      for(size_t i = 0; i < num_peers; i++)
+	if(int(i) != my_index)
+	  Network::set_network(local_nodes[i], this);
+#endif
+
+    log_shm.info() << "attached: " << num_peers << " local processes, "
+		   << (ring_size >> 10) << " KB rings, "
+		   << ((total_size - data_offset) >> 10) << " KB of segments";
+
+    core_rsrv = new CoreReservation("shm poller", *(runtime->core_reservations),
+				    CoreReservationParameters());
+    ThreadLaunchParameters tlp;
+    poll_thread = Thread::create_kernel_thread<ShmModule,
+					       &ShmModule::thread_loop>(this,
+									tlp,
+									*core_rsrv);
+  }
+
+  void ShmModule::thread_loop(void)
+  {
+    while(!shutdown_flag.load()) {
+      // don't hog a core that the other threads of this process (or other
+      //  processes) could be using when there's nothing to do
+      if(!poll())
+	Thread::yield();
+    }
+  }
+
+  // detaches from the network
+  void ShmModule::detach(RuntimeImpl *runtime,
+			 std::vector<NetworkSegment *>& segments)
+  {
+    if(!poll_thread)
+      return;
+
+    shutdown_flag.store(true);
+    poll_thread->join();
+    delete poll_thread;
+    poll_thread = 0;
+    delete core_rsrv;
+    core_rsrv = 0;
+
+#ifdef REALM_USE_MULTIPLE_NETWORKS
+    // the primary network detaches after us and its handlers can still
+    //  send to our local peers, so hand the routes back to it before
+    //  draining - anything sent through us before this point gets drained
+    if(overlay)
+      for(size_t i = 0; i < local_nodes.size(); i++)
+	if(int(i) != my_index)
+	  Network::set_network(local_nodes[i], Network::primary_network);
+#endif
+
+    // deliver everything that was sent to us before anybody unmaps their
+    //  region
+    drain_messages();
+
+    for(size_t i = 0; i < peers_out.size(); i++)
+      delete peers_out[i];
+    peers_out.clear();
+    for(size_t i = 0; i < peers_in.size(); i++) {
+      if(peers_in[i].frag_header) free(peers_in[i].frag_header);
+      if(peers_in[i].frag_payload) free(peers_in[i].frag_payload);
+    }
+    peers_in.clear();
+
+    // segments living in our region go away with it
+    if(!overlay)
+      for(std::vector<NetworkSegment *>::iterator it = segments.begin();
+	  it != segments.end();
+	  ++it)
+	if((*it)->get_rdma_info(this))
+	  (*it)->base = 0;
+
+    for(size_t i = 0; i < region_bases.size(); i++)
+      munmap(region_bases[i], region_sizes[i]);
+    region_bases.clear();
+    if(control) {
+      munmap(control, control_size);
+      control = 0;
+    }
+  }
+
+  // collective communication within this network
+  void ShmModule::barrier(void)
+  {
+    // only used in standalone mode - an overlay is never the primary network
+    assert(!overlay);
+    local_barrier(false /*!with_polling*/);
+  }
+
+  void ShmModule::broadcast(NodeID root,
+			    const void *val_in, void *val_out, size_t bytes)
+  {
+    assert(!overlay);
+    size_t done = 0;
+    do {
+      size_t chunk = std::min(bytes - done, control->scratch_size);
+      if(Network::my_node_id == root)
+	memcpy(control->scratch, static_cast<const char *>(val_in) + done, chunk);
+      local_barrier(false /*!with_polling*/);
+      memcpy(static_cast<char *>(val_out) + done, control->scratch, chunk);
+      // nobody can overwrite the scratch until everybody has read it
+      local_barrier(false /*!with_polling*/);
+      done += chunk;
+    } while(done < bytes);
+  }
+
+  void ShmModule::gather(NodeID root,
+			 const void *val_in, void *vals_out, size_t bytes)
+  {
+    assert(!overlay);
+    size_t num_peers = local_nodes.size();
+    // each rank gets an equal slice of the scratch space
+    size_t slice = control->scratch_size / num_peers;
+    assert(slice > 0);
+    size_t done = 0;
+    do {
+      size_t chunk = std::min(bytes - done, slice);
+      memcpy(control->scratch + (my_index * slice),
+	     static_cast<const char *>(val_in) + done, chunk);
+      local_barrier(false /*!with_polling*/);
+      if(Network::my_node_id == root)
+	for(size_t i = 0; i < num_peers; i++)
+	  memcpy(static_cast<char *>(vals_out) + (i * bytes) + done,
+		 control->scratch + (i * slice), chunk);
+      local_barrier(false /*!with_polling*/);
+      done += chunk;
+    } while(done < bytes);
+  }
+
+  void *ShmModule::translate_remote_addr(NodeID peer, const void *remote_addr,
+					 size_t bytes) const
+  {
+    if((peer < 0) || (size_t(peer) >= local_index.size()))
+      return 0;
+    int idx = local_index[peer];
+    if((idx < 0) || region_bases.empty())
+      return 0;
+    uintptr_t addr = reinterpret_cast<uintptr_t>(remote_addr);
+    if((addr < owner_bases[idx]) ||
+       ((addr + bytes) > (owner_bases[idx] + region_sizes[idx])))
+      return 0;
+    return region_bases[idx] + (addr - owner_bases[idx]);
+  }
+
+  // used to create a remote proxy for a memory
+  MemoryImpl *ShmModule::create_remote_memory(Memory m, size_t size, Memory::Kind kind,
+					      const ByteArray& rdma_info)
+  {
+#ifdef REALM_USE_MULTIPLE_NETWORKS
+    // in overlay mode, it's really the primary network's info
+    if(overlay)
+      return Network::primary_network->create_remote_memory(m, size, kind,
+							     rdma_info);
+#endif
+    // rdma info is the pointer in the remote address space
+    assert(rdma_info.size() == sizeof(void *));
+    char *owner_base;
+    memcpy(&owner_base, rdma_info.base(), sizeof(void *));
+    NodeID owner = ID(m).memory_owner_node();
+    char *local_base = static_cast<char *>(translate_remote_addr(owner,
+								 owner_base,
+								 size));
+    assert(local_base != 0);
+    return new ShmRemoteMemory(m, size, kind, local_base, owner_base);
+  }
+
+  ActiveMessageImpl *ShmModule::create_active_message_impl(NodeID target,
+							   unsigned short msgid,
+							   size_t header_size,
+							   size_t max_payload_size,
+							   void *dest_payload_addr,
+							   void *storage_base,
+							   size_t storage_size)
+  {
+#ifdef REALM_USE_MULTIPLE_NETWORKS
+    // destinations that aren't in shared memory belong to the primary
+    //  network's RDMA
+    if(dest_payload_addr &&
+       !translate_remote_addr(target, dest_payload_addr, max_payload_size))
+      return Network::primary_network->create_active_message_impl(target,
+								   msgid,
+								   header_size,
+								   max_payload_size,
+								   dest_payload_addr,
+								   storage_base,
+								   storage_size);
+#endif
+    assert(storage_size >= (sizeof(ShmMessageImpl) - sizeof(uint64_t) +
+			    header_size));
+    return new(storage_base) ShmMessageImpl(this,
+					    target,
+					    msgid,
+					    header_size,
+					    max_payload_size,
+					    dest_payload_addr);
+  }
+
+  ActiveMessageImpl *ShmModule::create_active_message_impl(const NodeSet& targets,
+							   unsigned short msgid,
+							   size_t header_size,
+							   size_t max_payload_size,
+							   void *storage_base,
+							   size_t storage_size)
+  {
+    assert(storage_size >= (sizeof(ShmMessageImpl) - sizeof(uint64_t) +
+			    header_size));
+    return new(storage_base) ShmMessageImpl(this,
+					    targets,
+					    msgid,
+					    header_size,
+					    max_payload_size);
+  }
+
+  // writes a record into a peer's ring if there's room - caller holds the
+  //  peer's mutex
+  bool ShmModule::try_write(PeerOut& out, const RecordHeader& rh,
+			    const void *data1, size_t len1,
+			    const void *data2, size_t len2)
+  {
+    // the second piece (if any) starts 8-byte aligned
+    size_t offset2 = round_up(len1, 8);
+    size_t bytes = round_up(sizeof(RecordHeader) + offset2 + len2, 8);
+    assert(bytes <= max_record_size);
+
+    size_t head = out.ring->head.load();
+    size_t tail = out.ring->tail.load_acquire();
+    size_t pos = head % ring_size;
+    // records never wrap - skip the end of the buffer if needed
+    size_t skip = ((ring_size - pos) < bytes) ? (ring_size - pos) : 0;
+    if((head + skip + bytes - tail) > ring_size)
+      return false;
+
+    if(skip) {
+      *reinterpret_cast<uint32_t *>(out.ring_data + pos) = 0;
+      head += skip;
+      pos = 0;
+    }
+
+    char *dst = out.ring_data + pos;
+    memcpy(dst, &rh, sizeof(RecordHeader));
+    reinterpret_cast<RecordHeader *>(dst)->bytes = bytes;
+    dst += sizeof(RecordHeader);
+    if(len1)
+      memcpy(dst, data1, len1);
+    if(len2)
+      memcpy(dst + offset2, data2, len2);
+
+    // publishing the new head makes the record visible
+    out.ring->head.store_release(head + bytes);
+    return true;
+  }
+
+  // caller holds the peer's mutex
+  void ShmModule::write_or_queue(PeerOut& out, const RecordHeader& rh,
+				 const void *data1, size_t len1,
+				 const void *data2, size_t len2)
+  {
+    records_sent.fetch_add(1);
+
+    // records must stay in order, so nothing jumps the overflow queue
+    if(out.overflow.empty() && try_write(out, rh, data1, len1, data2, len2))
+      return;
+
+    // stored with the same layout it will have in the ring
+    size_t offset2 = round_up(len1, 8);
+    OverflowRecord *rec = static_cast<OverflowRecord *>(malloc(sizeof(OverflowRecord) +
+							      offset2 + len2));
+    assert(rec != 0);
+    rec->rh = rh;
+    rec->len = offset2 + len2;
+    if(len1) memcpy(rec->data, data1, len1);
+    if(len2) memcpy(rec->data + offset2, data2, len2);
+    out.overflow.push_back(rec);
+    out.has_overflow.store(true);
+  }
+
+  // caller holds the peer's mutex - returns true if anything was written
+  bool ShmModule::drain_overflow(PeerOut& out)
+  {
+    bool progress = false;
+    while(!out.overflow.empty()) {
+      OverflowRecord *rec = out.overflow.front();
+      if(!try_write(out, rec->rh, rec->data, rec->len, 0, 0))
+	break;
+      out.overflow.pop_front();
+      free(rec);
+      progress = true;
+    }
+    if(out.overflow.empty())
+      out.has_overflow.store(false);
+    return progress;
+  }
+
+  void ShmModule::send(NodeID target, unsigned short msgid,
+		       const void *header, size_t header_size,
+		       const void *payload, size_t payload_size,
+		       void *dest_payload_addr)
+  {
+    assert((target >= 0) && (size_t(target) < local_index.size()) &&
+	   (local_index[target] >= 0));
+    PeerOut& out = *peers_out[local_index[target]];
+
+    RecordHeader rh;
+    rh.bytes = 0;
+    rh.msgid = msgid;
+    rh.header_size = header_size;
+
+    if(dest_payload_addr) {
+      // long message - copy the payload straight to its destination and
+      //  then send just the header (the release on the ring's head orders
+      //  the two)
+      void *dst = translate_remote_addr(target, dest_payload_addr, payload_size);
+      assert(dst != 0);
+      if(payload_size)
+	memcpy(dst, payload, payload_size);
+      rh.type = REC_DEST;
+      rh.payload_size = payload_size;
+      rh.extra = reinterpret_cast<uintptr_t>(dest_payload_addr);
+
+      AutoLock<> al(out.mutex);
+      write_or_queue(out, rh, header, header_size, 0, 0);
+      return;
+    }
+
+    AutoLock<> al(out.mutex);
+    // try to make room before adding more
+    if(out.has_overflow.load())
+      drain_overflow(out);
+
+    if((sizeof(RecordHeader) + header_size + payload_size) <= max_record_size) {
+      rh.type = REC_INLINE;
+      rh.payload_size = payload_size;
+      rh.extra = 0;
+      write_or_queue(out, rh, header, header_size, payload, payload_size);
+      return;
+    }
+
+    // too big for a single record - send it in pieces, all while holding
+    //  the mutex so that the receiver sees them back to back
+    size_t max_chunk = ((max_record_size - sizeof(RecordHeader)) & ~size_t(7));
+    assert(round_up(header_size, 8) < max_chunk);
+    size_t first = max_chunk - round_up(header_size, 8);
+    rh.type = REC_FRAG_START;
+    rh.payload_size = first;
+    rh.extra = payload_size;
+    write_or_queue(out, rh, header, header_size, payload, first);
+
+    const char *p = static_cast<const char *>(payload) + first;
+    size_t left = payload_size - first;
+    rh.type = REC_FRAG_CONT;
+    rh.header_size = 0;
+    rh.extra = 0;
+    while(left > 0) {
+      size_t chunk = std::min(left, max_chunk);
+      rh.payload_size = chunk;
+      write_or_queue(out, rh, p, chunk, 0, 0);
+      p += chunk;
+      left -= chunk;
+    }
+  }
+
+  static void run_handler(NodeID sender, unsigned short msgid,
+			  const void *header, const void *payload,
+			  size_t payload_size)
+  {
+    ActiveMessageHandlerTable::MessageHandler handler = activemsg_handler_table.lookup_message_handler(msgid);
+    long long t_start = 0;
+    if(Config::profile_activemsg_handlers)
+      t_start = Clock::current_time_in_nanoseconds();
+    (*handler)(sender, header, payload, payload_size);
+    if(Config::profile_activemsg_handlers)
+      activemsg_handler_table.record_message_handler_call(msgid, t_start,
+							  Clock::current_time_in_nanoseconds());
+  }
+
+  void ShmModule::handle_record(int peer_idx, const RecordHeader& rh,
+				const char *data)
+  {
+    NodeID sender = local_nodes[peer_idx];
+    switch(rh.type) {
+    case REC_INLINE:
+      {
+	run_handler(sender, rh.msgid, data,
+		    (rh.payload_size ? (data + round_up(rh.header_size, 8)) : 0),
+		    rh.payload_size);
+	break;
+      }
+
+    case REC_DEST:
+      {
+	run_handler(sender, rh.msgid, data,
+		    reinterpret_cast<const void *>(rh.extra),
+		    rh.payload_size);
+	break;
+      }
+
+    case REC_FRAG_START:
+      {
+	PeerIn& in = peers_in[peer_idx];
+	assert(in.frag_payload == 0);
+	in.frag_msgid = rh.msgid;
+	in.frag_header_size = rh.header_size;
+	in.frag_header = static_cast<char *>(malloc(std::max(size_t(rh.header_size),
+							     size_t(8))));
+	memcpy(in.frag_header, data, rh.header_size);
+	in.frag_total = rh.extra;
+	in.frag_payload = static_cast<char *>(malloc(in.frag_total));
+	assert(in.frag_header && in.frag_payload);
+	memcpy(in.frag_payload, data + round_up(rh.header_size, 8),
+	       rh.payload_size);
+	in.frag_received = rh.payload_size;
+	break;
+      }
+
+    case REC_FRAG_CONT:
+      {
+	PeerIn& in = peers_in[peer_idx];
+	assert(in.frag_payload != 0);
+	assert((in.frag_received + rh.payload_size) <= in.frag_total);
+	memcpy(in.frag_payload + in.frag_received, data, rh.payload_size);
+	in.frag_received += rh.payload_size;
+	if(in.frag_received == in.frag_total) {
+	  run_handler(sender, in.frag_msgid, in.frag_header,
+		      in.frag_payload, in.frag_total);
+	  free(in.frag_header);
+	  free(in.frag_payload);
+	  in.frag_header = 0;
+	  in.frag_payload = 0;
+	}
+	break;
+      }
+
+    default:
+      assert(0);
+    }
+  }
+
+  // handles (a bounded number of) the records waiting in a ring
+  bool ShmModule::poll_ring(int peer_idx)
+  {
+    static const int MAX_RECORDS_PER_POLL = 64;
+
+    PeerIn& in = peers_in[peer_idx];
+    size_t tail = in.ring->tail.load();
+    size_t head = in.ring->head.load_acquire();
+    int handled = 0;
+    while((tail != head) && (handled < MAX_RECORDS_PER_POLL)) {
+      size_t pos = tail % ring_size;
+      const char *rec = in.ring_data + pos;
+      uint32_t bytes = *reinterpret_cast<const uint32_t *>(rec);
+      if(bytes == 0) {
+	// wrap to the start of the buffer
+	tail += ring_size - pos;
+	continue;
+      }
+      // the handler runs on the ring memory - the space isn't released to
+      //  the sender until it returns
+      RecordHeader rh;
+      memcpy(&rh, rec, sizeof(RecordHeader));
+      handle_record(peer_idx, rh, rec + sizeof(RecordHeader));
+      records_received++;
+      tail += bytes;
+      in.ring->tail.store_release(tail);
+      handled++;
+    }
+    // make sure any wrap skip is released too
+    if(in.ring->tail.load() != tail)
+      in.ring->tail.store_release(tail);
+    return (handled > 0);
+  }
+
+  bool ShmModule::poll(void)
+  {
+    bool progress = false;
+    for(size_t i = 0; i < peers_in.size(); i++) {
+      if(int(i) == my_index) continue;
+      if(poll_ring(i))
+	progress = true;
+      // senders push out their own overflow when they can, but a peer that
+      //  stopped sending still needs its queue drained
+      PeerOut *out = peers_out[i];
+      if(out->has_overflow.load() && out->mutex.trylock()) {
+	if(drain_overflow(*out))
+	  progress = true;
+	out->mutex.unlock();
+      }
+    }
+    return progress;
+  }
+
+}; // namespace Realm
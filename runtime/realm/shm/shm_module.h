@@ -0,0 +1,200 @@
+/* Copyright 2020 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// shared memory network module implementation for Realm
+
+// The shm module connects the processes of a single host through POSIX
+//  shared memory.  Every process maps a region owned by each of its peers
+//  that holds one single-producer/single-consumer ring per sender (used for
+//  active messages) and, when the module is the only network, the registered
+//  memory segments (so RDMA is a memcpy).
+//
+// It can be used in two ways:
+//  1) standalone - set REALM_SHM_RANKS=N and the first process forks the
+//       other N-1 ranks (or launch them yourself with REALM_SHM_RANK set in
+//       each, all with the same REALM_SHM_NAME)
+//  2) on top of an inter-node network (requires REALM_USE_MULTIPLE_NETWORKS)
+//       - the other network assigns node IDs and handles collectives and
+//       RDMA, while active messages between processes on the same host are
+//       carried through shared memory (disable with -ll:shm 0)
+
+#ifndef SHM_MODULE_H
+#define SHM_MODULE_H
+
+#include "realm/network.h"
+#include "realm/atomics.h"
+#include "realm/mutex.h"
+
+#include <deque>
+#include <vector>
+
+namespace Realm {
+
+  class CoreReservation;
+  class Thread;
+
+  namespace Shm {
+    struct ControlRegion;
+    struct RingControl;
+    struct RecordHeader;
+    struct OverflowRecord;
+  };
+
+  class ShmModule : public NetworkModule {
+  protected:
+    ShmModule(bool _overlay);
+
+  public:
+    // all subclasses should define this (static) method - its responsibilities
+    // are:
+    // 1) determine if the network module should even be loaded
+    // 2) fix the command line if the spawning system hijacked it
+    static NetworkModule *create_network_module(RuntimeImpl *runtime,
+						int *argc, const char ***argv);
+
+    // actual parsing of the command line should wait until here if at all
+    //  possible
+    virtual void parse_command_line(RuntimeImpl *runtime,
+				    std::vector<std::string>& cmdline);
+
+    // "attaches" to the network, if that is meaningful - attempts to
+    //  bind/register/(pick your network-specific verb) the requested memory
+    //  segments with the network
+    virtual void attach(RuntimeImpl *runtime,
+			std::vector<NetworkSegment *>& segments);
+
+    // detaches from the network
+    virtual void detach(RuntimeImpl *runtime,
+			std::vector<NetworkSegment *>& segments);
+
+    // collective communication within this network
+    virtual void barrier(void);
+    virtual void broadcast(NodeID root,
+			   const void *val_in, void *val_out, size_t bytes);
+    virtual void gather(NodeID root,
+			const void *val_in, void *vals_out, size_t bytes);
+
+    // used to create a remote proxy for a memory
+    virtual MemoryImpl *create_remote_memory(Memory m, size_t size, Memory::Kind kind,
+					     const ByteArray& rdma_info);
+
+    virtual ActiveMessageImpl *create_active_message_impl(NodeID target,
+							  unsigned short msgid,
+							  size_t header_size,
+							  size_t max_payload_size,
+							  void *dest_payload_addr,
+							  void *storage_base,
+							  size_t storage_size);
+
+    virtual ActiveMessageImpl *create_active_message_impl(const NodeSet& targets,
+							  unsigned short msgid,
+							  size_t header_size,
+							  size_t max_payload_size,
+							  void *storage_base,
+							  size_t storage_size);
+
+    // enqueues a message for a peer - never blocks: if the peer's ring is
+    //  full, the message is copied to an overflow queue that is drained by
+    //  the polling thread
+    void send(NodeID target, unsigned short msgid,
+	      const void *header, size_t header_size,
+	      const void *payload, size_t payload_size,
+	      void *dest_payload_addr);
+
+    // handles incoming messages and drains overflow queues - returns true
+    //  if any progress was made
+    bool poll(void);
+
+    // maps an address in a peer's address space (within its shared region)
+    //  into ours - returns 0 if the address is not in the peer's region
+    void *translate_remote_addr(NodeID peer, const void *remote_addr,
+				size_t bytes) const;
+
+    void thread_loop(void);
+
+  protected:
+    // per-peer state for outgoing messages
+    struct PeerOut {
+      Mutex mutex;
+      Shm::RingControl *ring;
+      char *ring_data;
+      std::deque<Shm::OverflowRecord *> overflow;
+      atomic<bool> has_overflow;
+    };
+
+    // per-peer state for incoming messages (only touched by the poller)
+    struct PeerIn {
+      Shm::RingControl *ring;
+      char *ring_data;
+      // reassembly of fragmented payloads
+      unsigned short frag_msgid;
+      char *frag_header;
+      size_t frag_header_size;
+      char *frag_payload;
+      size_t frag_total, frag_received;
+    };
+
+    bool try_write(PeerOut& out, const Shm::RecordHeader& rh,
+		   const void *data1, size_t len1,
+		   const void *data2, size_t len2);
+    void write_or_queue(PeerOut& out, const Shm::RecordHeader& rh,
+			const void *data1, size_t len1,
+			const void *data2, size_t len2);
+    bool drain_overflow(PeerOut& out);
+    bool poll_ring(int peer_idx);
+    void handle_record(int peer_idx, const Shm::RecordHeader& rh,
+		       const char *data);
+
+    void *create_region(const std::string& name, size_t bytes);
+    void *open_region(const std::string& name, size_t& bytes);
+    void local_barrier(bool with_polling);
+    void drain_messages(void);
+    bool setup_overlay(void);
+
+    bool overlay, enabled;
+    size_t ring_size;
+    std::string session_name;
+    // processes sharing this host, in node ID order
+    std::vector<NodeID> local_nodes;
+    std::vector<int> local_index;  // node ID -> index in local_nodes (or -1)
+    int my_index;
+
+    Shm::ControlRegion *control;
+    size_t control_size;
+    // each process's region as mapped here, its size and its base address
+    //  in the owner's address space
+    std::vector<char *> region_bases;
+    std::vector<size_t> region_sizes;
+    std::vector<uintptr_t> owner_bases;
+
+    std::vector<PeerOut *> peers_out;
+    std::vector<PeerIn> peers_in;
+    size_t max_record_size;
+    // records written or queued for any peer and records handled (the
+    //  latter only touched by the poller) - used by detach to tell when
+    //  nothing is in flight any more
+    atomic<size_t> records_sent;
+    size_t records_received;
+
+    CoreReservation *core_rsrv;
+    Thread *poll_thread;
+    atomic<bool> shutdown_flag;
+  };
+
+  REGISTER_REALM_NETWORK_MODULE(ShmModule);
+
+}; // namespace Realm
+
+#endif
@@ -19,11 +19,23 @@
 
 #include "realm/runtime_impl.h"
 
+#include <algorithm>
+
 namespace Realm {
 
   Logger log_task("task");
   Logger log_sched("sched");
 
+  namespace Config {
+    bool use_work_stealing = false;
+  };
+
+  namespace ThreadLocal {
+    // the scheduler whose worker (if any) is the current thread - used to
+    //  decide whether a newly-ready task can go into a local deque
+    static REALM_THREAD_LOCAL ThreadedTaskScheduler *current_task_scheduler = 0;
+  };
+
   ////////////////////////////////////////////////////////////////////////
   //
   // class Task
@@ -306,14 +318,228 @@ namespace Realm {
   }
 
 
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class TaskDeque
+  //
+
+  TaskDeque::TaskDeque(void)
+    : top(0), bottom(0)
+  {
+    for(long long i = 0; i < CAPACITY; i++)
+      buffer[i].store(0);
+  }
+
+  bool TaskDeque::push(Task *task)
+  {
+    long long b = bottom.load();
+    long long t = top.load_acquire();
+    if((b - t) >= CAPACITY)
+      return false;
+    buffer[b & (CAPACITY - 1)].store(task);
+    bottom.store_release(b + 1);
+    return true;
+  }
+
+  Task *TaskDeque::steal(void)
+  {
+    // read-modify-write of top orders it before the read of bottom
+    long long t = top.fetch_add(0);
+    long long b = bottom.load_acquire();
+    if(t >= b)
+      return 0;
+    Task *task = buffer[t & (CAPACITY - 1)].load();
+    if(!top.compare_exchange(t, t + 1))
+      return 0;  // lost a race with the owner or another thief
+    return task;
+  }
+
+  bool TaskDeque::empty(void) const
+  {
+    return (bottom.load() <= top.load());
+  }
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class TaskQueue::LocalDeques
+  //
+
+  TaskQueue::LocalDeques::LocalDeques(ThreadedTaskScheduler *_owner,
+				      int _numa_domain)
+    : owner(_owner)
+    , numa_domain(_numa_domain)
+    , push_state(0)
+  {
+    for(int i = 0; i < NUM_BANDS; i++)
+      band_priorities[i].store(PRI_NEG_INF);
+  }
+
+  bool TaskQueue::LocalDeques::push(Task *task, bool& was_empty)
+  {
+    // register as an in-flight push unless the deques have been closed
+    int state = push_state.load_acquire();
+    do {
+      if((state & PUSH_CLOSED) != 0)
+	return false;
+    } while(!push_state.compare_exchange(state, state + PUSH_ACTIVE));
+
+    // find the band for this priority, claiming an unused one if needed -
+    //  only the owner assigns bands, so no synchronization is needed here
+    int band = -1;
+    for(int i = 0; i < NUM_BANDS; i++) {
+      priority_t p = band_priorities[i].load();
+      if(p == task->priority) {
+	band = i;
+	break;
+      }
+      if(p == PRI_NEG_INF) {
+	band_priorities[i].store_release(task->priority);
+	band = i;
+	break;
+      }
+    }
+    bool ok = false;
+    if(band >= 0) {
+      was_empty = bands[band].empty();
+      ok = bands[band].push(task);
+    }
+    push_state.fetch_sub_acqrel(PUSH_ACTIVE);
+    return ok;
+  }
+
+  TaskQueue::priority_t TaskQueue::LocalDeques::peek_priority(priority_t higher_than) const
+  {
+    priority_t best_priority = higher_than;
+    for(int i = 0; i < NUM_BANDS; i++) {
+      priority_t p = band_priorities[i].load();
+      if((p > best_priority) && !bands[i].empty())
+	best_priority = p;
+    }
+    return best_priority;
+  }
+
+  Task *TaskQueue::LocalDeques::pop(priority_t higher_than)
+  {
+    while(true) {
+      int best = -1;
+      priority_t best_priority = higher_than;
+      for(int i = 0; i < NUM_BANDS; i++) {
+	priority_t p = band_priorities[i].load();
+	if((p > best_priority) && !bands[i].empty()) {
+	  best = i;
+	  best_priority = p;
+	}
+      }
+      if(best < 0)
+	return 0;
+      // the owner takes from the top too, so that tasks of the same
+      //  priority run in the order they were readied
+      Task *task = bands[best].steal();
+      if(task)
+	return task;
+      // a thief got there first - try again
+    }
+  }
+
+  Task *TaskQueue::LocalDeques::steal(priority_t higher_than)
+  {
+    // unlike pop, a failed steal is not retried - the thief will come back
+    //  around through the scheduler loop
+    int best = -1;
+    priority_t best_priority = higher_than;
+    for(int i = 0; i < NUM_BANDS; i++) {
+      priority_t p = band_priorities[i].load_acquire();
+      if((p > best_priority) && !bands[i].empty()) {
+	best = i;
+	best_priority = p;
+      }
+    }
+    if(best < 0)
+      return 0;
+    return bands[best].steal();
+  }
+
+
   ////////////////////////////////////////////////////////////////////////
   //
   // class TaskQueue
   //
 
   TaskQueue::TaskQueue(void)
-    : task_count_gauge(0)
-  {}
+    : shared_max_priority(PRI_NEG_INF)
+    , task_count_gauge(0)
+    , num_local_deques(0)
+  {
+    for(int i = 0; i < MAX_LOCAL_DEQUES; i++)
+      local_deques[i].store(0);
+  }
+
+  void TaskQueue::add_local_deques(LocalDeques *deques)
+  {
+    AutoLock<> al(mutex);
+    int n = num_local_deques.load();
+    for(int i = 0; i < n; i++)
+      if(local_deques[i].load() == 0) {
+	local_deques[i].store_release(deques);
+	return;
+      }
+    if(n < MAX_LOCAL_DEQUES) {
+      local_deques[n].store_release(deques);
+      num_local_deques.store_release(n + 1);
+    }
+    // otherwise, the scheduler just won't get any local deques
+  }
+
+  void TaskQueue::remove_local_deques(LocalDeques *deques)
+  {
+    AutoLock<> al(mutex);
+    int n = num_local_deques.load();
+    for(int i = 0; i < n; i++)
+      if(local_deques[i].load() == deques) {
+	local_deques[i].store_release(0);
+	break;
+      }
+    // close the deques to new pushes and wait out any already in flight -
+    //  a push never blocks or takes the mutex, so a bare spin is fine
+    deques->push_state.fetch_or_acqrel(LocalDeques::PUSH_CLOSED);
+    while(deques->push_state.load_acquire() != LocalDeques::PUSH_CLOSED) {}
+    // anything left behind goes back on the shared list
+    while(true) {
+      Task *task = deques->steal(PRI_NEG_INF);
+      if(!task) {
+	// a failed steal may just have lost a race - check all bands
+	bool all_empty = true;
+	for(int i = 0; i < LocalDeques::NUM_BANDS; i++)
+	  if(!deques->bands[i].empty())
+	    all_empty = false;
+	if(all_empty) break;
+	continue;
+      }
+      ready_task_list.push_back(task);
+    }
+    update_shared_max_priority();
+  }
+
+  void TaskQueue::update_shared_max_priority(void)
+  {
+    // the mutex is held, so nobody can pop the head out from under us
+    Task *head = ready_task_list.front();
+    shared_max_priority.store_release(head ? head->priority : PRI_NEG_INF);
+  }
+
+  TaskQueue::LocalDeques *TaskQueue::find_local_deques(const ThreadedTaskScheduler *sched) const
+  {
+    if(!sched)
+      return 0;
+    int n = num_local_deques.load_acquire();
+    for(int i = 0; i < n; i++) {
+      LocalDeques *ld = local_deques[i].load_acquire();
+      if(ld && (ld->owner == sched))
+	return ld;
+    }
+    return 0;
+  }
 
   void TaskQueue::add_subscription(NotificationCallback *callback,
 				   priority_t higher_than /*= PRI_NEG_INF*/)
@@ -364,6 +590,8 @@ namespace Realm {
       {
 	AutoLock<> al((*it)->mutex);
 	new_task = (*it)->ready_task_list.pop_front(task_priority+1);
+	if(new_task)
+	  (*it)->update_shared_max_priority();
       }
       if(new_task) {
 	if((*it)->task_count_gauge)
@@ -374,6 +602,7 @@ namespace Realm {
 	  {
 	    AutoLock<> al(task_source->mutex);
 	    task_source->ready_task_list.push_front(task);
+	    task_source->update_shared_max_priority();
 	  }
 	  if(task_source->task_count_gauge)
 	    (*task_source->task_count_gauge) += 1;
@@ -388,17 +617,121 @@ namespace Realm {
     return task;
   }
 
+  /*static*/ Task *TaskQueue::get_best_task(const std::vector<TaskQueue *>& queues,
+					    int& task_priority,
+					    ThreadedTaskScheduler *sched)
+  {
+    // remember where a task has come from in case we want to put it back
+    Task *task = 0;
+    TaskQueue *task_source = 0;
+
+    for(std::vector<TaskQueue *>::const_iterator it = queues.begin();
+	it != queues.end();
+	it++) {
+      // a queue's tasks may be in our deques or on its shared list - take
+      //  whichever has the higher priority, only locking the shared list if
+      //  its head could win - nothing orders the shared list's tasks against
+      //  our deques' tasks of the same priority, so ties go to the shared
+      //  list to keep a worker that keeps refilling its own deques from
+      //  starving tasks readied elsewhere
+      LocalDeques *ld = (*it)->find_local_deques(sched);
+      Task *new_task = 0;
+      while(true) {
+	priority_t local_priority = (ld ?
+				       ld->peek_priority(task_priority) :
+				       task_priority);
+	priority_t shared_priority = (*it)->shared_max_priority.load_acquire();
+	if((shared_priority > task_priority) &&
+	   (shared_priority >= local_priority)) {
+	  AutoLock<> al((*it)->mutex);
+	  new_task = (*it)->ready_task_list.pop_front(std::max(local_priority,
+							       task_priority+1));
+	  if(new_task) {
+	    (*it)->update_shared_max_priority();
+	    break;
+	  }
+	  // the hint was stale - fall through to our deques
+	}
+	if(local_priority <= task_priority)
+	  break;
+	// only accept a task at least as good as the one we saw, so that we
+	//  never have to put something back
+	new_task = ld->pop(local_priority - 1);
+	if(new_task)
+	  break;
+	// a thief got there first - take another look
+      }
+      if(new_task) {
+	if((*it)->task_count_gauge)
+	  *((*it)->task_count_gauge) -= 1;
+
+	// if we got something better, put back the old thing (if any) - it
+	//  goes on the front of the shared list even if it came from our
+	//  deques, so that it stays ahead of later tasks of its priority
+	if(task) {
+	  {
+	    AutoLock<> al(task_source->mutex);
+	    task_source->ready_task_list.push_front(task);
+	    task_source->update_shared_max_priority();
+	  }
+	  if(task_source->task_count_gauge)
+	    (*task_source->task_count_gauge) += 1;
+	}
+
+	task = new_task;
+	task_source = *it;
+	task_priority = task->priority;
+      }
+    }
+
+    if(task || !sched)
+      return task;
+
+    // nothing local, so try to steal from a peer in the same NUMA domain -
+    //  only queues shared by several schedulers (i.e. processor groups) have
+    //  peers to steal from
+    for(std::vector<TaskQueue *>::const_iterator it = queues.begin();
+	it != queues.end();
+	it++) {
+      LocalDeques *mine = (*it)->find_local_deques(sched);
+      if(!mine) continue;
+      int n = (*it)->num_local_deques.load_acquire();
+      for(int i = 0; i < n; i++) {
+	LocalDeques *peer = (*it)->local_deques[i].load_acquire();
+	if(!peer || (peer == mine) || (peer->numa_domain != mine->numa_domain))
+	  continue;
+	Task *stolen = peer->steal(task_priority);
+	if(stolen) {
+	  if((*it)->task_count_gauge)
+	    *((*it)->task_count_gauge) -= 1;
+	  task_priority = stolen->priority;
+	  return stolen;
+	}
+      }
+    }
+
+    return 0;
+  }
+
   void TaskQueue::enqueue_task(Task *task)
   {
     priority_t notify_priority = PRI_NEG_INF;
 
     // just jam it into the task queue
     if(task->mark_ready()) {
-      {
+      // if this task was made ready by one of our consumers' own workers,
+      //  it can go into that scheduler's local deques without locking
+      LocalDeques *ld = find_local_deques(ThreadLocal::current_task_scheduler);
+      bool was_empty = false;
+      if(ld && ld->push(task, was_empty)) {
+	if(was_empty)
+	  notify_priority = task->priority;
+      } else {
 	AutoLock<> al(mutex);
 	if(ready_task_list.empty(task->priority))
 	  notify_priority = task->priority;
 	ready_task_list.push_back(task);
+	update_shared_max_priority();
       }
 
       if(task_count_gauge)
@@ -447,6 +780,7 @@ namespace Realm {
 	notify_priority = PRI_NEG_INF;
       // absorb new list into ours
       ready_task_list.absorb_append(tasks);
+      update_shared_max_priority();
     }
 
     if(task_count_gauge)
@@ -603,6 +937,7 @@ namespace Realm {
     , cfg_max_idle_workers(1)
     , cfg_min_active_workers(1)
     , cfg_max_active_workers(1)
+    , cfg_numa_domain(CoreReservationParameters::NUMA_DOMAIN_DONTCARE)
   {
     // hook up the work counter updates for the resumable worker queue
     resumable_workers.add_subscription(&wcu_resume_queue);
@@ -614,6 +949,11 @@ namespace Realm {
     assert(active_worker_count == 0);
     assert(unassigned_worker_count == 0);
     assert(idle_workers.empty());
+
+    for(std::map<TaskQueue *, TaskQueue::LocalDeques *>::iterator it = local_deques.begin();
+	it != local_deques.end();
+	++it)
+      delete it->second;
   }
 
   void ThreadedTaskScheduler::add_task_queue(TaskQueue *queue)
@@ -624,6 +964,16 @@ namespace Realm {
 
     // hook up the work counter updates for this queue
     queue->add_subscription(&wcu_task_queues);
+
+    // local deques rely on there being a single active worker to act as
+    //  the owner
+    if(Config::use_work_stealing && (cfg_max_active_workers == 1) &&
+       (local_deques.count(queue) == 0)) {
+      TaskQueue::LocalDeques *ld = new TaskQueue::LocalDeques(this,
+							      cfg_numa_domain);
+      local_deques[queue] = ld;
+      queue->add_local_deques(ld);
+    }
   }
 
   void ThreadedTaskScheduler::remove_task_queue(TaskQueue *queue)
@@ -639,6 +989,12 @@ namespace Realm {
     
     // un-hook up the work counter updates for this queue
     queue->remove_subscription(&wcu_task_queues);
+
+    // hand back any tasks sitting in our deques - the deques themselves are
+    //  kept until we're destroyed in case a thief is still looking at them
+    std::map<TaskQueue *, TaskQueue::LocalDeques *>::iterator it = local_deques.find(queue);
+    if(it != local_deques.end())
+      queue->remove_local_deques(it->second);
   }
 
   // helper for tracking/sanity-checking worker counts
@@ -891,6 +1247,8 @@ namespace Realm {
 
       // we're a new, and initially unassigned, worker - counters have already been updated
 
+      ThreadLocal::current_task_scheduler = this;
+
       while(true) {
 	// remember the work counter value before we start so that we don't iterate
 	//   unnecessarily
@@ -938,7 +1296,9 @@ namespace Realm {
 
 	// try to get a new task then
 	int task_priority = resumable_priority;
-	Task *task = TaskQueue::get_best_task(task_queues, task_priority);
+	Task *task = (local_deques.empty() ?
+		        TaskQueue::get_best_task(task_queues, task_priority) :
+		        TaskQueue::get_best_task(task_queues, task_priority, this));
 
 	// did we find work to do?
 	if(task) {
@@ -1079,6 +1439,10 @@ namespace Realm {
     // drop our scheduler lock while we wait
     lock.unlock();
 
+    // we're out of work, so there's no point holding on to any event
+    //  notifications that are waiting to be batched up
+    event_message_batcher.flush_all();
+
     work_counter.wait_for_work(old_work_counter);
 
     lock.lock();
@@ -1096,6 +1460,7 @@ namespace Realm {
     , core_rsrv(_core_rsrv)
     , shutdown_condvar(lock)
   {
+    cfg_numa_domain = core_rsrv.params.numa_domain;
   }
 
   KernelThreadTaskScheduler::~KernelThreadTaskScheduler(void)
@@ -1329,6 +1694,7 @@ namespace Realm {
     , host_startup_condvar(lock)
     , cfg_num_host_threads(1)
   {
+    cfg_numa_domain = core_rsrv.params.numa_domain;
   }
 
   UserThreadTaskScheduler::~UserThreadTaskScheduler(void)
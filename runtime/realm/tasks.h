@@ -32,7 +32,15 @@
 
 namespace Realm {
 
+    namespace Config {
+      // if true, tasks made ready by a processor's own worker threads go into
+      //  lock-free per-scheduler deques, and idle members of a processor
+      //  group steal group tasks from peers in the same NUMA domain
+      extern bool use_work_stealing;
+    };
+
     class ProcessorImpl;
+    class ThreadedTaskScheduler;
   
     // information for a task launch
     class Task : public Operation {
@@ -109,6 +117,26 @@ namespace Realm {
       Thread *executing_thread;
     };
 
+    // a fixed-capacity Chase-Lev deque of tasks - the owner pushes at the
+    //  bottom without taking any locks, while tasks are taken from the top
+    //  (by the owner or any other thread), so they come out in FIFO order
+    class TaskDeque {
+    public:
+      TaskDeque(void);
+
+      // owner-only operation - returns false if the deque is full
+      bool push(Task *task);
+
+      // may be called by any thread - can fail spuriously if it loses a race
+      Task *steal(void);
+      bool empty(void) const;
+
+    protected:
+      static const long long CAPACITY = 256;  // must be a power of two
+      atomic<long long> top, bottom;
+      atomic<Task *> buffer[CAPACITY];
+    };
+
     class TaskQueue {
     public:
       TaskQueue(void);
@@ -129,6 +157,12 @@ namespace Realm {
 
       Mutex mutex;
       Task::TaskList ready_task_list;
+      // priority of the head of ready_task_list (PRI_NEG_INF when empty) -
+      //  only written with the mutex held, but may be read without it to
+      //  decide whether the shared list is worth locking
+      atomic<priority_t> shared_max_priority;
+      // must be called with the mutex held after any change to the list
+      void update_shared_max_priority(void);
       std::vector<NotificationCallback *> callbacks;
       std::vector<priority_t> callback_priorities;
       ProfilingGauges::AbsoluteRangeGauge<int> *task_count_gauge;
@@ -146,6 +180,55 @@ namespace Realm {
 
       void enqueue_task(Task *task);
       void enqueue_tasks(Task::TaskList& tasks);
+
+      // when work stealing is enabled, each scheduler consuming from this
+      //  queue gets a set of deques, one per priority band, that it can
+      //  fill and drain without taking the queue's mutex
+      class LocalDeques {
+      public:
+	LocalDeques(ThreadedTaskScheduler *_owner, int _numa_domain);
+
+	// owner-only - returns false if no band is available for the task's
+	//  priority or the band is full, sets 'was_empty' otherwise
+	bool push(Task *task, bool& was_empty);
+	// returns the priority of the highest-priority non-empty band above
+	//  'higher_than' (or 'higher_than' if there is none)
+	priority_t peek_priority(priority_t higher_than) const;
+	// takes the oldest task from the highest-priority band above
+	//  'higher_than'
+	Task *pop(priority_t higher_than);
+
+	// may be called by any thread
+	Task *steal(priority_t higher_than);
+
+	static const int NUM_BANDS = 8;
+	ThreadedTaskScheduler *owner;
+	int numa_domain;
+	// bit 0 is set once the deques are removed from their queue, the rest
+	//  counts pushes in flight - keeping both in one word means a push
+	//  either sees the deques closed or is waited for before they're drained
+	static const int PUSH_CLOSED = 1;
+	static const int PUSH_ACTIVE = 2;
+	atomic<int> push_state;
+	// bands are assigned a priority on first use and keep it
+	atomic<priority_t> band_priorities[NUM_BANDS];
+	TaskDeque bands[NUM_BANDS];
+      };
+
+      void add_local_deques(LocalDeques *deques);
+      // any tasks left in the deques are moved back to the ready task list
+      void remove_local_deques(LocalDeques *deques);
+      LocalDeques *find_local_deques(const ThreadedTaskScheduler *sched) const;
+
+      // variant of get_best_task that also looks at 'sched's local deques
+      //  and, if nothing else is available, steals from its peers
+      static Task *get_best_task(const std::vector<TaskQueue *>& queues,
+				 int& task_priority,
+				 ThreadedTaskScheduler *sched);
+
+      static const int MAX_LOCAL_DEQUES = 64;
+      atomic<LocalDeques *> local_deques[MAX_LOCAL_DEQUES];
+      atomic<int> num_local_deques;
     };
 
     // an internal task is an arbitrary blob of work that needs to happen on
@@ -212,6 +295,8 @@ namespace Realm {
 
       Mutex lock;
       std::vector<TaskQueue *> task_queues;
+      // deques owned by this scheduler (work stealing only)
+      std::map<TaskQueue *, TaskQueue::LocalDeques *> local_deques;
       std::vector<Thread *> idle_workers;
       std::set<Thread *> blocked_workers;
       // threads that block while holding a scheduler lock go here instead
@@ -302,6 +387,9 @@ namespace Realm {
       int cfg_max_idle_workers;
       int cfg_min_active_workers;
       int cfg_max_active_workers;
+      // NUMA domain of this scheduler's cores - work is only stolen from
+      //  peers in the same domain
+      int cfg_numa_domain;
     };
 
     inline long long ThreadedTaskScheduler::WorkCounter::read_counter(void) const
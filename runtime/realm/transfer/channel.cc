@@ -17,6 +17,12 @@
 #include "realm/transfer/channel.h"
 #include "realm/transfer/channel_disk.h"
 #include "realm/transfer/transfer.h"
+#include "realm/numa/numasysif.h"
+
+#if defined(__x86_64__) || defined(__SSE2__)
+#include <emmintrin.h>
+#define REALM_MEMCPY_USE_STREAMING_STORES
+#endif
 
 TYPE_IS_SERIALIZABLE(Realm::XferDesKind);
 
@@ -2427,25 +2433,9 @@ namespace Realm {
           channel->get_request(thread_queue);
           if (channel->is_stopped)
             break;
-          std::deque<MemcpyRequest*>::const_iterator it;
-          for (it = thread_queue.begin(); it != thread_queue.end(); it++) {
-            MemcpyRequest* req = *it;
-            //double starttime = Realm::Clock::current_time_in_microseconds();
-            if (req->dim == Request::DIM_1D) {
-              memcpy(req->dst_base, req->src_base, req->nbytes);
-            } else {
-              assert(req->dim == Request::DIM_2D);
-              const char *src = (const char *)(req->src_base);
-	      char *dst = (char *)(req->dst_base);
-              for (size_t i = 0; i < req->nlines; i++) {
-                memcpy(dst, src, req->nbytes);
-                src += req->src_str;
-                dst += req->dst_str;
-              }
-            }
-            //double stoptime = Realm::Clock::current_time_in_microseconds();
-            //fprintf(stderr, "t = %.2lfus, tp = %.2lfMB/s\n", stoptime - starttime, (req->nbytes / (stoptime - starttime)));
-          }
+          std::deque<MemcpyPiece>::const_iterator it;
+          for (it = thread_queue.begin(); it != thread_queue.end(); it++)
+	    MemcpyChannel::copy_piece(*it);
           channel->return_request(thread_queue);
           thread_queue.clear();
         }
@@ -2462,13 +2452,40 @@ namespace Realm {
                                                     Memory::SOCKET_MEM };
       static const size_t num_cpu_mem_kinds = sizeof(cpu_mem_kinds) / sizeof(cpu_mem_kinds[0]);
 
-      MemcpyChannel::MemcpyChannel(long max_nr)
+      // copies of more than this are written with streaming stores when no
+      //  -ll:memcpy_nt size is given and the last-level cache size is unknown
+      static const size_t DEFAULT_NONTEMPORAL_SIZE = 32 << 20;
+
+      static size_t last_level_cache_size(void)
+      {
+#ifdef _SC_LEVEL3_CACHE_SIZE
+	long l3 = sysconf(_SC_LEVEL3_CACHE_SIZE);
+	if(l3 > 0)
+	  return l3;
+#endif
+#ifdef _SC_LEVEL2_CACHE_SIZE
+	long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+	if(l2 > 0)
+	  return l2;
+#endif
+	return DEFAULT_NONTEMPORAL_SIZE;
+      }
+
+      MemcpyChannel::MemcpyChannel(long max_nr,
+				   const MemcpyPoolConfig& _pool_config)
 	: Channel(XFER_MEM_CPY)
 	, pending_cond(pending_lock)
 	, capacity(max_nr)
+	, pool_config(_pool_config)
       {
         is_stopped = false;
         sleep_threads = false;
+	nontemporal_size = (pool_config.nontemporal_size ?
+			      pool_config.nontemporal_size :
+			      last_level_cache_size());
+	log_new_dma.info() << "memcpy channel: threads=" << pool_config.num_threads
+			   << " split=" << pool_config.split_size
+			   << " nontemporal=" << nontemporal_size;
         //cbs = (MemcpyRequest**) calloc(max_nr, sizeof(MemcpyRequest*));
 	unsigned bw = 0; // TODO
 	unsigned latency = 0;
@@ -2513,7 +2530,7 @@ namespace Realm {
 	pending_lock.unlock();
       }
 
-      void MemcpyChannel::get_request(std::deque<MemcpyRequest*>& thread_queue)
+      void MemcpyChannel::get_request(std::deque<MemcpyPiece>& thread_queue)
       {
         pending_lock.lock();
         while (pending_queue.empty() && !is_stopped) {
@@ -2521,23 +2538,154 @@ namespace Realm {
 	  pending_cond.wait();
         }
         if (!is_stopped) {
-          // TODO: enable the following optimization
-          //thread_queue.insert(thread_queue.end(), pending_queue.begin(), pending_queue.end());
-          thread_queue.push_back(pending_queue.front());
-          pending_queue.pop_front();
-          //fprintf(stderr, "[%d] thread_queue.size = %lu\n", gettid(), thread_queue.size());
-          //pending_queue.clear();
+	  // take our share of what's pending in one go - a single split
+	  //  request still spreads over all the threads, but a long queue
+	  //  doesn't cost a lock round trip per piece
+	  size_t count = std::max(pending_queue.size() / size_t(pool_config.num_threads),
+				  size_t(1));
+	  thread_queue.insert(thread_queue.end(),
+			      pending_queue.begin(),
+			      pending_queue.begin() + count);
+	  pending_queue.erase(pending_queue.begin(),
+			      pending_queue.begin() + count);
         }
         pending_lock.unlock();
       }
 
-      void MemcpyChannel::return_request(std::deque<MemcpyRequest*>& thread_queue)
+      void MemcpyChannel::return_request(std::deque<MemcpyPiece>& thread_queue)
       {
         finished_lock.lock();
-        finished_queue.insert(finished_queue.end(), thread_queue.begin(), thread_queue.end());
+	for(std::deque<MemcpyPiece>::const_iterator it = thread_queue.begin();
+	    it != thread_queue.end();
+	    ++it) {
+	  assert(it->req->pieces_left > 0);
+	  if(--(it->req->pieces_left) == 0)
+	    finished_queue.push_back(it->req);
+	}
         finished_lock.unlock();
       }
 
+      // copies 'bytes' from 'src' to 'dst' without pulling the destination
+      //  into the cache - the caller is responsible for the final fence
+      static void nontemporal_memcpy(char *dst, const char *src, size_t bytes)
+      {
+#ifdef REALM_MEMCPY_USE_STREAMING_STORES
+	// get the destination to 16B alignment with a normal copy
+	size_t head = (16 - (reinterpret_cast<uintptr_t>(dst) & 15)) & 15;
+	if(head > bytes)
+	  head = bytes;
+	if(head) {
+	  memcpy(dst, src, head);
+	  dst += head;
+	  src += head;
+	  bytes -= head;
+	}
+	size_t body = bytes & ~size_t(63);
+	for(size_t i = 0; i < body; i += 64) {
+	  __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+	  __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 16));
+	  __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 32));
+	  __m128i v3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 48));
+	  _mm_stream_si128(reinterpret_cast<__m128i *>(dst + i), v0);
+	  _mm_stream_si128(reinterpret_cast<__m128i *>(dst + i + 16), v1);
+	  _mm_stream_si128(reinterpret_cast<__m128i *>(dst + i + 32), v2);
+	  _mm_stream_si128(reinterpret_cast<__m128i *>(dst + i + 48), v3);
+	}
+	if(body < bytes)
+	  memcpy(dst + body, src + body, bytes - body);
+#else
+	memcpy(dst, src, bytes);
+#endif
+      }
+
+      static void nontemporal_fence(void)
+      {
+#ifdef REALM_MEMCPY_USE_STREAMING_STORES
+	// streaming stores are weakly ordered - make them visible before
+	//  anybody is told the copy is done
+	_mm_sfence();
+#endif
+      }
+
+      /*static*/ void MemcpyChannel::copy_piece(const MemcpyPiece& piece)
+      {
+	const MemcpyRequest *req = piece.req;
+	size_t lines = ((req->dim == Request::DIM_1D) ? 1 : req->nlines);
+	for(size_t r = piece.first_row; r < piece.first_row + piece.num_rows; r++) {
+	  size_t plane = r / lines;
+	  size_t line = r % lines;
+	  const char *src = (static_cast<const char *>(req->src_base) +
+			     (plane * req->src_pstr) + (line * req->src_str) +
+			     piece.byte_offset);
+	  char *dst = (static_cast<char *>(req->dst_base) +
+		       (plane * req->dst_pstr) + (line * req->dst_str) +
+		       piece.byte_offset);
+	  if(piece.nontemporal)
+	    nontemporal_memcpy(dst, src, piece.num_bytes);
+	  else
+	    memcpy(dst, src, piece.num_bytes);
+	}
+	if(piece.nontemporal)
+	  nontemporal_fence();
+      }
+
+      bool MemcpyChannel::split_request(MemcpyRequest *req)
+      {
+	if(pool_config.num_threads <= 0)
+	  return false;
+
+	size_t rows = 1;
+	if(req->dim != Request::DIM_1D) {
+	  rows = req->nlines;
+	  if(req->dim == Request::DIM_3D)
+	    rows *= req->nplanes;
+	}
+	size_t total_bytes = rows * req->nbytes;
+	if((total_bytes == 0) || (total_bytes < pool_config.split_size))
+	  return false;
+
+	MemcpyPiece piece;
+	piece.req = req;
+	piece.nontemporal = (total_bytes >= nontemporal_size);
+
+	std::vector<MemcpyPiece> pieces;
+	size_t num_pieces = pool_config.num_threads;
+	if(rows >= num_pieces) {
+	  // whole rows per piece
+	  piece.byte_offset = 0;
+	  piece.num_bytes = req->nbytes;
+	  for(size_t i = 0; i < num_pieces; i++) {
+	    piece.first_row = (rows * i) / num_pieces;
+	    piece.num_rows = (rows * (i + 1)) / num_pieces - piece.first_row;
+	    pieces.push_back(piece);
+	  }
+	} else {
+	  // split each row into cache-line-aligned byte ranges
+	  size_t per_row = (num_pieces + rows - 1) / rows;
+	  size_t chunk = (((req->nbytes + per_row - 1) / per_row) + 63) & ~size_t(63);
+	  piece.num_rows = 1;
+	  for(size_t r = 0; r < rows; r++) {
+	    piece.first_row = r;
+	    for(size_t ofs = 0; ofs < req->nbytes; ofs += chunk) {
+	      piece.byte_offset = ofs;
+	      piece.num_bytes = std::min(chunk, req->nbytes - ofs);
+	      pieces.push_back(piece);
+	    }
+	  }
+	}
+
+	// pieces_left must be set before any copy thread can see a piece
+	req->pieces_left = pieces.size();
+	pending_lock.lock();
+	pending_queue.insert(pending_queue.end(), pieces.begin(), pieces.end());
+	if(sleep_threads) {
+	  pending_cond.broadcast();
+	  sleep_threads = false;
+	}
+	pending_lock.unlock();
+	return true;
+      }
+
       long MemcpyChannel::submit(Request** requests, long nr)
       {
         MemcpyRequest** mem_cpy_reqs = (MemcpyRequest**) requests;
@@ -2564,6 +2712,14 @@ namespace Realm {
 	  XferDes::XferPort *out_port = &req->xd->output_ports[req->dst_port_idx];
 	  const CustomSerdezUntyped *src_serdez_op = in_port->serdez_op;
 	  const CustomSerdezUntyped *dst_serdez_op = out_port->serdez_op;
+	  // large plain copies go to the copy threads and are completed
+	  //  later by pull()
+	  if(!src_serdez_op && !dst_serdez_op && split_request(req))
+	    continue;
+	  // plain copies too big for the cache bypass it
+	  bool nontemporal = (!src_serdez_op && !dst_serdez_op &&
+			      ((req->nbytes * req->nlines * req->nplanes) >=
+			       nontemporal_size));
 	  if(src_serdez_op && !dst_serdez_op) {
 	    // we manage write_bytes_total, write_seq_{pos,count}
 	    req->write_seq_pos = out_port->local_bytes_total;
@@ -2929,7 +3085,10 @@ namespace Realm {
 		    in_port->local_bytes_total += bytes_used;
 		  } else {
 		    // normal copy
-		    memcpy(dst, src, req->nbytes);
+		    if(nontemporal)
+		      nontemporal_memcpy(dst, src, req->nbytes);
+		    else
+		      memcpy(dst, src, req->nbytes);
 		  }
 		}
 		if(req->dim == Request::DIM_1D) break;
@@ -2967,6 +3126,8 @@ namespace Realm {
 	    }
 	  } else
 	      assert(rewind_src == 0);
+	  if(nontemporal)
+	    nontemporal_fence();
           req->xd->notify_request_read_done(req);
           req->xd->notify_request_write_done(req);
         }
@@ -3581,10 +3742,11 @@ namespace Realm {
       ChannelManager::~ChannelManager(void) {
       }
 
-      MemcpyChannel* ChannelManager::create_memcpy_channel(long max_nr)
+      MemcpyChannel* ChannelManager::create_memcpy_channel(long max_nr,
+							   const MemcpyPoolConfig& pool_config)
       {
         assert(memcpy_channel == NULL);
-        memcpy_channel = new MemcpyChannel(max_nr);
+        memcpy_channel = new MemcpyChannel(max_nr, pool_config);
         return memcpy_channel;
       }
       GASNetChannel* ChannelManager::create_gasnet_read_channel(long max_nr) {
@@ -3644,10 +3806,60 @@ namespace Realm {
         dma_all_gpus.push_back(gpu);
       }
 #endif
+      XferDesQueue::XferDesQueue(int num_dma_threads, bool pinned,
+				 const MemcpyPoolConfig& _memcpy_pool,
+				 CoreReservationSet& crs)
+	: memcpy_pool(_memcpy_pool)
+      //: core_rsrv("DMA request queue", crs, CoreReservationParameters())
+      {
+        if (pinned) {
+          CoreReservationParameters params;
+          params.set_num_cores(num_dma_threads);
+          params.set_alu_usage(params.CORE_USAGE_EXCLUSIVE);
+          params.set_fpu_usage(params.CORE_USAGE_EXCLUSIVE);
+          params.set_ldst_usage(params.CORE_USAGE_SHARED);
+          core_rsrv = new CoreReservation("DMA threads", crs, params);
+        } else {
+          core_rsrv = new CoreReservation("DMA threads", crs, CoreReservationParameters());
+        }
+	// the copy threads are spread round-robin over the NUMA domains, so
+	//  that split copies use every socket's memory controllers
+	if(memcpy_pool.num_threads > 0) {
+	  std::vector<int> domains;
+	  std::map<int, NumaNodeCpuInfo> cpuinfo;
+	  if(numasysif_numa_available() &&
+	     numasysif_get_cpu_info(cpuinfo) &&
+	     (cpuinfo.size() > 1))
+	    for(std::map<int, NumaNodeCpuInfo>::const_iterator it = cpuinfo.begin();
+		it != cpuinfo.end();
+		++it)
+	      if(it->second.cores_available > 0)
+		domains.push_back(it->first);
+	  for(int i = 0; i < memcpy_pool.num_threads; i++) {
+	    CoreReservationParameters params;
+	    if(pinned) {
+	      params.set_alu_usage(params.CORE_USAGE_EXCLUSIVE);
+	      params.set_ldst_usage(params.CORE_USAGE_EXCLUSIVE);
+	    }
+	    if(!domains.empty())
+	      params.set_numa_domain(domains[i % domains.size()]);
+	    memcpy_rsrvs.push_back(new CoreReservation("DMA copy thread",
+						       crs, params));
+	  }
+	}
+        // reserve the first several guid
+        next_to_assign_idx.store(10);
+        num_threads = 0;
+        num_memcpy_threads = 0;
+        dma_threads = NULL;
+	memcpy_threads = NULL;
+      }
+
       void start_channel_manager(int count, bool pinned, int max_nr,
+				 const MemcpyPoolConfig& memcpy_pool,
                                  Realm::CoreReservationSet& crs)
       {
-        xferDes_queue = new XferDesQueue(count, pinned, crs);
+        xferDes_queue = new XferDesQueue(count, pinned, memcpy_pool, crs);
         channel_manager = new ChannelManager;
         xferDes_queue->start_worker(count, max_nr, channel_manager);
       }
@@ -3772,7 +3984,8 @@ namespace Realm {
         dma_threads = (DMAThread**) calloc(count, sizeof(DMAThread*));
         // dma thread #1: memcpy
         std::vector<Channel*> channels;
-        MemcpyChannel* memcpy_channel = channel_manager->create_memcpy_channel(max_nr);
+        MemcpyChannel* memcpy_channel = channel_manager->create_memcpy_channel(max_nr,
+									       memcpy_pool);
 	GASNetChannel* gasnet_read_channel = channel_manager->create_gasnet_read_channel(max_nr);
 	GASNetChannel* gasnet_write_channel = channel_manager->create_gasnet_write_channel(max_nr);
 	AddressSplitChannel *addr_split_channel = channel_manager->create_addr_split_channel();
@@ -3856,20 +4069,19 @@ namespace Realm {
           worker_threads.push_back(t);
         }
 
-#ifdef USE_DEDICATED_MEMCPY_THREADS
         // Next we create memcpy threads
+        num_memcpy_threads = memcpy_rsrvs.size();
         memcpy_threads =(MemcpyThread**) calloc(num_memcpy_threads, sizeof(MemcpyThread*));
         for (int i = 0; i < num_memcpy_threads; i++) {
           memcpy_threads[i] = new MemcpyThread(memcpy_channel);
           Realm::Thread *t = Realm::Thread::create_kernel_thread<MemcpyThread,
                                             &MemcpyThread::thread_loop>(memcpy_threads[i],
                                                                         tlp,
-                                                                        *core_rsrv,
+                                                                        *memcpy_rsrvs[i],
                                                                         0 /*default scheduler*/);
           worker_threads.push_back(t);
         }
-#endif
-        assert(worker_threads.size() == (size_t)(num_threads));
+        assert(worker_threads.size() == (size_t)(num_threads + num_memcpy_threads));
       }
 
       void stop_channel_manager()
@@ -3897,9 +4109,7 @@ namespace Realm {
         for (int i = 0; i < num_memcpy_threads; i++)
           delete memcpy_threads[i];
         free(dma_threads);
-#ifdef USE_DEDICATED_MEMCPY_THREADS
         free(memcpy_threads);
-#endif
       }
 
       void XferDes::DeferredXDEnqueue::defer(XferDesQueue *_xferDes_queue,
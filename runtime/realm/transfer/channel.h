@@ -214,6 +214,9 @@ namespace Realm {
       const void *src_base;
       void *dst_base;
       //size_t nbytes;
+      // pieces still being copied by the copy threads (protected by the
+      //  channel's finished_lock)
+      size_t pieces_left;
     };
 
     class GASNetRequest : public Request {
@@ -731,6 +734,15 @@ namespace Realm {
 
     class MemcpyChannel;
 
+    // a range of a (plain) copy request handed to a copy thread - either
+    //  whole rows (lines/planes flattened), or a byte range of one row
+    struct MemcpyPiece {
+      MemcpyRequest *req;
+      size_t first_row, num_rows;
+      size_t byte_offset, num_bytes;
+      bool nontemporal;
+    };
+
     class MemcpyThread {
     public:
       MemcpyThread(MemcpyChannel* _channel) : channel(_channel) {}
@@ -739,16 +751,16 @@ namespace Realm {
       void stop();
     private:
       MemcpyChannel* channel;
-      std::deque<MemcpyRequest*> thread_queue;
+      std::deque<MemcpyPiece> thread_queue;
     };
 
     class MemcpyChannel : public Channel {
     public:
-      MemcpyChannel(long max_nr);
+      MemcpyChannel(long max_nr, const MemcpyPoolConfig& _pool_config);
       ~MemcpyChannel();
       void stop();
-      void get_request(std::deque<MemcpyRequest*>& thread_queue);
-      void return_request(std::deque<MemcpyRequest*>& thread_queue);
+      void get_request(std::deque<MemcpyPiece>& thread_queue);
+      void return_request(std::deque<MemcpyPiece>& thread_queue);
       long submit(Request** requests, long nr);
       void pull();
       long available();
@@ -760,13 +772,24 @@ namespace Realm {
 				 unsigned *bw_ret = 0,
 				 unsigned *lat_ret = 0);
 
+      // copies 'piece' (called by the copy threads)
+      static void copy_piece(const MemcpyPiece& piece);
+
       bool is_stopped;
+    protected:
+      // splits a plain copy across the copy threads if it's big enough -
+      //  returns false if it should be done in place instead
+      bool split_request(MemcpyRequest *req);
+
     private:
-      std::deque<MemcpyRequest*> pending_queue, finished_queue;
+      std::deque<MemcpyPiece> pending_queue;
+      std::deque<MemcpyRequest*> finished_queue;
       Mutex pending_lock, finished_lock;
       CondVar pending_cond;
       atomic<long> capacity;
       bool sleep_threads;
+      MemcpyPoolConfig pool_config;
+      size_t nontemporal_size;
       //std::vector<MemcpyRequest*> available_cb;
       //MemcpyRequest** cbs;
     };
@@ -857,7 +880,8 @@ namespace Realm {
 	addr_split_channel = 0;
       }
       ~ChannelManager(void);
-      MemcpyChannel* create_memcpy_channel(long max_nr);
+      MemcpyChannel* create_memcpy_channel(long max_nr,
+					   const MemcpyPoolConfig& pool_config);
       GASNetChannel* create_gasnet_read_channel(long max_nr);
       GASNetChannel* create_gasnet_write_channel(long max_nr);
       RemoteWriteChannel* create_remote_write_channel(long max_nr);
@@ -1249,28 +1273,13 @@ namespace Realm {
         NODE_BITS = 16,
         INDEX_BITS = 32
       };
-      XferDesQueue(int num_dma_threads, bool pinned, CoreReservationSet& crs)
-      //: core_rsrv("DMA request queue", crs, CoreReservationParameters())
-      {
-        if (pinned) {
-          CoreReservationParameters params;
-          params.set_num_cores(num_dma_threads);
-          params.set_alu_usage(params.CORE_USAGE_EXCLUSIVE);
-          params.set_fpu_usage(params.CORE_USAGE_EXCLUSIVE);
-          params.set_ldst_usage(params.CORE_USAGE_SHARED);
-          core_rsrv = new CoreReservation("DMA threads", crs, params);
-        } else {
-          core_rsrv = new CoreReservation("DMA threads", crs, CoreReservationParameters());
-        }
-        // reserve the first several guid
-        next_to_assign_idx.store(10);
-        num_threads = 0;
-        num_memcpy_threads = 0;
-        dma_threads = NULL;
-      }
+      XferDesQueue(int num_dma_threads, bool pinned,
+		   const MemcpyPoolConfig& _memcpy_pool, CoreReservationSet& crs);
 
       ~XferDesQueue() {
         delete core_rsrv;
+	for(size_t i = 0; i < memcpy_rsrvs.size(); i++)
+	  delete memcpy_rsrvs[i];
         // clean up the priority queues
 	queues_lock.lock();  // probably don't need lock here
         std::map<Channel*, PriorityXferDesQueue*>::iterator it2;
@@ -1394,6 +1403,8 @@ namespace Realm {
       RWLock guid_lock;
       atomic<XferDesID> next_to_assign_idx;
       CoreReservation* core_rsrv;
+      MemcpyPoolConfig memcpy_pool;
+      std::vector<CoreReservation *> memcpy_rsrvs;
       int num_threads, num_memcpy_threads;
       DMAThread** dma_threads;
       MemcpyThread** memcpy_threads;
@@ -1405,7 +1416,9 @@ namespace Realm {
 #ifdef REALM_USE_CUDA
     void register_gpu_in_dma_systems(Cuda::GPU* gpu);
 #endif
-    void start_channel_manager(int count, bool pinned, int max_nr, CoreReservationSet& crs);
+    void start_channel_manager(int count, bool pinned, int max_nr,
+			       const MemcpyPoolConfig& memcpy_pool,
+			       CoreReservationSet& crs);
     void stop_channel_manager();
 
     void destroy_xfer_des(XferDesID _guid);
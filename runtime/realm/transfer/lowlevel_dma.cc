@@ -30,6 +30,12 @@
 #else
 #include <aio.h>
 #endif
+#ifdef REALM_USE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#endif
 
 #ifdef REALM_USE_CUDA
 #include "realm/cuda/cuda_module.h"
@@ -58,6 +64,10 @@ namespace Realm {
     Logger log_ib_alloc("ib_alloc");
     //extern Logger log_new_dma;
     Logger log_aio("aio");
+
+    namespace Config {
+      size_t io_uring_max_rw = 1 << 30;
+    };
 #ifdef EVENT_GRAPH_TRACE
     extern Logger log_event_graph;
     extern Event find_enclosing_termination_event(void);
@@ -1352,6 +1362,327 @@ namespace Realm {
     }
 #endif
 
+#ifdef REALM_USE_IO_URING
+    inline int io_uring_setup(unsigned entries, struct io_uring_params *p)
+    {
+      return syscall(__NR_io_uring_setup, entries, p);
+    }
+
+    inline int io_uring_enter(int fd, unsigned to_submit,
+			      unsigned min_complete, unsigned flags)
+    {
+      return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+		     flags, NULL, 0);
+    }
+
+    inline int io_uring_register(int fd, unsigned opcode,
+				 const void *arg, unsigned nr_args)
+    {
+      return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+    }
+
+    // a minimal io_uring wrapper - submission queue entries are filled in as
+    //  operations are launched, but are only handed to the kernel in batches,
+    //  and completions are found by polling the completion ring from whatever
+    //  thread calls make_progress (i.e. the DMA threads), so that neither
+    //  side needs a system call per operation
+    // all methods must be called with the AsyncFileIOContext's mutex held
+    class IOUringEngine {
+    public:
+      IOUringEngine(void);
+      ~IOUringEngine(void);
+
+      bool init(unsigned entries);
+
+      void add_fixed_buffer(void *base, size_t bytes);
+
+      void queue_rw(bool write, int fd, size_t offset,
+		    size_t bytes, void *buffer, void *user_data);
+
+      // hands any queued entries to the kernel
+      void submit_queued(void);
+
+      // returns true and fills in the result if a completion was available
+      bool reap_completion(void *& user_data, int& result);
+
+    protected:
+      // don't let more than this many entries accumulate before submitting
+      static const unsigned SUBMIT_BATCH = 32;
+      // a submission entry's length is only 32 bits (and the kernel won't
+      //  move 2GB or more in one read/write anyway)
+      static const size_t MAX_RW_BYTES = 1 << 30;
+
+      int ring_fd;
+      void *sq_ring, *cq_ring;
+      size_t sq_ring_bytes, cq_ring_bytes;
+      struct io_uring_sqe *sqes;
+      size_t sqes_bytes;
+      unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+      unsigned *cq_head, *cq_tail, *cq_mask;
+      struct io_uring_cqe *cqes;
+      unsigned queued;
+
+      // ranges registered as fixed buffers
+      std::vector<struct iovec> fixed_buffers;
+      bool fixed_registered;
+    };
+
+    IOUringEngine::IOUringEngine(void)
+      : ring_fd(-1)
+      , sq_ring(MAP_FAILED), cq_ring(MAP_FAILED)
+      , sq_ring_bytes(0), cq_ring_bytes(0)
+      , sqes(0), sqes_bytes(0)
+      , queued(0)
+      , fixed_registered(false)
+    {}
+
+    IOUringEngine::~IOUringEngine(void)
+    {
+      if(sqes)
+	munmap(sqes, sqes_bytes);
+      if(cq_ring != MAP_FAILED && cq_ring != sq_ring)
+	munmap(cq_ring, cq_ring_bytes);
+      if(sq_ring != MAP_FAILED)
+	munmap(sq_ring, sq_ring_bytes);
+      if(ring_fd >= 0)
+	close(ring_fd);
+    }
+
+    bool IOUringEngine::init(unsigned entries)
+    {
+      struct io_uring_params params;
+      memset(&params, 0, sizeof(params));
+      ring_fd = io_uring_setup(entries, &params);
+      if(ring_fd < 0) {
+	log_aio.info() << "io_uring_setup failed: " << strerror(errno);
+	return false;
+      }
+
+      sq_ring_bytes = params.sq_off.array + (params.sq_entries * sizeof(unsigned));
+      cq_ring_bytes = params.cq_off.cqes + (params.cq_entries * sizeof(struct io_uring_cqe));
+      // newer kernels map both rings with a single mmap
+      if((params.features & IORING_FEAT_SINGLE_MMAP) != 0)
+	sq_ring_bytes = cq_ring_bytes = std::max(sq_ring_bytes, cq_ring_bytes);
+
+      sq_ring = mmap(0, sq_ring_bytes, PROT_READ | PROT_WRITE,
+		     MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+      if(sq_ring == MAP_FAILED) {
+	log_aio.info() << "io_uring sq ring mmap failed: " << strerror(errno);
+	return false;
+      }
+      if((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+	cq_ring = sq_ring;
+      } else {
+	cq_ring = mmap(0, cq_ring_bytes, PROT_READ | PROT_WRITE,
+		       MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+	if(cq_ring == MAP_FAILED) {
+	  log_aio.info() << "io_uring cq ring mmap failed: " << strerror(errno);
+	  return false;
+	}
+      }
+      sqes_bytes = params.sq_entries * sizeof(struct io_uring_sqe);
+      void *sqe_base = mmap(0, sqes_bytes, PROT_READ | PROT_WRITE,
+			    MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+      if(sqe_base == MAP_FAILED) {
+	log_aio.info() << "io_uring sqe mmap failed: " << strerror(errno);
+	return false;
+      }
+      sqes = static_cast<struct io_uring_sqe *>(sqe_base);
+
+      char *sq_base = static_cast<char *>(sq_ring);
+      sq_head = reinterpret_cast<unsigned *>(sq_base + params.sq_off.head);
+      sq_tail = reinterpret_cast<unsigned *>(sq_base + params.sq_off.tail);
+      sq_mask = reinterpret_cast<unsigned *>(sq_base + params.sq_off.ring_mask);
+      sq_array = reinterpret_cast<unsigned *>(sq_base + params.sq_off.array);
+      char *cq_base = static_cast<char *>(cq_ring);
+      cq_head = reinterpret_cast<unsigned *>(cq_base + params.cq_off.head);
+      cq_tail = reinterpret_cast<unsigned *>(cq_base + params.cq_off.tail);
+      cq_mask = reinterpret_cast<unsigned *>(cq_base + params.cq_off.ring_mask);
+      cqes = reinterpret_cast<struct io_uring_cqe *>(cq_base + params.cq_off.cqes);
+
+      log_aio.info() << "io_uring initialized: entries=" << params.sq_entries
+		     << " features=" << std::hex << params.features << std::dec;
+      return true;
+    }
+
+    void IOUringEngine::add_fixed_buffer(void *base, size_t bytes)
+    {
+      // buffers have to be registered all at once, and before any I/O uses
+      //  them
+      assert(!fixed_registered);
+
+      // registration of a buffer pins it, which can fail due to (among other
+      //  things) locked memory limits - that's not fatal, the buffers just
+      //  won't be used as fixed buffers
+      struct iovec iov;
+      iov.iov_base = base;
+      iov.iov_len = bytes;
+      fixed_buffers.push_back(iov);
+    }
+
+    void IOUringEngine::queue_rw(bool write, int fd, size_t offset,
+				 size_t bytes, void *buffer, void *user_data)
+    {
+      // larger transfers are cut short here - the kernel reports a short
+      //  result and the operation resubmits the remainder
+      size_t max_bytes = Config::io_uring_max_rw;
+      if((max_bytes == 0) || (max_bytes > MAX_RW_BYTES))
+	max_bytes = MAX_RW_BYTES;
+      if(bytes > max_bytes)
+	bytes = max_bytes;
+
+      if(!fixed_registered) {
+	fixed_registered = true;
+	if(!fixed_buffers.empty()) {
+	  int ret = io_uring_register(ring_fd, IORING_REGISTER_BUFFERS,
+				      &fixed_buffers[0], fixed_buffers.size());
+	  if(ret < 0) {
+	    log_aio.info() << "io_uring buffer registration failed: "
+			   << strerror(errno);
+	    fixed_buffers.clear();
+	  }
+	}
+      }
+
+      unsigned tail = *sq_tail;
+      // the number of launched operations is limited by the ring size, so
+      //  there's always room for another entry
+      assert((tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE)) <= *sq_mask);
+      unsigned idx = tail & *sq_mask;
+      struct io_uring_sqe *sqe = &sqes[idx];
+      memset(sqe, 0, sizeof(struct io_uring_sqe));
+
+      int buf_index = -1;
+      for(size_t i = 0; i < fixed_buffers.size(); i++) {
+	char *lo = static_cast<char *>(fixed_buffers[i].iov_base);
+	if((static_cast<char *>(buffer) >= lo) &&
+	   ((static_cast<char *>(buffer) + bytes) <= (lo + fixed_buffers[i].iov_len))) {
+	  buf_index = i;
+	  break;
+	}
+      }
+
+      if(buf_index >= 0) {
+	sqe->opcode = (write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED);
+	sqe->buf_index = buf_index;
+      } else
+	sqe->opcode = (write ? IORING_OP_WRITE : IORING_OP_READ);
+      sqe->fd = fd;
+      sqe->off = offset;
+      sqe->addr = reinterpret_cast<uintptr_t>(buffer);
+      sqe->len = bytes;
+      sqe->user_data = reinterpret_cast<uintptr_t>(user_data);
+      sq_array[idx] = idx;
+
+      // make the entry visible to the kernel
+      __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+      queued++;
+
+      if(queued >= SUBMIT_BATCH)
+	submit_queued();
+    }
+
+    void IOUringEngine::submit_queued(void)
+    {
+      while(queued > 0) {
+	int ret = io_uring_enter(ring_fd, queued, 0, 0);
+	if(ret < 0) {
+	  // the kernel is temporarily out of resources - try again on the next
+	  //  call to make_progress
+	  if((errno == EAGAIN) || (errno == EBUSY) || (errno == EINTR))
+	    break;
+	  log_aio.fatal() << "io_uring_enter failed: " << strerror(errno);
+	  abort();
+	}
+	queued -= ret;
+      }
+    }
+
+    bool IOUringEngine::reap_completion(void *& user_data, int& result)
+    {
+      unsigned head = *cq_head;
+      if(head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+	return false;
+      const struct io_uring_cqe *cqe = &cqes[head & *cq_mask];
+      user_data = reinterpret_cast<void *>(uintptr_t(cqe->user_data));
+      result = cqe->res;
+      __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+      return true;
+    }
+
+    class IOUringOperation : public AsyncFileIOContext::AIOOperation {
+    public:
+      IOUringOperation(IOUringEngine *_engine, bool _write, int _fd,
+		       size_t _offset, size_t _bytes, void *_buffer,
+		       Request *request);
+      virtual void launch(void);
+      virtual bool check_completion(void);
+
+      // called when the kernel reports a result for this operation
+      void process_result(int result);
+
+    protected:
+      IOUringEngine *engine;
+      bool write;
+      int fd;
+      size_t offset, bytes, done;
+      char *buffer;
+    };
+
+    IOUringOperation::IOUringOperation(IOUringEngine *_engine, bool _write,
+				       int _fd, size_t _offset, size_t _bytes,
+				       void *_buffer, Request *request)
+      : engine(_engine), write(_write), fd(_fd)
+      , offset(_offset), bytes(_bytes), done(0)
+      , buffer(static_cast<char *>(_buffer))
+    {
+      completed = false;
+      req = request;
+    }
+
+    void IOUringOperation::launch(void)
+    {
+      log_aio.debug("%s issued: op=%p", (write ? "write" : "read"), this);
+      engine->queue_rw(write, fd, offset + done, bytes - done,
+		       buffer + done, this);
+    }
+
+    bool IOUringOperation::check_completion(void)
+    {
+      return completed;
+    }
+
+    void IOUringOperation::process_result(int result)
+    {
+      log_aio.debug("%s returned: op=%p ret=%d",
+		    (write ? "write" : "read"), this, result);
+      if(result < 0) {
+	log_aio.fatal() << "io_uring " << (write ? "write" : "read")
+			<< " failed: fd=" << fd << " offset=" << (offset + done)
+			<< " bytes=" << (bytes - done) << ": " << strerror(-result);
+	abort();
+      }
+      // the channels only read data that lies within the file and a write
+      //  that makes no progress would be resubmitted forever, so a transfer
+      //  that moves nothing is an error either way
+      if((result == 0) && (done < bytes)) {
+	log_aio.fatal() << "io_uring " << (write ? "write" : "read")
+			<< " made no progress: fd=" << fd
+			<< " offset=" << (offset + done)
+			<< " bytes=" << (bytes - done)
+			<< (write ? "" : " (unexpected end of file)");
+	abort();
+      }
+      done += result;
+      // a short transfer (buffered files can do this, and long transfers are
+      //  always split) gets resubmitted for the remainder
+      if(done < bytes)
+	launch();
+      else
+	completed = true;
+    }
+#endif
+
     class AIOFence : public Operation::AsyncWorkItem {
     public:
       AIOFence(Operation *_op) : Operation::AsyncWorkItem(_op) {}
@@ -1392,7 +1723,8 @@ namespace Realm {
       return true;
     }
 
-    AsyncFileIOContext::AsyncFileIOContext(int _max_depth)
+    AsyncFileIOContext::AsyncFileIOContext(int _max_depth,
+					   bool use_io_uring /*= false*/)
       : max_depth(_max_depth)
     {
 #ifdef REALM_USE_KERNEL_AIO
@@ -1402,6 +1734,20 @@ namespace Realm {
 #endif
 	io_setup(max_depth, &aio_ctx);
       assert(ret == 0);
+#endif
+#ifdef REALM_USE_IO_URING
+      uring = 0;
+      if(use_io_uring) {
+	uring = new IOUringEngine;
+	if(!uring->init(max_depth)) {
+	  log_aio.warning() << "io_uring not available - using AIO for file I/O";
+	  delete uring;
+	  uring = 0;
+	}
+      }
+#else
+      if(use_io_uring)
+	log_aio.warning() << "io_uring support not compiled in - using AIO for file I/O";
 #endif
     }
 
@@ -1415,6 +1761,18 @@ namespace Realm {
 #endif
 	io_destroy(aio_ctx);
       assert(ret == 0);
+#endif
+#ifdef REALM_USE_IO_URING
+      delete uring;
+#endif
+    }
+
+    void AsyncFileIOContext::register_buffer(void *base, size_t bytes)
+    {
+#ifdef REALM_USE_IO_URING
+      AutoLock<> al(mutex);
+      if(uring)
+	uring->add_fixed_buffer(base, bytes);
 #endif
     }
 
@@ -1422,11 +1780,17 @@ namespace Realm {
 					   size_t bytes, const void *buffer,
                                            Request* req)
     {
+      AIOOperation *op;
+#ifdef REALM_USE_IO_URING
+      if(uring)
+	op = new IOUringOperation(uring, true /*write*/, fd, offset, bytes,
+				  const_cast<void *>(buffer), req);
+      else
+#endif
 #ifdef REALM_USE_KERNEL_AIO
-      KernelAIOWrite *op = new KernelAIOWrite(aio_ctx,
-					      fd, offset, bytes, buffer, req);
+	op = new KernelAIOWrite(aio_ctx, fd, offset, bytes, buffer, req);
 #else
-      PosixAIOWrite *op = new PosixAIOWrite(fd, offset, bytes, buffer, req);
+	op = new PosixAIOWrite(fd, offset, bytes, buffer, req);
 #endif
       {
 	AutoLock<> al(mutex);
@@ -1443,11 +1807,17 @@ namespace Realm {
 					  size_t bytes, void *buffer,
                                           Request* req)
     {
+      AIOOperation *op;
+#ifdef REALM_USE_IO_URING
+      if(uring)
+	op = new IOUringOperation(uring, false /*!write*/, fd, offset, bytes,
+				  buffer, req);
+      else
+#endif
 #ifdef REALM_USE_KERNEL_AIO
-      KernelAIORead *op = new KernelAIORead(aio_ctx,
-					    fd, offset, bytes, buffer, req);
+	op = new KernelAIORead(aio_ctx, fd, offset, bytes, buffer, req);
 #else
-      PosixAIORead *op = new PosixAIORead(fd, offset, bytes, buffer, req);
+	op = new PosixAIORead(fd, offset, bytes, buffer, req);
 #endif
       {
 	AutoLock<> al(mutex);
@@ -1490,6 +1860,24 @@ namespace Realm {
     {
       AutoLock<> al(mutex);
 
+#ifdef REALM_USE_IO_URING
+      if(uring) {
+	// hand over anything queued since the last call, then collect
+	//  results - short transfers are requeued, so submit once more
+	//  after reaping
+	uring->submit_queued();
+	void *user_data;
+	int result;
+	bool any_reaped = false;
+	while(uring->reap_completion(user_data, result)) {
+	  static_cast<IOUringOperation *>(user_data)->process_result(result);
+	  any_reaped = true;
+	}
+	if(any_reaped)
+	  uring->submit_queued();
+      }
+#endif
+
       // first, reap as many events as we can - oldest first
 #ifdef REALM_USE_KERNEL_AIO
       while(true) {
@@ -3189,11 +3577,30 @@ namespace Realm {
     }
 
     void start_dma_system(int count, bool pinned, int max_nr,
+                          bool use_io_uring,
+			  const MemcpyPoolConfig& memcpy_pool,
                           CoreReservationSet& crs)
     {
       //log_dma.add_stream(&std::cerr, Logger::LEVEL_DEBUG, false, false);
-      aio_context = new AsyncFileIOContext(256);
-      start_channel_manager(count, pinned, max_nr, crs);
+      aio_context = new AsyncFileIOContext(256, use_io_uring);
+      if(use_io_uring) {
+	// registered memories are already pinned, so they can be used as
+	//  fixed buffers by the io_uring without further cost
+	const Node& n = get_runtime()->nodes[Network::my_node_id];
+	for(int pass = 0; pass < 2; pass++) {
+	  const std::vector<MemoryImpl *>& mems = (pass ? n.ib_memories :
+						                  n.memories);
+	  for(std::vector<MemoryImpl *>::const_iterator it = mems.begin();
+	      it != mems.end();
+	      ++it) {
+	    if((*it)->lowlevel_kind != Memory::REGDMA_MEM) continue;
+	    void *base = (*it)->get_direct_ptr(0, (*it)->size);
+	    if(base)
+	      aio_context->register_buffer(base, (*it)->size);
+	  }
+	}
+      }
+      start_channel_manager(count, pinned, max_nr, memcpy_pool, crs);
       ib_req_queue = new PendingIBQueue();
     }
 
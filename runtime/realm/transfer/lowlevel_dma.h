@@ -28,6 +28,12 @@
 namespace Realm {
   class CoreReservationSet;
 
+  namespace Config {
+    // largest read or write handed to an io_uring in a single submission -
+    //  longer transfers are submitted in pieces
+    extern size_t io_uring_max_rw;
+  };
+
     struct RemoteIBAllocRequestAsync {
       Memory memory;
       void *req;
@@ -87,7 +93,20 @@ namespace Realm {
     extern void start_dma_worker_threads(int count, Realm::CoreReservationSet& crs);
     extern void stop_dma_worker_threads(void);
 
-    extern void start_dma_system(int count, bool pinned, int max_nr, Realm::CoreReservationSet& crs);
+    // settings for the pool of copy threads used by the memcpy channel
+    struct MemcpyPoolConfig {
+      MemcpyPoolConfig(void)
+	: num_threads(0), split_size(4 << 20), nontemporal_size(0) {}
+
+      int num_threads;          // 0 = all copies done by the dma thread
+      size_t split_size;        // copies at least this big are split across the pool
+      size_t nontemporal_size;  // copies at least this big bypass the cache (0 = LLC size)
+    };
+
+    extern void start_dma_system(int count, bool pinned, int max_nr,
+                                 bool use_io_uring,
+				 const MemcpyPoolConfig& memcpy_pool,
+                                 Realm::CoreReservationSet& crs);
 
     extern void stop_dma_system(void);
 
@@ -502,12 +521,22 @@ namespace Realm {
     };
 
     class Request;
+#ifdef REALM_USE_IO_URING
+    class IOUringEngine;
+#endif
 
     class AsyncFileIOContext {
     public:
-      AsyncFileIOContext(int _max_depth);
+      // if `use_io_uring` is set (and io_uring is available), reads and
+      //  writes go through an io_uring instead of AIO
+      AsyncFileIOContext(int _max_depth, bool use_io_uring = false);
       ~AsyncFileIOContext(void);
 
+      // memory ranges that are already pinned (e.g. registered memory) can
+      //  be registered with the io_uring as fixed buffers - must be called
+      //  before any I/O is enqueued
+      void register_buffer(void *base, size_t bytes);
+
       void enqueue_write(int fd, size_t offset, size_t bytes, const void *buffer, Request* req = NULL);
       void enqueue_read(int fd, size_t offset, size_t bytes, void *buffer, Request* req = NULL);
       void enqueue_fence(DmaRequest *req);
@@ -532,6 +561,9 @@ namespace Realm {
       Mutex mutex;
 #ifdef REALM_USE_KERNEL_AIO
       aio_context_t aio_ctx;
+#endif
+#ifdef REALM_USE_IO_URING
+      IOUringEngine *uring;
 #endif
     };
 };
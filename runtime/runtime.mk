@@ -584,6 +584,17 @@ ifneq ($(findstring mpi,$(REALM_NETWORKS)),)
     USE_MPI = 1
 endif
 
+# Realm uses shared memory between processes on a node if requested
+ifneq ($(findstring shm,$(REALM_NETWORKS)),)
+    REALM_CC_FLAGS        += -DREALM_USE_SHM
+endif
+
+# more than one network - the first handles inter-node traffic and the others
+#  may take over some of the peers
+ifneq ($(word 2,$(REALM_NETWORKS)),)
+    REALM_CC_FLAGS        += -DREALM_USE_MULTIPLE_NETWORKS
+endif
+
 # Realm doesn't use HDF by default
 USE_HDF ?= 0
 HDF_LIBNAME ?= hdf5
@@ -721,6 +732,7 @@ REALM_SRC 	+= $(LG_RT_DIR)/realm/runtime_impl.cc \
 		   $(LG_RT_DIR)/realm/event_impl.cc \
 		   $(LG_RT_DIR)/realm/rsrv_impl.cc \
 		   $(LG_RT_DIR)/realm/proc_impl.cc \
+		   $(LG_RT_DIR)/realm/redop.cc \
 		   $(LG_RT_DIR)/realm/mem_impl.cc \
 		   $(LG_RT_DIR)/realm/idx_impl.cc \
 		   $(LG_RT_DIR)/realm/inst_impl.cc \
@@ -743,6 +755,9 @@ ifneq ($(findstring mpi,$(REALM_NETWORKS)),)
 REALM_SRC 	+= $(LG_RT_DIR)/realm/mpi/mpi_module.cc \
                    $(LG_RT_DIR)/realm/mpi/am_mpi.cc
 endif
+ifneq ($(findstring shm,$(REALM_NETWORKS)),)
+REALM_SRC 	+= $(LG_RT_DIR)/realm/shm/shm_module.cc
+endif
 ifeq ($(strip $(USE_OPENMP)),1)
 REALM_SRC 	+= $(LG_RT_DIR)/realm/openmp/openmp_module.cc \
 		   $(LG_RT_DIR)/realm/openmp/openmp_threadpool.cc \
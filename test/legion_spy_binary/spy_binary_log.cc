@@ -0,0 +1,161 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Round trip test for binary Legion Spy logs: records are written with
+// the runtime's binary writer and read back as text with
+// tools/legion_spy_loader, which must reproduce exactly what the text
+// logger would have printed for them.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "legion.h"
+#include "legion/legion_spy.h"
+
+using namespace Legion;
+namespace LegionSpy = Legion::Internal::LegionSpy;
+
+enum TaskIDs {
+  TOP_LEVEL_TASK_ID,
+};
+
+static std::vector<std::string> expected;
+
+// logs a record and remembers the line the loader should print for it
+#define LOG_RECORD(fmt, ...)                                         \
+  do {                                                               \
+    LegionSpy::log_spy.print(fmt, __VA_ARGS__);                      \
+    int len = snprintf(NULL, 0, fmt, __VA_ARGS__);                   \
+    std::string line(len, ' ');                                      \
+    snprintf(&line[0], len + 1, fmt, __VA_ARGS__);                   \
+    expected.push_back("[0 - 0] {3}{legion_spy}: " + line);           \
+  } while(0)
+
+static void write_log(const char *filename)
+{
+  LegionSpy::open_binary_log(filename, 0);
+
+  // every kind of conversion, including extreme values
+  LOG_RECORD("Spy Test Ints %d %d %u %ld %lu %lld %llu", 
+             -1, 2147483647, 4294967295U, -1234567890123L, 42UL,
+             (-9223372036854775807LL - 1), 18446744073709551615ULL);
+  LOG_RECORD("Spy Test Hex %x %lx %llx %zd %zd",
+             0xdeadbeefU, 0UL, 0x1234567890abcdefULL, 
+             (ssize_t)-7, (ssize_t)7);
+  LOG_RECORD("Spy Test Empty String %s %u", "", 1U);
+
+  // enough small records to wrap the writer's buffer several times
+  for (unsigned i = 0; i < 200000; i++)
+    LOG_RECORD("Spy Test Small %u %d %llx", i, -(int)i, 
+               (unsigned long long)i << 40);
+
+  // strings around the writer's 1MB flush threshold, each followed by
+  // the largest varints there are, to catch records that run past the
+  // end of the buffer
+  const size_t threshold = 1 << 20;
+  for (size_t size = threshold - 16; size <= threshold + 1040; size += 7)
+  {
+    std::string str(size, 'a' + (size % 26));
+    LOG_RECORD("Spy Test String %s %llu %lld", str.c_str(),
+               18446744073709551615ULL, (-9223372036854775807LL - 1));
+    LOG_RECORD("Spy Test After String %u", (unsigned)size);
+  }
+
+  LegionSpy::close_binary_log();
+  // records after the log is closed go to the text logger instead
+  LegionSpy::log_spy.print("Spy Test After Close %d", 1);
+}
+
+static bool check_log(const char *loader, const char *filename)
+{
+  std::string command = std::string(loader) + " -t " + filename;
+  FILE *text = popen(command.c_str(), "r");
+  if (text == NULL)
+  {
+    printf("FAIL: unable to run %s\n", command.c_str());
+    return false;
+  }
+  bool success = true;
+  size_t index = 0;
+  char *line = NULL;
+  size_t capacity = 0;
+  ssize_t length;
+  while ((length = getline(&line, &capacity, text)) >= 0)
+  {
+    if ((length > 0) && (line[length-1] == '\n'))
+      line[--length] = '\0';
+    if (index >= expected.size())
+    {
+      printf("FAIL: unexpected extra record at %zd\n", index);
+      success = false;
+      break;
+    }
+    if (expected[index] != line)
+    {
+      printf("FAIL: record %zd does not match (%zd bytes read, %zd "
+             "expected)\n", index, (size_t)length, expected[index].size());
+      success = false;
+      break;
+    }
+    index++;
+  }
+  free(line);
+  if (pclose(text) != 0)
+  {
+    printf("FAIL: %s reported an error\n", command.c_str());
+    success = false;
+  }
+  if (success && (index != expected.size()))
+  {
+    printf("FAIL: read %zd of %zd records\n", index, expected.size());
+    success = false;
+  }
+  return success;
+}
+
+void top_level_task(const Task *task,
+                    const std::vector<PhysicalRegion> &regions,
+                    Context ctx, Runtime *runtime)
+{
+  const char *loader = "./legion_spy_loader";
+  const InputArgs &command_args = Runtime::get_input_args();
+  for (int i = 1; i < command_args.argc; i++)
+    if (!strcmp(command_args.argv[i], "-loader") && 
+        ((i + 1) < command_args.argc))
+      loader = command_args.argv[++i];
+
+  const char *filename = "spy_binary_log_0.log";
+  write_log(filename);
+  if (!check_log(loader, filename))
+    abort();
+  remove(filename);
+  printf("SUCCESS: %zd records round tripped\n", expected.size());
+}
+
+int main(int argc, char **argv)
+{
+  Runtime::set_top_level_task_id(TOP_LEVEL_TASK_ID);
+
+  {
+    TaskVariantRegistrar registrar(TOP_LEVEL_TASK_ID, "top_level");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    Runtime::preregister_task_variant<top_level_task>(registrar, "top_level");
+  }
+
+  return Runtime::start(argc, argv);
+}
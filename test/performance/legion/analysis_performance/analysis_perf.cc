@@ -91,7 +91,7 @@ static void parse_arguments(char** argv, int argc, unsigned &num_tasks,
                             bool &alternate, bool &alternate_loop,
                             bool &single_launch, bool &block,
                             bool &cache_mapping, bool &tracing,
-                            vector<int> &pattern)
+                            bool &shared_instance, vector<int> &pattern)
 {
   int i = 1;
   while (i < argc)
@@ -112,6 +112,7 @@ static void parse_arguments(char** argv, int argc, unsigned &num_tasks,
     else if (strcmp(argv[i], "-b") == 0) block = true;
     else if (strcmp(argv[i], "-F") == 0) cache_mapping = false;
     else if (strcmp(argv[i], "-T") == 0) tracing = true;
+    else if (strcmp(argv[i], "-I") == 0) shared_instance = true;
     else if (strcmp(argv[i], "-P") == 0) parse_pattern(argv[++i], pattern);
     ++i;
   }
@@ -206,6 +207,7 @@ class PerfMapper : public DefaultMapper
     unsigned num_slices;
     bool cache_mapping;
     bool tracing;
+    bool shared_instance;
     unsigned skip_count;
     vector<Processor>& procs_list;
     //vector<Memory>& sysmems_list;
@@ -216,6 +218,9 @@ class PerfMapper : public DefaultMapper
     vector<vector<CachedConstraints> > constraint_cache;
     vector<VariantID> variant_id;
     vector<TaskSlice> slice_cache;
+    // [root region, fields] --> instance shared by all subregion users
+    map<pair<LogicalRegion, vector<FieldID> >, PhysicalInstance>
+      shared_instances;
 };
 
 PerfMapper::PerfMapper(MapperRuntime *rt, Machine machine, Processor local,
@@ -228,6 +233,7 @@ PerfMapper::PerfMapper(MapperRuntime *rt, Machine machine, Processor local,
     num_slices(1),
     cache_mapping(true),
     tracing(false),
+    shared_instance(false),
     skip_count(1),
     procs_list(*_procs_list),
     //sysmems_list(*_sysmems_list),
@@ -257,7 +263,7 @@ PerfMapper::PerfMapper(MapperRuntime *rt, Machine machine, Processor local,
   parse_arguments(argv, argc, num_tasks, num_loops, num_regions,
       num_partitions, num_slices, tree_depth, num_fields, dims, blast, slide,
       alternate, alternate_loop, single_launch, block, cache_mapping,
-      tracing, pattern);
+      tracing, shared_instance, pattern);
 
   if (tracing && !cache_mapping)
   {
@@ -421,6 +427,35 @@ void PerfMapper::map_task(const MapperContext  ctx,
           PhysicalInstance inst;
           vector<LogicalRegion> target_region;
           target_region.push_back(task.regions[idx].region);
+          // In the shared instance mode every subregion is mapped to
+          // one instance of the root region, so the runtime has to track
+          // all the (possibly aliased) subregion users on that instance
+          pair<LogicalRegion, vector<FieldID> > shared_key;
+          if (shared_instance)
+          {
+            LogicalRegion root = task.regions[idx].region;
+            while (runtime->has_parent_logical_partition(ctx, root))
+              root = runtime->get_parent_logical_region(ctx,
+                  runtime->get_parent_logical_partition(ctx, root));
+            shared_key.first = root;
+            shared_key.second = task.regions[idx].instance_fields;
+            map<pair<LogicalRegion, vector<FieldID> >,
+                PhysicalInstance>::const_iterator finder =
+              shared_instances.find(shared_key);
+            if (finder != shared_instances.end())
+            {
+#ifdef DEBUG_LEGION
+              bool ok =
+#endif
+                runtime->acquire_instance(ctx, finder->second);
+#ifdef DEBUG_LEGION
+              assert(ok);
+#endif
+              cached_mapping[idx].push_back(finder->second);
+              continue;
+            }
+            target_region[0] = root;
+          }
           LayoutConstraintSet constraints;
           std::vector<DimensionKind> dimension_ordering(4);
           dimension_ordering[0] = DIM_X;
@@ -434,7 +469,9 @@ void PerfMapper::map_task(const MapperContext  ctx,
           runtime->create_physical_instance(ctx, target_memory,
                 constraints, target_region, inst);
           runtime->set_garbage_collection_priority(ctx, inst,
-              cache_mapping ? GC_NEVER_PRIORITY : GC_FIRST_PRIORITY);
+              (cache_mapping || shared_instance) ?
+                GC_NEVER_PRIORITY : GC_FIRST_PRIORITY);
+          if (shared_instance) shared_instances[shared_key] = inst;
           cached_mapping[idx].push_back(inst);
         }
         if (cache_mapping) mapping_cache[part_id][point] = cached_mapping;
@@ -698,6 +735,7 @@ void top_level_task(const Task *task,
   bool block = false;
   bool cache_mapping = true;
   bool tracing = false;
+  bool shared_instance = false;
   vector<int> pattern;
 
   {
@@ -707,7 +745,7 @@ void top_level_task(const Task *task,
     parse_arguments(argv, argc, num_tasks, num_loops, num_regions,
         num_partitions, num_slices, tree_depth, num_fields, dims, blast, slide,
         alternate, alternate_loop, single_launch, block, cache_mapping,
-        tracing, pattern);
+        tracing, shared_instance, pattern);
     if (num_regions == 0) num_partitions = 1;
     if (num_regions > 0 && num_partitions > 0 && tree_depth == 0)
     {
@@ -785,6 +823,8 @@ void top_level_task(const Task *task,
       cache_mapping ? "yes" : " no");
   printf("* Block until Analyze   :         %s *\n", block ? "yes" : " no");
   printf("* Tracing               :         %s *\n", tracing ? "yes" : " no");
+  printf("* Shared Instance       :         %s *\n",
+      shared_instance ? "yes" : " no");
   printf("* Number of Slices      :       %5u *\n", num_slices);
   printf("* Dimensionality        :       %5u *\n", dims);
   printf("* Blast Factor          :       %5u *\n", blast);
@@ -0,0 +1,201 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Micro-benchmark comparing the ExpressionTrieTable used for the
+// children of an ExpressionTrieNode against the lookup it replaced: a
+// std::map read while holding the node's trie_lock in shared mode.
+// Each lookup task performs the lookups of an existing expression
+// (always hits) on tables shared by all the tasks; the tasks are index
+// launched so that several processors (-ll:cpu) look up concurrently
+// the way the analysis of independent operations does. Use -t to set
+// the largest number of concurrent lookup tasks and give it at least
+// as many processors beyond the one running the top-level task.
+
+#include "legion.h"
+#include "legion/region_tree.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+
+using namespace Legion;
+using Legion::Internal::AutoLock;
+using Legion::Internal::ExpressionTrieTable;
+using Legion::Internal::IndexSpaceExprID;
+using Legion::Internal::LocalLock;
+
+enum
+{
+  TOP_LEVEL_TASK_ID,
+  LOOKUP_TASK_ID,
+};
+
+enum LookupKind
+{
+  LOOKUP_TABLE,
+  LOOKUP_MAP,
+};
+
+struct Element {
+  unsigned long long value;
+};
+
+// Shared by all the lookup tasks in this process
+static ExpressionTrieTable<Element> table;
+static std::map<IndexSpaceExprID,Element*> map;
+static LocalLock *map_lock;
+static std::vector<IndexSpaceExprID> keys;
+
+struct LookupArgs {
+  LookupKind kind;
+  unsigned lookups;
+};
+
+unsigned long long lookup_task(const Task *task,
+                               const std::vector<PhysicalRegion> &regions,
+                               Context ctx, Runtime *runtime)
+{
+  const LookupArgs &args = *(const LookupArgs*)task->args;
+  // Start each point at a different key so they don't walk in lock step
+  size_t index = (task->index_point[0] * 7919) % keys.size();
+  unsigned long long checksum = 0;
+  if (args.kind == LOOKUP_TABLE)
+  {
+    for (unsigned idx = 0; idx < args.lookups; idx++)
+    {
+      Element *element = table.find(keys[index]);
+      if (element != NULL)
+        checksum += element->value;
+      if (++index == keys.size())
+        index = 0;
+    }
+  }
+  else
+  {
+    for (unsigned idx = 0; idx < args.lookups; idx++)
+    {
+      AutoLock m_lock(*map_lock,1,false/*exclusive*/);
+      std::map<IndexSpaceExprID,Element*>::const_iterator finder =
+        map.find(keys[index]);
+      if (finder != map.end())
+        checksum += finder->second->value;
+      if (++index == keys.size())
+        index = 0;
+    }
+  }
+  return checksum;
+}
+
+static double run_lookups(Context ctx, Runtime *runtime, LookupKind kind,
+                          unsigned threads, unsigned lookups,
+                          unsigned long long &checksum)
+{
+  LookupArgs args;
+  args.kind = kind;
+  args.lookups = lookups;
+  const Rect<1> launch_bounds(0, threads - 1);
+  IndexTaskLauncher launcher(LOOKUP_TASK_ID, launch_bounds,
+                             TaskArgument(&args, sizeof(args)), ArgumentMap());
+  // Make sure everything from the last run is done before timing
+  runtime->issue_execution_fence(ctx).get_void_result();
+  const unsigned long long start = Realm::Clock::current_time_in_nanoseconds();
+  FutureMap fm = runtime->execute_index_space(ctx, launcher);
+  fm.wait_all_results();
+  const unsigned long long stop = Realm::Clock::current_time_in_nanoseconds();
+  checksum = 0;
+  for (unsigned point = 0; point < threads; point++)
+    checksum += fm.get_result<unsigned long long>(point);
+  const double ops = double(threads) * lookups;
+  return ops / (1e-3 * (stop - start));
+}
+
+void top_level_task(const Task *task,
+                    const std::vector<PhysicalRegion> &regions,
+                    Context ctx, Runtime *runtime)
+{
+  unsigned max_size = 256;
+  unsigned lookups = 1 << 22;
+  unsigned max_threads = 1;
+  const InputArgs &command_args = Runtime::get_input_args();
+  for (int i = 1; i < command_args.argc; i++)
+  {
+    if (strcmp(command_args.argv[i], "-s") == 0)
+      max_size = atoi(command_args.argv[++i]);
+    else if (strcmp(command_args.argv[i], "-n") == 0)
+      lookups = atoi(command_args.argv[++i]);
+    else if (strcmp(command_args.argv[i], "-t") == 0)
+      max_threads = atoi(command_args.argv[++i]);
+  }
+  printf("%8s %8s %18s %16s %10s\n", "entries", "threads", "table (Mops/s)",
+         "map (Mops/s)", "speedup");
+  // Not made until Realm is running
+  map_lock = new LocalLock();
+  std::vector<Element> storage(max_size);
+  for (unsigned idx = 0; idx < max_size; idx++)
+    storage[idx].value = idx + 1;
+  for (unsigned size = 1; size <= max_size; size *= 2)
+  {
+    // Expression IDs are strided by the number of nodes, so mimic a
+    // run on four nodes, and look them up in a shuffled order
+    for (unsigned idx = keys.size(); idx < size; idx++)
+    {
+      const IndexSpaceExprID key = 4 * idx + 1;
+      keys.push_back(key);
+      table.insert(key, &storage[idx]);
+      map[key] = &storage[idx];
+    }
+    std::vector<IndexSpaceExprID> order(keys);
+    for (unsigned idx = order.size(); idx > 1; idx--)
+      std::swap(order[idx-1], order[lrand48() % idx]);
+    keys.swap(order);
+    for (unsigned threads = 1; threads <= max_threads; threads *= 2)
+    {
+      unsigned long long table_checksum, map_checksum;
+      const double table_rate = run_lookups(ctx, runtime, LOOKUP_TABLE,
+                                            threads, lookups, table_checksum);
+      const double map_rate = run_lookups(ctx, runtime, LOOKUP_MAP,
+                                          threads, lookups, map_checksum);
+      if (table_checksum != map_checksum)
+      {
+        fprintf(stderr, "Checksum mismatch for %u entries: %llu != %llu\n",
+                size, table_checksum, map_checksum);
+        exit(1);
+      }
+      printf("%8u %8u %18.2f %16.2f %9.2fx\n", size, threads, table_rate,
+             map_rate, table_rate / map_rate);
+    }
+  }
+  delete map_lock;
+}
+
+int main(int argc, char **argv)
+{
+  Runtime::set_top_level_task_id(TOP_LEVEL_TASK_ID);
+  {
+    TaskVariantRegistrar registrar(TOP_LEVEL_TASK_ID, "top_level");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    Runtime::preregister_task_variant<top_level_task>(registrar, "top_level");
+  }
+  {
+    TaskVariantRegistrar registrar(LOOKUP_TASK_ID, "lookup");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    Runtime::preregister_task_variant<unsigned long long, lookup_task>(
+        registrar, "lookup");
+  }
+  return Runtime::start(argc, argv);
+}
@@ -0,0 +1,205 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Micro-benchmark comparing FieldMaskSet against the plain map that it
+// used to be built on. Each round performs the operations that the
+// physical analysis does most often on sets of a given size: insert
+// the entries, look each of them up, iterate to compute the union of
+// their masks, filter some fields, and erase the entries again.
+// Compare the results against a build with
+// -DLEGION_FIELD_MASK_SET_FLAT_ENTRIES=0 to see the effect of the
+// flat representation on its own, and run analysis_perf with both
+// builds to see the effect on analysis throughput.
+
+#include "legion.h"
+#include "legion/legion_utilities.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace Legion;
+using Legion::Internal::FieldMask;
+using Legion::Internal::FieldMaskSet;
+using Legion::Internal::LegionMap;
+
+enum
+{
+  TOP_LEVEL_TASK_ID,
+};
+
+struct Element {
+  unsigned long long value;
+};
+
+typedef LegionMap<Element*,FieldMask>::aligned ElementMap;
+
+static void make_masks(unsigned size, std::vector<FieldMask> &masks)
+{
+  masks.resize(size);
+  for (unsigned idx = 0; idx < size; idx++)
+  {
+    // Give each entry a few fields that overlap with its neighbours
+    masks[idx].clear();
+    for (unsigned fid = 0; fid < 4; fid++)
+      masks[idx].set_bit((idx * 3 + fid) % LEGION_MAX_FIELDS);
+  }
+}
+
+static unsigned long long run_field_mask_set(
+                          const std::vector<Element*> &elements,
+                          const std::vector<FieldMask> &masks,
+                          const FieldMask &filter, unsigned rounds)
+{
+  unsigned long long checksum = 0;
+  for (unsigned r = 0; r < rounds; r++)
+  {
+    FieldMaskSet<Element> set;
+    for (unsigned idx = 0; idx < elements.size(); idx++)
+      set.insert(elements[idx], masks[idx]);
+    for (unsigned idx = 0; idx < elements.size(); idx++)
+    {
+      FieldMaskSet<Element>::const_iterator finder = set.find(elements[idx]);
+      if ((finder != set.end()) && !!finder->second)
+        checksum++;
+    }
+    FieldMask summary;
+    for (FieldMaskSet<Element>::const_iterator it =
+          set.begin(); it != set.end(); it++)
+      summary |= it->second;
+    checksum += summary.pop_count();
+    set.filter(filter);
+    checksum += set.size();
+    for (unsigned idx = 0; idx < elements.size(); idx++)
+      if (set.find(elements[idx]) != set.end())
+        set.erase(elements[idx]);
+  }
+  return checksum;
+}
+
+static unsigned long long run_map(const std::vector<Element*> &elements,
+                                  const std::vector<FieldMask> &masks,
+                                  const FieldMask &filter, unsigned rounds)
+{
+  unsigned long long checksum = 0;
+  for (unsigned r = 0; r < rounds; r++)
+  {
+    ElementMap map;
+    for (unsigned idx = 0; idx < elements.size(); idx++)
+    {
+      ElementMap::iterator finder = map.find(elements[idx]);
+      if (finder == map.end())
+        map[elements[idx]] = masks[idx];
+      else
+        finder->second |= masks[idx];
+    }
+    for (unsigned idx = 0; idx < elements.size(); idx++)
+    {
+      ElementMap::const_iterator finder = map.find(elements[idx]);
+      if ((finder != map.end()) && !!finder->second)
+        checksum++;
+    }
+    FieldMask summary;
+    for (ElementMap::const_iterator it = map.begin(); it != map.end(); it++)
+      summary |= it->second;
+    checksum += summary.pop_count();
+    std::vector<Element*> to_delete;
+    for (ElementMap::iterator it = map.begin(); it != map.end(); it++)
+    {
+      it->second -= filter;
+      if (!it->second)
+        to_delete.push_back(it->first);
+    }
+    for (unsigned idx = 0; idx < to_delete.size(); idx++)
+      map.erase(to_delete[idx]);
+    checksum += map.size();
+    for (unsigned idx = 0; idx < elements.size(); idx++)
+    {
+      ElementMap::iterator finder = map.find(elements[idx]);
+      if (finder != map.end())
+        map.erase(finder);
+    }
+  }
+  return checksum;
+}
+
+void top_level_task(const Task *task,
+                    const std::vector<PhysicalRegion> &regions,
+                    Context ctx, Runtime *runtime)
+{
+  unsigned max_size = 64;
+  unsigned total_inserts = 1 << 22;
+  const InputArgs &command_args = Runtime::get_input_args();
+  for (int i = 1; i < command_args.argc; i++)
+  {
+    if (strcmp(command_args.argv[i], "-s") == 0)
+      max_size = atoi(command_args.argv[++i]);
+    else if (strcmp(command_args.argv[i], "-n") == 0)
+      total_inserts = atoi(command_args.argv[++i]);
+  }
+  printf("FieldMaskSet flat entries: %d\n", LEGION_FIELD_MASK_SET_FLAT_ENTRIES);
+  printf("%8s %16s %16s %10s\n", "entries", "set (Mops/s)", "map (Mops/s)",
+         "speedup");
+  std::vector<Element> storage(max_size);
+  for (unsigned size = 1; size <= max_size; size *= 2)
+  {
+    // Shuffle the entries so they are not inserted in sorted order
+    std::vector<Element*> elements(size);
+    for (unsigned idx = 0; idx < size; idx++)
+      elements[idx] = &storage[(idx * 7) % max_size];
+    for (unsigned idx = size; idx > 1; idx--)
+      std::swap(elements[idx-1], elements[lrand48() % idx]);
+    std::vector<FieldMask> masks;
+    make_masks(size, masks);
+    FieldMask filter;
+    filter.set_bit(0);
+    filter.set_bit(1);
+    const unsigned rounds = (total_inserts / size) > 0 ?
+                            (total_inserts / size) : 1;
+    const double ops = double(rounds) * size;
+
+    unsigned long long start = Realm::Clock::current_time_in_nanoseconds();
+    unsigned long long set_checksum =
+      run_field_mask_set(elements, masks, filter, rounds);
+    unsigned long long stop = Realm::Clock::current_time_in_nanoseconds();
+    const double set_rate = ops / (1e-3 * (stop - start));
+
+    start = Realm::Clock::current_time_in_nanoseconds();
+    unsigned long long map_checksum = run_map(elements, masks, filter, rounds);
+    stop = Realm::Clock::current_time_in_nanoseconds();
+    const double map_rate = ops / (1e-3 * (stop - start));
+
+    if (set_checksum != map_checksum)
+    {
+      fprintf(stderr, "Checksum mismatch for %u entries: %llu != %llu\n",
+              size, set_checksum, map_checksum);
+      exit(1);
+    }
+    printf("%8u %16.2f %16.2f %9.2fx\n", size, set_rate, map_rate,
+           set_rate / map_rate);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  Runtime::set_top_level_task_id(TOP_LEVEL_TASK_ID);
+  {
+    TaskVariantRegistrar registrar(TOP_LEVEL_TASK_ID, "top_level");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    Runtime::preregister_task_variant<top_level_task>(registrar, "top_level");
+  }
+  return Runtime::start(argc, argv);
+}
@@ -0,0 +1,129 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the rate at which the runtime can map and launch the point
+// tasks of index space launches. Each launch has one point for every
+// subregion of a disjoint partition and each point task does nothing
+// but has a read-write requirement on its subregion, so the run time
+// is dominated by the mapping pipeline. Run once with the default
+// options and once with -dm:batch_map to compare calling map_task for
+// every point with mapping all the points of a slice in one
+// map_task_batch call.
+
+#include "legion.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace Legion;
+
+enum
+{
+  TOP_LEVEL_TASK_ID,
+  POINT_TASK_ID,
+};
+
+enum
+{
+  FID_VALUE,
+};
+
+void point_task(const Task *task,
+                const std::vector<PhysicalRegion> &regions,
+                Context ctx, Runtime *runtime)
+{
+}
+
+void top_level_task(const Task *task,
+                    const std::vector<PhysicalRegion> &regions,
+                    Context ctx, Runtime *runtime)
+{
+  int num_points = 4096;
+  int num_launches = 16;
+  int num_warmup = 2;
+  const InputArgs &command_args = Runtime::get_input_args();
+  for (int i = 1; i < command_args.argc; i++)
+  {
+    if (strcmp(command_args.argv[i], "-p") == 0)
+      num_points = atoi(command_args.argv[++i]);
+    else if (strcmp(command_args.argv[i], "-l") == 0)
+      num_launches = atoi(command_args.argv[++i]);
+    else if (strcmp(command_args.argv[i], "-w") == 0)
+      num_warmup = atoi(command_args.argv[++i]);
+  }
+
+  const Rect<1> elements(0, num_points - 1);
+  IndexSpace is = runtime->create_index_space(ctx, elements);
+  FieldSpace fs = runtime->create_field_space(ctx);
+  {
+    FieldAllocator allocator = runtime->create_field_allocator(ctx, fs);
+    allocator.allocate_field(sizeof(long long), FID_VALUE);
+  }
+  LogicalRegion lr = runtime->create_logical_region(ctx, is, fs);
+  const Rect<1> launch_bounds(0, num_points - 1);
+  IndexSpace launch_space = runtime->create_index_space(ctx, launch_bounds);
+  IndexPartition ip = runtime->create_equal_partition(ctx, is, launch_space);
+  LogicalPartition lp = runtime->get_logical_partition(ctx, lr, ip);
+  const long long zero = 0;
+  runtime->fill_field(ctx, lr, lr, FID_VALUE, &zero, sizeof(zero));
+
+  IndexTaskLauncher launcher(POINT_TASK_ID, launch_space,
+                             TaskArgument(NULL, 0), ArgumentMap());
+  launcher.add_region_requirement(
+      RegionRequirement(lp, 0/*projection ID*/,
+                        LEGION_READ_WRITE, LEGION_EXCLUSIVE, lr));
+  launcher.add_field(0/*index*/, FID_VALUE);
+
+  // Warm up to create the instances and fill the mapper caches
+  for (int i = 0; i < num_warmup; i++)
+    runtime->execute_index_space(ctx, launcher);
+  Future warm = runtime->issue_execution_fence(ctx);
+
+  Future start = runtime->get_current_time_in_nanoseconds(ctx, warm);
+  for (int i = 0; i < num_launches; i++)
+    runtime->execute_index_space(ctx, launcher);
+  Future done = runtime->issue_execution_fence(ctx);
+  Future stop = runtime->get_current_time_in_nanoseconds(ctx, done);
+
+  const double elapsed = 1e-9 *
+    (stop.get_result<long long>() - start.get_result<long long>());
+  const double total_points = double(num_points) * num_launches;
+  printf("Launched %d index tasks of %d points in %.3f s: "
+         "%.2f points/s, %.2f launches/s\n", num_launches, num_points,
+         elapsed, total_points / elapsed, num_launches / elapsed);
+
+  runtime->destroy_logical_region(ctx, lr);
+  runtime->destroy_field_space(ctx, fs);
+  runtime->destroy_index_space(ctx, launch_space);
+  runtime->destroy_index_space(ctx, is);
+}
+
+int main(int argc, char **argv)
+{
+  Runtime::set_top_level_task_id(TOP_LEVEL_TASK_ID);
+  {
+    TaskVariantRegistrar registrar(TOP_LEVEL_TASK_ID, "top_level");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    Runtime::preregister_task_variant<top_level_task>(registrar, "top_level");
+  }
+  {
+    TaskVariantRegistrar registrar(POINT_TASK_ID, "point_task");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    Runtime::preregister_task_variant<point_task>(registrar, "point_task");
+  }
+  return Runtime::start(argc, argv);
+}
@@ -129,6 +129,7 @@ void top_level_task(const void *args, size_t arglen,
   int levels = DEFAULT_LEVELS;
   int tracks = DEFAULT_TRACKS;
   int fanout = DEFAULT_FANOUT;
+  bool remote_only = false;
   // Parse the input arguments
 #define INT_ARG(argname, varname) do { \
         if(!strcmp((argv)[i], argname)) {		\
@@ -149,6 +150,7 @@ void top_level_task(const void *args, size_t arglen,
       INT_ARG("-l", levels);
       INT_ARG("-t", tracks);
       INT_ARG("-f", fanout);
+      BOOL_ARG("-remote", remote_only);
     }
     assert(levels > 0);
     assert(tracks > 0);
@@ -170,6 +172,28 @@ void top_level_task(const void *args, size_t arglen,
     Realm::Machine machine = Realm::Machine::get_machine();
     std::set<Processor> all_procs;
     machine.get_all_processors(all_procs);
+    // count the address spaces involved - with more than one, every level
+    //  of a track exchanges triggers and subscriptions between processes
+    std::set<AddressSpace> spaces;
+    for (std::set<Processor>::const_iterator it = all_procs.begin();
+          it != all_procs.end(); it++)
+      spaces.insert(it->address_space());
+    if (remote_only)
+    {
+      // build tracks only out of processors in other processes so that
+      //  every event hop crosses the network
+      std::set<Processor> remote_procs;
+      for (std::set<Processor>::const_iterator it = all_procs.begin();
+            it != all_procs.end(); it++)
+        if (it->address_space() != p.address_space())
+          remote_procs.insert(*it);
+      if (remote_procs.empty())
+        fprintf(stdout,"WARNING: no remote processors - using all processors\n");
+      else
+        all_procs.swap(remote_procs);
+    }
+    fprintf(stdout,"Using %zd processors in %zd address spaces\n",
+            all_procs.size(), spaces.size());
     for (int t = 0; t < tracks; t++)
     {
       construct_track(levels, fanout, p, start_event, wait_for_finish, all_procs);
@@ -19,6 +19,7 @@
 #include <cassert>
 #include <cstring>
 #include <set>
+#include <vector>
 #include <time.h>
 
 #include <realm.h>
@@ -95,6 +96,43 @@ static void ReductionAdd::apply<false>(LTYPE& lhs, RTYPE rhs)
   lhs += rhs;
 }
 */
+// element-wise reductions for comparing the generic ReductionOp loops with
+//  the vectorized kernels - VecReduction only differs in the specialization
+//  of ReductionKernels below
+template <class T, SIMDReductions::Operator OP>
+struct ScalarReduction {
+  typedef T LHS;
+  typedef T RHS;
+  template <bool EXCL>
+  static void apply(LHS& lhs, RHS rhs)
+  {
+    switch(OP) {
+    case SIMDReductions::SUM: lhs += rhs; break;
+    case SIMDReductions::PROD: lhs *= rhs; break;
+    case SIMDReductions::MIN: if(rhs < lhs) lhs = rhs; break;
+    case SIMDReductions::MAX: if(rhs > lhs) lhs = rhs; break;
+    }
+  }
+  static const RHS identity;
+  template <bool EXCL>
+  static void fold(RHS& rhs1, RHS rhs2)
+  {
+    apply<EXCL>(rhs1, rhs2);
+  }
+};
+
+template <class T, SIMDReductions::Operator OP>
+/*static*/ const T ScalarReduction<T,OP>::identity = 0;
+
+template <class T, SIMDReductions::Operator OP>
+struct VecReduction : public ScalarReduction<T,OP> {};
+
+namespace Realm {
+  template <class T, SIMDReductions::Operator OP>
+  struct ReductionKernels<VecReduction<T,OP> >
+    : public SIMDReductionKernels<T,OP> {};
+};
+
 struct InputArgs {
   int argc;
   char **argv;
@@ -217,6 +255,55 @@ static void run_case(const char *name, int task_id,
   printf("ELAPSED(%s) = %f\n", name, (end_time - start_time)*1e-6);
 }		     
 
+// times exclusive applies of one array into another through the generic
+//  loop and the vectorized kernels, and checks they agree
+template <class T, SIMDReductions::Operator OP>
+static void run_kernel_case(const char *name, size_t elements, int reps)
+{
+  ReductionOpUntyped *scalar_op =
+    ReductionOpUntyped::create_reduction_op<ScalarReduction<T,OP> >();
+  ReductionOpUntyped *vec_op =
+    ReductionOpUntyped::create_reduction_op<VecReduction<T,OP> >();
+
+  std::vector<T> rhs(elements), lhs_scalar(elements), lhs_vec(elements);
+  for(size_t i = 0; i < elements; i++) {
+    // small values keep products from overflowing (for floats, these all
+    //  stay exact, so the results must match bit for bit)
+    rhs[i] = (T)((i * 7) % 3) + (T)1;
+    lhs_scalar[i] = lhs_vec[i] = (T)((i * 13) % 5) - (T)2;
+  }
+
+  double t_scalar = 0, t_vec = 0;
+  for(int r = 0; r < reps; r++) {
+    double t1 = Clock::current_time();
+    scalar_op->apply(&lhs_scalar[0], &rhs[0], elements, true /*exclusive*/);
+    double t2 = Clock::current_time();
+    vec_op->apply(&lhs_vec[0], &rhs[0], elements, true /*exclusive*/);
+    double t3 = Clock::current_time();
+    t_scalar += t2 - t1;
+    t_vec += t3 - t2;
+  }
+
+  size_t errors = 0;
+  for(size_t i = 0; i < elements; i++)
+    if(memcmp(&lhs_scalar[i], &lhs_vec[i], sizeof(T)))
+      errors++;
+
+  // two reads and a write per element
+  double bytes = 3.0 * sizeof(T) * elements * reps;
+  printf("%-12s: scalar = %6.2f GB/s, vector = %6.2f GB/s (%s)%s\n",
+	 name, bytes / t_scalar * 1e-9, bytes / t_vec * 1e-9,
+	 SIMDReductions::instruction_set(),
+	 (errors ? " MISMATCH" : ""));
+  if(errors) {
+    log_app.fatal() << name << ": " << errors << " mismatched elements";
+    exit(1);
+  }
+
+  delete scalar_op;
+  delete vec_op;
+}
+
 void top_level_task(const void *args, size_t arglen, 
                     const void *userdata, size_t userlen, Processor p)
 {
@@ -226,6 +313,8 @@ void top_level_task(const void *args, size_t arglen,
   int seed1 = 12345;
   int seed2 = 54321;
   int do_slow = 0;
+  int kernel_size = 1 << 20;
+  int kernel_reps = 10;
 
   // Parse the input arguments
 #define INT_ARG(argname, varname) do { \
@@ -248,11 +337,28 @@ void top_level_task(const void *args, size_t arglen,
       INT_ARG("-buckets", buckets);
       INT_ARG("-batches", num_batches);
       INT_ARG("-bsize", batch_size);
+      INT_ARG("-ksize", kernel_size);
+      INT_ARG("-kreps", kernel_reps);
     }
   }
 #undef INT_ARG
 #undef BOOL_ARG
 
+  if(kernel_size > 0) {
+    run_kernel_case<float, SIMDReductions::SUM>("sum float", kernel_size, kernel_reps);
+    run_kernel_case<double, SIMDReductions::SUM>("sum double", kernel_size, kernel_reps);
+    run_kernel_case<int32_t, SIMDReductions::SUM>("sum int32", kernel_size, kernel_reps);
+    run_kernel_case<int64_t, SIMDReductions::SUM>("sum int64", kernel_size, kernel_reps);
+    run_kernel_case<float, SIMDReductions::PROD>("prod float", kernel_size, kernel_reps);
+    run_kernel_case<int32_t, SIMDReductions::PROD>("prod int32", kernel_size, kernel_reps);
+    run_kernel_case<int64_t, SIMDReductions::PROD>("prod int64", kernel_size, kernel_reps);
+    run_kernel_case<double, SIMDReductions::MIN>("min double", kernel_size, kernel_reps);
+    run_kernel_case<int64_t, SIMDReductions::MIN>("min int64", kernel_size, kernel_reps);
+    run_kernel_case<float, SIMDReductions::MAX>("max float", kernel_size, kernel_reps);
+    run_kernel_case<int32_t, SIMDReductions::MAX>("max int32", kernel_size, kernel_reps);
+    run_kernel_case<int64_t, SIMDReductions::MAX>("max int64", kernel_size, kernel_reps);
+  }
+
   //UserEvent start_event = UserEvent::create_user_event();
 
   IndexSpace<1, coord_t> hist_region = Rect<1, coord_t>(0, buckets - 1);
@@ -9,6 +9,7 @@
 #include <csignal>
 #include <cmath>
 #include <climits>
+#include <algorithm>
 
 #include <time.h>
 #include <unistd.h>
@@ -2115,6 +2116,363 @@ int RandomTest<N1,T1,N2,T2,FT>::check_partitioning(void)
   return 0;
 }
 
+// partition-by-field on a large 1-D instance whose field holds runs of
+//  small integer colors - measures the throughput of the field scan (try
+//  it with different values of -dp:workers)
+class ByFieldTest : public TestInterface {
+public:
+  ByFieldTest(int argc, const char *argv[]);
+  virtual ~ByFieldTest(void);
+
+  virtual void print_info(void);
+
+  virtual Event initialize_data(const std::vector<Memory>& memories,
+				const std::vector<Processor>& procs);
+
+  virtual Event perform_partitioning(void);
+
+  virtual int perform_dynamic_checks(void);
+
+  virtual int check_partitioning(void);
+
+protected:
+  int num_elements, num_colors, avg_run_length, iterations;
+
+  IndexSpace<1> root;
+  std::vector<int> values;
+  std::vector<size_t> counts;
+  std::vector<RegionInstance> ri_data;
+  std::vector<FieldDataDescriptor<IndexSpace<1>, int> > fd_colors;
+  std::vector<IndexSpace<1> > ss_by_color;
+};
+
+ByFieldTest::ByFieldTest(int argc, const char *argv[])
+  : num_elements(1 << 20), num_colors(16), avg_run_length(8), iterations(3)
+{
+  for(int i = 1; i < argc; i++) {
+#define INT_ARG(s, v) if(!strcmp(argv[i], s)) { v = atoi(argv[++i]); continue; }
+    INT_ARG("-n", num_elements)
+    INT_ARG("-c", num_colors)
+    INT_ARG("-r", avg_run_length)
+    INT_ARG("-i", iterations)
+#undef INT_ARG
+  }
+  assert((num_elements > 0) && (num_colors > 0) && (avg_run_length > 0));
+}
+
+ByFieldTest::~ByFieldTest(void)
+{}
+
+void ByFieldTest::print_info(void)
+{
+  printf("Realm dependent partitioning test - byfield: %d elements, %d colors, run length ~%d\n",
+	 num_elements, num_colors, avg_run_length);
+}
+
+Event ByFieldTest::initialize_data(const std::vector<Memory>& memories,
+				   const std::vector<Processor>& procs)
+{
+  root = Rect<1>(0, num_elements - 1);
+
+  // runs of random colors with random lengths between 1 and 2*r-1
+  RandStream<> rs(random_seed);
+  values.resize(num_elements);
+  counts.assign(num_colors + 1, 0);
+  int pos = 0;
+  while(pos < num_elements) {
+    int color = rs.rand_int(num_colors);
+    int len = 1 + rs.rand_int(2 * avg_run_length - 1);
+    for(int i = 0; (i < len) && (pos < num_elements); i++, pos++) {
+      values[pos] = color;
+      counts[color]++;
+    }
+  }
+
+  // one instance per memory
+  size_t num_insts = memories.size();
+  std::vector<IndexSpace<1> > ss_inst;
+  root.create_equal_subspaces(num_insts, 1, ss_inst,
+			      Realm::ProfilingRequestSet()).wait();
+
+  std::vector<size_t> field_sizes(1, sizeof(int));
+
+  ri_data.resize(num_insts);
+  fd_colors.resize(num_insts);
+
+  for(size_t i = 0; i < num_insts; i++) {
+    RegionInstance ri;
+    RegionInstance::create_instance(ri,
+				    memories[i],
+				    ss_inst[i],
+				    field_sizes,
+				    0 /*SOA*/,
+				    Realm::ProfilingRequestSet()).wait();
+    ri_data[i] = ri;
+
+    fd_colors[i].index_space = ss_inst[i];
+    fd_colors[i].inst = ri;
+    fd_colors[i].field_offset = 0;
+
+    AffineAccessor<int,1> a_colors(ri, 0);
+    for(PointInRectIterator<1> pir(ss_inst[i].bounds); pir.valid; pir.step())
+      a_colors.write(pir.p, values[pir.p.x]);
+  }
+
+  return Event::NO_EVENT;
+}
+
+Event ByFieldTest::perform_partitioning(void)
+{
+  // ask for one more color than is used so that an empty subspace is
+  //  computed as well
+  std::vector<int> colors(num_colors + 1);
+  for(int i = 0; i <= num_colors; i++)
+    colors[i] = i;
+
+  for(int iter = 0; iter < iterations; iter++) {
+    for(size_t i = 0; i < ss_by_color.size(); i++)
+      ss_by_color[i].destroy();
+    ss_by_color.clear();
+
+    double t_start = Clock::current_time();
+    Event e = root.create_subspaces_by_field(fd_colors,
+					     colors,
+					     ss_by_color,
+					     ProfilingRequestSet());
+    e.wait();
+    double elapsed = Clock::current_time() - t_start;
+
+    log_app.print() << "byfield: " << num_elements << " elements in "
+		    << (elapsed * 1e3) << " ms = "
+		    << (num_elements / elapsed * 1e-6) << " Melements/s";
+  }
+
+  return Event::NO_EVENT;
+}
+
+int ByFieldTest::perform_dynamic_checks(void)
+{
+  return 0;
+}
+
+int ByFieldTest::check_partitioning(void)
+{
+  int errors = 0;
+
+  for(int i = 0; i <= num_colors; i++) {
+    size_t volume = ss_by_color[i].volume();
+    if(volume != counts[i]) {
+      log_app.error() << "volume mismatch: color=" << i
+		      << " expected=" << counts[i] << " actual=" << volume;
+      errors++;
+    }
+  }
+
+  // spot-check membership of a sample of points
+  int stride = std::max(1, num_elements / 10000);
+  for(int x = 0; x < num_elements; x += stride) {
+    int color = values[x];
+    if(!ss_by_color[color].contains(Point<1>(x))) {
+      log_app.error() << "point " << x << " missing from color " << color;
+      errors++;
+    }
+    int other = (color + 1) % (num_colors + 1);
+    if(ss_by_color[other].contains(Point<1>(x))) {
+      log_app.error() << "point " << x << " in wrong color " << other;
+      errors++;
+    }
+  }
+
+  return errors;
+}
+
+// image and preimage of a large 1-D pointer field (e.g. edges pointing at
+//  the nodes of a graph, with some locality) - measures the throughput of
+//  the pointer scan (try it with different values of -dp:workers)
+class ImageTest : public TestInterface {
+public:
+  ImageTest(int argc, const char *argv[]);
+  virtual ~ImageTest(void);
+
+  virtual void print_info(void);
+
+  virtual Event initialize_data(const std::vector<Memory>& memories,
+				const std::vector<Processor>& procs);
+
+  virtual Event perform_partitioning(void);
+
+  virtual int perform_dynamic_checks(void);
+
+  virtual int check_partitioning(void);
+
+protected:
+  int num_edges, num_nodes, num_pieces, window, iterations;
+
+  IndexSpace<1> is_edges, is_nodes;
+  std::vector<int> ptrs;
+  std::vector<RegionInstance> ri_edges;
+  std::vector<FieldDataDescriptor<IndexSpace<1>, Point<1> > > fd_ptrs;
+  std::vector<IndexSpace<1> > p_edges, p_nodes, p_images, p_preimages;
+};
+
+ImageTest::ImageTest(int argc, const char *argv[])
+  : num_edges(1 << 20), num_nodes(1 << 17), num_pieces(4), window(64)
+  , iterations(3)
+{
+  for(int i = 1; i < argc; i++) {
+#define INT_ARG(s, v) if(!strcmp(argv[i], s)) { v = atoi(argv[++i]); continue; }
+    INT_ARG("-e", num_edges)
+    INT_ARG("-n", num_nodes)
+    INT_ARG("-p", num_pieces)
+    INT_ARG("-w", window)
+    INT_ARG("-i", iterations)
+#undef INT_ARG
+  }
+  assert((num_edges > 0) && (num_nodes > 0) && (num_pieces > 0) && (window > 0));
+}
+
+ImageTest::~ImageTest(void)
+{}
+
+void ImageTest::print_info(void)
+{
+  printf("Realm dependent partitioning test - image: %d edges, %d nodes, %d pieces\n",
+	 num_edges, num_nodes, num_pieces);
+}
+
+Event ImageTest::initialize_data(const std::vector<Memory>& memories,
+				 const std::vector<Processor>& procs)
+{
+  is_edges = Rect<1>(0, num_edges - 1);
+  is_nodes = Rect<1>(0, num_nodes - 1);
+
+  // each edge points at a random node near its "home" node
+  RandStream<> rs(random_seed);
+  ptrs.resize(num_edges);
+  for(int i = 0; i < num_edges; i++) {
+    long long home = (long long)i * num_nodes / num_edges;
+    ptrs[i] = (home + rs.rand_int(window)) % num_nodes;
+  }
+
+  // one instance per memory
+  size_t num_insts = memories.size();
+  std::vector<IndexSpace<1> > ss_inst;
+  is_edges.create_equal_subspaces(num_insts, 1, ss_inst,
+				  Realm::ProfilingRequestSet()).wait();
+
+  std::vector<size_t> field_sizes(1, sizeof(Point<1>));
+
+  ri_edges.resize(num_insts);
+  fd_ptrs.resize(num_insts);
+
+  for(size_t i = 0; i < num_insts; i++) {
+    RegionInstance ri;
+    RegionInstance::create_instance(ri,
+				    memories[i],
+				    ss_inst[i],
+				    field_sizes,
+				    0 /*SOA*/,
+				    Realm::ProfilingRequestSet()).wait();
+    ri_edges[i] = ri;
+
+    fd_ptrs[i].index_space = ss_inst[i];
+    fd_ptrs[i].inst = ri;
+    fd_ptrs[i].field_offset = 0;
+
+    AffineAccessor<Point<1>,1> a_ptrs(ri, 0);
+    for(PointInRectIterator<1> pir(ss_inst[i].bounds); pir.valid; pir.step())
+      a_ptrs.write(pir.p, Point<1>(ptrs[pir.p.x]));
+  }
+
+  is_edges.create_equal_subspaces(num_pieces, 1, p_edges,
+				  Realm::ProfilingRequestSet()).wait();
+  is_nodes.create_equal_subspaces(num_pieces, 1, p_nodes,
+				  Realm::ProfilingRequestSet()).wait();
+
+  return Event::NO_EVENT;
+}
+
+Event ImageTest::perform_partitioning(void)
+{
+  for(int iter = 0; iter < iterations; iter++) {
+    for(size_t i = 0; i < p_images.size(); i++) {
+      p_images[i].destroy();
+      p_preimages[i].destroy();
+    }
+    p_images.clear();
+    p_preimages.clear();
+
+    double t_start = Clock::current_time();
+    Event e1 = is_nodes.create_subspaces_by_image(fd_ptrs,
+						  p_edges,
+						  p_images,
+						  ProfilingRequestSet());
+    e1.wait();
+    double t_image = Clock::current_time();
+    Event e2 = is_edges.create_subspaces_by_preimage(fd_ptrs,
+						     p_nodes,
+						     p_preimages,
+						     ProfilingRequestSet());
+    e2.wait();
+    double t_preimage = Clock::current_time();
+
+    log_app.print() << "image: " << num_edges << " pointers in "
+		    << ((t_image - t_start) * 1e3) << " ms = "
+		    << (num_edges / (t_image - t_start) * 1e-6) << " Mptrs/s";
+    log_app.print() << "preimage: " << num_edges << " pointers in "
+		    << ((t_preimage - t_image) * 1e3) << " ms = "
+		    << (num_edges / (t_preimage - t_image) * 1e-6) << " Mptrs/s";
+  }
+
+  return Event::NO_EVENT;
+}
+
+int ImageTest::perform_dynamic_checks(void)
+{
+  return 0;
+}
+
+int ImageTest::check_partitioning(void)
+{
+  int errors = 0;
+
+  for(int i = 0; i < num_pieces; i++) {
+    // nodes reached from edge piece i and edges that reach node piece i
+    std::vector<bool> reached(num_nodes, false);
+    size_t exp_image = 0;
+    for(PointInRectIterator<1> pir(p_edges[i].bounds); pir.valid; pir.step())
+      if(!reached[ptrs[pir.p.x]]) {
+	reached[ptrs[pir.p.x]] = true;
+	exp_image++;
+      }
+    size_t exp_preimage = 0;
+    for(int e = 0; e < num_edges; e++)
+      if(p_nodes[i].bounds.contains(Point<1>(ptrs[e])))
+	exp_preimage++;
+
+    if(p_images[i].volume() != exp_image) {
+      log_app.error() << "image volume mismatch: piece=" << i
+		      << " expected=" << exp_image << " actual=" << p_images[i].volume();
+      errors++;
+    }
+    if(p_preimages[i].volume() != exp_preimage) {
+      log_app.error() << "preimage volume mismatch: piece=" << i
+		      << " expected=" << exp_preimage << " actual=" << p_preimages[i].volume();
+      errors++;
+    }
+
+    // spot-check membership of a sample of nodes
+    int stride = std::max(1, num_nodes / 1000);
+    for(int n = 0; n < num_nodes; n += stride)
+      if(p_images[i].contains(Point<1>(n)) != reached[n]) {
+	log_app.error() << "image mismatch: piece=" << i << " node=" << n;
+	errors++;
+      }
+  }
+
+  return errors;
+}
+
 void top_level_task(const void *args, size_t arglen,
 		    const void *userdata, size_t userlen, Processor p)
 {
@@ -2242,6 +2600,16 @@ int main(int argc, char **argv)
       break;
     }
 
+    if(!strcmp(argv[i], "byfield")) {
+      testcfg = new ByFieldTest(argc-i, const_cast<const char **>(argv+i));
+      break;
+    }
+
+    if(!strcmp(argv[i], "image")) {
+      testcfg = new ImageTest(argc-i, const_cast<const char **>(argv+i));
+      break;
+    }
+
     if(!strcmp(argv[i], "random")) {
       testcfg = new RandomTest<1,int,2,int,int>(argc-i, const_cast<const char **>(argv+i));
       break;
@@ -0,0 +1,179 @@
+#include "realm.h"
+#include "realm/cmdline.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+
+#include <time.h>
+#include <unistd.h>
+
+using namespace Realm;
+
+Logger log_app("app");
+
+// Task IDs, some IDs are reserved so start at first available number
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE+0,
+};
+
+// measures the throughput of copies between system memory and a file
+//  instance - run once with and once without -ll:io_uring to compare the
+//  io_uring and AIO engines
+namespace TestConfig {
+  size_t buffer_size = 64 << 20;
+  size_t chunk_size = 256 << 10;  // each copy moves this much data
+  int reps = 4;
+  std::string filename = "fileio_test.dat";
+};
+
+typedef unsigned long long ElemType;
+
+// issues one copy per chunk, all at once, and returns the elapsed time in
+//  nanoseconds once they're all done
+static long long timed_chunked_copy(size_t elements, size_t chunk_elements,
+				    RegionInstance src_inst,
+				    RegionInstance dst_inst)
+{
+  std::vector<CopySrcDstField> src(1), dst(1);
+  src[0].inst = src_inst;
+  src[0].field_id = 0;
+  src[0].size = sizeof(ElemType);
+  dst[0].inst = dst_inst;
+  dst[0].field_id = 0;
+  dst[0].size = sizeof(ElemType);
+
+  long long t_start = Clock::current_time_in_nanoseconds();
+  std::vector<Event> events;
+  for(size_t lo = 0; lo < elements; lo += chunk_elements) {
+    size_t hi = std::min(lo + chunk_elements, elements) - 1;
+    IndexSpace<1> chunk(Rect<1>(lo, hi));
+    events.push_back(chunk.copy(src, dst, ProfilingRequestSet()));
+  }
+  Event::merge_events(events).wait();
+  return Clock::current_time_in_nanoseconds() - t_start;
+}
+
+void top_level_task(const void *args, size_t arglen,
+		    const void *userdata, size_t userlen, Processor p)
+{
+  size_t elements = TestConfig::buffer_size / sizeof(ElemType);
+  size_t chunk_elements = std::max(TestConfig::chunk_size / sizeof(ElemType),
+				   size_t(1));
+  IndexSpace<1> is(Rect<1>(0, elements - 1));
+
+  Memory sysmem = Machine::MemoryQuery(Machine::get_machine())
+    .has_affinity_to(p)
+    .only_kind(Memory::SYSTEM_MEM)
+    .first();
+  assert(sysmem.exists());
+
+  std::vector<size_t> field_sizes(1, sizeof(ElemType));
+  RegionInstance src_inst, check_inst, file_inst;
+  RegionInstance::create_instance(src_inst, sysmem, is, field_sizes,
+				  0 /*SOA*/, ProfilingRequestSet()).wait();
+  RegionInstance::create_instance(check_inst, sysmem, is, field_sizes,
+				  0 /*SOA*/, ProfilingRequestSet()).wait();
+
+  std::vector<FieldID> field_ids(1, 0);
+  RegionInstance::create_file_instance(file_inst,
+				       TestConfig::filename.c_str(),
+				       is, field_ids, field_sizes,
+				       LEGION_FILE_CREATE,
+				       ProfilingRequestSet()).wait();
+  assert(file_inst.exists());
+
+  // fill the source with a pattern
+  {
+    AffineAccessor<ElemType, 1> acc(src_inst, 0);
+    for(size_t i = 0; i < elements; i++)
+      acc[i] = (i * 0x9E3779B97F4A7C15ULL) ^ 0x5555;
+  }
+
+  log_app.print() << "file copies: size=" << TestConfig::buffer_size
+		  << " chunk=" << (chunk_elements * sizeof(ElemType))
+		  << " reps=" << TestConfig::reps;
+
+  double best_write = 0, best_read = 0;
+  int errors = 0;
+  for(int r = 0; r < TestConfig::reps; r++) {
+    // clear the check buffer so each read is verified independently
+    {
+      AffineAccessor<ElemType, 1> acc(check_inst, 0);
+      for(size_t i = 0; i < elements; i++)
+	acc[i] = 0;
+    }
+
+    long long t_write = timed_chunked_copy(elements, chunk_elements,
+					   src_inst, file_inst);
+    long long t_read = timed_chunked_copy(elements, chunk_elements,
+					  file_inst, check_inst);
+
+    double write_bw = double(TestConfig::buffer_size) / t_write;
+    double read_bw = double(TestConfig::buffer_size) / t_read;
+    log_app.info() << "rep " << r << ": write=" << write_bw
+		   << " GB/s read=" << read_bw << " GB/s";
+    best_write = std::max(best_write, write_bw);
+    best_read = std::max(best_read, read_bw);
+
+    AffineAccessor<ElemType, 1> acc_src(src_inst, 0);
+    AffineAccessor<ElemType, 1> acc_chk(check_inst, 0);
+    for(size_t i = 0; i < elements; i++)
+      if(acc_src[i] != acc_chk[i]) {
+	if(errors < 10)
+	  log_app.error() << "mismatch: index=" << i << " expected="
+			  << acc_src[i] << " actual=" << acc_chk[i];
+	errors++;
+      }
+  }
+
+  log_app.print() << "best write bandwidth: " << best_write << " GB/s";
+  log_app.print() << "best read bandwidth: " << best_read << " GB/s";
+
+  src_inst.destroy();
+  check_inst.destroy();
+  file_inst.destroy();
+
+  unlink(TestConfig::filename.c_str());
+
+  if(errors > 0) {
+    log_app.fatal() << errors << " mismatched elements";
+    exit(1);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  Runtime rt;
+
+  rt.init(&argc, &argv);
+
+  CommandLineParser cp;
+  cp.add_option_int_units("-b", TestConfig::buffer_size, 'M')
+    .add_option_int_units("-c", TestConfig::chunk_size, 'K')
+    .add_option_int("-r", TestConfig::reps)
+    .add_option_string("-f", TestConfig::filename);
+  bool ok = cp.parse_command_line(argc, const_cast<const char **>(argv));
+  assert(ok);
+
+  rt.register_task(TOP_LEVEL_TASK, top_level_task);
+
+  // select a processor to run the top level task on
+  Processor p = Machine::ProcessorQuery(Machine::get_machine())
+    .only_kind(Processor::LOC_PROC)
+    .first();
+  assert(p.exists());
+
+  // collective launch of a single task - everybody gets the same finish event
+  Event e = rt.collective_spawn(p, TOP_LEVEL_TASK, 0, 0);
+
+  // request shutdown once that task is complete
+  rt.shutdown(e);
+
+  // now sleep this thread until that shutdown actually happens
+  rt.wait_for_shutdown();
+
+  return 0;
+}
@@ -0,0 +1,159 @@
+/* Copyright 2020 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Realm test for the rate at which tasks on several processors can log
+//  messages - run with and without -logasync to compare the synchronous
+//  and asynchronous loggers
+
+#include <realm.h>
+#include <realm/cmdline.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+using namespace Realm;
+
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE+0,
+  LOGGER_TASK,
+};
+
+Logger log_app("app");
+Logger log_speed("logspeed");
+
+namespace TestConfig {
+  size_t messages = 100000;
+  // if set, the log file that every message must show up in
+  std::string check_file;
+};
+
+// counts the lines written by the logspeed logger to 'filename'
+static size_t count_logged_messages(const std::string& filename)
+{
+  FILE *f = fopen(filename.c_str(), "r");
+  if(!f) {
+    log_app.fatal() << "could not open log file '" << filename << "'";
+    return 0;
+  }
+  size_t count = 0;
+  char line[1024];
+  while(fgets(line, sizeof(line), f))
+    if(strstr(line, "{logspeed}: task ") != 0)
+      count++;
+  fclose(f);
+  return count;
+}
+
+struct LoggerTaskArgs {
+  int index;
+  size_t messages;
+};
+
+void logger_task(const void *args, size_t arglen,
+		 const void *userdata, size_t userlen, Processor p)
+{
+  const LoggerTaskArgs& l_args = *reinterpret_cast<const LoggerTaskArgs *>(args);
+
+  for(size_t i = 0; i < l_args.messages; i++)
+    log_speed.info() << "task " << l_args.index << " message " << i
+		     << " on proc " << p;
+}
+
+void top_level_task(const void *args, size_t arglen,
+		    const void *userdata, size_t userlen, Processor p)
+{
+  size_t messages = TestConfig::messages;
+
+  Machine::ProcessorQuery pq(Machine::get_machine());
+  pq.only_kind(p.kind());
+  std::vector<Processor> procs(pq.begin(), pq.end());
+
+  double t_start = Clock::current_time();
+
+  std::vector<Event> events;
+  for(size_t i = 0; i < procs.size(); i++) {
+    LoggerTaskArgs l_args;
+    l_args.index = i;
+    l_args.messages = messages;
+    events.push_back(procs[i].spawn(LOGGER_TASK, &l_args, sizeof(l_args)));
+  }
+  Event::merge_events(events).wait();
+
+  double elapsed = Clock::current_time() - t_start;
+  size_t total = messages * procs.size();
+  log_app.print() << "logspeed: " << procs.size() << " procs, "
+		  << total << " messages in " << elapsed << " s = "
+		  << (total / elapsed) << " messages/s";
+
+  int errors = 0;
+  if(!TestConfig::check_file.empty()) {
+    // warnings are written synchronously, after everything logged before
+    //  them - with -logasync this waits for the background writer to
+    //  drain the rings, so any message still missing was dropped
+    log_app.warning() << "logspeed: checking " << TestConfig::check_file;
+    size_t logged = count_logged_messages(TestConfig::check_file);
+    if(logged != total) {
+      log_app.error() << "logspeed: " << logged << " of " << total
+		      << " messages reached " << TestConfig::check_file;
+      errors++;
+    }
+  }
+
+  if(errors == 0)
+    log_app.info() << "completed successfully";
+
+  Runtime::get_runtime().shutdown(Event::NO_EVENT,
+				  (errors == 0) ? 0 : 1);
+}
+
+int main(int argc, const char **argv)
+{
+  Runtime rt;
+
+  rt.init(&argc, (char ***)&argv);
+
+  CommandLineParser clp;
+  clp.add_option_int("-m", TestConfig::messages);
+  clp.add_option_string("-check", TestConfig::check_file);
+
+  bool ok = clp.parse_command_line(argc, argv);
+  assert(ok);
+
+  // try to use a cpu proc, but if that doesn't exist, take whatever we can get
+  Processor p = Machine::ProcessorQuery(Machine::get_machine())
+    .only_kind(Processor::LOC_PROC)
+    .first();
+  if(!p.exists())
+    p = Machine::ProcessorQuery(Machine::get_machine()).first();
+  assert(p.exists());
+
+  Processor::register_task_by_kind(p.kind(), false /*!global*/,
+				   TOP_LEVEL_TASK,
+				   CodeDescriptor(top_level_task),
+				   ProfilingRequestSet()).external_wait();
+  Processor::register_task_by_kind(p.kind(), false /*!global*/,
+				   LOGGER_TASK,
+				   CodeDescriptor(logger_task),
+				   ProfilingRequestSet()).external_wait();
+
+  // collective launch of a single top level task
+  rt.collective_spawn(p, TOP_LEVEL_TASK, 0, 0);
+
+  // now sleep this thread until that shutdown actually happens
+  int ret = rt.wait_for_shutdown();
+
+  return ret;
+}
@@ -0,0 +1,174 @@
+/* Copyright 2020 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Realm test for the rate at which active messages can be exchanged
+//  between ranks - every node spawns a stream of empty tasks on a
+//  processor of every other node, so each task costs one spawn message
+//  (carrying -s bytes of task arguments) and one event trigger message
+//  on the way back.  Run with several ranks (e.g. mpirun -n 4) to
+//  measure the network module; on a single node the tasks are spawned
+//  on the local processors instead
+
+#include <realm.h>
+#include <realm/cmdline.h>
+
+#include <set>
+#include <vector>
+
+using namespace Realm;
+
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE+0,
+  SENDER_TASK,
+  EMPTY_TASK,
+};
+
+Logger log_app("app");
+
+struct TestConfig {
+  size_t messages;   // tasks spawned on each target by each sender
+  size_t arg_size;   // size of each task's arguments
+  int iterations;
+};
+
+struct SenderArgs {
+  TestConfig config;
+  Processor target;
+};
+
+void empty_task(const void *args, size_t arglen,
+		const void *userdata, size_t userlen, Processor p)
+{
+}
+
+void sender_task(const void *args, size_t arglen,
+		 const void *userdata, size_t userlen, Processor p)
+{
+  const SenderArgs& s_args = *reinterpret_cast<const SenderArgs *>(args);
+
+  std::vector<char> buffer(s_args.config.arg_size, 0);
+  std::vector<Event> events;
+  events.reserve(s_args.config.messages);
+  for(size_t i = 0; i < s_args.config.messages; i++) {
+    // make each argument buffer distinct so nothing can be deduplicated
+    if(!buffer.empty())
+      buffer[i % buffer.size()]++;
+    events.push_back(s_args.target.spawn(EMPTY_TASK,
+					 (buffer.empty() ? 0 : &buffer[0]),
+					 buffer.size()));
+  }
+  Event::merge_events(events).wait();
+}
+
+void top_level_task(const void *args, size_t arglen,
+		    const void *userdata, size_t userlen, Processor p)
+{
+  const TestConfig& config = *reinterpret_cast<const TestConfig *>(args);
+
+  // one sender and one target processor per node - if we're alone, pair
+  //  up the local processors instead
+  std::vector<Processor> procs;
+  {
+    Machine::ProcessorQuery pq(Machine::get_machine());
+    pq.only_kind(p.kind());
+    std::set<AddressSpace> seen;
+    for(Machine::ProcessorQuery::iterator it = pq.begin(); it != pq.end(); ++it)
+      if(seen.insert(it->address_space()).second)
+	procs.push_back(*it);
+    if(procs.size() == 1)
+      procs.assign(pq.begin(), pq.end());
+  }
+  if(procs.size() < 2) {
+    log_app.warning() << "need at least two processors - skipping test";
+    Runtime::get_runtime().shutdown(Event::NO_EVENT, 0 /*success*/);
+    return;
+  }
+
+  for(int iter = 0; iter < config.iterations; iter++) {
+    double t_start = Clock::current_time();
+
+    std::vector<Event> events;
+    for(size_t i = 0; i < procs.size(); i++)
+      for(size_t j = 0; j < procs.size(); j++) {
+	if(i == j) continue;
+	SenderArgs s_args;
+	s_args.config = config;
+	s_args.target = procs[j];
+	events.push_back(procs[i].spawn(SENDER_TASK, &s_args, sizeof(s_args)));
+      }
+    Event::merge_events(events).wait();
+
+    double elapsed = Clock::current_time() - t_start;
+    size_t total = config.messages * events.size();
+    log_app.print() << "msgrate: " << procs.size() << " procs, "
+		    << total << " tasks (" << config.arg_size
+		    << " byte args) in " << elapsed << " s = "
+		    << (total / elapsed) << " tasks/s, "
+		    << (2 * total / elapsed) << " messages/s";
+  }
+
+  log_app.info() << "completed successfully";
+
+  Runtime::get_runtime().shutdown(Event::NO_EVENT, 0 /*success*/);
+}
+
+int main(int argc, const char **argv)
+{
+  Runtime rt;
+
+  rt.init(&argc, (char ***)&argv);
+
+  TestConfig config;
+  config.messages = 10000;
+  config.arg_size = 16;
+  config.iterations = 3;
+
+  CommandLineParser clp;
+  clp.add_option_int("-m", config.messages)
+    .add_option_int_units("-s", config.arg_size)
+    .add_option_int("-i", config.iterations);
+
+  bool ok = clp.parse_command_line(argc, argv);
+  assert(ok);
+
+  // try to use a cpu proc, but if that doesn't exist, take whatever we can get
+  Processor p = Machine::ProcessorQuery(Machine::get_machine())
+    .only_kind(Processor::LOC_PROC)
+    .first();
+  if(!p.exists())
+    p = Machine::ProcessorQuery(Machine::get_machine()).first();
+  assert(p.exists());
+
+  Processor::register_task_by_kind(p.kind(), false /*!global*/,
+				   TOP_LEVEL_TASK,
+				   CodeDescriptor(top_level_task),
+				   ProfilingRequestSet()).external_wait();
+  Processor::register_task_by_kind(p.kind(), false /*!global*/,
+				   SENDER_TASK,
+				   CodeDescriptor(sender_task),
+				   ProfilingRequestSet()).external_wait();
+  Processor::register_task_by_kind(p.kind(), false /*!global*/,
+				   EMPTY_TASK,
+				   CodeDescriptor(empty_task),
+				   ProfilingRequestSet()).external_wait();
+
+  // collective launch of a single top level task
+  rt.collective_spawn(p, TOP_LEVEL_TASK, &config, sizeof(config));
+
+  // now sleep this thread until that shutdown actually happens
+  int ret = rt.wait_for_shutdown();
+
+  return ret;
+}
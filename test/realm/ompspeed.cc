@@ -0,0 +1,214 @@
+/* Copyright 2020 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Realm test for the latency of barriers and loop dispatch in Realm's
+//  OpenMP runtime - a task on an OpenMP processor runs a parallel region
+//  that measures the cost of an (empty) barrier and of short loops with
+//  each schedule, and checks that every loop iteration ran exactly once
+
+#include <realm.h>
+#include <realm/cmdline.h>
+
+#include <omp.h>
+
+#include <vector>
+#include <algorithm>
+
+using namespace Realm;
+
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE+0,
+  OMP_TASK,
+};
+
+Logger log_app("app");
+
+struct TestConfig {
+  int barriers;    // number of barriers to time
+  int loops;       // number of loops of each schedule to time
+  int loop_size;   // iterations in each loop
+};
+
+enum LoopKind {
+  LOOP_STATIC,
+  LOOP_DYNAMIC,
+  LOOP_DYNAMIC_CHUNKED,
+  LOOP_GUIDED,
+  LOOP_AUTO,
+  LOOP_RUNTIME,
+  NUM_LOOP_KINDS
+};
+
+static const char *loop_names[NUM_LOOP_KINDS] = {
+  "static", "dynamic", "dynamic,16", "guided", "auto", "runtime"
+};
+
+// each loop adds one to every entry of 'hits'
+static void run_loops(LoopKind kind, int count, int loop_size, int *hits)
+{
+  for(int l = 0; l < count; l++) {
+    switch(kind) {
+    case LOOP_STATIC:
+      {
+#pragma omp for schedule(static)
+	for(int i = 0; i < loop_size; i++) hits[i]++;
+	break;
+      }
+    case LOOP_DYNAMIC:
+      {
+#pragma omp for schedule(dynamic)
+	for(int i = 0; i < loop_size; i++) hits[i]++;
+	break;
+      }
+    case LOOP_DYNAMIC_CHUNKED:
+      {
+#pragma omp for schedule(dynamic, 16)
+	for(int i = 0; i < loop_size; i++) hits[i]++;
+	break;
+      }
+    case LOOP_GUIDED:
+      {
+#pragma omp for schedule(guided)
+	for(int i = 0; i < loop_size; i++) hits[i]++;
+	break;
+      }
+    case LOOP_AUTO:
+      {
+#pragma omp for schedule(auto)
+	for(int i = 0; i < loop_size; i++) hits[i]++;
+	break;
+      }
+    case LOOP_RUNTIME:
+      {
+#pragma omp for schedule(runtime)
+	for(int i = 0; i < loop_size; i++) hits[i]++;
+	break;
+      }
+    default: assert(0);
+    }
+  }
+}
+
+void omp_task(const void *args, size_t arglen,
+	      const void *userdata, size_t userlen, Processor p)
+{
+  const TestConfig& config = *reinterpret_cast<const TestConfig *>(args);
+
+  int errors = 0;
+
+  // barrier latency
+  {
+    int num_threads = 0;
+    double t_start = Clock::current_time();
+#pragma omp parallel
+    {
+#pragma omp single
+      num_threads = omp_get_num_threads();
+      for(int i = 0; i < config.barriers; i++) {
+#pragma omp barrier
+      }
+    }
+    double elapsed = Clock::current_time() - t_start;
+    log_app.print() << "barrier: " << num_threads << " threads, "
+		    << (elapsed / config.barriers * 1e6) << " us/barrier";
+  }
+
+  // loop dispatch latency for each schedule
+  std::vector<int> hits(config.loop_size);
+  for(int k = 0; k < NUM_LOOP_KINDS; k++) {
+    std::fill(hits.begin(), hits.end(), 0);
+
+    double t_start = Clock::current_time();
+#pragma omp parallel
+    run_loops(LoopKind(k), config.loops, config.loop_size, &hits[0]);
+    double elapsed = Clock::current_time() - t_start;
+
+    log_app.print() << "loop(" << loop_names[k] << "): "
+		    << config.loop_size << " iterations, "
+		    << (elapsed / config.loops * 1e6) << " us/loop";
+
+    for(int i = 0; i < config.loop_size; i++)
+      if(hits[i] != config.loops) {
+	log_app.error() << "loop(" << loop_names[k] << "): iteration " << i
+			<< " ran " << hits[i] << " times (expected "
+			<< config.loops << ")";
+	errors++;
+	break;
+      }
+  }
+
+  if(errors > 0)
+    log_app.fatal() << errors << " errors";
+  assert(errors == 0);
+}
+
+void top_level_task(const void *args, size_t arglen,
+		    const void *userdata, size_t userlen, Processor p)
+{
+  Processor omp = Machine::ProcessorQuery(Machine::get_machine())
+    .only_kind(Processor::OMP_PROC)
+    .local_address_space()
+    .first();
+  if(!omp.exists()) {
+    log_app.warning() << "no OpenMP processors - skipping test";
+  } else {
+    omp.spawn(OMP_TASK, args, arglen).wait();
+    log_app.info() << "completed successfully";
+  }
+
+  Runtime::get_runtime().shutdown(Event::NO_EVENT, 0 /*success*/);
+}
+
+int main(int argc, const char **argv)
+{
+  Runtime rt;
+
+  rt.init(&argc, (char ***)&argv);
+
+  TestConfig config;
+  config.barriers = 10000;
+  config.loops = 1000;
+  config.loop_size = 4096;
+
+  CommandLineParser clp;
+  clp.add_option_int("-b", config.barriers)
+    .add_option_int("-l", config.loops)
+    .add_option_int("-n", config.loop_size);
+
+  bool ok = clp.parse_command_line(argc, argv);
+  assert(ok);
+
+  Processor p = Machine::ProcessorQuery(Machine::get_machine())
+    .only_kind(Processor::LOC_PROC)
+    .first();
+  assert(p.exists());
+
+  Processor::register_task_by_kind(Processor::LOC_PROC, false /*!global*/,
+				   TOP_LEVEL_TASK,
+				   CodeDescriptor(top_level_task),
+				   ProfilingRequestSet()).external_wait();
+  Processor::register_task_by_kind(Processor::OMP_PROC, false /*!global*/,
+				   OMP_TASK,
+				   CodeDescriptor(omp_task),
+				   ProfilingRequestSet()).external_wait();
+
+  // collective launch of a single top level task
+  rt.collective_spawn(p, TOP_LEVEL_TASK, &config, sizeof(config));
+
+  // now sleep this thread until that shutdown actually happens
+  int ret = rt.wait_for_shutdown();
+
+  return ret;
+}
@@ -0,0 +1,220 @@
+// Copyright 2020 Stanford University
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// test (and microbenchmark) for Realm's BasicRangeAllocator
+
+#include "realm/mem_impl.h"
+#include "realm/timers.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <vector>
+#include <cassert>
+
+using namespace Realm;
+
+typedef BasicRangeAllocator<size_t, RegionInstance> Allocator;
+
+int seed = 12345;
+int num_steps = 100000;
+size_t heap_size = size_t(1) << 30;
+int max_live = 100000;
+bool verbose = false;
+
+static RegionInstance make_tag(realm_id_t id)
+{
+  RegionInstance inst;
+  inst.id = id;
+  return inst;
+}
+
+static size_t random_size(void)
+{
+  // mostly small allocations with the occasional large one, like instances
+  if((lrand48() % 16) == 0)
+    return 4096 + (lrand48() % (1 << 20));
+  return 8 * (1 + (lrand48() % 512));
+}
+
+static size_t random_alignment(void)
+{
+  static const size_t aligns[] = { 0, 1, 8, 16, 64, 256, 4096 };
+  return aligns[lrand48() % (sizeof(aligns) / sizeof(aligns[0]))];
+}
+
+// randomized correctness check against a simple model of the live set
+static void run_correctness(void)
+{
+  Allocator alloc;
+  alloc.add_range(0, heap_size);
+
+  // tag id -> (first, size)
+  std::map<realm_id_t, std::pair<size_t, size_t> > live;
+  std::vector<realm_id_t> live_ids;
+  realm_id_t next_id = 1;
+
+  for(int i = 0; i < num_steps; i++) {
+    bool do_alloc = (live_ids.empty() ||
+		     ((int)live_ids.size() < max_live && (lrand48() % 3) != 0));
+    if(do_alloc) {
+      realm_id_t id = next_id++;
+      size_t size = ((lrand48() % 64) == 0) ? 0 : random_size();
+      size_t align = random_alignment();
+      bool ok = alloc.can_allocate(make_tag(id), size, align);
+      size_t first = 0;
+      bool ok2 = alloc.allocate(make_tag(id), size, align, first);
+      assert(ok == ok2);
+      if(verbose)
+	printf("ALLOC(%lld, %zd, %zd) -> %d %zd\n",
+	       (long long)id, size, align, ok2, first);
+      if(!ok2)
+	continue;
+      if(size > 0) {
+	if(align)
+	  assert((first % align) == 0);
+	assert((first + size) <= heap_size);
+      }
+      live[id] = std::make_pair(first, size);
+      live_ids.push_back(id);
+    } else {
+      size_t which = lrand48() % live_ids.size();
+      realm_id_t id = live_ids[which];
+      live_ids[which] = live_ids.back();
+      live_ids.pop_back();
+      size_t first, size;
+      bool found = alloc.lookup(make_tag(id), first, size);
+      assert(found);
+      assert(first == live[id].first);
+      assert(size == live[id].second);
+      if(verbose)
+	printf("FREE(%lld)\n", (long long)id);
+      alloc.deallocate(make_tag(id));
+      live.erase(id);
+      assert(!alloc.lookup(make_tag(id), first, size));
+    }
+
+    // periodically check that no two live allocations overlap
+    if((i % 1000) == 0) {
+      std::map<size_t, size_t> by_addr;
+      for(std::map<realm_id_t, std::pair<size_t, size_t> >::const_iterator it = live.begin();
+	  it != live.end();
+	  ++it)
+	if(it->second.second > 0)
+	  by_addr[it->second.first] = it->second.second;
+      size_t prev_end = 0;
+      for(std::map<size_t, size_t>::const_iterator it = by_addr.begin();
+	  it != by_addr.end();
+	  ++it) {
+	assert(it->first >= prev_end);
+	prev_end = it->first + it->second;
+      }
+    }
+  }
+
+  // free everything - the heap must coalesce back into a single range
+  for(size_t i = 0; i < live_ids.size(); i++)
+    alloc.deallocate(make_tag(live_ids[i]));
+  alloc.deallocate(make_tag(0), true /*missing_ok*/);
+  size_t first = 0;
+  bool ok = alloc.allocate(make_tag(next_id), heap_size, 0, first);
+  assert(ok && (first == 0));
+}
+
+// measures the average latency of an alloc/free pair with a given number of
+//  (fragmented) live allocations
+static void run_timing(int live_count)
+{
+  Allocator alloc;
+  alloc.add_range(0, heap_size);
+
+  std::vector<realm_id_t> live_ids;
+  realm_id_t next_id = 1;
+
+  // populate, then free every other allocation to fragment the heap
+  for(int i = 0; i < 2 * live_count; i++) {
+    size_t first;
+    if(alloc.allocate(make_tag(next_id), 64 + 8 * (i % 32), 16, first))
+      live_ids.push_back(next_id);
+    next_id++;
+  }
+  std::vector<realm_id_t> kept;
+  for(size_t i = 0; i < live_ids.size(); i++)
+    if((i % 2) == 0)
+      alloc.deallocate(make_tag(live_ids[i]));
+    else
+      kept.push_back(live_ids[i]);
+
+  const int reps = 100000;
+  long long t_alloc = 0, t_free = 0;
+  for(int i = 0; i < reps; i++) {
+    realm_id_t id = next_id++;
+    size_t first;
+    long long t1 = Clock::current_time_in_nanoseconds();
+    bool ok = alloc.allocate(make_tag(id), random_size(), 64, first);
+    long long t2 = Clock::current_time_in_nanoseconds();
+    if(ok)
+      alloc.deallocate(make_tag(id));
+    long long t3 = Clock::current_time_in_nanoseconds();
+    t_alloc += (t2 - t1);
+    t_free += (t3 - t2);
+  }
+
+  printf("live=%8zd  alloc=%8.1f ns  free=%8.1f ns\n",
+	 kept.size(), double(t_alloc) / reps, double(t_free) / reps);
+}
+
+int main(int argc, const char *argv[])
+{
+  bool timing = false;
+
+  // parse args
+  for(int i = 1; i < argc; i++) {
+    if(!strcmp(argv[i], "-s")) {
+      seed = atoi(argv[++i]);
+      continue;
+    }
+    if(!strcmp(argv[i], "-i")) {
+      num_steps = atoi(argv[++i]);
+      continue;
+    }
+    if(!strcmp(argv[i], "-l")) {
+      max_live = atoi(argv[++i]);
+      continue;
+    }
+    if(!strcmp(argv[i], "-t")) {
+      timing = true;
+      continue;
+    }
+    if(!strcmp(argv[i], "-v")) {
+      verbose = true;
+      continue;
+    }
+  }
+
+  srand48(seed);
+
+  run_correctness();
+
+  if(timing) {
+    for(int live = 1000; live <= max_live; live *= 10)
+      run_timing(live);
+  }
+
+  printf("PASS\n");
+  return 0;
+}
@@ -0,0 +1,376 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Test for the persistent template optimization cache (-lg:trace_cache).
+// A traced loop of index launches over a partitioned region is run
+// several times against the same cache directory, each run checking its
+// results against a reference computed on the host:
+//   -mode save     starts with an empty cache and must save templates
+//   -mode load     must load every template from the cache
+//   -mode changed  runs a different trace under the same trace ID,
+//                  which must not use the cached templates
+//   -mode corrupt  damages every cache file first, which must be
+//                  detected and ignored
+// Whether templates were saved or loaded is read back from the tracing
+// log, so the runtime must be built with info-level logging.
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "legion.h"
+
+using namespace Legion;
+
+enum TaskIDs {
+  TOP_LEVEL_TASK_ID,
+  INIT_TASK_ID,
+  STEP_TASK_ID,
+  SCALE_TASK_ID,
+};
+
+enum FieldIDs {
+  FID_A,
+  FID_B,
+};
+
+static const TraceID TRACE_ID = 17;
+static const long long MODULUS = 1000003;
+
+static long long step(long long value, long long idx)
+{
+  return ((2 * value + idx) % MODULUS);
+}
+
+static long long scale(long long value)
+{
+  return ((3 * value + 1) % MODULUS);
+}
+
+void init_task(const Task *task,
+               const std::vector<PhysicalRegion> &regions,
+               Context ctx, Runtime *runtime)
+{
+  const FieldAccessor<WRITE_DISCARD,long long,1> acc(regions[0], FID_A);
+  Rect<1> rect = runtime->get_index_space_domain(ctx,
+                  task->regions[0].region.get_index_space());
+  for (coord_t idx = rect.lo[0]; idx <= rect.hi[0]; idx++)
+    acc[idx] = idx;
+}
+
+void step_task(const Task *task,
+               const std::vector<PhysicalRegion> &regions,
+               Context ctx, Runtime *runtime)
+{
+  const FieldID src_fid = task->regions[0].instance_fields[0];
+  const FieldID dst_fid = task->regions[1].instance_fields[0];
+  const FieldAccessor<READ_ONLY,long long,1> src(regions[0], src_fid);
+  const FieldAccessor<WRITE_DISCARD,long long,1> dst(regions[1], dst_fid);
+  Rect<1> rect = runtime->get_index_space_domain(ctx,
+                  task->regions[0].region.get_index_space());
+  for (coord_t idx = rect.lo[0]; idx <= rect.hi[0]; idx++)
+    dst[idx] = step(src[idx], idx);
+}
+
+void scale_task(const Task *task,
+                const std::vector<PhysicalRegion> &regions,
+                Context ctx, Runtime *runtime)
+{
+  const FieldAccessor<READ_WRITE,long long,1> acc(regions[0], FID_A);
+  Rect<1> rect = runtime->get_index_space_domain(ctx,
+                  task->regions[0].region.get_index_space());
+  for (coord_t idx = rect.lo[0]; idx <= rect.hi[0]; idx++)
+    acc[idx] = scale(acc[idx]);
+}
+
+static void launch_step(Context ctx, Runtime *runtime, IndexSpace colors,
+                        LogicalRegion region, LogicalPartition lp,
+                        FieldID src, FieldID dst)
+{
+  IndexLauncher launcher(STEP_TASK_ID, colors, TaskArgument(), ArgumentMap());
+  launcher.add_region_requirement(
+      RegionRequirement(lp, 0/*projection ID*/, READ_ONLY, EXCLUSIVE, region));
+  launcher.add_field(0, src);
+  launcher.add_region_requirement(
+      RegionRequirement(lp, 0/*projection ID*/,
+                        WRITE_DISCARD, EXCLUSIVE, region));
+  launcher.add_field(1, dst);
+  runtime->execute_index_space(ctx, launcher);
+}
+
+void top_level_task(const Task *task,
+                    const std::vector<PhysicalRegion> &regions,
+                    Context ctx, Runtime *runtime)
+{
+  int num_pieces = 4;
+  int piece_size = 64;
+  int num_iterations = 8;
+  bool changed = false;
+  const InputArgs &args = Runtime::get_input_args();
+  for (int i = 1; i < args.argc; i++)
+  {
+    if (!strcmp(args.argv[i], "-p"))
+      num_pieces = atoi(args.argv[++i]);
+    else if (!strcmp(args.argv[i], "-e"))
+      piece_size = atoi(args.argv[++i]);
+    else if (!strcmp(args.argv[i], "-i"))
+      num_iterations = atoi(args.argv[++i]);
+    else if (!strcmp(args.argv[i], "-mode"))
+      changed = !strcmp(args.argv[++i], "changed");
+  }
+  const long long size = (long long)num_pieces * piece_size;
+
+  const Rect<1> bounds(0, size - 1);
+  IndexSpace is = runtime->create_index_space(ctx, bounds);
+  FieldSpace fs = runtime->create_field_space(ctx);
+  {
+    FieldAllocator allocator = runtime->create_field_allocator(ctx, fs);
+    allocator.allocate_field(sizeof(long long), FID_A);
+    allocator.allocate_field(sizeof(long long), FID_B);
+  }
+  LogicalRegion region = runtime->create_logical_region(ctx, is, fs);
+
+  const Rect<1> color_bounds(0, num_pieces - 1);
+  IndexSpace colors = runtime->create_index_space(ctx, color_bounds);
+  IndexPartition ip = runtime->create_equal_partition(ctx, is, colors);
+  LogicalPartition lp = runtime->get_logical_partition(ctx, region, ip);
+
+  {
+    IndexLauncher launcher(INIT_TASK_ID, colors, TaskArgument(),
+                           ArgumentMap());
+    launcher.add_region_requirement(
+        RegionRequirement(lp, 0/*projection ID*/,
+                          WRITE_DISCARD, EXCLUSIVE, region));
+    launcher.add_field(0, FID_A);
+    runtime->execute_index_space(ctx, launcher);
+    const long long zero = 0;
+    runtime->fill_field(ctx, region, region, FID_B, &zero, sizeof(zero));
+  }
+
+  for (int iter = 0; iter < num_iterations; iter++)
+  {
+    runtime->begin_trace(ctx, TRACE_ID);
+    launch_step(ctx, runtime, colors, region, lp, FID_A, FID_B);
+    launch_step(ctx, runtime, colors, region, lp, FID_B, FID_A);
+    if (changed)
+    {
+      IndexLauncher launcher(SCALE_TASK_ID, colors, TaskArgument(),
+                             ArgumentMap());
+      launcher.add_region_requirement(
+          RegionRequirement(lp, 0/*projection ID*/,
+                            READ_WRITE, EXCLUSIVE, region));
+      launcher.add_field(0, FID_A);
+      runtime->execute_index_space(ctx, launcher);
+    }
+    runtime->end_trace(ctx, TRACE_ID);
+  }
+
+  // compute the same thing on the host
+  std::vector<long long> a(size), b(size, 0);
+  for (long long idx = 0; idx < size; idx++)
+    a[idx] = idx;
+  for (int iter = 0; iter < num_iterations; iter++)
+  {
+    for (long long idx = 0; idx < size; idx++)
+      b[idx] = step(a[idx], idx);
+    for (long long idx = 0; idx < size; idx++)
+      a[idx] = step(b[idx], idx);
+    if (changed)
+      for (long long idx = 0; idx < size; idx++)
+        a[idx] = scale(a[idx]);
+  }
+
+  InlineLauncher launcher(RegionRequirement(region, READ_ONLY,
+                                            EXCLUSIVE, region));
+  launcher.add_field(FID_A);
+  launcher.add_field(FID_B);
+  PhysicalRegion result = runtime->map_region(ctx, launcher);
+  result.wait_until_valid();
+  const FieldAccessor<READ_ONLY,long long,1> acc_a(result, FID_A);
+  const FieldAccessor<READ_ONLY,long long,1> acc_b(result, FID_B);
+  unsigned long long checksum = 0;
+  for (long long idx = 0; idx < size; idx++)
+  {
+    if ((acc_a[idx] != a[idx]) || (acc_b[idx] != b[idx]))
+    {
+      fprintf(stderr, "MISMATCH at %lld: got (%lld, %lld), "
+              "expected (%lld, %lld)\n", idx, (long long)acc_a[idx],
+              (long long)acc_b[idx], a[idx], b[idx]);
+      abort();
+    }
+    checksum = checksum * 31 + a[idx] + b[idx];
+  }
+  printf("results match (checksum %llx)\n", checksum);
+  runtime->unmap_region(ctx, result);
+
+  runtime->destroy_logical_region(ctx, region);
+  runtime->destroy_field_space(ctx, fs);
+  runtime->destroy_index_space(ctx, colors);
+  runtime->destroy_index_space(ctx, is);
+}
+
+static void list_cache_files(const std::string &dir,
+                             std::vector<std::string> &files)
+{
+  DIR *d = opendir(dir.c_str());
+  if (d == NULL)
+    return;
+  struct dirent *entry;
+  while ((entry = readdir(d)) != NULL)
+  {
+    const size_t len = strlen(entry->d_name);
+    if ((len > 4) && !strcmp(entry->d_name + len - 4, ".tpl"))
+      files.push_back(dir + "/" + entry->d_name);
+  }
+  closedir(d);
+}
+
+static int count_lines(const std::string &filename, const char *pattern)
+{
+  FILE *f = fopen(filename.c_str(), "r");
+  if (f == NULL)
+    return 0;
+  int count = 0;
+  char line[4096];
+  while (fgets(line, sizeof(line), f) != NULL)
+    if (strstr(line, pattern) != NULL)
+      count++;
+  fclose(f);
+  return count;
+}
+
+int main(int argc, char **argv)
+{
+  std::string dir = "trace_cache_files";
+  std::string mode = "save";
+  for (int i = 1; i < (argc - 1); i++)
+  {
+    if (!strcmp(argv[i], "-dir"))
+      dir = argv[i+1];
+    else if (!strcmp(argv[i], "-mode"))
+      mode = argv[i+1];
+  }
+  if ((mode != "save") && (mode != "load") &&
+      (mode != "changed") && (mode != "corrupt"))
+  {
+    fprintf(stderr, "unknown mode '%s'\n", mode.c_str());
+    return 1;
+  }
+
+  std::vector<std::string> files;
+  if (mode == "save")
+  {
+    mkdir(dir.c_str(), 0755);
+    list_cache_files(dir, files);
+    for (unsigned idx = 0; idx < files.size(); idx++)
+      unlink(files[idx].c_str());
+    files.clear();
+  }
+  else
+    list_cache_files(dir, files);
+  if (mode == "corrupt")
+  {
+    // flip the last byte of each file, which is part of the cached result
+    for (unsigned idx = 0; idx < files.size(); idx++)
+    {
+      FILE *f = fopen(files[idx].c_str(), "r+b");
+      if ((f == NULL) || (fseek(f, -1, SEEK_END) != 0))
+      {
+        fprintf(stderr, "unable to corrupt %s\n", files[idx].c_str());
+        return 1;
+      }
+      const int c = fgetc(f);
+      fseek(f, -1, SEEK_END);
+      fputc(c ^ 0xff, f);
+      fclose(f);
+    }
+  }
+  const size_t files_before = files.size();
+
+  // point the runtime at the cache and capture the tracing log, the
+  // default mapper only memoizes (i.e. makes physical traces) on request
+  const std::string logfile = dir + "/" + mode + ".log";
+  std::vector<char*> new_argv(argv, argv + argc);
+  const char *extra_args[] = { "-dm:memoize",
+                               "-lg:trace_cache", dir.c_str(),
+                               "-level", "tracing=2",
+                               "-logfile", logfile.c_str() };
+  for (unsigned idx = 0; idx < (sizeof(extra_args)/sizeof(char*)); idx++)
+    new_argv.push_back(const_cast<char*>(extra_args[idx]));
+  int new_argc = new_argv.size();
+  new_argv.push_back(NULL);
+  char **new_argv_ptr = &new_argv[0];
+
+  Runtime::set_top_level_task_id(TOP_LEVEL_TASK_ID);
+  {
+    TaskVariantRegistrar registrar(TOP_LEVEL_TASK_ID, "top_level");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    Runtime::preregister_task_variant<top_level_task>(registrar, "top_level");
+  }
+  {
+    TaskVariantRegistrar registrar(INIT_TASK_ID, "init");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    Runtime::preregister_task_variant<init_task>(registrar, "init");
+  }
+  {
+    TaskVariantRegistrar registrar(STEP_TASK_ID, "step");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    Runtime::preregister_task_variant<step_task>(registrar, "step");
+  }
+  {
+    TaskVariantRegistrar registrar(SCALE_TASK_ID, "scale");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    Runtime::preregister_task_variant<scale_task>(registrar, "scale");
+  }
+  const int result = Runtime::start(new_argc, new_argv_ptr);
+  if (result != 0)
+    return result;
+
+  files.clear();
+  list_cache_files(dir, files);
+  const int loaded = count_lines(logfile, "Loaded optimized template");
+  const int saved = count_lines(logfile, "Saved optimized template");
+  const int ignored = count_lines(logfile, "Ignoring mismatched template");
+  printf("%s: %d templates loaded, %d saved, %d ignored, "
+         "%zd cache files (%zd before)\n", mode.c_str(), loaded, saved,
+         ignored, files.size(), files_before);
+  bool success = true;
+  if (mode == "save")
+    success = (loaded == 0) && (saved > 0) && !files.empty();
+  else if (mode == "load")
+    success = (loaded > 0) && (saved == 0) && (ignored == 0) &&
+              (files.size() == files_before);
+  else if (mode == "changed")
+    success = (loaded == 0) && (saved > 0) && (ignored == 0) &&
+              (files.size() > files_before);
+  else if (mode == "corrupt")
+    success = (loaded == 0) && (saved > 0) && (ignored > 0) &&
+              (files.size() == files_before);
+  if (!success)
+  {
+    fprintf(stderr, "unexpected use of the template cache in mode '%s', "
+            "see %s\n", mode.c_str(), logfile.c_str());
+    return 1;
+  }
+  return 0;
+}
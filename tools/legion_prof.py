@@ -32,7 +32,7 @@ import json
 import heapq
 import time
 import itertools
-from legion_serializer import LegionProfASCIIDeserializer, LegionProfBinaryDeserializer, GetFileTypeInfo
+from legion_serializer import LegionProfASCIIDeserializer, LegionProfBinaryDeserializer, GetFileTypeInfo, LegionProfColumnarStore
 
 root_dir = os.path.dirname(os.path.realpath(__file__))
 
@@ -162,6 +162,29 @@ PIXELS_PER_LEVEL = 40
 # Pixels per tick mark
 PIXELS_PER_TICK = 200
 
+# Names of the runtime's virtual channels for message statistics; channel 1
+# is shared by the throughput and mapper channels
+virtual_channel_names = {
+    0: 'default',
+    1: 'throughput/mapper',
+    2: 'task',
+    3: 'index space',
+    4: 'field space',
+    5: 'logical tree',
+    6: 'reference',
+    7: 'update',
+    8: 'subset',
+    9: 'context',
+    10: 'layout constraint',
+    11: 'expression',
+    12: 'migration',
+    13: 'tracing',
+}
+
+# Runtime call kind used for physical trace replay slices; the runtime's own
+# call kinds are all non-negative
+REPLAY_SLICE_KIND = -1
+
 # prof_uid counter
 prof_uid_ctr = 0
 
@@ -2243,7 +2266,7 @@ class IndexSpace(StatObject):
         return stext
 
 class RuntimeCall(Base, TimeRange, HasNoDependencies):
-    __slots__ = TimeRange._abstract_slots + HasNoDependencies._abstract_slots + ['kind']
+    __slots__ = TimeRange._abstract_slots + HasNoDependencies._abstract_slots + ['kind', 'proc']
     def __init__(self, kind, start, stop):
         Base.__init__(self)
         TimeRange.__init__(self, None, None, start, stop)
@@ -2292,6 +2315,19 @@ class RuntimeCall(Base, TimeRange, HasNoDependencies):
     def __repr__(self):
         return 'Runtime Call '+str(self.kind)
 
+class ReplaySlice(RuntimeCall):
+    __slots__ = ['slice_index', 'num_instructions', 'cost']
+    def __init__(self, kind, slice_index, num_instructions, cost, start, stop):
+        RuntimeCall.__init__(self, kind, start, stop)
+        self.slice_index = slice_index
+        self.num_instructions = num_instructions
+        self.cost = cost
+
+    def __repr__(self):
+        return 'Trace Replay Slice '+str(self.slice_index)+' ('+ \
+                str(self.num_instructions)+' instructions, cost '+ \
+                str(self.cost)+')'
+
 class LFSR(object):
     __slots__ = ['register', 'max_value', 'taps']
     def __init__(self, size):
@@ -2405,7 +2441,8 @@ class State(object):
         'prof_uid_map', 'multi_tasks', 'first_times', 'last_times',
         'last_time', 'mapper_call_kinds', 'mapper_calls', 'runtime_call_kinds', 
         'runtime_calls', 'instances', 'index_spaces', 'partitions', 'logical_regions', 
-        'field_spaces', 'fields', 'has_spy_data', 'spy_state', 'callbacks'
+        'field_spaces', 'fields', 'message_channels', 'has_spy_data', 'spy_state',
+        'callbacks'
     ]
     def __init__(self):
         self.max_dim = 3
@@ -2433,6 +2470,7 @@ class State(object):
         self.logical_regions = {}
         self.field_spaces = {}
         self.fields = {}
+        self.message_channels = []
         self.has_spy_data = False
         self.spy_state = None
         self.callbacks = {
@@ -2460,6 +2498,8 @@ class State(object):
             "PartitionInfo": self.log_partition_info,
             "MapperCallInfo": self.log_mapper_call_info,
             "RuntimeCallInfo": self.log_runtime_call_info,
+            "ReplaySliceInfo": self.log_replay_slice_info,
+            "MessageChannelInfo": self.log_message_channel_info,
             "ProfTaskInfo": self.log_proftask_info,
             "ProcMDesc": self.log_mem_proc_affinity_desc,
             "IndexSpacePointDesc": self.log_index_space_point_desc,
@@ -2761,6 +2801,21 @@ class State(object):
         proc = self.find_processor(proc_id)
         proc.add_runtime_call(call)
 
+    def log_replay_slice_info(self, slice_index, num_instructions, cost,
+                              proc_id, start, stop):
+        assert start <= stop
+        # replay slices are shown like runtime calls, with their own kind
+        # so that they show up together in the statistics
+        if REPLAY_SLICE_KIND not in self.runtime_call_kinds:
+            self.runtime_call_kinds[REPLAY_SLICE_KIND] = \
+                RuntimeCallKind(REPLAY_SLICE_KIND, 'Physical Trace Replay Slice')
+        if stop > self.last_time:
+            self.last_time = stop
+        call = ReplaySlice(self.runtime_call_kinds[REPLAY_SLICE_KIND],
+                           slice_index, num_instructions, cost, start, stop)
+        proc = self.find_processor(proc_id)
+        proc.add_runtime_call(call)
+
     def log_proftask_info(self, proc_id, op_id, start, stop):
         # we don't have a unique op_id for the profiling task itself, so we don't 
         # add to self.operations
@@ -2768,6 +2823,15 @@ class State(object):
         proc = self.find_processor(proc_id)
         proc.add_task(proftask)
 
+    def log_message_channel_info(self, channel, messages, bytes,
+                                 active_messages, explicit_flushes,
+                                 full_flushes, size_flushes, delay_flushes,
+                                 idle_flushes, proc_id):
+        node_id = (proc_id >> 40) & ((1 << 16) - 1)
+        self.message_channels.append((node_id, channel, messages, bytes,
+            active_messages, explicit_flushes, full_flushes, size_flushes,
+            delay_flushes, idle_flushes))
+
     def find_processor(self, proc_id):
         if proc_id not in self.processors:
             self.processors[proc_id] = Processor(proc_id, None)
@@ -3047,6 +3111,29 @@ class State(object):
             channel.print_stats(verbose)
         print
 
+    def print_message_stats(self, verbose):
+        if not self.message_channels:
+            return
+        print('****************************************************')
+        print('   MESSAGE STATS')
+        print('****************************************************')
+        for node_id, channel, messages, bytes, active_messages, \
+                explicit_flushes, full_flushes, size_flushes, \
+                delay_flushes, idle_flushes in sorted(self.message_channels):
+            name = virtual_channel_names.get(channel, str(channel))
+            print('Node '+str(node_id)+' '+name+' channel')
+            print('       Messages:                  '+str(messages))
+            print('       Bytes:                     '+str(bytes))
+            print('       Active Messages:           '+str(active_messages))
+            if active_messages > 0:
+                print('       Messages per Active Message: %.2f' % \
+                        (float(messages) / active_messages))
+            print('       Flushes (explicit/full/size/delay/idle): '+
+                    str(explicit_flushes)+'/'+str(full_flushes)+'/'+
+                    str(size_flushes)+'/'+str(delay_flushes)+'/'+
+                    str(idle_flushes))
+        print
+
     def print_task_stats(self, verbose):
         print('****************************************************')
         print('   TASK STATS')
@@ -3059,6 +3146,7 @@ class State(object):
         self.print_processor_stats(verbose)
         self.print_memory_stats(verbose)
         self.print_channel_stats(verbose)
+        self.print_message_stats(verbose)
         self.print_task_stats(verbose)
 
     def assign_colors(self):
@@ -3880,6 +3968,12 @@ def main():
         '--stop-trim', dest='stop_trim', action='store',
         type=int, default=-1,
         help='stop time in micro-seconds to trim the profile')
+    parser.add_argument(
+        '--columnar', dest='columnar', action='store',
+        default=None,
+        help='convert the binary logs once into a columnar store in this '
+             'directory (reused while the logs are unchanged) and load only '
+             'the records overlapping the trim range from it')
     parser.add_argument(
         dest='filenames', nargs='+',
         help='input Legion Prof log filenames')
@@ -3903,16 +3997,29 @@ def main():
     has_matches = False
     has_binary_files = False # true if any of the files are a binary file
 
+    if args.columnar is not None:
+        store = LegionProfColumnarStore.open_or_build(args.columnar, file_names)
+        # The store only skips chunks that are entirely outside the trim
+        # range, the exact trimming below still happens as usual
+        total_matches = store.replay(state.callbacks,
+                                     start_trim if start_trim > 0 else None,
+                                     stop_trim if stop_trim > 0 else None)
+        print('Matched %s objects' % total_matches)
+        has_matches = total_matches > 0
+        file_names_to_parse = []
+    else:
+        file_names_to_parse = file_names
+
     asciiDeserializer = LegionProfASCIIDeserializer(state, state.callbacks)
     binaryDeserializer = LegionProfBinaryDeserializer(state, state.callbacks)
 
-    for file_name in file_names:
+    for file_name in file_names_to_parse:
         file_type, version = GetFileTypeInfo(file_name)
         if file_type == "binary":
             has_binary_files = True
             break
 
-    for file_name in file_names:
+    for file_name in file_names_to_parse:
         deserializer = None
         file_type, version = GetFileTypeInfo(file_name)
         if file_type == "binary":
@@ -18,7 +18,12 @@ from __future__ import absolute_import
 from __future__ import division
 from __future__ import print_function
 
+import array
+import heapq
 import inspect
+import json
+import mmap
+import os
 import re
 import struct
 import legion_spy
@@ -124,6 +129,8 @@ class LegionProfASCIIDeserializer(LegionDeserializer):
         "PartitionInfo": re.compile(prefix + r'Prof Partition Timeline (?P<op_id>[0-9]+) (?P<part_op>[0-9]+) (?P<create>[0-9]+) (?P<ready>[0-9]+) (?P<start>[0-9]+) (?P<stop>[0-9]+)'),
         "MapperCallInfo": re.compile(prefix + r'Prof Mapper Call Info (?P<kind>[0-9]+) (?P<proc_id>[a-f0-9]+) (?P<op_id>[0-9]+) (?P<start>[0-9]+) (?P<stop>[0-9]+)'),
         "RuntimeCallInfo": re.compile(prefix + r'Prof Runtime Call Info (?P<kind>[0-9]+) (?P<proc_id>[a-f0-9]+) (?P<start>[0-9]+) (?P<stop>[0-9]+)'),
+        "ReplaySliceInfo": re.compile(prefix + r'Prof Replay Slice Info (?P<slice_index>[0-9]+) (?P<num_instructions>[0-9]+) (?P<cost>[0-9]+) (?P<proc_id>[a-f0-9]+) (?P<start>[0-9]+) (?P<stop>[0-9]+)'),
+        "MessageChannelInfo": re.compile(prefix + r'Prof Message Channel Info (?P<channel>[0-9]+) (?P<messages>[0-9]+) (?P<bytes>[0-9]+) (?P<active_messages>[0-9]+) (?P<explicit_flushes>[0-9]+) (?P<full_flushes>[0-9]+) (?P<size_flushes>[0-9]+) (?P<delay_flushes>[0-9]+) (?P<idle_flushes>[0-9]+) (?P<proc_id>[a-f0-9]+)'),
         "ProfTaskInfo": re.compile(prefix + r'Prof ProfTask Info (?P<proc_id>[a-f0-9]+) (?P<op_id>[0-9]+) (?P<start>[0-9]+) (?P<stop>[0-9]+)')
         # "UserInfo": re.compile(prefix + r'Prof User Info (?P<proc_id>[a-f0-9]+) (?P<start>[0-9]+) (?P<stop>[0-9]+) (?P<name>[$()a-zA-Z0-9_]+)')
     }
@@ -175,6 +182,18 @@ class LegionProfASCIIDeserializer(LegionDeserializer):
         "eqk": int,
         "dim_kind": int,
         "dense_size": long_type,
+        "slice_index": int,
+        "num_instructions": int,
+        "cost": long_type,
+        "channel": int,
+        "messages": long_type,
+        "bytes": long_type,
+        "active_messages": long_type,
+        "explicit_flushes": long_type,
+        "full_flushes": long_type,
+        "size_flushes": long_type,
+        "delay_flushes": long_type,
+        "idle_flushes": long_type,
         "sparse_size": long_type,
         "name": lambda x: x,
         "desc": lambda x: x
@@ -244,7 +263,9 @@ class LegionProfBinaryDeserializer(LegionDeserializer):
     params_regex = re.compile(r', (?P<param_name>[^:]+):(?P<param_type>[^:]+):(?P<param_bytes>-?\d+)')
 
     preamble_data = {}
+    preamble_types = {}
     name_to_id = {}
+    id_to_name = {}
 
     # XXX: Make sure these are consistent with legion_profiling.h and legion_types.h!
     fmt_dict = {
@@ -281,9 +302,13 @@ class LegionProfBinaryDeserializer(LegionDeserializer):
             def string_reader(log):
                 string = ""
                 char = log.read(1).decode('utf-8')
+                if not char:
+                    raise EOFError("truncated string")
                 while ord(char) != 0:
                     string += char
                     char = log.read(1).decode('utf-8')
+                    if not char:
+                        raise EOFError("truncated string")
                 return string
             return string_reader
         if param_type == "point":
@@ -338,6 +363,7 @@ class LegionProfBinaryDeserializer(LegionDeserializer):
             _id = int(m.group('id'))
             params = m.group('params')
             param_data = []
+            param_types = []
             
             for param_m in LegionProfBinaryDeserializer.params_regex.finditer(params):
                 param_name = param_m.group('param_name')
@@ -347,9 +373,12 @@ class LegionProfBinaryDeserializer(LegionDeserializer):
                 reader = LegionProfBinaryDeserializer.create_type_reader(param_bytes, param_type) 
 
                 param_data.append((param_name, reader))
+                param_types.append((param_name, param_type))
 
             LegionProfBinaryDeserializer.preamble_data[_id] = param_data
+            LegionProfBinaryDeserializer.preamble_types[_id] = param_types
             LegionProfBinaryDeserializer.name_to_id[name] = _id
+            LegionProfBinaryDeserializer.id_to_name[_id] = name
 
 
         # change the callbacks to be by id
@@ -368,22 +397,42 @@ class LegionProfBinaryDeserializer(LegionDeserializer):
         #     callbacks_valid = callbacks_valid and cur_valid
         # assert callbacks_valid
 
+    def read_records(self, log, filename):
+        """Generator over (id, kwargs) for every complete record in a log"""
+        self.parse_preamble(log)
+        _id_raw = log.read(4)
+        while _id_raw:
+            if len(_id_raw) < 4:
+                print("WARNING: " + str(filename) + " is truncated")
+                break
+            _id = int(struct.unpack('i', _id_raw)[0])
+            param_data = LegionProfBinaryDeserializer.preamble_data[_id]
+            kwargs = {}
+            try:
+                for (param_name, reader) in param_data:
+                    val = reader(log)
+                    kwargs[param_name] = val
+            except (EOFError, struct.error):
+                # The runtime streams the profile out in chunks, so a
+                # run that did not shut down cleanly leaves a file that
+                # ends part way through a record (or gzip member)
+                print("WARNING: " + str(filename) + " is truncated, " +
+                      "ignoring its last incomplete record")
+                break
+            yield _id, kwargs
+            try:
+                _id_raw = log.read(4)
+            except EOFError:
+                print("WARNING: " + str(filename) + " is truncated")
+                break
+
     def parse(self, filename, verbose):
         print("parsing " + str(filename))
         def parse_file(log):
             matches = 0
-            self.parse_preamble(log)
-            _id_raw = log.read(4)
-            while _id_raw:
+            for _id, kwargs in self.read_records(log, filename):
                 matches += 1
-                _id = int(struct.unpack('i', _id_raw)[0])
-                param_data = LegionProfBinaryDeserializer.preamble_data[_id]
-                kwargs = {}
-                for (param_name, reader) in param_data:
-                    val = reader(log)
-                    kwargs[param_name] = val
                 self.callbacks[_id](**kwargs)
-                _id_raw = log.read(4)
             return matches
         try:
             # Try it as a gzip file first
@@ -413,3 +462,346 @@ def GetFileTypeInfo(filename):
     except IOError:
         with getFileObj(filename,compressed=False) as log:
             return parse_file(log)
+
+
+class LegionProfColumnarStore(object):
+    """A columnar copy of one or more binary Legion Prof logs
+
+    Logs are converted once into a directory holding one file per record
+    type and processor, each storing its fields column by column, and a
+    manifest describing them. Records with a time range are sorted by start
+    time and indexed in chunks of rows, so loading a time window only maps
+    in the chunks that overlap it instead of parsing the whole log again.
+    """
+
+    VERSION = 1
+    MANIFEST = "manifest.json"
+    CHUNK_ROWS = 4096
+    # Pairs of fields that give the time range of a record
+    TIME_FIELDS = (("start", "stop"), ("create", "destroy"))
+    # Wait records always directly follow the record of the task or meta
+    # task that waited, and are only loaded together with that record
+    OWNER_RECORDS = ("TaskInfo", "GPUTaskInfo", "MetaInfo")
+    ATTACHED_RECORDS = ("TaskWaitInfo", "MetaWaitInfo")
+
+    def __init__(self, directory, manifest):
+        self.directory = directory
+        self.manifest = manifest
+        self.strings = manifest["strings"]
+        self.partitions = manifest["partitions"]
+        self.mapped = {}
+
+    @staticmethod
+    def source_info(filenames):
+        info = []
+        for filename in filenames:
+            stat = os.stat(filename)
+            info.append([os.path.abspath(filename), stat.st_size,
+                         int(stat.st_mtime)])
+        return info
+
+    @classmethod
+    def open(cls, directory, filenames=None):
+        """Open an existing store, returns None if it is missing or stale"""
+        try:
+            with open(os.path.join(directory, cls.MANIFEST), "r") as f:
+                manifest = json.load(f)
+        except (IOError, ValueError):
+            return None
+        if manifest.get("version") != cls.VERSION:
+            return None
+        if filenames is not None and \
+                manifest["sources"] != cls.source_info(filenames):
+            return None
+        return cls(directory, manifest)
+
+    @classmethod
+    def open_or_build(cls, directory, filenames):
+        store = cls.open(directory, filenames)
+        if store is None:
+            store = cls.build(directory, filenames)
+        return store
+
+    @classmethod
+    def build(cls, directory, filenames):
+        """Convert binary logs into a new store in directory"""
+        if not os.path.exists(directory):
+            os.makedirs(directory)
+        strings = []
+        string_ids = {}
+        # (record name, partition) -> [fields, columns, seq column,
+        #                               owner seq column]
+        partitions = {}
+        # Global order of the records across all the logs
+        next_seq = [0]
+        last_owner = [0]
+        for filename in filenames:
+            file_type, version = GetFileTypeInfo(filename)
+            if file_type != "binary":
+                raise ValueError("Only binary logs can be converted to a " +
+                                 "columnar store: " + str(filename))
+            print("converting " + str(filename))
+            deserializer = LegionProfBinaryDeserializer(None, {})
+            def convert_file(log):
+                count = 0
+                for _id, kwargs in deserializer.read_records(log, filename):
+                    name = deserializer.id_to_name[_id]
+                    key = (name, kwargs.get("proc_id", -1))
+                    part = partitions.get(key)
+                    if part is None:
+                        fields = []
+                        columns = []
+                        for param_name, param_type in \
+                                LegionProfBinaryDeserializer.preamble_types[_id]:
+                            value = kwargs[param_name]
+                            width = len(value) if isinstance(value, list) else 1
+                            if param_type == "string":
+                                fmt = "I"
+                            elif param_type == "timestamp_t":
+                                # Already converted to microseconds
+                                fmt = "d"
+                            elif param_type == "bool":
+                                # Arrays have no bool type
+                                fmt = "B"
+                            else:
+                                fmt = LegionProfBinaryDeserializer.fmt_dict[param_type]
+                            fields.append([param_name, param_type, fmt, width])
+                            columns.append(array.array(fmt))
+                        part = partitions[key] = [fields, columns,
+                            array.array("Q"), array.array("Q")]
+                    fields, columns, seqs, owners = part
+                    for (param_name, param_type, fmt, width), column in \
+                            zip(fields, columns):
+                        value = kwargs[param_name]
+                        if param_type == "string":
+                            index = string_ids.get(value)
+                            if index is None:
+                                index = string_ids[value] = len(strings)
+                                strings.append(value)
+                            column.append(index)
+                        elif width > 1:
+                            column.extend(value)
+                        else:
+                            column.append(value)
+                    seqs.append(next_seq[0])
+                    if name in cls.OWNER_RECORDS:
+                        last_owner[0] = next_seq[0]
+                    elif name in cls.ATTACHED_RECORDS:
+                        owners.append(last_owner[0])
+                    next_seq[0] += 1
+                    count += 1
+                return count
+            try:
+                with getFileObj(filename, compressed=True) as log:
+                    count = convert_file(log)
+            except IOError:
+                with getFileObj(filename, compressed=False) as log:
+                    count = convert_file(log)
+            print("Converted %d records" % count)
+
+        manifest = {
+            "version": cls.VERSION,
+            "sources": cls.source_info(filenames),
+            "strings": strings,
+            "partitions": [],
+        }
+        for (name, proc_id), (fields, columns, seqs, owners) in \
+                sorted(iteritems(partitions), key=lambda kv: kv[0]):
+            rows = len(seqs)
+            field_names = [field[0] for field in fields]
+            time_range = None
+            for start, stop in cls.TIME_FIELDS:
+                if start in field_names and stop in field_names:
+                    time_range = (field_names.index(start),
+                                  field_names.index(stop))
+                    break
+            chunks = []
+            if time_range is not None:
+                starts = columns[time_range[0]]
+                order = sorted(range(rows), key=starts.__getitem__)
+                def permute(column, width):
+                    if width == 1:
+                        return array.array(column.typecode,
+                                           (column[i] for i in order))
+                    result = array.array(column.typecode)
+                    for i in order:
+                        result.extend(column[i*width:(i+1)*width])
+                    return result
+                columns = [permute(column, field[3])
+                           for field, column in zip(fields, columns)]
+                seqs = permute(seqs, 1)
+                if owners:
+                    owners = permute(owners, 1)
+                starts = columns[time_range[0]]
+                stops = columns[time_range[1]]
+                for first in range(0, rows, cls.CHUNK_ROWS):
+                    last = min(first + cls.CHUNK_ROWS, rows)
+                    chunks.append([first, last, starts[first],
+                                   max(stops[first:last])])
+            filename = "%s.%s.col" % (name, "all" if proc_id == -1
+                                      else "%x" % proc_id)
+            layout = []
+            offset = 0
+            with open(os.path.join(directory, filename), "wb") as f:
+                for column in [seqs, owners] + columns:
+                    data = column.tobytes() if hasattr(column, "tobytes") \
+                        else column.tostring()
+                    # Keep every column aligned for the memoryview casts
+                    padding = (-len(data)) % 8
+                    f.write(data + b"\0" * padding)
+                    layout.append(offset)
+                    offset += len(data) + padding
+            manifest["partitions"].append({
+                "name": name,
+                "proc_id": proc_id,
+                "file": filename,
+                "rows": rows,
+                "fields": fields,
+                "offsets": layout,
+                "time_range": time_range,
+                "chunks": chunks,
+                "attached": name in cls.ATTACHED_RECORDS,
+            })
+        # Write the manifest last so an interrupted conversion is stale
+        with open(os.path.join(directory, cls.MANIFEST), "w") as f:
+            json.dump(manifest, f)
+        return cls(directory, manifest)
+
+    def columns(self, part):
+        """Memory map the columns of a partition, the first two are the
+        record seq and the seq of the owner of attached records"""
+        mapped = self.mapped.get(part["file"])
+        if mapped is None:
+            with open(os.path.join(self.directory, part["file"]), "rb") as f:
+                mm = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+            view = memoryview(mm)
+            rows = part["rows"]
+            mapped = []
+            formats = ["Q", "Q"] + [field[2] for field in part["fields"]]
+            widths = [1, 1 if part["attached"] else 0] + \
+                [field[3] for field in part["fields"]]
+            for offset, fmt, width in zip(part["offsets"], formats, widths):
+                size = struct.calcsize(fmt) * rows * width
+                if hasattr(view, "cast"):
+                    mapped.append(view[offset:offset+size].cast(fmt))
+                else:
+                    # Python 2 can't view the mapping as typed memory so
+                    # it has to copy each column it touches instead
+                    column = array.array("B" if fmt == "?" else fmt)
+                    column.fromstring(mm[offset:offset+size])
+                    mapped.append(column)
+            self.mapped[part["file"]] = mapped
+        return mapped
+
+    def find_partitions(self, name=None, proc_id=None):
+        for part in self.partitions:
+            if name is not None and part["name"] != name:
+                continue
+            if proc_id is not None and part["proc_id"] != proc_id:
+                continue
+            yield part
+
+    def row_ranges(self, part, start, stop):
+        """The rows of a partition that may overlap [start, stop]"""
+        if part["time_range"] is None or (start is None and stop is None):
+            return [(0, part["rows"])]
+        ranges = []
+        for first, last, min_start, max_stop in part["chunks"]:
+            if stop is not None and min_start > stop:
+                # Chunks are sorted by start time so we're done
+                break
+            if start is not None and max_stop < start:
+                continue
+            if ranges and ranges[-1][1] == first:
+                ranges[-1] = (ranges[-1][0], last)
+            else:
+                ranges.append((first, last))
+        return ranges
+
+    def iter_rows(self, part, start=None, stop=None):
+        """Generator over (seq, owner seq, kwargs) of the records of a
+        partition, skipping timed records that do not overlap [start, stop]"""
+        columns = self.columns(part)
+        fields = part["fields"]
+        time_range = part["time_range"]
+        for first, last in self.row_ranges(part, start, stop):
+            for row in range(first, last):
+                if time_range is not None:
+                    if start is not None and \
+                            columns[time_range[1]+2][row] < start:
+                        continue
+                    if stop is not None and \
+                            columns[time_range[0]+2][row] > stop:
+                        continue
+                kwargs = {}
+                for (param_name, param_type, fmt, width), column in \
+                        zip(fields, columns[2:]):
+                    if param_type == "string":
+                        kwargs[param_name] = self.strings[column[row]]
+                    elif param_type == "bool":
+                        kwargs[param_name] = bool(column[row])
+                    elif width > 1:
+                        kwargs[param_name] = list(column[row*width:(row+1)*width])
+                    else:
+                        kwargs[param_name] = column[row]
+                yield columns[0][row], \
+                    columns[1][row] if part["attached"] else None, kwargs
+
+    def replay(self, callbacks, start=None, stop=None):
+        """Feed the records to the callbacks of a deserializer state
+
+        Records without a time range (descriptors, kinds, variants, etc.)
+        are always replayed first and in their original order, then only
+        the timed records that overlap [start, stop] follow, and finally
+        the wait records of the tasks that were replayed.
+        """
+        matches = 0
+        untimed = []
+        timed = []
+        attached = []
+        for part in self.partitions:
+            if part["name"] not in callbacks:
+                continue
+            if part["attached"]:
+                attached.append(part)
+            elif part["time_range"] is None:
+                untimed.append(part)
+            else:
+                timed.append(part)
+        def tagged(part):
+            for seq, owner, kwargs in self.iter_rows(part):
+                yield seq, part["name"], kwargs
+        for seq, name, kwargs in heapq.merge(*[tagged(part) for part in untimed]):
+            callbacks[name](**kwargs)
+            matches += 1
+        windowed = start is not None or stop is not None
+        owners = set()
+        for part in timed:
+            callback = callbacks[part["name"]]
+            track = windowed and part["name"] in self.OWNER_RECORDS
+            for seq, owner, kwargs in self.iter_rows(part, start, stop):
+                callback(**kwargs)
+                if track:
+                    owners.add(seq)
+                matches += 1
+        for part in attached:
+            callback = callbacks[part["name"]]
+            for seq, owner, kwargs in self.iter_rows(part):
+                if windowed and owner not in owners:
+                    continue
+                callback(**kwargs)
+                matches += 1
+        return matches
+
+    def time_range(self):
+        """The earliest start and latest stop of any timed record"""
+        first = None
+        last = None
+        for part in self.partitions:
+            if not part["chunks"]:
+                continue
+            min_start = part["chunks"][0][2]
+            max_stop = max(chunk[3] for chunk in part["chunks"])
+            first = min_start if first is None else min(first, min_start)
+            last = max_stop if last is None else max(last, max_stop)
+        return first, last
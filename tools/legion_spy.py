@@ -10023,6 +10023,59 @@ barrier_wait_pat        = re.compile(
 replay_op_pat           = re.compile(
     prefix+"Replay Operation (?P<uid>[0-9]+)")
 
+binary_spy_header = b'FileType: BinaryLegionSpy'
+c_conversion_pat = re.compile(r'%(?:ll|l|z)?([diuxs])')
+
+def decode_varint(data, offset):
+    value = 0
+    shift = 0
+    while True:
+        byte = data[offset]
+        offset += 1
+        value |= (byte & 0x7f) << shift
+        if byte < 0x80:
+            return value, offset
+        shift += 7
+
+def read_binary_spy_lines(log):
+    # Decode a log written with -lg:spy_logfile back into the text lines
+    # that the patterns above match. See BinarySpyLog in legion_spy.cc
+    # for a description of the format.
+    header = log.readline().decode('ascii')
+    node = int(header.split()[-1])
+    line_prefix = '[%d - 0] {3}{legion_spy}: ' % node
+    data = bytearray(log.read())
+    formats = dict()
+    offset = 0
+    try:
+        while offset < len(data):
+            tag, offset = decode_varint(data, offset)
+            if tag == 0:
+                fid, offset = decode_varint(data, offset)
+                length, offset = decode_varint(data, offset)
+                fmt = data[offset:offset+length].decode('ascii')
+                offset += length
+                kinds = c_conversion_pat.findall(fmt)
+                fmt = c_conversion_pat.sub(lambda m: '%x' if m.group(1) == 'x'
+                        else '%s' if m.group(1) == 's' else '%d', fmt)
+                formats[fid] = (fmt, kinds)
+                continue
+            fmt, kinds = formats[tag]
+            args = list()
+            for kind in kinds:
+                value, offset = decode_varint(data, offset)
+                if kind == 's':
+                    args.append(data[offset:offset+value].decode('ascii'))
+                    offset += value
+                elif kind in 'di':
+                    # Signed values are zig-zag encoded
+                    args.append((value >> 1) ^ -(value & 1))
+                else:
+                    args.append(value)
+            yield line_prefix + (fmt % tuple(args)) + '\n'
+    except IndexError:
+        print('WARNING: binary log is truncated, the job may have crashed')
+
 def parse_legion_spy_line(line, state):
     # Quick test to see if the line is even worth considering
     m = prefix_pat.match(line)
@@ -10971,7 +11024,10 @@ class State(object):
     def parse_log_file(self, file_name):
         print('Reading log file %s...' % file_name)
         try:
-            log = open(file_name, 'r')
+            log = open(file_name, 'rb')
+            binary = log.read(len(binary_spy_header)) == binary_spy_header
+            log.close()
+            log = open(file_name, 'rb' if binary else 'r')
         except:
             print('ERROR: Unable to find file '+file_name)
             print('Legion Spy will now exit')
@@ -10980,7 +11036,8 @@ class State(object):
             with log:
                 matches = 0
                 skipped = 0
-                for line in log:
+                lines = read_binary_spy_lines(log) if binary else log
+                for line in lines:
                     if parse_legion_spy_line(line, self):
                         matches += 1
                     else:
@@ -0,0 +1,664 @@
+/* Copyright 2020 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Native loader for the binary Legion Spy logs written with
+// -lg:spy_logfile. It can convert the logs back into the text format
+// that legion_spy.py parses, and it performs the checks of the event
+// graph and the mapping dependences that legion_spy.py does after
+// loading a log, which is where most of its time goes on large runs.
+//
+//   g++ -O2 -std=c++11 -o legion_spy_loader legion_spy_loader.cc
+//   legion_spy_loader [-t] [-c] [-d] [-l] [-s] spy_*.log
+//
+//  -t : print the records as text lines for legion_spy.py
+//  -c : check the event graph for cycles
+//  -d : check that mapping dependences follow program order and
+//       only name operations that were fully logged
+//  -l : report user events that were never triggered
+//  -s : print the number of records of each kind
+//
+// With no options it runs all of the checks.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+typedef unsigned long long u64;
+
+// The records that the checks look at, identified by the text before the
+// first conversion in their format string
+enum RecordKind {
+  OTHER_RECORD,
+  EVENT_EVENT,
+  OPERATION_EVENTS,
+  COPY_EVENTS,
+  INDIRECT_EVENTS,
+  FILL_EVENTS,
+  DEPPART_EVENTS,
+  BARRIER_ARRIVE,
+  BARRIER_WAIT,
+  AP_USER_EVENT,
+  RT_USER_EVENT,
+  PRED_EVENT,
+  AP_USER_EVENT_TRIGGER,
+  RT_USER_EVENT_TRIGGER,
+  PRED_EVENT_TRIGGER,
+  MAPPING_DEPENDENCE,
+  OPERATION_INDEX,
+  CLOSE_INDEX,
+};
+
+static const struct {
+  const char *text;
+  RecordKind kind;
+} record_kinds[] = {
+  { "Event Event ", EVENT_EVENT },
+  { "Operation Events ", OPERATION_EVENTS },
+  { "Copy Events ", COPY_EVENTS },
+  { "Indirect Events ", INDIRECT_EVENTS },
+  { "Fill Events ", FILL_EVENTS },
+  { "Deppart Events ", DEPPART_EVENTS },
+  { "Phase Barrier Arrive ", BARRIER_ARRIVE },
+  { "Phase Barrier Wait ", BARRIER_WAIT },
+  { "Ap User Event ", AP_USER_EVENT },
+  { "Rt User Event ", RT_USER_EVENT },
+  { "Pred Event ", PRED_EVENT },
+  { "Ap User Event Trigger ", AP_USER_EVENT_TRIGGER },
+  { "Rt User Event Trigger ", RT_USER_EVENT_TRIGGER },
+  { "Pred Event Trigger ", PRED_EVENT_TRIGGER },
+  { "Mapping Dependence ", MAPPING_DEPENDENCE },
+  { "Operation Index ", OPERATION_INDEX },
+  { "Close Index ", CLOSE_INDEX },
+};
+
+struct Format {
+  std::string text;
+  // one of 'd' (signed), 'u' (unsigned), 'x' (hex) or 's' (string)
+  // for each conversion
+  std::string args;
+  RecordKind kind;
+  u64 count;
+};
+
+struct Record {
+  const Format *format;
+  std::vector<u64> values;  // signed values are stored two's complement
+  std::vector<std::string> strings;
+};
+
+class BinaryReader {
+public:
+  BinaryReader(FILE *_f) : f(_f), pos(0), len(0) {}
+
+  bool at_end(void)
+  {
+    return (pos == len) && !refill();
+  }
+
+  bool read_byte(unsigned char &byte)
+  {
+    if((pos == len) && !refill())
+      return false;
+    byte = buffer[pos++];
+    return true;
+  }
+
+  bool read_varint(u64 &value)
+  {
+    value = 0;
+    unsigned shift = 0;
+    unsigned char byte;
+    do {
+      if(!read_byte(byte))
+        return false;
+      value |= u64(byte & 0x7f) << shift;
+      shift += 7;
+    } while(byte & 0x80);
+    return true;
+  }
+
+  bool read_string(std::string &str)
+  {
+    u64 size;
+    if(!read_varint(size))
+      return false;
+    str.resize(size);
+    for(u64 i = 0; i < size; i++) {
+      unsigned char byte;
+      if(!read_byte(byte))
+        return false;
+      str[i] = byte;
+    }
+    return true;
+  }
+
+protected:
+  bool refill(void)
+  {
+    len = fread(buffer, 1, sizeof(buffer), f);
+    pos = 0;
+    return (len > 0);
+  }
+
+  FILE *f;
+  size_t pos, len;
+  unsigned char buffer[1 << 20];
+};
+
+class SpyLoader {
+public:
+  SpyLoader(void) : print_text(false), truncated_files(0) {}
+
+  bool load_file(const char *filename);
+  bool check_cycles(void);
+  bool check_dependences(void);
+  bool check_user_events(void);
+  void print_statistics(void);
+
+  bool print_text;
+
+protected:
+  void handle_record(const Record &rec, int node);
+  void print_record(const Record &rec, int node);
+
+  // the event graph has a node for every event and every operation,
+  //  copy, fill and dependent partitioning operation
+  unsigned event_node(u64 id);
+  unsigned op_node(u64 uid);
+  unsigned realm_node(char kind, u64 post);
+  void add_edge(unsigned src, unsigned dst);
+  static const unsigned NO_NODE = unsigned(-1);
+
+  std::vector<Format> formats;
+  std::unordered_map<u64, unsigned> event_nodes, op_nodes, realm_nodes;
+  std::vector<std::pair<char, u64> > node_names;
+  std::vector<std::pair<unsigned, unsigned> > edges;
+
+  struct Dependence {
+    u64 context, prev, next;
+    unsigned prev_idx, next_idx, type;
+  };
+  std::vector<Dependence> dependences;
+  std::unordered_map<u64, long long> op_indexes;
+  std::unordered_set<u64> logged_ops;
+
+  std::unordered_map<u64, char> user_events;
+  std::unordered_set<u64> triggered_events;
+
+  unsigned truncated_files;
+};
+
+bool SpyLoader::load_file(const char *filename)
+{
+  FILE *f = fopen(filename, "rb");
+  if(!f) {
+    fprintf(stderr, "could not open %s\n", filename);
+    return false;
+  }
+  int node = -1;
+  if(fscanf(f, "FileType: BinaryLegionSpy v: 1.0 node: %d\n", &node) != 1) {
+    fprintf(stderr, "%s is not a binary Legion Spy log\n", filename);
+    fclose(f);
+    return false;
+  }
+
+  // format ids are local to each file
+  std::vector<unsigned> file_formats;
+  BinaryReader reader(f);
+  Record rec;
+  bool ok = true;
+  while(ok && !reader.at_end()) {
+    u64 tag;
+    if(!reader.read_varint(tag)) {
+      ok = false;
+      break;
+    }
+    if(tag == 0) {
+      u64 id;
+      Format fmt;
+      if(!reader.read_varint(id) || !reader.read_string(fmt.text)) {
+        ok = false;
+        break;
+      }
+      fmt.kind = OTHER_RECORD;
+      size_t prefix = fmt.text.find('%');
+      std::string text = fmt.text.substr(0, prefix);
+      for(size_t i = 0; i < sizeof(record_kinds) / sizeof(record_kinds[0]); i++)
+        if(text == record_kinds[i].text)
+          fmt.kind = record_kinds[i].kind;
+      for(size_t i = fmt.text.find('%'); i != std::string::npos;
+          i = fmt.text.find('%', i + 1)) {
+        size_t j = i + 1;
+        while((fmt.text[j] == 'l') || (fmt.text[j] == 'z'))
+          j++;
+        char conv = fmt.text[j];
+        fmt.args.push_back(((conv == 'd') || (conv == 'i')) ? 'd' : conv);
+      }
+      fmt.count = 0;
+      if(file_formats.size() <= id)
+        file_formats.resize(id + 1, unsigned(-1));
+      // identical formats from different files share an entry
+      unsigned index = formats.size();
+      for(unsigned i = 0; i < formats.size(); i++)
+        if(formats[i].text == fmt.text) {
+          index = i;
+          break;
+        }
+      if(index == formats.size())
+        formats.push_back(fmt);
+      file_formats[id] = index;
+      continue;
+    }
+    if((tag >= file_formats.size()) || (file_formats[tag] == unsigned(-1))) {
+      fprintf(stderr, "%s: record with unknown format %llu\n", filename, tag);
+      fclose(f);
+      return false;
+    }
+    Format &fmt = formats[file_formats[tag]];
+    rec.format = &fmt;
+    rec.values.clear();
+    rec.strings.clear();
+    for(size_t i = 0; ok && (i < fmt.args.size()); i++) {
+      if(fmt.args[i] == 's') {
+        rec.strings.push_back(std::string());
+        ok = reader.read_string(rec.strings.back());
+      } else {
+        u64 value;
+        ok = reader.read_varint(value);
+        // undo the zig-zag encoding of signed values
+        if(fmt.args[i] == 'd')
+          value = (value >> 1) ^ (0 - (value & 1));
+        rec.values.push_back(value);
+      }
+    }
+    if(!ok)
+      break;
+    fmt.count++;
+    if(print_text)
+      print_record(rec, node);
+    handle_record(rec, node);
+  }
+  if(!ok) {
+    // this is what a log looks like when the job crashed
+    fprintf(stderr, "warning: %s is truncated\n", filename);
+    truncated_files++;
+  }
+  fclose(f);
+  return true;
+}
+
+void SpyLoader::print_record(const Record &rec, int node)
+{
+  const std::string &text = rec.format->text;
+  std::string line;
+  char buffer[32];
+  size_t value = 0, string = 0;
+  for(size_t i = 0; i < text.size(); i++) {
+    if(text[i] != '%') {
+      line.push_back(text[i]);
+      continue;
+    }
+    i++;
+    while((text[i] == 'l') || (text[i] == 'z'))
+      i++;
+    switch(text[i]) {
+    case 's':
+      line += rec.strings[string++];
+      break;
+    case 'x':
+      snprintf(buffer, sizeof(buffer), "%llx", rec.values[value++]);
+      line += buffer;
+      break;
+    case 'u':
+      snprintf(buffer, sizeof(buffer), "%llu", rec.values[value++]);
+      line += buffer;
+      break;
+    default:
+      snprintf(buffer, sizeof(buffer), "%lld", (long long)rec.values[value++]);
+      line += buffer;
+      break;
+    }
+  }
+  printf("[%d - 0] {3}{legion_spy}: %s\n", node, line.c_str());
+}
+
+unsigned SpyLoader::event_node(u64 id)
+{
+  // nothing can be ordered by the absence of an event
+  if(id == 0)
+    return NO_NODE;
+  std::unordered_map<u64, unsigned>::const_iterator finder =
+    event_nodes.find(id);
+  if(finder != event_nodes.end())
+    return finder->second;
+  unsigned result = node_names.size();
+  node_names.push_back(std::make_pair('e', id));
+  event_nodes[id] = result;
+  return result;
+}
+
+unsigned SpyLoader::op_node(u64 uid)
+{
+  std::unordered_map<u64, unsigned>::const_iterator finder = op_nodes.find(uid);
+  if(finder != op_nodes.end())
+    return finder->second;
+  unsigned result = node_names.size();
+  node_names.push_back(std::make_pair('o', uid));
+  op_nodes[uid] = result;
+  return result;
+}
+
+unsigned SpyLoader::realm_node(char kind, u64 post)
+{
+  // realm operations are named by their completion event like legion_spy.py
+  std::unordered_map<u64, unsigned>::const_iterator finder =
+    realm_nodes.find(post);
+  if(finder != realm_nodes.end())
+    return finder->second;
+  unsigned result = node_names.size();
+  node_names.push_back(std::make_pair(kind, post));
+  realm_nodes[post] = result;
+  return result;
+}
+
+void SpyLoader::add_edge(unsigned src, unsigned dst)
+{
+  if((src == NO_NODE) || (dst == NO_NODE))
+    return;
+  edges.push_back(std::make_pair(src, dst));
+}
+
+void SpyLoader::handle_record(const Record &rec, int node)
+{
+  const std::vector<u64> &v = rec.values;
+  switch(rec.format->kind) {
+  case EVENT_EVENT:
+    add_edge(event_node(v[0]), event_node(v[1]));
+    break;
+  case OPERATION_EVENTS:
+    {
+      unsigned op = op_node(v[0]);
+      add_edge(event_node(v[1]), op);
+      add_edge(op, event_node(v[2]));
+      logged_ops.insert(v[0]);
+      break;
+    }
+  case COPY_EVENTS:
+  case INDIRECT_EVENTS:
+  case FILL_EVENTS:
+  case DEPPART_EVENTS:
+    {
+      // the pre event comes right before the post event in all of these
+      size_t post = (rec.format->kind == COPY_EVENTS) ? 5 :
+                    (rec.format->kind == INDIRECT_EVENTS) ? 4 :
+                    (rec.format->kind == FILL_EVENTS) ? 5 : 3;
+      char kind = (rec.format->kind == FILL_EVENTS) ? 'f' :
+                  (rec.format->kind == DEPPART_EVENTS) ? 'p' : 'c';
+      unsigned realm_op = realm_node(kind, v[post]);
+      add_edge(event_node(v[post - 1]), realm_op);
+      add_edge(realm_op, event_node(v[post]));
+      break;
+    }
+  case BARRIER_ARRIVE:
+    add_edge(op_node(v[0]), event_node(v[1]));
+    break;
+  case BARRIER_WAIT:
+    add_edge(event_node(v[1]), op_node(v[0]));
+    break;
+  case AP_USER_EVENT:
+    user_events[v[0]] = 'a';
+    break;
+  case RT_USER_EVENT:
+    user_events[v[0]] = 'r';
+    break;
+  case PRED_EVENT:
+    user_events[v[0]] = 'p';
+    break;
+  case AP_USER_EVENT_TRIGGER:
+  case RT_USER_EVENT_TRIGGER:
+  case PRED_EVENT_TRIGGER:
+    triggered_events.insert(v[0]);
+    break;
+  case MAPPING_DEPENDENCE:
+    {
+      Dependence dep;
+      dep.context = v[0];
+      dep.prev = v[1];
+      dep.prev_idx = v[2];
+      dep.next = v[3];
+      dep.next_idx = v[4];
+      dep.type = v[5];
+      dependences.push_back(dep);
+      break;
+    }
+  case OPERATION_INDEX:
+  case CLOSE_INDEX:
+    // close operations get the index of the operation that made them
+    op_indexes[v[2]] = v[1];
+    break;
+  default:
+    break;
+  }
+}
+
+static void print_node(const std::pair<char, u64> &name)
+{
+  switch(name.first) {
+  case 'e':
+    printf("  Event %llx\n", name.second);
+    break;
+  case 'o':
+    printf("  Operation %llu\n", name.second);
+    break;
+  case 'c':
+    printf("  Realm Copy (%llx)\n", name.second);
+    break;
+  case 'f':
+    printf("  Realm Fill (%llx)\n", name.second);
+    break;
+  case 'p':
+    printf("  Realm Deppart (%llx)\n", name.second);
+    break;
+  }
+}
+
+bool SpyLoader::check_cycles(void)
+{
+  printf("Checking for cycles in %zd nodes and %zd edges...\n",
+         node_names.size(), edges.size());
+  // build a compressed adjacency list
+  const size_t num_nodes = node_names.size();
+  std::vector<size_t> offsets(num_nodes + 1, 0);
+  for(size_t i = 0; i < edges.size(); i++)
+    offsets[edges[i].first + 1]++;
+  for(size_t i = 0; i < num_nodes; i++)
+    offsets[i + 1] += offsets[i];
+  std::vector<unsigned> targets(edges.size());
+  {
+    std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+    for(size_t i = 0; i < edges.size(); i++)
+      targets[fill[edges[i].first]++] = edges[i].second;
+  }
+
+  // an iterative version of Tarjan's algorithm - any strongly connected
+  //  component with more than one node (or a self edge) is a cycle
+  const unsigned UNVISITED = unsigned(-1);
+  std::vector<unsigned> index(num_nodes, UNVISITED), lowlink(num_nodes, 0);
+  std::vector<bool> on_stack(num_nodes, false);
+  std::vector<unsigned> stack;
+  std::vector<std::pair<unsigned, size_t> > work;
+  unsigned next_index = 0;
+  for(unsigned root = 0; root < num_nodes; root++) {
+    if(index[root] != UNVISITED)
+      continue;
+    work.push_back(std::make_pair(root, offsets[root]));
+    index[root] = lowlink[root] = next_index++;
+    stack.push_back(root);
+    on_stack[root] = true;
+    while(!work.empty()) {
+      unsigned node = work.back().first;
+      size_t &edge = work.back().second;
+      if(edge < offsets[node + 1]) {
+        unsigned next = targets[edge++];
+        if(next == node) {
+          printf("SELF CYCLE DETECTED!\n");
+          print_node(node_names[node]);
+          return false;
+        }
+        if(index[next] == UNVISITED) {
+          index[next] = lowlink[next] = next_index++;
+          stack.push_back(next);
+          on_stack[next] = true;
+          work.push_back(std::make_pair(next, offsets[next]));
+        } else if(on_stack[next] && (index[next] < lowlink[node]))
+          lowlink[node] = index[next];
+        continue;
+      }
+      work.pop_back();
+      if(!work.empty()) {
+        unsigned parent = work.back().first;
+        if(lowlink[node] < lowlink[parent])
+          lowlink[parent] = lowlink[node];
+      }
+      if(lowlink[node] == index[node]) {
+        unsigned last = stack.back();
+        stack.pop_back();
+        on_stack[last] = false;
+        if(last != node) {
+          printf("CYCLE DETECTED!\n");
+          print_node(node_names[last]);
+          while(last != node) {
+            last = stack.back();
+            stack.pop_back();
+            print_node(node_names[last]);
+          }
+          return false;
+        }
+      }
+    }
+  }
+  printf("No cycles detected\n");
+  return true;
+}
+
+bool SpyLoader::check_dependences(void)
+{
+  printf("Checking %zd mapping dependences...\n", dependences.size());
+  bool success = true;
+  size_t unlogged = 0;
+  for(size_t i = 0; i < dependences.size(); i++) {
+    const Dependence &dep = dependences[i];
+    if(dep.prev == dep.next) {
+      printf("ERROR: operation %llu depends on itself in context %llu\n",
+             dep.prev, dep.context);
+      success = false;
+      continue;
+    }
+    // a dependence can never point forward in program order
+    std::unordered_map<u64, long long>::const_iterator prev =
+      op_indexes.find(dep.prev);
+    std::unordered_map<u64, long long>::const_iterator next =
+      op_indexes.find(dep.next);
+    if((prev != op_indexes.end()) && (next != op_indexes.end()) &&
+       (prev->second > next->second)) {
+      printf("ERROR: operation %llu (index %lld) depends on later "
+             "operation %llu (index %lld) in context %llu\n",
+             dep.next, next->second, dep.prev, prev->second, dep.context);
+      success = false;
+    }
+    if(logged_ops.find(dep.next) == logged_ops.end())
+      unlogged++;
+  }
+  if(unlogged > 0)
+    printf("WARNING: %zd dependences are on operations that were not "
+           "fully logged\n", unlogged);
+  printf("%s\n", success ? "Pass" : "FAIL");
+  return success;
+}
+
+bool SpyLoader::check_user_events(void)
+{
+  size_t leaks = 0;
+  for(std::unordered_map<u64, char>::const_iterator it = user_events.begin();
+      it != user_events.end(); it++) {
+    if(triggered_events.find(it->first) != triggered_events.end())
+      continue;
+    printf("WARNING: Event %llx is an untriggered %s event\n", it->first,
+           (it->second == 'a') ? "application user" :
+           (it->second == 'r') ? "runtime user" : "predicate");
+    leaks++;
+  }
+  printf("%zd of %zd user events were never triggered\n",
+         leaks, user_events.size());
+  return (leaks == 0);
+}
+
+void SpyLoader::print_statistics(void)
+{
+  u64 total = 0;
+  for(size_t i = 0; i < formats.size(); i++) {
+    printf("%12llu  %s\n", formats[i].count, formats[i].text.c_str());
+    total += formats[i].count;
+  }
+  printf("%12llu  total records in %zd formats\n", total, formats.size());
+  if(truncated_files > 0)
+    printf("%12u  truncated files\n", truncated_files);
+}
+
+int main(int argc, char **argv)
+{
+  SpyLoader loader;
+  bool cycles = false, deps = false, leaks = false, stats = false;
+  std::vector<const char *> files;
+  for(int i = 1; i < argc; i++) {
+    if(!strcmp(argv[i], "-t"))
+      loader.print_text = true;
+    else if(!strcmp(argv[i], "-c"))
+      cycles = true;
+    else if(!strcmp(argv[i], "-d"))
+      deps = true;
+    else if(!strcmp(argv[i], "-l"))
+      leaks = true;
+    else if(!strcmp(argv[i], "-s"))
+      stats = true;
+    else if(argv[i][0] == '-') {
+      fprintf(stderr, "usage: %s [-t] [-c] [-d] [-l] [-s] files...\n", argv[0]);
+      return 1;
+    } else
+      files.push_back(argv[i]);
+  }
+  if(!loader.print_text && !cycles && !deps && !leaks && !stats)
+    cycles = deps = leaks = stats = true;
+
+  for(size_t i = 0; i < files.size(); i++)
+    if(!loader.load_file(files[i]))
+      return 1;
+
+  bool success = true;
+  if(cycles && !loader.check_cycles())
+    success = false;
+  if(deps && !loader.check_dependences())
+    success = false;
+  if(leaks)
+    loader.check_user_events();
+  if(stats)
+    loader.print_statistics();
+  return success ? 0 : 2;
+}
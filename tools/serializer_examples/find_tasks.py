@@ -97,6 +97,8 @@ callbacks = {
     "MessageInfo": noop,
     "MapperCallInfo": noop,
     "RuntimeCallInfo": noop,
+    "ReplaySliceInfo": noop,
+    "MessageChannelInfo": noop,
     "ProfTaskInfo": noop,
     "ProcMDesc": noop,
     "IndexSpacePointDesc": noop,